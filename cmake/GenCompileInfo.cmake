@@ -18,6 +18,7 @@ function(generate_compile_info)
             "WITH_FFMPEGTHUMBNAILER=${WITH_FFMPEGTHUMBNAILER}"
             "WITH_EXIF=${WITH_EXIF}"
             "WITH_EXIV2=${WITH_EXIV2}"
+            "WITH_JPEG=${WITH_JPEG}"
             "WITH_SYSTEMD=${WITH_SYSTEMD}"
             "WITH_LASTFM=${WITH_LASTFM}"
             "WITH_DEBUG=${WITH_DEBUG}"
@@ -76,12 +76,15 @@ enum config_option_t {
     CFG_SERVER_STORAGE_SQLITE,
     CFG_SERVER_STORAGE_DRIVER,
     CFG_SERVER_STORAGE_USE_TRANSACTIONS,
+    CFG_SERVER_STORAGE_FULLTEXT_SEARCH,
     CFG_SERVER_STORAGE_SQLITE_ENABLED,
     CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE,
     CFG_SERVER_STORAGE_SQLITE_SYNCHRONOUS,
     CFG_SERVER_STORAGE_SQLITE_RESTORE,
     CFG_SERVER_STORAGE_SQLITE_BACKUP_ENABLED,
     CFG_SERVER_STORAGE_SQLITE_BACKUP_INTERVAL,
+    CFG_SERVER_STORAGE_SQLITE_BACKUP_STEP_PAGES,
+    CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS,
     CFG_SERVER_STORAGE_SQLITE_INIT_SQL_FILE,
     CFG_SERVER_STORAGE_MYSQL_ENABLED,
 #ifdef HAVE_MYSQL
@@ -102,6 +105,21 @@ enum config_option_t {
     CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_IMAGE_QUALITY,
     CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR_ENABLED,
     CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR,
+    CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_SIZE,
+    CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_PREGENERATE,
+    CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_THREADS,
+#endif
+    CFG_SERVER_EXTOPTS_ART_CACHE_ENABLED,
+    CFG_SERVER_EXTOPTS_ART_CACHE_DIR,
+    CFG_SERVER_EXTOPTS_ART_CACHE_SIZE,
+    CFG_SERVER_EXTOPTS_ART_CACHE_DISK_SIZE,
+#ifdef HAVE_LIBJPEG
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_ENABLED,
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_DIR,
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_SIZE,
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_QUALITY,
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_PREGENERATE,
+    CFG_SERVER_EXTOPTS_IMAGE_SCALING_THREADS,
 #endif
     CFG_SERVER_EXTOPTS_MARK_PLAYED_ITEMS_ENABLED,
     CFG_SERVER_EXTOPTS_MARK_PLAYED_ITEMS_STRING_MODE_PREPEND,
@@ -212,6 +230,9 @@ enum config_option_t {
     CFG_UPNP_TITLE_PROPERTIES,
     CFG_THREAD_SCOPE_SYSTEM,
     CFG_IMPORT_READABLE_NAMES,
+    CFG_IMPORT_METADATA_THREADS,
+    CFG_IMPORT_SCAN_THREADS,
+    CFG_IMPORT_METADATA_CACHE,
 
     CFG_MAX,
 
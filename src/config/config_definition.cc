@@ -61,6 +61,9 @@
 #define DEFAULT_PLAYLIST_CREATE_LINK YES
 #define DEFAULT_HIDDEN_FILES_VALUE NO
 #define DEFAULT_FOLLOW_SYMLINKS_VALUE YES
+#define DEFAULT_METADATA_THREADS 0
+#define DEFAULT_SCAN_THREADS 0
+#define DEFAULT_METADATA_CACHE YES
 #define DEFAULT_RESOURCES_CASE_SENSITIVE YES
 #define DEFAULT_UPNP_STRING_LIMIT (-1)
 #define DEFAULT_SESSION_TIMEOUT 30
@@ -88,6 +91,8 @@
 #define DEFAULT_SQLITE_RESTORE "restore"
 #define DEFAULT_SQLITE_BACKUP_ENABLED NO
 #define DEFAULT_SQLITE_BACKUP_INTERVAL 600
+#define DEFAULT_SQLITE_BACKUP_STEP_PAGES 256
+#define DEFAULT_SQLITE_READ_CONNECTIONS 0
 #define DEFAULT_SQLITE_ENABLED YES
 
 #ifdef HAVE_MYSQL
@@ -117,6 +122,9 @@
 #define DEFAULT_FFMPEGTHUMBNAILER_IMAGE_QUALITY 8
 #define DEFAULT_FFMPEGTHUMBNAILER_CACHE_DIR_ENABLED YES
 #define DEFAULT_FFMPEGTHUMBNAILER_CACHE_DIR ""
+#define DEFAULT_FFMPEGTHUMBNAILER_CACHE_SIZE 100
+#define DEFAULT_FFMPEGTHUMBNAILER_PREGENERATE YES
+#define DEFAULT_FFMPEGTHUMBNAILER_THREADS 1
 #endif
 
 #if defined(HAVE_LASTFMLIB)
@@ -125,6 +133,20 @@
 #define DEFAULT_LASTFM_PASSWORD "lastfmpass"
 #endif
 
+#define DEFAULT_ART_CACHE_ENABLED YES
+#define DEFAULT_ART_CACHE_DIR ""
+#define DEFAULT_ART_CACHE_SIZE 16
+#define DEFAULT_ART_CACHE_DISK_SIZE 256
+
+#ifdef HAVE_LIBJPEG
+#define DEFAULT_IMAGE_SCALING_ENABLED NO
+#define DEFAULT_IMAGE_SCALING_DIR ""
+#define DEFAULT_IMAGE_SCALING_SIZE 100
+#define DEFAULT_IMAGE_SCALING_QUALITY 85
+#define DEFAULT_IMAGE_SCALING_PREGENERATE NO
+#define DEFAULT_IMAGE_SCALING_THREADS 1
+#endif
+
 #define DEFAULT_MARK_PLAYED_ITEMS_ENABLED NO
 #define DEFAULT_MARK_PLAYED_ITEMS_SUPPRESS_CDS_UPDATES YES
 #define DEFAULT_MARK_PLAYED_ITEMS_STRING "*"
@@ -321,6 +343,9 @@ const std::vector<std::shared_ptr<ConfigSetup>> ConfigDefinition::complexOptions
     std::make_shared<ConfigBoolSetup>(CFG_SERVER_STORAGE_USE_TRANSACTIONS,
         "/server/storage/attribute::use-transactions", "config-server.html#storage",
         NO),
+    std::make_shared<ConfigBoolSetup>(CFG_SERVER_STORAGE_FULLTEXT_SEARCH,
+        "/server/storage/attribute::fulltext-search", "config-server.html#storage",
+        NO),
     std::make_shared<ConfigStringSetup>(CFG_SERVER_STORAGE_MYSQL,
         "/server/storage/mysql", "config-server.html#storage"),
 #ifdef HAVE_MYSQL
@@ -381,6 +406,12 @@ const std::vector<std::shared_ptr<ConfigSetup>> ConfigDefinition::complexOptions
     std::make_shared<ConfigIntSetup>(CFG_SERVER_STORAGE_SQLITE_BACKUP_INTERVAL,
         "/server/storage/sqlite3/backup/attribute::interval", "config-server.html#storage",
         DEFAULT_SQLITE_BACKUP_INTERVAL, 1, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_STORAGE_SQLITE_BACKUP_STEP_PAGES,
+        "/server/storage/sqlite3/backup/attribute::step-pages", "config-server.html#storage",
+        DEFAULT_SQLITE_BACKUP_STEP_PAGES, 1, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS,
+        "/server/storage/sqlite3/read-connections", "config-server.html#storage",
+        DEFAULT_SQLITE_READ_CONNECTIONS, 0, ConfigIntSetup::CheckMinValue),
 
     std::make_shared<ConfigPathSetup>(CFG_SERVER_STORAGE_SQLITE_INIT_SQL_FILE,
         "/server/storage/sqlite3/init-sql-file", "config-server.html#storage",
@@ -446,6 +477,15 @@ const std::vector<std::shared_ptr<ConfigSetup>> ConfigDefinition::complexOptions
     std::make_shared<ConfigBoolSetup>(CFG_IMPORT_READABLE_NAMES,
         "/import/attribute::readable-names", "config-import.html#import",
         YES),
+    std::make_shared<ConfigIntSetup>(CFG_IMPORT_METADATA_THREADS,
+        "/import/attribute::metadata-threads", "config-import.html#import",
+        DEFAULT_METADATA_THREADS, 0, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigIntSetup>(CFG_IMPORT_SCAN_THREADS,
+        "/import/attribute::scan-threads", "config-import.html#import",
+        DEFAULT_SCAN_THREADS, 0, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigBoolSetup>(CFG_IMPORT_METADATA_CACHE,
+        "/import/attribute::metadata-cache", "config-import.html#import",
+        DEFAULT_METADATA_CACHE),
     std::make_shared<ConfigDictionarySetup>(CFG_IMPORT_MAPPINGS_EXTENSION_TO_MIMETYPE_LIST,
         "/import/mappings/extension-mimetype", "config-import.html#extension-mimetype",
         ATTR_IMPORT_MAPPINGS_MIMETYPE_MAP, ATTR_IMPORT_MAPPINGS_MIMETYPE_FROM, ATTR_IMPORT_MAPPINGS_MIMETYPE_TO,
@@ -609,6 +649,49 @@ const std::vector<std::shared_ptr<ConfigSetup>> ConfigDefinition::complexOptions
     std::make_shared<ConfigStringSetup>(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR, // ConfigPathSetup
         "/server/extended-runtime-options/ffmpegthumbnailer/cache-dir", "config-extended.html#ffmpegthumbnailer",
         DEFAULT_FFMPEGTHUMBNAILER_CACHE_DIR),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_SIZE,
+        "/server/extended-runtime-options/ffmpegthumbnailer/cache-dir/attribute::size", "config-extended.html#ffmpegthumbnailer",
+        DEFAULT_FFMPEGTHUMBNAILER_CACHE_SIZE, 0, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigBoolSetup>(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_PREGENERATE,
+        "/server/extended-runtime-options/ffmpegthumbnailer/cache-dir/attribute::pregenerate", "config-extended.html#ffmpegthumbnailer",
+        DEFAULT_FFMPEGTHUMBNAILER_PREGENERATE),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_THREADS,
+        "/server/extended-runtime-options/ffmpegthumbnailer/attribute::threads", "config-extended.html#ffmpegthumbnailer",
+        DEFAULT_FFMPEGTHUMBNAILER_THREADS, 1, ConfigIntSetup::CheckMinValue),
+#endif
+
+    std::make_shared<ConfigBoolSetup>(CFG_SERVER_EXTOPTS_ART_CACHE_ENABLED,
+        "/server/extended-runtime-options/art-cache/attribute::enabled", "config-extended.html#art-cache",
+        DEFAULT_ART_CACHE_ENABLED),
+    std::make_shared<ConfigStringSetup>(CFG_SERVER_EXTOPTS_ART_CACHE_DIR, // ConfigPathSetup
+        "/server/extended-runtime-options/art-cache", "config-extended.html#art-cache",
+        DEFAULT_ART_CACHE_DIR),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_ART_CACHE_SIZE,
+        "/server/extended-runtime-options/art-cache/attribute::size", "config-extended.html#art-cache",
+        DEFAULT_ART_CACHE_SIZE, 0, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_ART_CACHE_DISK_SIZE,
+        "/server/extended-runtime-options/art-cache/attribute::disk-size", "config-extended.html#art-cache",
+        DEFAULT_ART_CACHE_DISK_SIZE, 0, ConfigIntSetup::CheckMinValue),
+
+#ifdef HAVE_LIBJPEG
+    std::make_shared<ConfigBoolSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_ENABLED,
+        "/server/extended-runtime-options/image-scaling/attribute::enabled", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_ENABLED),
+    std::make_shared<ConfigStringSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_DIR, // ConfigPathSetup
+        "/server/extended-runtime-options/image-scaling", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_DIR),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_SIZE,
+        "/server/extended-runtime-options/image-scaling/attribute::size", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_SIZE, 0, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_QUALITY,
+        "/server/extended-runtime-options/image-scaling/attribute::quality", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_QUALITY, 1, ConfigIntSetup::CheckMinValue),
+    std::make_shared<ConfigBoolSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_PREGENERATE,
+        "/server/extended-runtime-options/image-scaling/attribute::pregenerate", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_PREGENERATE),
+    std::make_shared<ConfigIntSetup>(CFG_SERVER_EXTOPTS_IMAGE_SCALING_THREADS,
+        "/server/extended-runtime-options/image-scaling/attribute::threads", "config-extended.html#image-scaling",
+        DEFAULT_IMAGE_SCALING_THREADS, 1, ConfigIntSetup::CheckMinValue),
 #endif
 
     std::make_shared<ConfigBoolSetup>(CFG_SERVER_EXTOPTS_MARK_PLAYED_ITEMS_ENABLED,
@@ -921,6 +921,7 @@ void ConfigManager::load(const fs::path& userHome)
     co = ConfigDefinition::findConfigSetup(CFG_SERVER_STORAGE);
     co->getXmlElement(root); // fails if missing
     setOption(root, CFG_SERVER_STORAGE_USE_TRANSACTIONS);
+    setOption(root, CFG_SERVER_STORAGE_FULLTEXT_SEARCH);
 
     co = ConfigDefinition::findConfigSetup(CFG_SERVER_STORAGE_MYSQL);
     if (co->hasXmlElement(root)) {
@@ -968,6 +969,8 @@ void ConfigManager::load(const fs::path& userHome)
         setOption(root, CFG_SERVER_STORAGE_SQLITE_RESTORE);
         setOption(root, CFG_SERVER_STORAGE_SQLITE_BACKUP_ENABLED);
         setOption(root, CFG_SERVER_STORAGE_SQLITE_BACKUP_INTERVAL);
+        setOption(root, CFG_SERVER_STORAGE_SQLITE_BACKUP_STEP_PAGES);
+        setOption(root, CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS);
 
         co = ConfigDefinition::findConfigSetup(CFG_SERVER_STORAGE_SQLITE_INIT_SQL_FILE);
         fs::path dir = dataDir / "sqlite3.sql";
@@ -1018,6 +1021,9 @@ void ConfigManager::load(const fs::path& userHome)
     setOption(root, CFG_IMPORT_HIDDEN_FILES);
     setOption(root, CFG_IMPORT_FOLLOW_SYMLINKS);
     setOption(root, CFG_IMPORT_READABLE_NAMES);
+    setOption(root, CFG_IMPORT_METADATA_THREADS);
+    setOption(root, CFG_IMPORT_SCAN_THREADS);
+    setOption(root, CFG_IMPORT_METADATA_CACHE);
     setOption(root, CFG_IMPORT_MAPPINGS_IGNORE_UNKNOWN_EXTENSIONS);
     bool csens = setOption(root, CFG_IMPORT_MAPPINGS_EXTENSION_TO_MIMETYPE_CASE_SENSITIVE)->getBoolOption();
     args["tolower"] = fmt::to_string(!csens);
@@ -1271,6 +1277,25 @@ void ConfigManager::load(const fs::path& userHome)
         setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_IMAGE_QUALITY);
         setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR_ENABLED);
         setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR);
+        setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_SIZE);
+        setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_PREGENERATE);
+        setOption(root, CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_THREADS);
+    }
+#endif
+
+    if (setOption(root, CFG_SERVER_EXTOPTS_ART_CACHE_ENABLED)->getBoolOption()) {
+        setOption(root, CFG_SERVER_EXTOPTS_ART_CACHE_DIR);
+        setOption(root, CFG_SERVER_EXTOPTS_ART_CACHE_SIZE);
+        setOption(root, CFG_SERVER_EXTOPTS_ART_CACHE_DISK_SIZE);
+    }
+
+#ifdef HAVE_LIBJPEG
+    if (setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_ENABLED)->getBoolOption()) {
+        setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_DIR);
+        setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_SIZE);
+        setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_QUALITY);
+        setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_PREGENERATE);
+        setOption(root, CFG_SERVER_EXTOPTS_IMAGE_SCALING_THREADS);
     }
 #endif
 
@@ -773,6 +773,7 @@ bool ConfigDictionarySetup::updateDetail(const std::string& optItem, std::string
     if (optItem.substr(0, strlen(xpath)) == xpath && optionValue != nullptr) {
         std::shared_ptr<DictionaryOption> value = std::dynamic_pointer_cast<DictionaryOption>(optionValue);
         log_debug("Updating Dictionary Detail {} {} {}", xpath, optItem, optValue.c_str());
+        generation++;
 
         size_t i = extractIndex(optItem);
         if (i < std::numeric_limits<std::size_t>::max()) {
@@ -914,7 +915,7 @@ bool ConfigAutoscanSetup::updateItem(size_t i, const std::string& optItem, const
             config->setOrigValue(index, entry->getLocation().string());
         auto pathValue = optValue;
         if (ConfigDefinition::findConfigSetup<ConfigPathSetup>(ATTR_AUTOSCAN_DIRECTORY_LOCATION)->checkPathValue(optValue, pathValue)) {
-            entry->setLocation(pathValue);
+            config->getAutoscanListOption(option)->setLocation(entry, pathValue);
         }
         log_debug("New Autoscan Detail {} {}", index, config->getAutoscanListOption(option)->get(i)->getLocation().string());
         return true;
@@ -26,6 +26,7 @@
 #ifndef __CONFIG_SETUP_H__
 #define __CONFIG_SETUP_H__
 
+#include <atomic>
 #include <filesystem>
 #include <map>
 #include <memory>
@@ -76,9 +77,13 @@ protected:
 
     static size_t extractIndex(const std::string& item);
 
+    /// \brief counts the changes of the value, see getGeneration()
+    std::atomic_uint generation { 0 };
+
     void setOption(const std::shared_ptr<Config>& config)
     {
         config->addOption(option, optionValue);
+        generation++;
     }
     static std::string buildCpath(const char* xpath)
     {
@@ -96,6 +101,9 @@ public:
 
     pugi::xpath_node_set getXmlTree(const pugi::xml_node& element) const;
 
+    /// \brief changes whenever the value is set or edited in place, so users of the value can tell when to rebuild what they derived from it
+    unsigned int getGeneration() const { return generation; }
+
     config_option_t option;
     const char* xpath;
 
@@ -36,8 +36,15 @@
 
 #include "content_manager.h"
 #include "database/database.h"
+#include "metadata/metacontent_handler.h"
 
 #define INOTIFY_MAX_USER_WATCHES_FILE "/proc/sys/fs/inotify/max_user_watches"
+// time to wait for the IN_MOVED_TO of an IN_MOVED_FROM, both are usually read at once
+#define INOTIFY_MOVE_TIMEOUT std::chrono::milliseconds(500)
+// files are imported when there was no event for them during this time
+#define INOTIFY_COALESCE_DELAY std::chrono::seconds(1)
+// minimum time between two checks of the pending changes
+#define INOTIFY_COALESCE_INTERVAL std::chrono::milliseconds(100)
 
 AutoscanInotify::AutoscanInotify(std::shared_ptr<ContentManager> content)
     : config(content->getContext()->getConfig())
@@ -105,6 +112,14 @@ void AutoscanInotify::threadProc()
                 }
                 auto dirEnt = fs::directory_entry(location, ec);
 
+                for (auto it = pendingChanges.begin(); it != pendingChanges.end();) {
+                    if (it->second.adir == adir)
+                        it = pendingChanges.erase(it);
+                    else
+                        ++it;
+                }
+                pendingCount = pendingChanges.size();
+
                 if (adir->getRecursive()) {
                     log_debug("Removing recursive watch: {}", location.c_str());
                     monitorUnmonitorRecursive(dirEnt, true, adir, true, config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS));
@@ -147,114 +162,299 @@ void AutoscanInotify::threadProc()
 
             lock.unlock();
 
-            /* --- get event --- (blocking) */
-            inotify_event* event = inotify->nextEvent();
+            /* --- get events --- (blocking) */
+            auto&& batch = inotify->nextEvents(getTimeout());
             /* --- */
 
-            if (event) {
-                int wd = event->wd;
-                int mask = event->mask;
-                std::string name = event->name;
-                log_debug("inotify event: {} 0x{:x} {}", wd, mask, name.c_str());
+            if (pendingMove != nullptr && batch.empty() && std::chrono::steady_clock::now() >= pendingMove->time + INOTIFY_MOVE_TIMEOUT)
+                removePendingMove();
+
+            if (!pendingChanges.empty() && std::chrono::steady_clock::now() >= nextFlush)
+                flushChanges();
 
-                std::shared_ptr<Wd> wdObj = nullptr;
+            for (auto&& event : batch) {
+                if (shutdownFlag)
+                    break;
+                if (pendingMove != nullptr && (!(event->mask & IN_MOVED_TO) || event->cookie != pendingMove->cookie))
+                    removePendingMove();
                 try {
-                    wdObj = watches->at(wd);
-                } catch (const std::out_of_range& ex) {
-                    inotify->removeWatch(wd);
-                    continue;
+                    handleEvent(event);
+                } catch (const std::runtime_error& e) {
+                    log_error("Inotify thread caught exception: {}", e.what());
                 }
+            }
+        } catch (const std::runtime_error& e) {
+            log_error("Inotify thread caught exception: {}", e.what());
+        }
+    }
+}
 
-                fs::path path = wdObj->getPath();
-                if (!(mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)))
-                    path /= name;
+void AutoscanInotify::handleEvent(const struct inotify_event* event)
+{
+    std::error_code ec;
+    int wd = event->wd;
+    int mask = event->mask;
+    // events of the watched directory itself have no name
+    std::string name = event->len > 0 ? event->name : "";
+    log_debug("inotify event: {} 0x{:x} {}", wd, mask, name.c_str());
+    eventCount++;
+
+    if (mask & IN_Q_OVERFLOW) {
+        rescanAfterOverflow();
+        return;
+    }
 
-                std::shared_ptr<AutoscanDirectory> adir;
-                auto watchAs = getAppropriateAutoscan(wdObj, path);
-                if (watchAs != nullptr)
-                    adir = watchAs->getAutoscanDirectory();
-                else
-                    adir = nullptr;
+    std::shared_ptr<Wd> wdObj = nullptr;
+    try {
+        wdObj = watches->at(wd);
+    } catch (const std::out_of_range& ex) {
+        inotify->removeWatch(wd);
+        return;
+    }
 
-                if (mask & IN_MOVE_SELF) {
-                    checkMoveWatches(wd, wdObj);
-                }
+    fs::path path = wdObj->getPath();
+    if (!(mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)))
+        path /= name;
 
-                if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
-                    recheckNonexistingMonitors(wd, wdObj);
-                }
+    std::shared_ptr<AutoscanDirectory> adir;
+    auto watchAs = getAppropriateAutoscan(wdObj, path);
+    if (watchAs != nullptr)
+        adir = watchAs->getAutoscanDirectory();
+    else
+        adir = nullptr;
 
-                if (mask & IN_ISDIR) {
-                    if (mask & (IN_CREATE | IN_MOVED_TO)) {
-                        recheckNonexistingMonitors(wd, wdObj);
-                    }
+    // fanart, subtitles and other resources are looked up in the listing of the folder
+    if (mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+        MetacontentHandler::invalidateFolder(wdObj->getPath());
 
-                    if (adir != nullptr && adir->getRecursive()) {
-                        if (mask & IN_CREATE) {
-                            if (adir->getHidden() || name.at(0) != '.') {
-                                log_debug("Detected new dir, adding to inotify: {}", path.c_str());
-                                auto dirEnt = fs::directory_entry(path, ec);
-                                if (!ec) {
-                                    monitorUnmonitorRecursive(dirEnt, false, adir, false, config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS));
-                                } else {
-                                    log_error("Failed to read {}: {}", path.c_str(), ec.message());
-                                }
-                            } else {
-                                log_debug("Detected new dir, irgnoring because it's hidden: {}", path.c_str());
-                            }
-                        }
+    if ((mask & IN_MOVE_SELF) && movedWds.erase(wd) > 0) {
+        // moved within the autoscan directory, the watch is still valid
+        return;
+    }
+
+    if ((mask & IN_MOVED_FROM) && adir != nullptr) {
+        int objectID = database->findObjectIDByPath(path, !(mask & IN_ISDIR));
+        if (objectID != INVALID_OBJECT_ID) {
+            pendingMove = std::make_unique<PendingMove>(PendingMove { event->cookie, path, objectID, (mask & IN_ISDIR) != 0, adir, std::chrono::steady_clock::now() });
+            return;
+        }
+    }
+
+    if ((mask & IN_MOVED_TO) && pendingMove != nullptr) {
+        auto move = std::move(pendingMove);
+        if (adir == move->adir && content->moveObject(adir, move->objectID, path)) {
+            log_debug("moving {} to {}", move->path.c_str(), path.c_str());
+            if (mask & IN_ISDIR) {
+                recheckNonexistingMonitors(wd, wdObj);
+                moveWatches(move->path, path, wd);
+            }
+            return;
+        }
+        // moved to another autoscan directory
+        if (move->isDir) {
+            log_debug("deleting {}", move->path.c_str());
+            content->removeObject(move->adir, move->objectID, true);
+        } else {
+            queueChange(move->path, move->adir);
+        }
+    }
+
+    if (mask & IN_MOVE_SELF) {
+        checkMoveWatches(wd, wdObj);
+    }
+
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
+        recheckNonexistingMonitors(wd, wdObj);
+    }
+
+    if (mask & IN_ISDIR) {
+        if (mask & (IN_CREATE | IN_MOVED_TO)) {
+            recheckNonexistingMonitors(wd, wdObj);
+        }
+
+        if (adir != nullptr && adir->getRecursive()) {
+            if (mask & IN_CREATE) {
+                if (adir->getHidden() || name.at(0) != '.') {
+                    log_debug("Detected new dir, adding to inotify: {}", path.c_str());
+                    auto dirEnt = fs::directory_entry(path, ec);
+                    if (!ec) {
+                        monitorUnmonitorRecursive(dirEnt, false, adir, false, config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS));
+                    } else {
+                        log_error("Failed to read {}: {}", path.c_str(), ec.message());
                     }
+                } else {
+                    log_debug("Detected new dir, irgnoring because it's hidden: {}", path.c_str());
                 }
+            }
+        }
+    }
 
-                if (adir != nullptr && mask & (IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_UNMOUNT | IN_CREATE)) {
-                    if (!(mask & (IN_MOVED_TO | IN_CREATE))) {
-                        log_debug("deleting {}", path.c_str());
-
-                        if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
-                            if (mask & IN_MOVE_SELF)
-                                inotify->removeWatch(wd);
-                            auto watch = getStartPoint(wdObj);
-                            if (watch != nullptr) {
-                                if (adir->persistent()) {
-                                    monitorNonexisting(path, watch->getAutoscanDirectory());
-                                    content->handlePeristentAutoscanRemove(adir);
-                                }
-                            }
-                        }
+    if (adir != nullptr && !(mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) && mask & (IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE)) {
+        // file events are merged, a file being written or copied is imported once
+        queueChange(path, adir);
+    } else if (adir != nullptr && mask & (IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_UNMOUNT | IN_CREATE)) {
+        if (!(mask & (IN_MOVED_TO | IN_CREATE))) {
+            log_debug("deleting {}", path.c_str());
 
-                        int objectID = database->findObjectIDByPath(path, !(mask & IN_ISDIR));
-                        if (objectID != INVALID_OBJECT_ID)
-                            content->removeObject(adir, objectID, !(mask & IN_MOVED_TO));
-                    }
-                    if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) {
-                        log_debug("Adding {}", path.c_str());
-                        auto dirEnt = fs::directory_entry(path, ec);
-                        if (!ec) {
-                            AutoScanSetting asSetting;
-                            asSetting.adir = adir;
-                            asSetting.followSymlinks = config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS);
-                            asSetting.recursive = adir->getRecursive();
-                            asSetting.hidden = adir->getHidden();
-                            asSetting.rescanResource = true;
-                            asSetting.mergeOptions(config, path);
-                            // path, recursive, async, hidden, rescanResource, low priority, cancellable
-                            content->addFile(dirEnt, adir->getLocation(), asSetting, true, true, false);
-                            if (mask & IN_ISDIR) {
-                                monitorUnmonitorRecursive(dirEnt, false, adir, false, asSetting.followSymlinks);
-                            }
-                        } else {
-                            log_error("Failed to read {}: {}", path.c_str(), ec.message());
-                        }
+            if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
+                if (mask & IN_MOVE_SELF)
+                    inotify->removeWatch(wd);
+                auto watch = getStartPoint(wdObj);
+                if (watch != nullptr) {
+                    if (adir->persistent()) {
+                        monitorNonexisting(path, watch->getAutoscanDirectory());
+                        content->handlePeristentAutoscanRemove(adir);
                     }
                 }
-                if (mask & IN_IGNORED) {
-                    removeWatchMoves(wd);
-                    removeDescendants(wd);
-                    watches->erase(wd);
+            }
+
+            int objectID = database->findObjectIDByPath(path, !(mask & IN_ISDIR));
+            if (objectID != INVALID_OBJECT_ID)
+                content->removeObject(adir, objectID, !(mask & IN_MOVED_TO));
+        }
+        if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) {
+            log_debug("Adding {}", path.c_str());
+            auto dirEnt = fs::directory_entry(path, ec);
+            if (!ec) {
+                AutoScanSetting asSetting;
+                asSetting.adir = adir;
+                asSetting.followSymlinks = config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS);
+                asSetting.recursive = adir->getRecursive();
+                asSetting.hidden = adir->getHidden();
+                asSetting.rescanResource = true;
+                asSetting.mergeOptions(config, path);
+                // path, recursive, async, hidden, rescanResource, low priority, cancellable
+                content->addFile(dirEnt, adir->getLocation(), asSetting, true, true, false);
+                if (mask & IN_ISDIR) {
+                    monitorUnmonitorRecursive(dirEnt, false, adir, false, asSetting.followSymlinks);
                 }
+            } else {
+                log_error("Failed to read {}: {}", path.c_str(), ec.message());
             }
-        } catch (const std::runtime_error& e) {
-            log_error("Inotify thread caught exception: {}", e.what());
+        }
+    }
+    if (mask & IN_IGNORED) {
+        removeWatchMoves(wd);
+        removeDescendants(wd);
+        watches->erase(wd);
+    }
+}
+
+void AutoscanInotify::rescanAfterOverflow()
+{
+    // events were lost, every watched tree may have changed
+    std::vector<std::shared_ptr<AutoscanDirectory>> roots;
+    for (auto&& [wd, wdObj] : *watches) {
+        auto watch = getStartPoint(wdObj);
+        if (watch != nullptr && watch->getNonexistingPathArray().empty())
+            roots.push_back(watch->getAutoscanDirectory());
+    }
+    log_warning("Inotify event queue overflowed, rescanning {} autoscan directories", roots.size());
+    overflowCount++;
+
+    if (pendingMove != nullptr)
+        removePendingMove();
+
+    std::error_code ec;
+    for (auto&& adir : roots) {
+        auto location = adir->getLocation();
+        auto dirEnt = fs::directory_entry(location, ec);
+        if (ec) {
+            log_error("Failed to read {}: {}", location.c_str(), ec.message());
+            continue;
+        }
+        // watch directories created while events were lost, existing watches are kept
+        if (adir->getRecursive())
+            monitorUnmonitorRecursive(dirEnt, false, adir, false, config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS));
+        content->rescanDirectory(adir, adir->getObjectID(), location, false);
+    }
+}
+
+void AutoscanInotify::removePendingMove()
+{
+    auto move = std::move(pendingMove);
+    if (!move->isDir) {
+        queueChange(move->path, move->adir);
+        return;
+    }
+    log_debug("deleting {}", move->path.c_str());
+    content->removeObject(move->adir, move->objectID, true);
+}
+
+void AutoscanInotify::queueChange(const fs::path& path, const std::shared_ptr<AutoscanDirectory>& adir)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (pendingChanges.empty())
+        nextFlush = now + INOTIFY_COALESCE_DELAY;
+
+    auto [it, added] = pendingChanges.insert_or_assign(path, PendingChange { adir, now });
+    if (!added)
+        coalescedCount++;
+    pendingCount = pendingChanges.size();
+}
+
+void AutoscanInotify::flushChanges()
+{
+    auto now = std::chrono::steady_clock::now();
+    auto earliest = std::chrono::steady_clock::time_point::max();
+
+    // group by directory, the content manager imports each group in one task
+    std::map<fs::path, std::pair<std::shared_ptr<AutoscanDirectory>, std::vector<fs::path>>> batches;
+    for (auto it = pendingChanges.begin(); it != pendingChanges.end();) {
+        if (it->second.time + INOTIFY_COALESCE_DELAY > now) {
+            earliest = std::min(earliest, it->second.time);
+            ++it;
+            continue;
+        }
+        auto&& batch = batches[it->first.parent_path()];
+        if (batch.first == nullptr)
+            batch.first = it->second.adir;
+        batch.second.push_back(it->first);
+        it = pendingChanges.erase(it);
+    }
+    pendingCount = pendingChanges.size();
+
+    for (auto&& [dir, batch] : batches) {
+        log_debug("updating {} files in {}", batch.second.size(), dir.c_str());
+        changeCount += batch.second.size();
+        taskCount++;
+        content->updateFiles(batch.first, std::move(batch.second));
+    }
+
+    if (!pendingChanges.empty())
+        nextFlush = std::max(earliest + INOTIFY_COALESCE_DELAY, now + INOTIFY_COALESCE_INTERVAL);
+}
+
+int AutoscanInotify::getTimeout() const
+{
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (pendingMove != nullptr)
+        deadline = pendingMove->time + INOTIFY_MOVE_TIMEOUT;
+    if (!pendingChanges.empty())
+        deadline = std::min(deadline, nextFlush);
+    if (deadline == std::chrono::steady_clock::time_point::max())
+        return -1;
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return std::max(0, static_cast<int>(remaining.count()));
+}
+
+AutoscanInotify::Stats AutoscanInotify::getStats() const
+{
+    return Stats { eventCount, coalescedCount, changeCount, taskCount, pendingCount, overflowCount };
+}
+
+void AutoscanInotify::moveWatches(const fs::path& from, const fs::path& to, int parentWd)
+{
+    auto prefix = fmt::format("{}{}", from.string(), DIR_SEPARATOR);
+    for (auto&& [wd, wdObj] : *watches) {
+        auto path = wdObj->getPath().string();
+        if (path == from) {
+            wdObj->setPath(to);
+            wdObj->setParentWd(parentWd);
+            movedWds.insert(wd);
+        } else if (startswith(path, prefix)) {
+            wdObj->setPath(to / path.substr(prefix.size()));
         }
     }
 }
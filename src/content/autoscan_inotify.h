@@ -31,11 +31,15 @@
 #ifndef __AUTOSCAN_INOTIFY_H__
 #define __AUTOSCAN_INOTIFY_H__
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "autoscan.h"
@@ -65,12 +69,26 @@ public:
     /// \brief Stop monitoring a directory
     void unmonitor(const std::shared_ptr<AutoscanDirectory>& dir);
 
+    /// \brief counters of the file event coalescing
+    struct Stats {
+        std::size_t events; // events read from inotify
+        std::size_t coalesced; // file events merged into a pending change
+        std::size_t changes; // net changes handed to the content manager
+        std::size_t tasks; // batched tasks queued
+        std::size_t pending; // changes waiting for the quiet period
+        std::size_t overflows; // event queue overflows
+    };
+    Stats getStats() const;
+
 private:
     std::shared_ptr<Config> config;
     std::shared_ptr<Database> database;
     std::shared_ptr<ContentManager> content;
 
     void threadProc();
+    void handleEvent(const struct inotify_event* event);
+    /// \brief rescan all watched autoscan directories after events were dropped by the kernel
+    void rescanAfterOverflow();
 
     std::thread thread_;
 
@@ -150,6 +168,7 @@ private:
         {
         }
         fs::path getPath() const { return path; }
+        void setPath(const fs::path& path) { this->path = path; }
         int getWd() const { return wd; }
         int getParentWd() const { return parentWd; }
         void setParentWd(int parentWd) { this->parentWd = parentWd; }
@@ -166,6 +185,46 @@ private:
 
     std::unique_ptr<std::unordered_map<int, std::shared_ptr<Wd>>> watches;
 
+    /// \brief a file or directory that was moved away, waiting for the IN_MOVED_TO with the same cookie
+    struct PendingMove {
+        uint32_t cookie;
+        fs::path path;
+        int objectID;
+        bool isDir;
+        std::shared_ptr<AutoscanDirectory> adir;
+        std::chrono::steady_clock::time_point time;
+    };
+    std::unique_ptr<PendingMove> pendingMove;
+    /// \brief watches of directories moved in place, their IN_MOVE_SELF is not a removal
+    std::unordered_set<int> movedWds;
+
+    /// \brief a file with events, imported when there were no more events for it during the quiet period
+    struct PendingChange {
+        std::shared_ptr<AutoscanDirectory> adir;
+        std::chrono::steady_clock::time_point time;
+    };
+    std::map<fs::path, PendingChange> pendingChanges;
+    std::chrono::steady_clock::time_point nextFlush;
+
+    std::atomic<std::size_t> eventCount { 0 };
+    std::atomic<std::size_t> coalescedCount { 0 };
+    std::atomic<std::size_t> changeCount { 0 };
+    std::atomic<std::size_t> taskCount { 0 };
+    std::atomic<std::size_t> pendingCount { 0 };
+    std::atomic<std::size_t> overflowCount { 0 };
+
+    /// \brief record a file event, the net change is determined from the file when it is imported
+    void queueChange(const fs::path& path, const std::shared_ptr<AutoscanDirectory>& adir);
+    /// \brief hand the quiet changes to the content manager, one task per directory
+    void flushChanges();
+    /// \brief milliseconds until the next pending move or change is due, -1 if there is none
+    int getTimeout() const;
+
+    /// \brief remove the object of a move without IN_MOVED_TO, it was moved out of the watched directories
+    void removePendingMove();
+    /// \brief change the paths of the watches of a moved directory and below
+    void moveWatches(const fs::path& from, const fs::path& to, int parentWd);
+
     void monitorUnmonitorRecursive(const fs::directory_entry& startPath, bool unmonitor, const std::shared_ptr<AutoscanDirectory>& adir, bool startPoint, bool followSymlinks);
     int monitorDirectory(const fs::path& path, const std::shared_ptr<AutoscanDirectory>& adir, bool startPoint, const std::vector<std::string>* pathArray = nullptr);
     void unmonitorDirectory(const fs::path& path, const std::shared_ptr<AutoscanDirectory>& adir);
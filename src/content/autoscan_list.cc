@@ -50,7 +50,7 @@ int AutoscanList::add(const std::shared_ptr<AutoscanDirectory>& dir, size_t inde
 
 int AutoscanList::_add(const std::shared_ptr<AutoscanDirectory>& dir, size_t index)
 {
-    if (std::any_of(list.begin(), list.end(), [loc = dir->getLocation()](auto&& item) { return loc == item->getLocation(); })) {
+    if (get(dir->getLocation()) != nullptr) {
         throw_std_runtime_error("Attempted to add same autoscan path twice");
     }
     if (index == std::numeric_limits<std::size_t>::max()) {
@@ -63,6 +63,7 @@ int AutoscanList::_add(const std::shared_ptr<AutoscanDirectory>& dir, size_t ind
     dir->setScanID(index);
     list.push_back(dir);
     indexMap[dir->getScanID()] = dir;
+    indexAdd(dir);
 
     return dir->getScanID();
 }
@@ -118,8 +119,134 @@ std::shared_ptr<AutoscanDirectory> AutoscanList::get(const fs::path& location)
 {
     AutoLock lock(mutex);
 
-    auto it = std::find_if(list.begin(), list.end(), [=](auto&& item) { return location == item->getLocation(); });
-    return it != list.end() ? *it : nullptr;
+    if (location.empty()) {
+        // not in the index
+        auto it = std::find_if(list.begin(), list.end(), [](auto&& item) { return item->getLocation().empty(); });
+        return it != list.end() ? *it : nullptr;
+    }
+    auto node = findNode(location);
+    return node != nullptr ? node->dir : nullptr;
+}
+
+std::shared_ptr<AutoscanDirectory> AutoscanList::getContaining(const fs::path& path)
+{
+    AutoLock lock(mutex);
+
+    std::shared_ptr<AutoscanDirectory> result;
+    PathNode* node = &pathIndex;
+    for (auto&& part : path) {
+        if (part.empty())
+            continue;
+        auto child = node->children.find(part.string());
+        if (child == node->children.end())
+            break;
+        node = child->second.get();
+        if (node->dir != nullptr)
+            result = node->dir;
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<AutoscanDirectory>> AutoscanList::getSubdirs(const fs::path& parent)
+{
+    AutoLock lock(mutex);
+
+    std::vector<std::shared_ptr<AutoscanDirectory>> result;
+    auto node = findNode(parent);
+    if (node != nullptr)
+        collect(*node, result);
+    return result;
+}
+
+void AutoscanList::setLocation(const std::shared_ptr<AutoscanDirectory>& dir, const fs::path& location)
+{
+    AutoLock lock(mutex);
+
+    bool listed = std::find(list.begin(), list.end(), dir) != list.end();
+    if (listed)
+        indexRemove(dir);
+    dir->setLocation(location);
+    if (listed)
+        indexAdd(dir);
+}
+
+AutoscanList::PathNode* AutoscanList::findNode(const fs::path& location, bool create)
+{
+    PathNode* node = &pathIndex;
+    for (auto&& part : location) {
+        if (part.empty())
+            continue;
+        auto child = node->children.find(part.string());
+        if (child == node->children.end()) {
+            if (!create)
+                return nullptr;
+            child = node->children.emplace(part.string(), std::make_unique<PathNode>()).first;
+        }
+        node = child->second.get();
+    }
+    return node;
+}
+
+void AutoscanList::indexAdd(const std::shared_ptr<AutoscanDirectory>& dir)
+{
+    if (!dir->getLocation().empty())
+        findNode(dir->getLocation(), true)->dir = dir;
+}
+
+void AutoscanList::indexRemove(const std::shared_ptr<AutoscanDirectory>& dir)
+{
+    // the location of an indexed directory should not change, search the whole index if it did
+    std::vector<std::pair<PathNode*, std::string>> trail;
+    PathNode* node = &pathIndex;
+    for (auto&& part : dir->getLocation()) {
+        if (part.empty())
+            continue;
+        auto child = node->children.find(part.string());
+        if (child == node->children.end()) {
+            node = nullptr;
+            break;
+        }
+        trail.emplace_back(node, part.string());
+        node = child->second.get();
+    }
+    if (node == nullptr || node == &pathIndex || node->dir != dir) {
+        indexRemove(pathIndex, dir);
+        return;
+    }
+
+    node->dir = nullptr;
+    // drop nodes that lead to no directory any more
+    for (auto it = trail.rbegin(); it != trail.rend(); ++it) {
+        auto&& child = it->first->children.at(it->second);
+        if (child->dir != nullptr || !child->children.empty())
+            break;
+        it->first->children.erase(it->second);
+    }
+}
+
+bool AutoscanList::indexRemove(PathNode& node, const std::shared_ptr<AutoscanDirectory>& dir)
+{
+    for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+        auto&& child = it->second;
+        if (child->dir == dir) {
+            child->dir = nullptr;
+        } else if (!indexRemove(*child, dir)) {
+            continue;
+        }
+        if (child->dir == nullptr && child->children.empty())
+            node.children.erase(it);
+        return true;
+    }
+    return false;
+}
+
+void AutoscanList::collect(const PathNode& node, std::vector<std::shared_ptr<AutoscanDirectory>>& result)
+{
+    if (node.dir != nullptr)
+        result.push_back(node.dir);
+    for (auto&& [name, child] : node.children) {
+        collect(*child, result);
+    }
 }
 
 void AutoscanList::remove(size_t id, bool edit)
@@ -133,6 +260,7 @@ void AutoscanList::remove(size_t id, bool edit)
         }
         auto dir = list[id];
         dir->setScanID(INVALID_SCAN_ID);
+        indexRemove(dir);
 
         list.erase(list.begin() + id);
         log_debug("ID {} removed!", id);
@@ -144,6 +272,7 @@ void AutoscanList::remove(size_t id, bool edit)
         auto&& dir = indexMap[id];
         auto entry = std::find_if(list.begin(), list.end(), [loc = dir->getScanID()](auto&& item) { return loc == item->getScanID(); });
         dir->setScanID(INVALID_SCAN_ID);
+        indexRemove(dir);
         list.erase(entry);
 
         if (id >= origSize) {
@@ -159,24 +288,19 @@ std::shared_ptr<AutoscanList> AutoscanList::removeIfSubdir(const fs::path& paren
 
     auto rm_id_list = std::make_shared<AutoscanList>(database);
 
-    for (auto it = list.begin(); it != list.end(); /*++it*/) {
-        auto& dir = *it;
-
-        if (startswith(dir->getLocation(), parent)) {
-            if (dir->persistent() && !persistent) {
-                ++it;
-                continue;
-            }
-            indexMap[dir->getScanID()] = nullptr;
-            auto copy = std::make_shared<AutoscanDirectory>();
-            dir->copyTo(copy);
-            copy->setScanID(dir->getScanID());
-            rm_id_list->add(copy);
-
-            dir->setScanID(INVALID_SCAN_ID);
-            it = list.erase(it);
-        } else
-            ++it;
+    for (auto&& dir : getSubdirs(parent)) {
+        if (dir->persistent() && !persistent)
+            continue;
+
+        indexMap[dir->getScanID()] = nullptr;
+        auto copy = std::make_shared<AutoscanDirectory>();
+        dir->copyTo(copy);
+        copy->setScanID(dir->getScanID());
+        rm_id_list->add(copy);
+
+        dir->setScanID(INVALID_SCAN_ID);
+        indexRemove(dir);
+        list.erase(std::find(list.begin(), list.end(), dir));
     }
 
     return rm_id_list;
@@ -26,6 +26,8 @@
 #ifndef __AUTOSCAN_LIST_H__
 #define __AUTOSCAN_LIST_H__
 
+#include <unordered_map>
+
 #include "util/timer.h"
 
 // forward declaration
@@ -52,6 +54,15 @@ public:
 
     std::shared_ptr<AutoscanDirectory> get(const fs::path& location);
 
+    /// \brief returns the deepest AutoscanDirectory whose location is path or one of its parents
+    std::shared_ptr<AutoscanDirectory> getContaining(const fs::path& path);
+
+    /// \brief returns the AutoscanDirectories located at or below parent
+    std::vector<std::shared_ptr<AutoscanDirectory>> getSubdirs(const fs::path& parent);
+
+    /// \brief changes the location of a directory and keeps the lookup index up to date
+    void setLocation(const std::shared_ptr<AutoscanDirectory>& dir, const fs::path& location);
+
     std::shared_ptr<AutoscanDirectory> getByObjectID(int objectID);
 
     size_t getEditSize() const;
@@ -89,6 +100,19 @@ protected:
 
     std::vector<std::shared_ptr<AutoscanDirectory>> list;
     int _add(const std::shared_ptr<AutoscanDirectory>& dir, size_t index);
+
+    /// \brief location index with one node per path component
+    struct PathNode {
+        std::unordered_map<std::string, std::unique_ptr<PathNode>> children;
+        std::shared_ptr<AutoscanDirectory> dir;
+    };
+    PathNode pathIndex;
+
+    PathNode* findNode(const fs::path& location, bool create = false);
+    void indexAdd(const std::shared_ptr<AutoscanDirectory>& dir);
+    void indexRemove(const std::shared_ptr<AutoscanDirectory>& dir);
+    static bool indexRemove(PathNode& node, const std::shared_ptr<AutoscanDirectory>& dir);
+    static void collect(const PathNode& node, std::vector<std::shared_ptr<AutoscanDirectory>>& result);
 };
 
 #endif //__AUTOSCAN_LIST_H__
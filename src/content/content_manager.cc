@@ -31,19 +31,29 @@
 
 #include "content_manager.h" // API
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <filesystem>
-#include <regex>
+#include <sstream>
 
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "config/config_definition.h"
 #include "config/config_manager.h"
+#include "config/config_setup.h"
 #include "config/directory_tweak.h"
 #include "database/database.h"
 #include "layout/builtin_layout.h"
+#include "metadata/media_file.h"
+#if defined(HAVE_FFMPEG) && defined(HAVE_FFMPEGTHUMBNAILER)
+#include "metadata/ffmpeg_handler.h"
+#endif
+#ifdef HAVE_LIBJPEG
+#include "metadata/jpeg_scale_handler.h"
+#endif
 #include "metadata/metadata_handler.h"
 #include "update_manager.h"
 #include "util/mime.h"
@@ -80,6 +90,13 @@
 #include "scripting/scripting_runtime.h"
 #endif
 
+/* number of new items of a directory that are written with one transaction */
+#define IMPORT_BATCH_SIZE 500
+
+/* FNV-1a, the digest of a directory is stored in the database */
+#define DIGEST_OFFSET_BASIS 14695981039346656037ULL
+#define DIGEST_PRIME 1099511628211ULL
+
 ContentManager::ContentManager(const std::shared_ptr<Context>& context,
     const std::shared_ptr<Server>& server, std::shared_ptr<Timer> timer)
     : config(context->getConfig())
@@ -118,6 +135,42 @@ void ContentManager::run()
 #ifdef HAVE_LASTFMLIB
     last_fm->run();
 #endif
+    int workerCount = config->getIntOption(CFG_IMPORT_METADATA_THREADS);
+    if (workerCount > 0)
+        metadataWorkers = std::make_unique<MetadataWorkers>(config, workerCount);
+    directoryWalker = std::make_unique<DirectoryWalker>(config, config->getIntOption(CFG_IMPORT_SCAN_THREADS));
+    if (config->getBoolOption(CFG_SERVER_EXTOPTS_ART_CACHE_ENABLED)) {
+        auto artDir = fs::path(config->getOption(CFG_SERVER_EXTOPTS_ART_CACHE_DIR));
+        if (artDir.empty())
+            artDir = fs::path(config->getOption(CFG_SERVER_HOME)) / "art-cache";
+        artCache = std::make_shared<ArtCache>(artDir, std::size_t(config->getIntOption(CFG_SERVER_EXTOPTS_ART_CACHE_SIZE)) * 1024 * 1024,
+            std::size_t(config->getIntOption(CFG_SERVER_EXTOPTS_ART_CACHE_DISK_SIZE)) * 1024 * 1024);
+    }
+#if defined(HAVE_FFMPEG) && defined(HAVE_FFMPEGTHUMBNAILER)
+    if (config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_ENABLED)) {
+        auto cacheEnabled = config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR_ENABLED);
+        auto cacheSize = std::size_t(config->getIntOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_SIZE)) * 1024 * 1024;
+        auto background = cacheEnabled && config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_PREGENERATE) ? 1 : 0;
+        if (cacheEnabled)
+            removeLegacyThumbnails(getThumbnailCacheBasePath(*config));
+        thumbnailCache = std::make_shared<ThumbnailCache>(config, cacheEnabled ? getThumbnailCacheBasePath(*config) : fs::path(),
+            cacheSize, config->getIntOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_THREADS), background,
+            [config = config](const fs::path& file, const std::string& variant) { return FfmpegHandler::generateThumbnail(config, file); });
+    }
+#endif
+#ifdef HAVE_LIBJPEG
+    if (config->getBoolOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_ENABLED)) {
+        auto imageDir = fs::path(config->getOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_DIR));
+        if (imageDir.empty())
+            imageDir = fs::path(config->getOption(CFG_SERVER_HOME)) / "image-cache";
+        auto threads = config->getIntOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_THREADS);
+        imageCache = std::make_shared<ThumbnailCache>(config, imageDir,
+            std::size_t(config->getIntOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_SIZE)) * 1024 * 1024,
+            threads, config->getBoolOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_PREGENERATE) ? threads : 0,
+            [config = config](const fs::path& file, const std::string& variant) { return JpegScaleHandler::generateImage(config, file, variant); });
+    }
+#endif
+
     threadRunner = std::make_unique<ThreadRunner<std::condition_variable_any, std::recursive_mutex>>("ContentTaskThread", ContentManager::staticThreadProc, this, config);
 
     // wait for ContentTaskThread to become ready
@@ -363,6 +416,18 @@ void ContentManager::shutdown()
 
     threadRunner->join();
 
+    // after the content thread, which may be waiting for extracted files
+    if (metadataWorkers != nullptr) {
+        metadataWorkers->shutdown();
+        metadataWorkers = nullptr;
+    }
+    directoryWalker->shutdown();
+    // requests may still hold the cache
+    if (thumbnailCache != nullptr)
+        thumbnailCache->shutdown();
+    if (imageCache != nullptr)
+        imageCache->shutdown();
+
 #ifdef HAVE_LASTFMLIB
     last_fm->shutdown();
     last_fm = nullptr;
@@ -413,6 +478,21 @@ std::deque<std::shared_ptr<GenericTask>> ContentManager::getTasklist()
     return taskList;
 }
 
+std::size_t ContentManager::getTaskQueueSize()
+{
+    auto lock = threadRunner->lockGuard("getTaskQueueSize");
+    return taskQueue1.size() + taskQueue2.size();
+}
+
+#ifdef HAVE_INOTIFY
+AutoscanInotify::Stats ContentManager::getInotifyStats() const
+{
+    if (inotify == nullptr)
+        return {};
+    return inotify->getStats();
+}
+#endif
+
 void ContentManager::addVirtualItem(const std::shared_ptr<CdsObject>& obj, bool allow_fifo)
 {
     obj->validate();
@@ -438,7 +518,7 @@ void ContentManager::addVirtualItem(const std::shared_ptr<CdsObject>& obj, bool
     addObject(obj, true);
 }
 
-std::shared_ptr<CdsObject> ContentManager::createSingleItem(const fs::directory_entry& dirEnt, fs::path& rootPath, bool followSymlinks, bool checkDatabase, bool processExisting, bool firstChild, const std::shared_ptr<CMAddFileTask>& task)
+std::shared_ptr<CdsObject> ContentManager::createSingleItem(const fs::directory_entry& dirEnt, fs::path& rootPath, bool followSymlinks, bool checkDatabase, bool processExisting, bool firstChild, const std::shared_ptr<CMAddFileTask>& task, std::vector<std::shared_ptr<CdsObject>>* batch)
 {
     auto obj = checkDatabase ? database->findObjectByPath(dirEnt.path()) : nullptr;
     bool isNew = false;
@@ -450,34 +530,107 @@ std::shared_ptr<CdsObject> ContentManager::createSingleItem(const fs::directory_
             return nullptr;
         }
         if (obj->isItem()) {
+            if (batch != nullptr) {
+                // added and processed by the caller with the other items of the directory
+                obj->validate();
+                batch->push_back(obj);
+                return obj;
+            }
             addObject(obj, firstChild);
             isNew = true;
         }
     } else if (obj->isItem() && processExisting) {
         MetadataHandler::setMetadata(context, std::static_pointer_cast<CdsItem>(obj), dirEnt);
     }
-    if (obj->isItem() && layout != nullptr && (processExisting || isNew)) {
-        try {
-            if (rootPath.empty() && (task != nullptr))
-                rootPath = task->getRootPath();
+    if (obj->isItem() && (processExisting || isNew)) {
+        processSingleItem(obj, rootPath, task);
+    }
+    return obj;
+}
+
+void ContentManager::processSingleItem(const std::shared_ptr<CdsObject>& obj, fs::path& rootPath, const std::shared_ptr<CMAddFileTask>& task)
+{
+    // the first client browsing the folder finds the thumbnails ready
+    if (thumbnailCache != nullptr) {
+        auto item = std::static_pointer_cast<CdsItem>(obj);
+        for (auto&& res : item->getResources()) {
+            if (res->getHandlerType() == CH_FFTH) {
+                thumbnailCache->enqueue(item->getLocation());
+                break;
+            }
+        }
+    }
+    if (imageCache != nullptr) {
+        auto item = std::static_pointer_cast<CdsItem>(obj);
+        for (auto&& res : item->getResources()) {
+            if (res->getHandlerType() == CH_JPEGSCALE)
+                imageCache->enqueue(item->getLocation(), res->getAttribute(R_RESOLUTION));
+        }
+    }
 
-            layout->processCdsObject(obj, rootPath);
+    if (layout == nullptr)
+        return;
 
-            std::string mimetype = std::static_pointer_cast<CdsItem>(obj)->getMimeType();
-            std::string content_type = getValueOrDefault(mimetype_contenttype_map, mimetype);
+    try {
+        if (rootPath.empty() && (task != nullptr))
+            rootPath = task->getRootPath();
+
+        layout->processCdsObject(obj, rootPath);
+
+        std::string mimetype = std::static_pointer_cast<CdsItem>(obj)->getMimeType();
+        std::string content_type = getValueOrDefault(mimetype_contenttype_map, mimetype);
 
 #ifdef HAVE_JS
-            if ((playlist_parser_script != nullptr) && (content_type == CONTENT_TYPE_PLAYLIST))
-                playlist_parser_script->processPlaylistObject(obj, task);
+        if ((playlist_parser_script != nullptr) && (content_type == CONTENT_TYPE_PLAYLIST))
+            playlist_parser_script->processPlaylistObject(obj, task);
 #else
-            if (content_type == CONTENT_TYPE_PLAYLIST)
-                log_warning("Playlist {} will not be parsed: Gerbera was compiled without JS support!", obj->getLocation().c_str());
+        if (content_type == CONTENT_TYPE_PLAYLIST)
+            log_warning("Playlist {} will not be parsed: Gerbera was compiled without JS support!", obj->getLocation().c_str());
 #endif // JS
-        } catch (const std::runtime_error& e) {
-            log_error("{}", e.what());
+    } catch (const std::runtime_error& e) {
+        log_error("{}", e.what());
+    }
+}
+
+void ContentManager::extractItem(const fs::directory_entry& dirEnt, bool followSymlinks, const std::shared_ptr<GenericTask>& task, std::deque<PendingItem>& pending)
+{
+    auto job = [this, dirEnt, followSymlinks, task]() -> std::shared_ptr<CdsObject> {
+        // the import was cancelled while the file was queued
+        if (shutdownFlag || (task != nullptr && !task->isValid()))
+            return nullptr;
+        auto obj = createObjectFromFile(dirEnt, followSymlinks);
+        if (obj != nullptr && obj->isItem())
+            obj->validate();
+        return obj;
+    };
+
+    if (metadataWorkers != nullptr) {
+        pending.emplace_back(dirEnt.path(), metadataWorkers->submit(std::move(job)));
+    } else {
+        std::packaged_task<std::shared_ptr<CdsObject>()> extract(std::move(job));
+        pending.emplace_back(dirEnt.path(), extract.get_future());
+        extract();
+    }
+}
+
+bool ContentManager::collectItems(std::deque<PendingItem>& pending, std::vector<std::shared_ptr<CdsObject>>& batch)
+{
+    bool complete = true;
+    for (auto&& [path, result] : pending) {
+        try {
+            auto obj = result.get();
+            if (obj == nullptr) { // object ignored
+                log_debug("File ignored: {}", path.c_str());
+            } else if (obj->isItem()) {
+                batch.push_back(obj);
+            }
+        } catch (const std::runtime_error& ex) {
+            log_warning("skipping {} (ex:{})", path.c_str(), ex.what());
+            complete = false;
         }
     }
-    return obj;
+    pending.clear();
+    return complete;
 }
 
 int ContentManager::_addFile(const fs::directory_entry& dirEnt, fs::path rootPath, AutoScanSetting& asSetting, const std::shared_ptr<CMAddFileTask>& task)
@@ -497,7 +650,14 @@ int ContentManager::_addFile(const fs::directory_entry& dirEnt, fs::path rootPat
         return INVALID_OBJECT_ID;
 
     if (asSetting.recursive && obj->isContainer()) {
-        addRecursive(asSetting.adir, dirEnt, asSetting.followSymlinks, asSetting.hidden, task);
+        auto walkID = directoryWalker->prefetch(dirEnt.path(), asSetting.hidden, asSetting.followSymlinks, true);
+        try {
+            addRecursive(asSetting.adir, dirEnt, asSetting.followSymlinks, asSetting.hidden, task, walkID);
+        } catch (const std::runtime_error&) {
+            directoryWalker->release(walkID);
+            throw;
+        }
+        directoryWalker->release(walkID);
     }
 
     if (asSetting.rescanResource && obj->hasResource(CH_RESOURCE)) {
@@ -644,10 +804,10 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
 
     std::error_code ec;
     auto rootDir = fs::directory_entry(location, ec);
-    fs::directory_iterator dIter;
+    std::vector<fs::directory_entry> dIter;
 
     if (!ec && rootDir.exists(ec) && rootDir.is_directory(ec)) {
-        dIter = fs::directory_iterator(location, ec);
+        dIter = directoryWalker->list(location, ec);
         if (ec) {
             log_error("_rescanDirectory: Failed to iterate {}, {}", location.c_str(), ec.message());
         }
@@ -680,8 +840,18 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
 
     log_debug("Rescanning options {}: recursive={} hidden={} followSymlinks={}", location.c_str(), asSetting.recursive, asSetting.hidden, asSetting.followSymlinks);
 
+    // files of a directory that did not change since its last complete scan are not compared with the database,
+    // subdirectories are still rescanned as their contents may have changed
+    auto dirState = getDirectoryState(location, dIter, asSetting.hidden, asSetting.followSymlinks);
+    DirectoryState lastState {};
+    bool unchanged = database->loadDirectoryState(containerID, lastState) && lastState.mtime == dirState.mtime && lastState.digest == dirState.digest;
+    if (unchanged)
+        log_debug("{} is unchanged, checking subdirectories only", location.c_str());
+
     // request only items if non-recursive scan is wanted
-    auto list = database->getObjects(containerID, !asSetting.recursive);
+    std::unique_ptr<std::unordered_set<int>> list;
+    if (!unchanged)
+        list = database->getObjects(containerID, !asSetting.recursive);
 
     unsigned int thisTaskID;
     if (task != nullptr) {
@@ -690,11 +860,45 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
         thisTaskID = 0;
     }
 
+    // unchanged files are only loaded to find album art if the container has none yet
+    bool needFanArt = !parentContainer || std::none_of(parentContainer->getResources().begin(), parentContainer->getResources().end(), [](auto&& res) { return res->isMetaResource(ID3_ALBUM_ART); });
+
     auto last_modified_current_max = adir->getPreviousLMT(location, parentContainer);
     auto last_modified_new_max = last_modified_current_max;
     adir->setCurrentLMT(location, std::chrono::seconds::zero());
 
     std::shared_ptr<CdsObject> firstObject = nullptr;
+    // the state is only stored if every file made it into the database
+    bool complete = true;
+
+    // new and changed files are written in batches to save a transaction per file
+    std::vector<std::shared_ptr<CdsObject>> batch;
+    std::deque<PendingItem> pending;
+    auto addBatch = [&]() {
+        complete = collectItems(pending, batch) && complete;
+        if (batch.empty())
+            return;
+        addObjects(batch, false);
+        for (auto&& obj : batch) {
+            if (obj->getID() == INVALID_OBJECT_ID) {
+                complete = false;
+                continue;
+            }
+            if (!firstObject && obj->getClass() == UPNP_CLASS_MUSIC_TRACK) {
+                firstObject = obj;
+            }
+            fs::path rootPath = rootpath;
+            processSingleItem(obj, rootPath, nullptr);
+        }
+        batch.clear();
+    };
+    auto addBatchItem = [&](const fs::directory_entry& dirEnt) {
+        // never add the server configuration file
+        if (config->getConfigFilename() == dirEnt.path())
+            return;
+        extractItem(dirEnt, asSetting.followSymlinks, task, pending);
+    };
+
     for (auto&& dirEnt : dIter) {
         auto&& newPath = dirEnt.path();
         auto&& name = newPath.filename().string();
@@ -709,6 +913,7 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
         // in this case we will invalidate the autoscan entry
         if (adir->getScanID() == INVALID_SCAN_ID) {
             log_info("lost autoscan for {}", newPath.c_str());
+            addBatch();
             finishScan(adir, location, parentContainer, last_modified_new_max);
             return;
         }
@@ -728,6 +933,10 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
         asSetting.followSymlinks = config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS);
         asSetting.hidden = adir->getHidden();
         asSetting.mergeOptions(config, location);
+
+        std::error_code dirEc;
+        if (unchanged && !(asSetting.recursive && dirEnt.is_directory(dirEc)))
+            continue;
         auto lwt = to_seconds(dirEnt.last_write_time(ec));
 
         if (isRegularFile(dirEnt, ec)) {
@@ -741,22 +950,22 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
                     // re-add object - we have to do this in order to trigger
                     // layout
                     removeObject(adir, objectID, false, false);
-                    asSetting.recursive = false;
-                    asSetting.rescanResource = false;
-                    objectID = addFileInternal(dirEnt, rootpath, asSetting, false);
+                    addBatchItem(dirEnt);
+                    objectID = INVALID_OBJECT_ID;
                     // update time variable
                     if (last_modified_new_max < lwt)
                         last_modified_new_max = lwt;
                 }
             } else {
-                // add file, not recursive, not async, not forced
-                asSetting.recursive = false;
-                asSetting.rescanResource = false;
-                objectID = addFileInternal(dirEnt, rootpath, asSetting, false);
+                // add file with the other new files of the directory, unless it was moved here
+                if (!moveIdenticalFile(adir, dirEnt))
+                    addBatchItem(dirEnt);
                 if (last_modified_new_max < lwt)
                     last_modified_new_max = lwt;
             }
-            if (!firstObject && objectID > 0) {
+            if (batch.size() + pending.size() >= IMPORT_BATCH_SIZE)
+                addBatch();
+            if (!firstObject && objectID > 0 && needFanArt) {
                 firstObject = database->loadObject(objectID);
                 if (firstObject->getClass() != UPNP_CLASS_MUSIC_TRACK) {
                     firstObject = nullptr;
@@ -770,6 +979,7 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
                 log_debug("rescanSubDirectory {}", newPath.c_str());
                 if (list != nullptr)
                     list->erase(objectID);
+                rescanWalkID = directoryWalker->prefetch(newPath, asSetting.hidden, asSetting.followSymlinks, false, rescanWalkID);
                 // add a task to rescan the directory that was found
                 rescanDirectory(adir, objectID, newPath, task->isCancellable());
             } else {
@@ -786,6 +996,7 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
                 // in this case we will invalidate the autoscan entry
                 if (adir->getScanID() == INVALID_SCAN_ID) {
                     log_info("lost autoscan for {}", newPath.c_str());
+                    addBatch();
                     finishScan(adir, location, parentContainer, last_modified_new_max);
                     return;
                 }
@@ -800,10 +1011,13 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
         }
         if (ec) {
             log_error("_rescanDirectory: Failed to read {}, {}", newPath.c_str(), ec.message());
+            complete = false;
         }
     } // dIter
+    addBatch();
 
-    finishScan(adir, location, parentContainer, last_modified_new_max, firstObject);
+    std::shared_ptr<CdsContainer> unchangedContainer;
+    finishScan(adir, location, unchanged ? unchangedContainer : parentContainer, last_modified_new_max, firstObject);
 
     if ((shutdownFlag) || ((task != nullptr) && !task->isValid())) {
         return;
@@ -815,10 +1029,12 @@ void ContentManager::_rescanDirectory(const std::shared_ptr<AutoscanDirectory>&
             update_manager->containersChanged(changedContainers->upnp);
         }
     }
+    if (!unchanged && complete)
+        database->storeDirectoryState(containerID, dirState);
 }
 
 /* scans the given directory and adds everything recursively */
-void ContentManager::addRecursive(std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& subDir, bool followSymlinks, bool hidden, const std::shared_ptr<CMAddFileTask>& task)
+void ContentManager::addRecursive(std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& subDir, bool followSymlinks, bool hidden, const std::shared_ptr<CMAddFileTask>& task, unsigned int walkID)
 {
     auto f2i = StringConverter::f2i(config);
 
@@ -847,27 +1063,12 @@ void ContentManager::addRecursive(std::shared_ptr<AutoscanDirectory>& adir, cons
     if (task != nullptr) {
         log_debug("IS TASK VALID? [{}], task path: [{}]", task->isValid(), subDir.path().c_str());
     }
-#ifdef HAVE_INOTIFY
     if (adir == nullptr) {
-        for (size_t i = 0; i < autoscan_inotify->size(); i++) {
-            log_debug("AutoDir {}", i);
-            std::shared_ptr<AutoscanDirectory> dir = autoscan_inotify->get(i);
-            if (dir != nullptr && startswith(dir->getLocation(), subDir.path()) && fs::is_directory(dir->getLocation())) {
-                adir = dir;
-            }
-        }
-    }
-#endif
-    if (adir == nullptr) {
-        for (size_t i = 0; i < autoscan_timed->size(); i++) {
-            log_debug("Timed AutoscanDir {}", i);
-            std::shared_ptr<AutoscanDirectory> dir = autoscan_timed->get(i);
-            if (dir != nullptr && startswith(dir->getLocation(), subDir.path()) && fs::is_directory(dir->getLocation())) {
-                adir = dir;
-            }
-        }
+        adir = findAutoscanDirectory(subDir.path());
+        if (adir != nullptr && !fs::is_directory(adir->getLocation()))
+            adir = nullptr;
     }
-    auto dIter = fs::directory_iterator(subDir, ec);
+    auto dIter = directoryWalker->list(subDir.path(), ec);
     if (ec) {
         log_error("addRecursive: Failed to iterate {}, {}", subDir.path().c_str(), ec.message());
         return;
@@ -882,49 +1083,98 @@ void ContentManager::addRecursive(std::shared_ptr<AutoscanDirectory>& adir, cons
     }
 
     bool firstChild = true;
+    bool complete = true;
     std::shared_ptr<CdsObject> firstObject = nullptr;
+
+    // new items are written in batches to save a transaction per file
+    std::vector<std::shared_ptr<CdsObject>> batch;
+    std::deque<PendingItem> pending;
+    bool firstBatch = true;
+    auto addBatch = [&]() {
+        complete = collectItems(pending, batch) && complete;
+        if (batch.empty())
+            return;
+        addObjects(batch, firstBatch);
+        firstBatch = false;
+        for (auto&& obj : batch) {
+            if (obj->getID() == INVALID_OBJECT_ID) {
+                complete = false;
+                continue;
+            }
+            parentID = obj->getParentID();
+            if (!firstObject && obj->getClass() == UPNP_CLASS_MUSIC_TRACK) {
+                firstObject = obj;
+            }
+            fs::path rootPath("");
+            processSingleItem(obj, rootPath, task);
+        }
+        batch.clear();
+    };
+
     for (auto&& subDirEnt : dIter) {
         auto&& newPath = subDirEnt.path();
         auto&& name = newPath.filename().string();
         if (name[0] == '.' && !hidden) {
             continue;
         }
-        if ((shutdownFlag) || ((task != nullptr) && !task->isValid()))
+        if ((shutdownFlag) || ((task != nullptr) && !task->isValid())) {
+            complete = false;
             break;
+        }
 
         if (config->getConfigFilename() == newPath)
             continue;
 
         // For the Web UI
         if (task != nullptr) {
-            task->setDescription(fmt::format("Importing: {}", newPath.string().c_str()));
+            auto [taken, found] = directoryWalker->getProgress(walkID);
+            if (found > 0)
+                task->setDescription(fmt::format("Importing: {} ({}/{} directories)", newPath.string().c_str(), taken, found));
+            else
+                task->setDescription(fmt::format("Importing: {}", newPath.string().c_str()));
         }
 
         try {
             fs::path rootPath("");
-            // check database if parent, process existing
-            auto obj = createSingleItem(subDirEnt, rootPath, followSymlinks, (parentID > 0), true, firstChild, task);
+            std::shared_ptr<CdsObject> obj;
+            // new files are extracted by the metadata workers while the directory is read on
+            bool isNewFile = isRegularFile(subDirEnt, ec) && (followSymlinks || !subDirEnt.is_symlink())
+                && (parentID <= 0 || database->findObjectIDByPath(newPath) == INVALID_OBJECT_ID);
+            if (isNewFile) {
+                if (!moveIdenticalFile(adir, subDirEnt))
+                    extractItem(subDirEnt, followSymlinks, task, pending);
+            } else {
+                // check database if parent, process existing
+                obj = createSingleItem(subDirEnt, rootPath, followSymlinks, (parentID > 0), true, firstChild, task, &batch);
+            }
 
-            if (obj != nullptr) {
+            if (isNewFile || obj != nullptr) {
                 firstChild = false;
                 auto lwt = to_seconds(subDirEnt.last_write_time(ec));
                 if (last_modified_current_max < lwt) {
                     last_modified_new_max = lwt;
                 }
-                if (obj->isItem()) {
+            }
+            if (obj != nullptr) {
+                if (obj->isItem() && obj->getID() != INVALID_OBJECT_ID) {
                     parentID = obj->getParentID();
                     if (!firstObject && obj->getClass() == UPNP_CLASS_MUSIC_TRACK) {
                         firstObject = obj;
                     }
                 }
                 if (obj->isContainer()) {
-                    addRecursive(adir, subDirEnt, followSymlinks, hidden, task);
+                    addBatch();
+                    addRecursive(adir, subDirEnt, followSymlinks, hidden, task, walkID);
                 }
             }
         } catch (const std::runtime_error& ex) {
             log_warning("skipping {} (ex:{})", newPath.c_str(), ex.what());
+            complete = false;
         }
+        if (batch.size() + pending.size() >= IMPORT_BATCH_SIZE)
+            addBatch();
     } // dIter
+    addBatch();
 
     if (parentID != INVALID_OBJECT_ID && !parentContainer) {
         try {
@@ -938,6 +1188,61 @@ void ContentManager::addRecursive(std::shared_ptr<AutoscanDirectory>& adir, cons
         }
     }
     finishScan(adir, subDir.path(), parentContainer, last_modified_new_max, firstObject);
+
+    // the next rescan can skip the files
+    if (complete && parentContainer)
+        database->storeDirectoryState(parentContainer->getID(), getDirectoryState(subDir.path(), dIter, hidden, followSymlinks));
+}
+
+DirectoryState ContentManager::getDirectoryState(const fs::path& location, const std::vector<fs::directory_entry>& entries, bool hidden, bool followSymlinks)
+{
+    auto hashBytes = [](unsigned long long hash, const void* data, std::size_t len) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < len; i++) {
+            hash = (hash ^ bytes[i]) * DIGEST_PRIME;
+        }
+        return hash;
+    };
+
+    DirectoryState state {};
+    struct stat statbuf;
+    if (stat(location.c_str(), &statbuf) == 0)
+        state.mtime = static_cast<long long>(statbuf.st_mtim.tv_sec) * 1000000000LL + statbuf.st_mtim.tv_nsec;
+
+    // files are skipped or typed differently when these settings change
+    std::ostringstream settings;
+    settings << hidden << followSymlinks << config->getBoolOption(CFG_IMPORT_MAPPINGS_IGNORE_UNKNOWN_EXTENSIONS)
+             << config->getBoolOption(CFG_IMPORT_MAPPINGS_EXTENSION_TO_MIMETYPE_CASE_SENSITIVE) << config->getBoolOption(CFG_IMPORT_READABLE_NAMES)
+             << ';' << join(config->getArrayOption(CFG_IMPORT_SYSTEM_DIRECTORIES), ',');
+    for (auto option : { CFG_IMPORT_MAPPINGS_EXTENSION_TO_MIMETYPE_LIST, CFG_IMPORT_MAPPINGS_MIMETYPE_TO_UPNP_CLASS_LIST, CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST }) {
+        for (auto&& [key, value] : config->getDictionaryOption(option))
+            settings << ';' << key << '=' << value;
+    }
+#ifdef HAVE_MAGIC
+    settings << ';' << config->getOption(CFG_IMPORT_MAGIC_FILE);
+#endif
+    auto&& settingsStr = settings.str();
+
+    // entry hashes are added up, so the order of the listing does not matter
+    unsigned long long digest = hashBytes(DIGEST_OFFSET_BASIS, settingsStr.data(), settingsStr.size());
+    for (auto&& entry : entries) {
+        auto&& name = entry.path().filename().native();
+        auto hash = hashBytes(DIGEST_OFFSET_BASIS, name.data(), name.size());
+        std::error_code ec;
+        long long values[5] = { entry.is_symlink(ec) ? 1 : 0 };
+        // subdirectories are compared by their own rescan
+        if (stat(entry.path().c_str(), &statbuf) == 0) {
+            values[1] = statbuf.st_mode;
+            if (!S_ISDIR(statbuf.st_mode)) {
+                values[2] = statbuf.st_size;
+                values[3] = statbuf.st_mtim.tv_sec;
+                values[4] = statbuf.st_mtim.tv_nsec;
+            }
+        }
+        digest += hashBytes(hash, values, sizeof(values));
+    }
+    state.digest = static_cast<long long>(digest);
+    return state;
 }
 
 void ContentManager::finishScan(const std::shared_ptr<AutoscanDirectory>& adir, const fs::path& location, std::shared_ptr<CdsContainer>& parent, std::chrono::seconds lmt, const std::shared_ptr<CdsObject>& firstObject)
@@ -1102,6 +1407,52 @@ void ContentManager::addObject(const std::shared_ptr<CdsObject>& obj, bool first
         session_manager->containerChangedUI(obj->getParentID());
 }
 
+void ContentManager::addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, bool firstChild)
+{
+    if (objects.empty())
+        return;
+
+    int containerChanged = INVALID_OBJECT_ID;
+    try {
+        database->addObjects(objects, &containerChanged);
+    } catch (const std::runtime_error& e) {
+        log_warning("Failed to add {} objects at once, adding them one by one: {}", objects.size(), e.what());
+        for (auto&& obj : objects) {
+            // stored before the failure
+            if (obj->getID() != INVALID_OBJECT_ID) {
+                update_manager->containerChanged(obj->getParentID());
+                firstChild = false;
+                continue;
+            }
+            try {
+                addObject(obj, firstChild);
+                firstChild = false;
+            } catch (const std::runtime_error& ex) {
+                log_warning("skipping {} (ex:{})", obj->getLocation().c_str(), ex.what());
+            }
+        }
+        return;
+    }
+
+    update_manager->containerChanged(containerChanged);
+    session_manager->containerChangedUI(containerChanged);
+
+    std::map<int, int> addedChildren;
+    for (auto&& obj : objects) {
+        if (obj->getID() != INVALID_OBJECT_ID)
+            addedChildren[obj->getParentID()]++;
+    }
+    for (auto&& [parent_id, count] : addedChildren) {
+        // the container only holds the new entries, so it is new also, send update for parent of parent
+        if (firstChild && parent_id != -1 && database->getChildCount(parent_id) == count) {
+            auto parent = database->loadObject(parent_id);
+            log_debug("Will update parent ID {}", parent->getParentID());
+            update_manager->containerChanged(parent->getParentID());
+        }
+        update_manager->containerChanged(parent_id);
+    }
+}
+
 void ContentManager::addContainer(int parentID, std::string title, const std::string& upnpClass)
 {
     addContainerChain(database->buildContainerPath(parentID, escape(std::move(title), VIRTUAL_CONTAINER_ESCAPE, VIRTUAL_CONTAINER_SEPARATOR)), upnpClass);
@@ -1121,9 +1472,7 @@ std::pair<int, bool> ContentManager::addContainerTree(const std::vector<std::sha
         }
         tree = fmt::format("{}{}{}", tree, VIRTUAL_CONTAINER_SEPARATOR, escape(item->getTitle(), VIRTUAL_CONTAINER_ESCAPE, VIRTUAL_CONTAINER_SEPARATOR));
         log_debug("Received chain item {}", tree);
-        for (auto&& [key, val] : config->getDictionaryOption(CFG_IMPORT_LAYOUT_MAPPING)) {
-            tree = std::regex_replace(tree, std::regex(key), val);
-        }
+        tree = getLayoutMapping().replaceAll(tree);
         if (containerMap.find(tree) == containerMap.end()) {
             item->setMetadata(M_TITLE, item->getTitle());
             database->addContainerChain(tree, item->getClass(), INVALID_OBJECT_ID, &result, createdIds, item->getMetadata());
@@ -1143,6 +1492,19 @@ std::pair<int, bool> ContentManager::addContainerTree(const std::vector<std::sha
     return { result, isNew };
 }
 
+const RegexMapping& ContentManager::getLayoutMapping()
+{
+    // the option is edited in place, its setup counts the changes
+    if (layoutMappingSetup == nullptr)
+        layoutMappingSetup = ConfigDefinition::findConfigSetup(CFG_IMPORT_LAYOUT_MAPPING);
+    auto generation = layoutMappingSetup->getGeneration();
+    if (layoutMapping == nullptr || generation != layoutMappingGeneration) {
+        layoutMapping = std::make_unique<RegexMapping>(config->getDictionaryOption(CFG_IMPORT_LAYOUT_MAPPING));
+        layoutMappingGeneration = generation;
+    }
+    return *layoutMapping;
+}
+
 std::pair<int, bool> ContentManager::addContainerChain(const std::string& chain, const std::string& lastClass, int lastRefID, const std::shared_ptr<CdsObject>& origObj)
 {
     std::map<std::string, std::string> lastMetadata = origObj != nullptr ? origObj->getMetadata() : std::map<std::string, std::string>();
@@ -1152,10 +1514,7 @@ std::pair<int, bool> ContentManager::addContainerChain(const std::string& chain,
     if (chain.empty())
         throw_std_runtime_error("addContainerChain() called with empty chain parameter");
 
-    std::string newChain = chain;
-    for (auto&& [key, val] : config->getDictionaryOption(CFG_IMPORT_LAYOUT_MAPPING)) {
-        newChain = std::regex_replace(newChain, std::regex(key), val);
-    }
+    std::string newChain = getLayoutMapping().replaceAll(chain);
 
     log_debug("Received chain: {} -> {} ({}) [{}]", chain.c_str(), newChain.c_str(), lastClass.c_str(), dictEncodeSimple(lastMetadata).c_str());
     // copy artist to album artist if empty
@@ -1275,7 +1634,8 @@ std::shared_ptr<CdsObject> ContentManager::createObjectFromFile(const fs::direct
     std::shared_ptr<CdsObject> obj;
     if (isRegularFile(dirEnt, ec) || (allow_fifo && dirEnt.is_fifo(ec))) { // item
         /* retrieve information about item and decide if it should be included */
-        std::string mimetype = mime->getMimeType(dirEnt.path(), MIMETYPE_DEFAULT);
+        auto file = std::make_shared<MediaFile>(dirEnt.path());
+        std::string mimetype = mime->getMimeType(dirEnt.path(), MIMETYPE_DEFAULT, file);
         if (mimetype.empty()) {
             return nullptr;
         }
@@ -1285,7 +1645,7 @@ std::shared_ptr<CdsObject> ContentManager::createObjectFromFile(const fs::direct
         if (upnp_class.empty()) {
             std::string content_type = getValueOrDefault(mimetype_contenttype_map, mimetype);
             if (content_type == CONTENT_TYPE_OGG) {
-                upnp_class = isTheora(dirEnt.path())
+                upnp_class = isTheora(file->getHeader())
                     ? UPNP_CLASS_VIDEO_ITEM
                     : UPNP_CLASS_MUSIC_TRACK;
             }
@@ -1305,15 +1665,9 @@ std::shared_ptr<CdsObject> ContentManager::createObjectFromFile(const fs::direct
             item->setClass(upnp_class);
         }
 
-        auto f2i = StringConverter::f2i(config);
-        auto title = dirEnt.path().filename().string();
-        if (config->getBoolOption(CFG_IMPORT_READABLE_NAMES) && upnp_class != UPNP_CLASS_ITEM) {
-            title = dirEnt.path().stem().string();
-            title = replaceAllString(title, "_", " ");
-        }
-        obj->setTitle(f2i->convert(title));
+        obj->setTitle(getFileTitle(dirEnt.path(), upnp_class));
 
-        MetadataHandler::setMetadata(context, item, dirEnt);
+        MetadataHandler::setMetadata(context, item, dirEnt, file);
     } else if (dirEnt.is_directory(ec)) {
         obj = std::make_shared<CdsContainer>();
         /* adding containers is done by Database now
@@ -1336,6 +1690,17 @@ std::shared_ptr<CdsObject> ContentManager::createObjectFromFile(const fs::direct
     return obj;
 }
 
+std::string ContentManager::getFileTitle(const fs::path& path, const std::string& upnpClass) const
+{
+    auto f2i = StringConverter::f2i(config);
+    auto title = path.filename().string();
+    if (config->getBoolOption(CFG_IMPORT_READABLE_NAMES) && upnpClass != UPNP_CLASS_ITEM) {
+        title = path.stem().string();
+        title = replaceAllString(title, "_", " ");
+    }
+    return f2i->convert(title);
+}
+
 void ContentManager::initLayout()
 {
     if (layout == nullptr) {
@@ -1423,6 +1788,11 @@ void ContentManager::threadProc()
         }
 
         if (task == nullptr) {
+            // the rescans that queued their subdirectories are done
+            if (rescanWalkID != 0) {
+                directoryWalker->release(rescanWalkID);
+                rescanWalkID = 0;
+            }
             working = false;
             /* if nothing to do, sleep until awakened */
             threadRunner->wait(lock);
@@ -1656,6 +2026,163 @@ void ContentManager::removeObject(const std::shared_ptr<AutoscanDirectory>& adir
     }
 }
 
+bool ContentManager::moveObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, const fs::path& location, bool async)
+{
+    std::shared_ptr<CdsObject> obj;
+    try {
+        obj = database->loadObject(objectID);
+    } catch (const std::runtime_error& e) {
+        log_debug("trying to move an object ID which is no longer in the database! {}", objectID);
+        return false;
+    }
+
+    // the directory of the resource has to be rescanned
+    if (obj->hasResource(CH_RESOURCE))
+        return false;
+
+    if (obj->isContainer()) {
+        // the locations of autoscan directories are not moved with the container
+        if (!autoscan_timed->getSubdirs(obj->getLocation()).empty())
+            return false;
+#ifdef HAVE_INOTIFY
+        if (config->getBoolOption(CFG_IMPORT_AUTOSCAN_USE_INOTIFY) && !autoscan_inotify->getSubdirs(obj->getLocation()).empty())
+            return false;
+#endif
+    }
+
+    if (async) {
+        auto task = std::make_shared<CMMoveObjectTask>(shared_from_this(), adir, objectID, location);
+        task->setDescription(fmt::format("Move: {} to {}", obj->getLocation().c_str(), location.c_str()));
+        addTask(task);
+    } else {
+        _moveObject(adir, objectID, location);
+    }
+    return true;
+}
+
+void ContentManager::_moveObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, const fs::path& location)
+{
+    std::shared_ptr<CdsObject> obj;
+    try {
+        obj = database->loadObject(objectID);
+    } catch (const std::runtime_error& e) {
+        log_warning("Object {} was removed before it could be moved to {}", objectID, location.c_str());
+        return;
+    }
+    log_debug("Moving {} to {}", obj->getLocation().c_str(), location.c_str());
+
+    // the move replaced a file
+    int replacedID = database->findObjectIDByPath(location);
+    if (replacedID != INVALID_OBJECT_ID && replacedID != objectID)
+        _removeObject(adir, replacedID, false, false);
+
+    // keep titles taken from metadata
+    auto title = obj->getTitle();
+    if (obj->isContainer()) {
+        title = StringConverter::f2i(config)->convert(location.filename());
+    } else if (title == getFileTitle(obj->getLocation(), obj->getClass())) {
+        title = getFileTitle(location, obj->getClass());
+    }
+
+    containerMap.clear();
+    std::vector<int> movedItems;
+    auto changedContainers = database->moveObject(objectID, location, title, movedItems);
+    if (changedContainers != nullptr) {
+        session_manager->containerChangedUI(changedContainers->ui);
+        update_manager->containersChanged(changedContainers->upnp);
+    }
+
+    // the layout may depend on the location, so the virtual items are created again
+    if (layout == nullptr)
+        return;
+    auto references = database->getReferences(movedItems);
+    if (references != nullptr) {
+        changedContainers = database->removeObjects(references);
+        if (changedContainers != nullptr) {
+            session_manager->containerChangedUI(changedContainers->ui);
+            update_manager->containersChanged(changedContainers->upnp);
+        }
+    }
+    fs::path rootPath = adir != nullptr ? adir->getLocation() : fs::path();
+    for (auto&& itemID : movedItems) {
+        if (shutdownFlag)
+            break;
+        try {
+            layout->processCdsObject(database->loadObject(itemID), rootPath);
+        } catch (const std::runtime_error& e) {
+            log_error("{}", e.what());
+        }
+    }
+}
+
+void ContentManager::updateFiles(const std::shared_ptr<AutoscanDirectory>& adir, std::vector<fs::path> paths)
+{
+    if (paths.empty())
+        return;
+    auto description = fmt::format("Update: {} ({} files)", paths.front().parent_path().c_str(), paths.size());
+    auto task = std::make_shared<CMUpdateFilesTask>(shared_from_this(), adir, std::move(paths));
+    task->setDescription(description);
+    addTask(task, true);
+}
+
+void ContentManager::_updateFiles(const std::shared_ptr<AutoscanDirectory>& adir, const std::vector<fs::path>& paths, const std::shared_ptr<GenericTask>& task)
+{
+    AutoScanSetting asSetting;
+    asSetting.adir = adir;
+    asSetting.followSymlinks = config->getBoolOption(CFG_IMPORT_FOLLOW_SYMLINKS);
+    asSetting.recursive = adir->getRecursive();
+    asSetting.hidden = adir->getHidden();
+    asSetting.rescanResource = true;
+
+    std::error_code ec;
+    for (auto&& path : paths) {
+        if (shutdownFlag || (task != nullptr && !task->isValid()))
+            break;
+
+        auto dirEnt = fs::directory_entry(path, ec);
+        bool exists = !ec && dirEnt.exists(ec);
+        auto obj = database->findObjectByPath(path, true);
+        if (obj != nullptr) {
+            if (exists && obj->getMTime() == to_seconds(dirEnt.last_write_time(ec))) {
+                log_debug("{} is unchanged", path.c_str());
+                continue;
+            }
+            log_debug("deleting {}", path.c_str());
+            _removeObject(adir, obj->getID(), true, false);
+        } else if (exists && moveIdenticalFile(adir, dirEnt)) {
+            continue;
+        }
+
+        if (exists) {
+            log_debug("Adding {}", path.c_str());
+            auto fileSetting = asSetting;
+            fileSetting.mergeOptions(config, path);
+            try {
+                _addFile(dirEnt, adir->getLocation(), fileSetting);
+            } catch (const std::runtime_error& e) {
+                log_error("Failed to add {}: {}", path.c_str(), e.what());
+            }
+        }
+    }
+}
+
+bool ContentManager::moveIdenticalFile(const std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& dirEnt)
+{
+    FileIdentity identity {};
+    if (!config->getBoolOption(CFG_IMPORT_METADATA_CACHE) || !MetadataHandler::getFileIdentity(dirEnt.path(), identity))
+        return false;
+
+    auto obj = database->findObjectByIdentity(identity);
+    std::error_code ec;
+    // a hard link or a copy keeps the old item
+    if (obj == nullptr || obj->getLocation() == dirEnt.path() || fs::exists(obj->getLocation(), ec))
+        return false;
+
+    log_info("Detected move of {} to {}", obj->getLocation().c_str(), dirEnt.path().c_str());
+    _moveObject(adir, obj->getID(), dirEnt.path());
+    return true;
+}
+
 void ContentManager::rescanDirectory(const std::shared_ptr<AutoscanDirectory>& adir, int objectId, fs::path descPath, bool cancellable)
 {
     // building container path for the description
@@ -1701,6 +2228,18 @@ std::shared_ptr<AutoscanDirectory> ContentManager::getAutoscanDirectory(const fs
     return adir;
 }
 
+std::shared_ptr<AutoscanDirectory> ContentManager::findAutoscanDirectory(const fs::path& path) const
+{
+    auto adir = autoscan_timed->getContaining(path);
+#if HAVE_INOTIFY
+    auto inotifyDir = autoscan_inotify->getContaining(path);
+    // the deeper one if both contain the path
+    if (inotifyDir != nullptr && (adir == nullptr || inotifyDir->getLocation().string().length() >= adir->getLocation().string().length()))
+        adir = inotifyDir;
+#endif
+    return adir;
+}
+
 std::vector<std::shared_ptr<AutoscanDirectory>> ContentManager::getAutoscanDirectories() const
 {
 #if HAVE_INOTIFY
@@ -1947,6 +2486,40 @@ CMRescanDirectoryTask::CMRescanDirectoryTask(std::shared_ptr<ContentManager> con
     this->taskType = RescanDirectory;
 }
 
+CMMoveObjectTask::CMMoveObjectTask(std::shared_ptr<ContentManager> content, std::shared_ptr<AutoscanDirectory> adir,
+    int objectID, fs::path location)
+    : GenericTask(ContentManagerTask)
+    , content(std::move(content))
+    , adir(std::move(adir))
+    , objectID(objectID)
+    , location(std::move(location))
+{
+    this->taskType = MoveObject;
+    cancellable = false;
+}
+
+void CMMoveObjectTask::run()
+{
+    content->_moveObject(adir, objectID, location);
+}
+
+CMUpdateFilesTask::CMUpdateFilesTask(std::shared_ptr<ContentManager> content, std::shared_ptr<AutoscanDirectory> adir,
+    std::vector<fs::path> paths)
+    : GenericTask(ContentManagerTask)
+    , content(std::move(content))
+    , adir(std::move(adir))
+    , paths(std::move(paths))
+{
+    this->taskType = UpdateFiles;
+    cancellable = false;
+}
+
+void CMUpdateFilesTask::run()
+{
+    auto self = shared_from_this();
+    content->_updateFiles(adir, paths, self);
+}
+
 void CMRescanDirectoryTask::run()
 {
     if (adir == nullptr)
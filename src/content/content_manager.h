@@ -32,6 +32,7 @@
 #define __CONTENT_MANAGER_H__
 
 #include <deque>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -43,6 +44,7 @@
 #include "common.h"
 #include "context.h"
 #include "util/generic_task.h"
+#include "util/regex_mapping.h"
 #include "util/thread_runner.h"
 #include "util/timer.h"
 
@@ -56,6 +58,10 @@ class ScriptingRuntime;
 #endif // HAVE_JS
 
 #include "layout/layout.h"
+#include "directory_walker.h"
+#include "metadata/art_cache.h"
+#include "metadata/thumbnail_cache.h"
+#include "metadata_workers.h"
 
 #include "autoscan_list.h"
 #ifdef HAVE_INOTIFY
@@ -72,7 +78,9 @@ class ScriptingRuntime;
 #include "util/executor.h"
 
 // forward declarations
+class ConfigSetup;
 class ContentManager;
+struct DirectoryState;
 class LastFm;
 class Runtime;
 class Server;
@@ -107,6 +115,31 @@ public:
     void run() override;
 };
 
+class CMMoveObjectTask : public GenericTask {
+protected:
+    std::shared_ptr<ContentManager> content;
+    std::shared_ptr<AutoscanDirectory> adir;
+    int objectID;
+    fs::path location;
+
+public:
+    CMMoveObjectTask(std::shared_ptr<ContentManager> content, std::shared_ptr<AutoscanDirectory> adir,
+        int objectID, fs::path location);
+    void run() override;
+};
+
+class CMUpdateFilesTask : public GenericTask, public std::enable_shared_from_this<CMUpdateFilesTask> {
+protected:
+    std::shared_ptr<ContentManager> content;
+    std::shared_ptr<AutoscanDirectory> adir;
+    std::vector<fs::path> paths;
+
+public:
+    CMUpdateFilesTask(std::shared_ptr<ContentManager> content, std::shared_ptr<AutoscanDirectory> adir,
+        std::vector<fs::path> paths);
+    void run() override;
+};
+
 class CMRescanDirectoryTask : public GenericTask, public std::enable_shared_from_this<CMRescanDirectoryTask> {
 protected:
     std::shared_ptr<ContentManager> content;
@@ -164,6 +197,21 @@ public:
     /// \brief Find a task identified by the task ID and invalidate it.
     void invalidateTask(unsigned int taskID, task_owner_t taskOwner = ContentManagerTask);
 
+    /// \brief Returns the number of enqueued tasks, without the current one.
+    std::size_t getTaskQueueSize();
+
+#ifdef HAVE_INOTIFY
+    /// \brief Returns the event coalescing counters of the inotify thread.
+    AutoscanInotify::Stats getInotifyStats() const;
+#endif
+
+    /// \brief Returns the cache of the video thumbnails, nullptr if they are disabled.
+    std::shared_ptr<ThumbnailCache> getThumbnailCache() const { return thumbnailCache; }
+    /// \brief Returns the cache of the art embedded in media files, nullptr if it is disabled.
+    std::shared_ptr<ArtCache> getArtCache() const { return artCache; }
+    /// \brief Returns the cache of the downscaled images, nullptr if they are disabled.
+    std::shared_ptr<ThumbnailCache> getImageCache() const { return imageCache; }
+
     /* the functions below return true if the task has been enqueued */
 
     /// \brief Adds a file or directory to the database.
@@ -192,6 +240,18 @@ public:
     int ensurePathExistence(fs::path path);
     void removeObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, bool rescanResource, bool async = true, bool all = false);
 
+    /// \brief Moves a file or directory that was renamed on disk.
+    ///
+    /// Metadata and object ids are kept, only the layout is run again for the moved items.
+    /// \return false if the object cannot be moved in place and has to be removed and added again
+    bool moveObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, const fs::path& location, bool async = true);
+
+    /// \brief Imports the net change of files that had events, e.g. from inotify.
+    ///
+    /// Missing files are removed, new or modified files are (re)added and unchanged files are skipped.
+    /// \param paths files of one directory, handled in one low priority task
+    void updateFiles(const std::shared_ptr<AutoscanDirectory>& adir, std::vector<fs::path> paths);
+
     /// \brief Updates an object in the database using the given parameters.
     /// \param objectID ID of the object to update
     /// \param parameters key value pairs of fields to be updated
@@ -229,6 +289,11 @@ public:
     /// The ID of the object provided is ignored and generated by this method
     void addObject(const std::shared_ptr<CdsObject>& obj, bool firstChild);
 
+    /// \brief Adds the new items of a directory with one database transaction.
+    /// \param objects items to add, objects that could not be added keep INVALID_OBJECT_ID
+    /// \param firstChild indicate that the objects are the first children in their parent container
+    void addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, bool firstChild);
+
     /// \brief Adds a virtual container chain specified by path.
     /// \param container path separated by '/'. Slashes in container
     /// titles must be escaped.
@@ -262,6 +327,9 @@ public:
     /// \brief Get an AutoscanDirectory given by location on disk from the watch list.
     std::shared_ptr<AutoscanDirectory> getAutoscanDirectory(const fs::path& location) const;
 
+    /// \brief Get the deepest AutoscanDirectory containing path, or nullptr.
+    std::shared_ptr<AutoscanDirectory> findAutoscanDirectory(const fs::path& path) const;
+
     /// \brief returns an array of all autoscan directories
     std::vector<std::shared_ptr<AutoscanDirectory>> getAutoscanDirectories() const;
 
@@ -323,6 +391,11 @@ protected:
     std::shared_ptr<Context> context;
     ///\brief cache for containers while creating new layout
     std::map<std::string, std::shared_ptr<CdsContainer>> containerMap;
+    /// \brief CFG_IMPORT_LAYOUT_MAPPING, compiled again when the web ui changed it
+    std::unique_ptr<RegexMapping> layoutMapping;
+    std::shared_ptr<ConfigSetup> layoutMappingSetup;
+    unsigned int layoutMappingGeneration {};
+    const RegexMapping& getLayoutMapping();
 
     std::shared_ptr<Timer> timer;
     std::shared_ptr<TaskProcessor> task_processor;
@@ -349,13 +422,34 @@ protected:
         const std::shared_ptr<CMAddFileTask>& task = nullptr);
 
     void _removeObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, bool rescanResource, bool all);
+    void _moveObject(const std::shared_ptr<AutoscanDirectory>& adir, int objectID, const fs::path& location);
+    void _updateFiles(const std::shared_ptr<AutoscanDirectory>& adir, const std::vector<fs::path>& paths, const std::shared_ptr<GenericTask>& task);
+    /// \brief move the item of a new file that was imported before at a location that does not exist any more
+    /// \return true if the file was moved and must not be added
+    bool moveIdenticalFile(const std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& dirEnt);
+    /// \brief title of a file item without metadata
+    std::string getFileTitle(const fs::path& path, const std::string& upnpClass) const;
 
     void _rescanDirectory(const std::shared_ptr<AutoscanDirectory>& adir, int containerID, const std::shared_ptr<GenericTask>& task = nullptr);
     /* for recursive addition */
-    void addRecursive(std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& subDir, bool followSymlinks, bool hidden, const std::shared_ptr<CMAddFileTask>& task);
-    std::shared_ptr<CdsObject> createSingleItem(const fs::directory_entry& dirEnt, fs::path& rootPath, bool followSymlinks, bool checkDatabase, bool processExisting, bool firstChild, const std::shared_ptr<CMAddFileTask>& task);
+    void addRecursive(std::shared_ptr<AutoscanDirectory>& adir, const fs::directory_entry& subDir, bool followSymlinks, bool hidden, const std::shared_ptr<CMAddFileTask>& task, unsigned int walkID);
+    /// \brief create the object for dirEnt, new items are appended to batch instead of being added if batch is set
+    std::shared_ptr<CdsObject> createSingleItem(const fs::directory_entry& dirEnt, fs::path& rootPath, bool followSymlinks, bool checkDatabase, bool processExisting, bool firstChild, const std::shared_ptr<CMAddFileTask>& task,
+        std::vector<std::shared_ptr<CdsObject>>* batch = nullptr);
+    /// \brief run layout and playlist parser for an item that is stored in the database
+    void processSingleItem(const std::shared_ptr<CdsObject>& obj, fs::path& rootPath, const std::shared_ptr<CMAddFileTask>& task);
+
+    /// \brief a new file of an import and the object created for it
+    using PendingItem = std::pair<fs::path, std::future<std::shared_ptr<CdsObject>>>;
+    /// \brief create the object for a new file, on the metadata workers if they are enabled
+    void extractItem(const fs::directory_entry& dirEnt, bool followSymlinks, const std::shared_ptr<GenericTask>& task, std::deque<PendingItem>& pending);
+    /// \brief wait for the pending files in the order of extractItem and append their items to batch
+    /// \return false if a file could not be read
+    bool collectItems(std::deque<PendingItem>& pending, std::vector<std::shared_ptr<CdsObject>>& batch);
     bool updateAttachedResources(const std::shared_ptr<AutoscanDirectory>& adir, const fs::path& location, const std::string& parentPath, bool all);
     void finishScan(const std::shared_ptr<AutoscanDirectory>& adir, const fs::path& location, std::shared_ptr<CdsContainer>& parent, std::chrono::seconds lmt, const std::shared_ptr<CdsObject>& firstObject = nullptr);
+    /// \brief mtime of location and digest of name, type, size and mtime of its entries and of the import settings
+    DirectoryState getDirectoryState(const fs::path& location, const std::vector<fs::directory_entry>& entries, bool hidden, bool followSymlinks);
     static void invalidateAddTask(const std::shared_ptr<GenericTask>& t, const fs::path& path);
 
     void assignFanArt(const std::vector<std::shared_ptr<CdsContainer>>& containerList, const std::shared_ptr<CdsObject>& origObj);
@@ -364,6 +458,13 @@ protected:
     void updateCdsObject(std::shared_ptr<T>& item, const std::map<std::string, std::string>& parameters);
 
     std::shared_ptr<Layout> layout;
+    std::unique_ptr<MetadataWorkers> metadataWorkers;
+    std::shared_ptr<ThumbnailCache> thumbnailCache;
+    std::shared_ptr<ArtCache> artCache;
+    std::shared_ptr<ThumbnailCache> imageCache;
+    std::unique_ptr<DirectoryWalker> directoryWalker;
+    // walk collecting the subdirectories queued by rescans, released when the task queue runs empty
+    unsigned int rescanWalkID {};
 
 #ifdef ONLINE_SERVICES
     std::unique_ptr<OnlineServiceList> online_services;
@@ -393,6 +494,8 @@ protected:
 
     friend void CMAddFileTask::run();
     friend void CMRemoveObjectTask::run();
+    friend void CMMoveObjectTask::run();
+    friend void CMUpdateFilesTask::run();
     friend void CMRescanDirectoryTask::run();
 #ifdef ONLINE_SERVICES
     friend void CMFetchOnlineContentTask::run();
@@ -0,0 +1,309 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    directory_walker.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file directory_walker.cc
+
+#include "directory_walker.h" // API
+
+#include <algorithm>
+
+#include "config/config.h"
+
+// listings waiting for the content thread, workers pause when there are more
+#define DIRECTORY_WALKER_MAX_LISTINGS 512
+// older listings are dropped, the directory may have changed since
+#define DIRECTORY_WALKER_LISTING_TTL std::chrono::minutes(5)
+
+DirectoryWalker::DirectoryWalker(const std::shared_ptr<Config>& config, int count)
+{
+    for (auto&& dir : config->getArrayOption(CFG_IMPORT_SYSTEM_DIRECTORIES)) {
+        systemDirectories.insert(dir);
+    }
+
+    for (int i = 0; i < count; i++) {
+        auto worker = std::make_unique<Worker>();
+        worker->walker = this;
+        worker->index = workers.size();
+        worker->thread = std::make_unique<StdThreadRunner>(fmt::format("DirectoryWalker{}", i), DirectoryWalker::staticThreadProc, worker.get(), config);
+        if (!worker->thread->isAlive()) {
+            log_error("Could not start DirectoryWalker{}", i);
+            continue;
+        }
+        workers.push_back(std::move(worker));
+    }
+    log_debug("{} directory walkers started", workers.size());
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    shutdown();
+}
+
+unsigned int DirectoryWalker::prefetch(const fs::path& path, bool hidden, bool followSymlinks, bool recursive, unsigned int walkID)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty() || shutdownFlag)
+        return 0;
+
+    auto walk = walks.find(walkID);
+    if (walk == walks.end()) {
+        walkID = ++lastWalkID;
+        walks[walkID] = { 0, 1 };
+    } else {
+        walk->second.found++;
+    }
+    workers[nextWorker++ % workers.size()]->walks.push_back({ path, walkID, hidden, followSymlinks, recursive });
+    queued++;
+    workCond.notify_one();
+    return walkID;
+}
+
+std::vector<fs::directory_entry> DirectoryWalker::list(const fs::path& path, std::error_code& ec)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = listings.find(path);
+        if (it != listings.end()) {
+            // a worker is reading it right now
+            doneCond.wait(lock, [&] { return (it = listings.find(path)) == listings.end() || it->second.done; });
+        }
+        if (it != listings.end()) {
+            auto listing = std::move(it->second);
+            listings.erase(it);
+            ready--;
+            workCond.notify_one();
+            if (auto walk = walks.find(listing.walkID); walk != walks.end())
+                walk->second.taken++;
+            if (std::chrono::steady_clock::now() - listing.time < DIRECTORY_WALKER_LISTING_TTL) {
+                ec = listing.ec;
+                return std::move(listing.entries);
+            }
+        }
+        // keep workers from reading it as well
+        listings[path] = { 0, false };
+    }
+
+    std::vector<fs::directory_entry> entries;
+    readDirectory(path, entries, ec, false);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    listings.erase(path);
+    expandWaiting(path, entries, ec);
+    doneCond.notify_all();
+    return entries;
+}
+
+std::pair<std::size_t, std::size_t> DirectoryWalker::getProgress(unsigned int walkID)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto walk = walks.find(walkID);
+    if (walk == walks.end())
+        return { 0, 0 };
+    return { walk->second.taken, walk->second.found };
+}
+
+void DirectoryWalker::release(unsigned int walkID)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (walks.erase(walkID) == 0)
+        return;
+
+    // queued directories of the walk are skipped when they are taken
+    for (auto it = listings.begin(); it != listings.end();) {
+        if (it->second.walkID == walkID && it->second.done) {
+            it = listings.erase(it);
+            ready--;
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = waiting.begin(); it != waiting.end();) {
+        auto&& pending = it->second;
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [=](auto&& w) { return w.walkID == walkID; }), pending.end());
+        it = pending.empty() ? waiting.erase(it) : std::next(it);
+    }
+    workCond.notify_all();
+}
+
+void DirectoryWalker::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (shutdownFlag)
+            return;
+        shutdownFlag = true;
+        waiting.clear();
+    }
+    workCond.notify_all();
+    doneCond.notify_all();
+    for (auto&& worker : workers) {
+        worker->thread->join();
+    }
+    workers.clear();
+}
+
+void* DirectoryWalker::staticThreadProc(void* arg)
+{
+    auto worker = static_cast<Worker*>(arg);
+    worker->walker->threadProc(worker->index);
+    return nullptr;
+}
+
+bool DirectoryWalker::takeWalk(std::size_t self, Walk& walk)
+{
+    // own work depth first
+    auto&& own = workers[self]->walks;
+    if (!own.empty()) {
+        walk = std::move(own.back());
+        own.pop_back();
+        return true;
+    }
+    // steal the oldest, i.e. biggest, subtree of another worker
+    for (std::size_t i = 1; i < workers.size(); i++) {
+        auto&& other = workers[(self + i) % workers.size()]->walks;
+        if (!other.empty()) {
+            walk = std::move(other.front());
+            other.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirectoryWalker::evictExpired()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = listings.begin(); it != listings.end();) {
+        if (it->second.done && now - it->second.time >= DIRECTORY_WALKER_LISTING_TTL) {
+            it = listings.erase(it);
+            ready--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DirectoryWalker::threadProc(std::size_t self)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!shutdownFlag) {
+        evictExpired();
+        if (queued == 0 || ready >= DIRECTORY_WALKER_MAX_LISTINGS) {
+            workCond.wait_for(lock, std::chrono::seconds(1));
+            continue;
+        }
+
+        Walk walk;
+        if (!takeWalk(self, walk))
+            continue;
+        queued--;
+        // released by the content thread
+        if (walks.find(walk.walkID) == walks.end())
+            continue;
+        // already listed or being listed, e.g. the root of an import by the content thread,
+        // the subdirectories are walked all the same
+        if (auto listing = listings.find(walk.path); listing != listings.end()) {
+            if (!walk.recursive)
+                continue;
+            if (listing->second.done) {
+                if (!listing->second.ec)
+                    queueChildren(self, walk, listing->second.entries);
+            } else {
+                waiting[walk.path].push_back(std::move(walk));
+            }
+            continue;
+        }
+        listings[walk.path] = { walk.walkID, false };
+        lock.unlock();
+
+        std::vector<fs::directory_entry> entries;
+        std::error_code ec;
+        readDirectory(walk.path, entries, ec, true);
+
+        lock.lock();
+        if (walk.recursive && !ec)
+            queueChildren(self, walk, entries);
+        expandWaiting(walk.path, entries, ec);
+        auto listing = listings.find(walk.path);
+        if (listing != listings.end() && !listing->second.done) {
+            listing->second = { walk.walkID, true, std::chrono::steady_clock::now(), std::move(entries), ec };
+            ready++;
+            doneCond.notify_all();
+        }
+    }
+}
+
+void DirectoryWalker::queueChildren(std::size_t worker, const Walk& walk, const std::vector<fs::directory_entry>& entries)
+{
+    auto progress = walks.find(walk.walkID);
+    if (progress == walks.end() || shutdownFlag)
+        return;
+
+    std::vector<Walk> children;
+    for (auto&& entry : entries) {
+        std::error_code dirEc;
+        auto&& name = entry.path().filename().string();
+        if ((name[0] == '.' && !walk.hidden) || (!walk.followSymlinks && entry.is_symlink(dirEc)))
+            continue;
+        if (entry.is_directory(dirEc))
+            children.push_back({ entry.path(), walk.walkID, walk.hidden, walk.followSymlinks, true });
+    }
+    if (children.empty())
+        return;
+
+    progress->second.found += children.size();
+    // reversed, so the first subdirectory is taken first
+    auto&& own = workers[worker]->walks;
+    own.insert(own.end(), std::make_move_iterator(children.rbegin()), std::make_move_iterator(children.rend()));
+    queued += children.size();
+    workCond.notify_all();
+}
+
+void DirectoryWalker::expandWaiting(const fs::path& path, const std::vector<fs::directory_entry>& entries, const std::error_code& ec)
+{
+    auto it = waiting.find(path);
+    if (it == waiting.end())
+        return;
+
+    auto pending = std::move(it->second);
+    waiting.erase(it);
+    if (ec || workers.empty())
+        return;
+    for (auto&& walk : pending)
+        queueChildren(nextWorker++ % workers.size(), walk, entries);
+}
+
+void DirectoryWalker::readDirectory(const fs::path& path, std::vector<fs::directory_entry>& entries, std::error_code& ec, bool prefetch) const
+{
+    for (auto it = fs::directory_iterator(path, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        auto&& entry = *it;
+        if (!systemDirectories.empty() && systemDirectories.find(entry.path().string()) != systemDirectories.end())
+            continue;
+        if (prefetch) {
+            // stat now, the content thread finds the attributes in the cache of the kernel
+            std::error_code statEc;
+            entry.last_write_time(statEc);
+        }
+        entries.push_back(entry);
+    }
+}
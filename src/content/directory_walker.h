@@ -0,0 +1,124 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    directory_walker.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file directory_walker.h
+
+#ifndef __DIRECTORY_WALKER_H__
+#define __DIRECTORY_WALKER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+namespace fs = std::filesystem;
+
+#include "util/thread_runner.h"
+
+// forward declaration
+class Config;
+
+/// \brief Lists the directories of an import ahead of the content thread
+///
+/// Each worker takes the directories it found itself from the back of its own deque,
+/// so it walks its part of the tree depth first, and steals from the front of the
+/// other deques when it runs dry. The content thread takes the listings in its own
+/// order and lists a directory itself if no worker got to it yet.
+class DirectoryWalker {
+public:
+    DirectoryWalker(const std::shared_ptr<Config>& config, int count);
+    ~DirectoryWalker();
+
+    DirectoryWalker(const DirectoryWalker&) = delete;
+    DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+
+    /// \brief queue path and, if recursive, the directories below it
+    /// \param walkID add to a walk that was not released yet, 0 to start a new one
+    /// \return id of the walk, 0 if there are no workers
+    unsigned int prefetch(const fs::path& path, bool hidden, bool followSymlinks, bool recursive, unsigned int walkID = 0);
+    /// \brief entries of path in directory order, without the system directories
+    std::vector<fs::directory_entry> list(const fs::path& path, std::error_code& ec);
+    /// \brief directories taken by the content thread and directories found by a walk
+    std::pair<std::size_t, std::size_t> getProgress(unsigned int walkID);
+    /// \brief drop queued directories and listings of a walk
+    void release(unsigned int walkID);
+    void shutdown();
+
+private:
+    struct Walk {
+        fs::path path;
+        unsigned int walkID;
+        bool hidden;
+        bool followSymlinks;
+        bool recursive;
+    };
+    struct Listing {
+        unsigned int walkID;
+        bool done;
+        std::chrono::steady_clock::time_point time;
+        std::vector<fs::directory_entry> entries;
+        std::error_code ec;
+    };
+    struct Progress {
+        std::size_t taken;
+        std::size_t found;
+    };
+    struct Worker {
+        DirectoryWalker* walker;
+        std::size_t index;
+        std::deque<Walk> walks;
+        std::unique_ptr<StdThreadRunner> thread;
+    };
+
+    static void* staticThreadProc(void* arg);
+    void threadProc(std::size_t self);
+    bool takeWalk(std::size_t self, Walk& walk);
+    /// \brief queue the subdirectories of a recursive walk, the mutex is held
+    void queueChildren(std::size_t worker, const Walk& walk, const std::vector<fs::directory_entry>& entries);
+    /// \brief expand the walks that found path being listed by someone else, the mutex is held
+    void expandWaiting(const fs::path& path, const std::vector<fs::directory_entry>& entries, const std::error_code& ec);
+    void evictExpired();
+    void readDirectory(const fs::path& path, std::vector<fs::directory_entry>& entries, std::error_code& ec, bool prefetch) const;
+
+    std::unordered_set<std::string> systemDirectories;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    std::map<fs::path, Listing> listings;
+    std::map<fs::path, std::vector<Walk>> waiting;
+    std::map<unsigned int, Progress> walks;
+    unsigned int lastWalkID {};
+    std::size_t nextWorker {};
+    std::size_t queued {};
+    std::size_t ready {};
+    bool shutdownFlag {};
+};
+
+#endif // __DIRECTORY_WALKER_H__
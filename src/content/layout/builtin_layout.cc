@@ -31,8 +31,6 @@
 
 #include "builtin_layout.h" // API
 
-#include <regex>
-
 #include "config/config_manager.h"
 #include "content/content_manager.h"
 #include "metadata/metadata_handler.h"
@@ -390,7 +388,7 @@ void BuiltinLayout::addATrailers(const std::shared_ptr<CdsObject>& obj)
 BuiltinLayout::BuiltinLayout(std::shared_ptr<ContentManager> content)
     : Layout(std::move(content))
 {
-    genreMap = config->getDictionaryOption(CFG_IMPORT_SCRIPTING_IMPORT_GENRE_MAP);
+    genreMap = std::make_unique<RegexMapping>(config->getDictionaryOption(CFG_IMPORT_SCRIPTING_IMPORT_GENRE_MAP), std::regex::ECMAScript | std::regex::icase);
 #ifdef ENABLE_PROFILING
     PROF_INIT_GLOBAL(layout_profiling, "builtin layout");
 #endif
@@ -398,12 +396,7 @@ BuiltinLayout::BuiltinLayout(std::shared_ptr<ContentManager> content)
 
 std::string BuiltinLayout::mapGenre(const std::string& genre)
 {
-    for (auto&& [from, to] : genreMap) {
-        if (std::regex_match(genre, std::regex(from, std::regex::ECMAScript | std::regex::icase))) {
-            return std::regex_replace(genre, std::regex(from, std::regex::ECMAScript | std::regex::icase), to);
-        }
-    }
-    return genre;
+    return genreMap->replaceFirstMatch(genre);
 }
 
 void BuiltinLayout::processCdsObject(std::shared_ptr<CdsObject> obj, fs::path rootpath)
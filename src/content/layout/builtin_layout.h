@@ -36,6 +36,7 @@
 #include <memory>
 
 #include "layout.h"
+#include "util/regex_mapping.h"
 
 #ifdef ENABLE_PROFILING
 #include "util/tools.h"
@@ -66,7 +67,7 @@ protected:
 #ifdef ATRAILERS
     void addATrailers(const std::shared_ptr<CdsObject>& obj);
 #endif
-    std::map<std::string, std::string> genreMap;
+    std::unique_ptr<RegexMapping> genreMap;
 #ifdef ENABLE_PROFILING
     bool profiling_initialized;
     profiling_t layout_profiling;
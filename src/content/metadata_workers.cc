@@ -0,0 +1,109 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    metadata_workers.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file metadata_workers.cc
+
+#include "metadata_workers.h" // API
+
+#include "cds_objects.h"
+
+// queued jobs per thread, the content thread waits if more are queued
+#define METADATA_WORKER_QUEUE 4
+
+MetadataWorkers::MetadataWorkers(const std::shared_ptr<Config>& config, int count)
+    : maxJobs(count * METADATA_WORKER_QUEUE)
+{
+    for (int i = 0; i < count; i++) {
+        auto thread = std::make_unique<StdThreadRunner>(fmt::format("MetadataWorker{}", i), MetadataWorkers::staticThreadProc, this, config);
+        if (!thread->isAlive()) {
+            log_error("Could not start MetadataWorker{}", i);
+            continue;
+        }
+        threads.push_back(std::move(thread));
+    }
+    log_debug("{} metadata workers started", threads.size());
+}
+
+MetadataWorkers::~MetadataWorkers()
+{
+    shutdown();
+}
+
+std::future<std::shared_ptr<CdsObject>> MetadataWorkers::submit(Job job)
+{
+    std::packaged_task<std::shared_ptr<CdsObject>()> task(std::move(job));
+    auto result = task.get_future();
+
+    std::unique_lock<decltype(mutex)> lock(mutex);
+    if (shutdownFlag || threads.empty()) {
+        // nobody would run it
+        lock.unlock();
+        task();
+        return result;
+    }
+    spaceCond.wait(lock, [this] { return jobs.size() < maxJobs || shutdownFlag; });
+    jobs.push_back(std::move(task));
+    jobCond.notify_one();
+    return result;
+}
+
+void MetadataWorkers::shutdown()
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if (shutdownFlag)
+            return;
+        shutdownFlag = true;
+        jobs.clear();
+    }
+    jobCond.notify_all();
+    spaceCond.notify_all();
+    for (auto&& thread : threads) {
+        thread->join();
+    }
+    threads.clear();
+}
+
+void* MetadataWorkers::staticThreadProc(void* arg)
+{
+    auto inst = static_cast<MetadataWorkers*>(arg);
+    inst->threadProc();
+    return nullptr;
+}
+
+void MetadataWorkers::threadProc()
+{
+    while (true) {
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        jobCond.wait(lock, [this] { return !jobs.empty() || shutdownFlag; });
+        if (shutdownFlag)
+            break;
+        auto task = std::move(jobs.front());
+        jobs.pop_front();
+        spaceCond.notify_one();
+        lock.unlock();
+
+        // exceptions of the job are stored for the collector
+        task();
+    }
+}
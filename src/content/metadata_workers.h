@@ -0,0 +1,76 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    metadata_workers.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file metadata_workers.h
+
+#ifndef __METADATA_WORKERS_H__
+#define __METADATA_WORKERS_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "util/thread_runner.h"
+
+// forward declaration
+class CdsObject;
+class Config;
+
+/// \brief Pool of threads running the mime detection and metadata extraction of an import
+///
+/// The content thread queues the new files of a directory in order and collects the
+/// results in the same order, so layout and database writes stay on the content thread.
+class MetadataWorkers {
+public:
+    MetadataWorkers(const std::shared_ptr<Config>& config, int count);
+    ~MetadataWorkers();
+
+    MetadataWorkers(const MetadataWorkers&) = delete;
+    MetadataWorkers& operator=(const MetadataWorkers&) = delete;
+
+    using Job = std::function<std::shared_ptr<CdsObject>()>;
+
+    /// \brief queue a job, waits while the queue is full
+    std::future<std::shared_ptr<CdsObject>> submit(Job job);
+    /// \brief stop the threads, jobs that did not start are dropped
+    void shutdown();
+
+private:
+    static void* staticThreadProc(void* arg);
+    void threadProc();
+
+    std::vector<std::unique_ptr<StdThreadRunner>> threads;
+
+    std::deque<std::packaged_task<std::shared_ptr<CdsObject>()>> jobs;
+    std::size_t maxJobs;
+    bool shutdownFlag {};
+    std::mutex mutex;
+    std::condition_variable jobCond;
+    std::condition_variable spaceCond;
+};
+
+#endif // __METADATA_WORKERS_H__
@@ -61,6 +61,9 @@ std::shared_ptr<Database> Database::createInstance(const std::shared_ptr<Config>
 
     database->init();
     database->doMetadataMigration();
+    database->checkChildCounts();
+    database->pruneMetadataCache();
+    database->pruneDirectoryStates();
 
     return database;
 }
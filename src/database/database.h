@@ -43,12 +43,27 @@ namespace fs = std::filesystem;
 // forward declaration
 class AutoscanDirectory;
 class AutoscanList;
+class CdsItem;
 class CdsObject;
 class Config;
 class ConfigValue;
 enum class ScanMode;
 class Timer;
 
+/// \brief Identity of a file in the metadata cache, cached metadata is used while it is unchanged
+struct FileIdentity {
+    long long device;
+    long long inode;
+    long long size;
+    long long mtime;
+};
+
+/// \brief State of a directory after its last complete scan, a rescan skips the files while it is unchanged
+struct DirectoryState {
+    long long mtime;
+    long long digest;
+};
+
 #define BROWSE_DIRECT_CHILDREN 0x00000001
 #define BROWSE_ITEMS 0x00000002
 #define BROWSE_CONTAINERS 0x00000004
@@ -156,6 +171,13 @@ public:
 
     virtual void addObject(std::shared_ptr<CdsObject> object, int* changedContainer) = 0;
 
+    /// \brief Adds a batch of objects, e.g. the files of a directory, in one transaction.
+    /// \param objects new objects without an id, the ids are set when the batch
+    /// is written. Objects that could not be prepared keep INVALID_OBJECT_ID.
+    /// \param changedContainer will be filled in with the id of a container that
+    /// was created for the objects.
+    virtual void addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, int* changedContainer) = 0;
+
     /// \brief Adds a virtual container chain specified by path.
     /// \param path container path separated by '/'. Slashes in container
     /// titles must be escaped.
@@ -217,6 +239,11 @@ public:
     virtual std::shared_ptr<CdsObject> loadObject(int objectID) = 0;
     virtual int getChildCount(int contId, bool containers = true, bool items = true, bool hideFsRoot = false) = 0;
 
+    /// \brief compares the persisted child counts of all containers with the
+    /// actual number of children and repairs deviating entries, runs once after
+    /// the database upgrade that introduced the counts
+    virtual void checkChildCounts() = 0;
+
     class ChangedContainers {
     public:
         // Signed because IDs start at -1.
@@ -248,6 +275,19 @@ public:
     /// \return changed container ids
     virtual std::unique_ptr<ChangedContainers> removeObjects(const std::unique_ptr<std::unordered_set<int>>& list, bool all = false) = 0;
 
+    /// \brief Moves a (pc directory) object to a new location, for a container the
+    /// locations of all objects below are changed as well.
+    /// \param objectID the object id of the file or directory that was moved
+    /// \param location new location of the file or directory
+    /// \param title new title of the object
+    /// \param movedItems filled with the ids of the moved items
+    /// \return changed container ids
+    virtual std::unique_ptr<ChangedContainers> moveObject(int objectID, const fs::path& location, const std::string& title, std::vector<int>& movedItems) = 0;
+
+    /// \brief Get the virtual items that reference one of the given objects
+    /// \return ids of the references - nullptr if there are none!
+    virtual std::unique_ptr<std::unordered_set<int>> getReferences(const std::vector<int>& objectIDs) = 0;
+
     /// \brief Loads an object given by the online service ID.
     virtual std::shared_ptr<CdsObject> loadObjectByServiceID(const std::string& serviceID) = 0;
 
@@ -263,6 +303,25 @@ public:
     virtual std::string getInternalSetting(const std::string& key) = 0;
     virtual void storeInternalSetting(const std::string& key, const std::string& value) = 0;
 
+    /* metadata cache methods */
+    /// \brief add flags, metadata, auxdata and resources extracted from a file with the same identity and mime type
+    /// \return false if nothing is cached for the file
+    virtual bool loadCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) = 0;
+    virtual void storeCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) = 0;
+    /// \brief find the item that was last imported from a file with the same identity
+    /// \return the item or nullptr if the file is not cached
+    virtual std::shared_ptr<CdsObject> findObjectByIdentity(const FileIdentity& identity) = 0;
+    /// \brief drop entries of files that are no longer in the database and were not used recently,
+    /// drop all entries if the metadata extraction settings changed since they were stored
+    virtual void pruneMetadataCache() = 0;
+
+    /* directory scan state methods */
+    /// \return false if the container was not scanned completely yet
+    virtual bool loadDirectoryState(int objectID, DirectoryState& state) = 0;
+    virtual void storeDirectoryState(int objectID, const DirectoryState& state) = 0;
+    /// \brief drop states of containers that are no longer in the database
+    virtual void pruneDirectoryStates() = 0;
+
     /* autoscan methods */
     virtual std::shared_ptr<AutoscanList> getAutoscanList(ScanMode scanode) = 0;
     virtual void updateAutoscanList(ScanMode scanmode, std::shared_ptr<AutoscanList> list) = 0;
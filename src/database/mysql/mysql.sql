@@ -26,6 +26,8 @@ CREATE TABLE `mt_cds_object` (
   `service_id` varchar(255) default NULL,
   `bookmark_pos` int(11) unsigned NOT NULL default '0',
   `last_modified` bigint(20) unsigned default NULL,
+  `child_count_container` int(11) unsigned NOT NULL default '0',
+  `child_count_item` int(11) unsigned NOT NULL default '0',
   PRIMARY KEY  (`id`),
   KEY `cds_object_ref_id` (`ref_id`),
   KEY `cds_object_parent_id` (`parent_id`,`object_type`,`dc_title`),
@@ -36,16 +38,16 @@ CREATE TABLE `mt_cds_object` (
   CONSTRAINT `mt_cds_object_ibfk_1` FOREIGN KEY (`ref_id`) REFERENCES `mt_cds_object` (`id`) ON DELETE CASCADE ON UPDATE CASCADE,
   CONSTRAINT `mt_cds_object_ibfk_2` FOREIGN KEY (`parent_id`) REFERENCES `mt_cds_object` (`id`) ON DELETE CASCADE ON UPDATE CASCADE
 ) ENGINE=MyISAM CHARSET=utf8;
-INSERT INTO `mt_cds_object` VALUES (-1,NULL,-1,0,NULL,NULL,NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL);
-INSERT INTO `mt_cds_object` VALUES (0,NULL,-1,1,'object.container','Root',NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL);
+INSERT INTO `mt_cds_object` VALUES (-1,NULL,-1,0,NULL,NULL,NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL,0,0);
+INSERT INTO `mt_cds_object` VALUES (0,NULL,-1,1,'object.container','Root',NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL,1,0);
 UPDATE `mt_cds_object` SET `id`='0' WHERE `id`='1';
-INSERT INTO `mt_cds_object` VALUES (1,NULL,0,1,'object.container','PC Directory',NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL);
+INSERT INTO `mt_cds_object` VALUES (1,NULL,0,1,'object.container','PC Directory',NULL,NULL,NULL,NULL,NULL,0,NULL,9,NULL,NULL,NULL,0,NULL,0,0);
 CREATE TABLE `mt_internal_setting` (
   `key` varchar(40) NOT NULL,
   `value` varchar(255) NOT NULL,
   PRIMARY KEY  (`key`)
 ) ENGINE=MyISAM CHARSET=utf8;
-INSERT INTO `mt_internal_setting` VALUES ('db_version','10');
+INSERT INTO `mt_internal_setting` VALUES ('db_version','13');
 CREATE TABLE `mt_autoscan` (
   `id` int(11) NOT NULL auto_increment,
   `obj_id` int(11) default NULL,
@@ -79,6 +81,28 @@ CREATE TABLE `grb_config_value` (
   `status` varchar(20) NOT NULL)
   ENGINE=MyISAM CHARSET=utf8;
 CREATE INDEX grb_config_value_item ON grb_config_value(item);
+CREATE TABLE `grb_metadata_cache` (
+  `device` bigint(20) NOT NULL,
+  `inode` bigint(20) NOT NULL,
+  `size` bigint(20) NOT NULL,
+  `mtime` bigint(20) NOT NULL,
+  `location_hash` int(11) unsigned NOT NULL,
+  `location` blob NOT NULL,
+  `mime_type` varchar(40) NOT NULL,
+  `flags` int(11) unsigned NOT NULL default '0',
+  `metadata` blob,
+  `auxdata` blob,
+  `resources` blob,
+  `last_used` bigint(20) NOT NULL,
+  PRIMARY KEY (`device`,`inode`)
+) ENGINE=MyISAM CHARSET=utf8;
+CREATE TABLE `grb_directory_state` (
+  `obj_id` int(11) NOT NULL,
+  `mtime` bigint(20) NOT NULL,
+  `digest` bigint(20) NOT NULL,
+  PRIMARY KEY (`obj_id`),
+  CONSTRAINT `grb_directory_state_idfk1` FOREIGN KEY (`obj_id`) REFERENCES `mt_cds_object` (`id`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=MyISAM CHARSET=utf8;
 /*!40101 SET SQL_MODE=@OLD_SQL_MODE */;
 /*!40014 SET FOREIGN_KEY_CHECKS=@OLD_FOREIGN_KEY_CHECKS */;
 /*!40014 SET UNIQUE_CHECKS=@OLD_UNIQUE_CHECKS */;
@@ -33,10 +33,13 @@
 #include "mysql_database.h"
 
 #include <cstdlib>
+#include <limits>
 
+#include <errmsg.h>
 #include <netinet/in.h>
 
 #include "config/config_manager.h"
+#include "database/search_handler.h"
 #include "util/thread_runner.h"
 #include "util/tools.h"
 
@@ -44,6 +47,9 @@
 //#define MYSQL_SELECT_DEBUG
 //#define MYSQL_EXEC_DEBUG
 
+#define MYSQL_STATEMENT_CACHE_SIZE 64
+#define MYSQL_STATEMENT_BUFFER_SIZE 256
+
 // updates 1->2
 #define MYSQL_UPDATE_1_2_1 "ALTER TABLE `mt_cds_object` CHANGE `location` `location` BLOB NULL DEFAULT NULL"
 #define MYSQL_UPDATE_1_2_2 "ALTER TABLE `mt_cds_object` CHANGE `metadata` `metadata` BLOB NULL DEFAULT NULL"
@@ -94,9 +100,56 @@
 // updates 9->10: last_modified
 #define MYSQL_UPDATE_9_10_1 "ALTER TABLE `mt_cds_object` ADD `last_modified` bigint(20) unsigned default NULL AFTER `bookmark_pos`"
 
+// updates 10->11: child counts
+#define MYSQL_UPDATE_10_11_1 "ALTER TABLE `mt_cds_object` ADD `child_count_container` int(11) unsigned NOT NULL default '0' AFTER `last_modified`"
+#define MYSQL_UPDATE_10_11_2 "ALTER TABLE `mt_cds_object` ADD `child_count_item` int(11) unsigned NOT NULL default '0' AFTER `child_count_container`"
+#define MYSQL_UPDATE_10_11_3 "UPDATE `mt_cds_object` o JOIN ( \
+  SELECT `parent_id`, SUM(`object_type` = 1) AS `containers`, SUM((`object_type` & 2) = 2) AS `items` \
+  FROM `mt_cds_object` GROUP BY `parent_id`) c ON c.`parent_id` = o.`id` \
+  SET o.`child_count_container` = c.`containers`, o.`child_count_item` = c.`items` \
+  WHERE o.`object_type` = 1"
+
+// updates 11->12: metadata cache
+#define MYSQL_UPDATE_11_12_1 "CREATE TABLE `grb_metadata_cache` ( \
+  `device` bigint(20) NOT NULL, \
+  `inode` bigint(20) NOT NULL, \
+  `size` bigint(20) NOT NULL, \
+  `mtime` bigint(20) NOT NULL, \
+  `location_hash` int(11) unsigned NOT NULL, \
+  `location` blob NOT NULL, \
+  `mime_type` varchar(40) NOT NULL, \
+  `flags` int(11) unsigned NOT NULL default '0', \
+  `metadata` blob, \
+  `auxdata` blob, \
+  `resources` blob, \
+  `last_used` bigint(20) NOT NULL, \
+  PRIMARY KEY (`device`,`inode`) \
+) ENGINE=MyISAM CHARSET=utf8"
+
+// updates 12->13: directory scan state
+#define MYSQL_UPDATE_12_13_1 "CREATE TABLE `grb_directory_state` ( \
+  `obj_id` int(11) NOT NULL, \
+  `mtime` bigint(20) NOT NULL, \
+  `digest` bigint(20) NOT NULL, \
+  PRIMARY KEY (`obj_id`), \
+  CONSTRAINT `grb_directory_state_idfk1` FOREIGN KEY (`obj_id`) REFERENCES `mt_cds_object` (`id`) ON DELETE CASCADE ON UPDATE CASCADE \
+) ENGINE=MyISAM CHARSET=utf8"
+
 #define MYSQL_UPDATE_VERSION "UPDATE `mt_internal_setting` SET `value`='{}' WHERE `key`='db_version' AND `value`='{}'"
 
-static const auto dbUpdates = std::array<std::vector<const char*>, 9> { {
+// full-text search index
+#define MYSQL_FULLTEXT_EXISTS "SHOW INDEX FROM `mt_metadata` WHERE `Key_name`='grb_metadata_fulltext'"
+#define MYSQL_FULLTEXT_TOKEN_SIZE "SELECT @@ngram_token_size"
+static const auto fullTextCreate = std::vector<const char*> {
+    "ALTER TABLE `mt_cds_object` ADD FULLTEXT INDEX `grb_cds_object_fulltext` (`dc_title`) WITH PARSER ngram",
+    "ALTER TABLE `mt_metadata` ADD FULLTEXT INDEX `grb_metadata_fulltext` (`property_value`) WITH PARSER ngram",
+};
+static const auto fullTextDrop = std::vector<const char*> {
+    "ALTER TABLE `mt_cds_object` DROP INDEX `grb_cds_object_fulltext`",
+    "ALTER TABLE `mt_metadata` DROP INDEX `grb_metadata_fulltext`",
+};
+
+static const auto dbUpdates = std::array<std::vector<const char*>, 12> { {
     { MYSQL_UPDATE_1_2_1, MYSQL_UPDATE_1_2_2, MYSQL_UPDATE_1_2_3, MYSQL_UPDATE_1_2_4, MYSQL_UPDATE_1_2_5 },
     { MYSQL_UPDATE_2_3_1, MYSQL_UPDATE_2_3_2, MYSQL_UPDATE_2_3_3 },
     { MYSQL_UPDATE_3_4_1, MYSQL_UPDATE_3_4_2 },
@@ -106,6 +159,9 @@ static const auto dbUpdates = std::array<std::vector<const char*>, 9> { {
     { MYSQL_UPDATE_7_8_1, MYSQL_UPDATE_7_8_2, MYSQL_UPDATE_7_8_3 },
     { MYSQL_UPDATE_8_9_1 },
     { MYSQL_UPDATE_9_10_1 },
+    { MYSQL_UPDATE_10_11_1, MYSQL_UPDATE_10_11_2, MYSQL_UPDATE_10_11_3 },
+    { MYSQL_UPDATE_11_12_1 },
+    { MYSQL_UPDATE_12_13_1 },
 } };
 
 MySQLDatabase::MySQLDatabase(std::shared_ptr<Config> config)
@@ -122,6 +178,7 @@ MySQLDatabase::~MySQLDatabase()
     SqlAutoLock lock(sqlMutex); // just to ensure, that we don't close while another thread
     // is executing a query
 
+    clearStatementCache();
     if (mysql_connection) {
         mysql_close(&db);
         mysql_connection = false;
@@ -247,6 +304,8 @@ void MySQLDatabase::init()
                 _exec(upgradeCmd);
             }
             _exec(fmt::format(MYSQL_UPDATE_VERSION, version + 1, version).c_str());
+            if (version + 1 == CHILD_COUNT_DB_VERSION)
+                childCountsUpgraded = true;
             dbVersion = fmt::to_string(version + 1);
             log_info("Database upgrade to version {} successful.", dbVersion.c_str());
         }
@@ -256,11 +315,56 @@ void MySQLDatabase::init()
     if (dbVersion != fmt::to_string(version))
         throw_std_runtime_error("The database seems to be from a newer version (database version {})", dbVersion);
 
+    initFullTextSearch();
+
     lock.unlock();
 
     log_debug("end");
 }
 
+void MySQLDatabase::initFullTextSearch()
+{
+    auto res = SQLDatabase::select(MYSQL_FULLTEXT_EXISTS);
+    bool exists = (res != nullptr && res->nextRow() != nullptr);
+    res = nullptr;
+
+    if (!config->getBoolOption(CFG_SERVER_STORAGE_FULLTEXT_SEARCH)) {
+        if (exists) {
+            log_info("Removing full-text search index");
+            for (auto&& cmd : fullTextDrop)
+                _exec(cmd);
+        }
+        return;
+    }
+
+    std::size_t tokenSize;
+    try {
+        if (!exists) {
+            log_info("Creating full-text search index...");
+            for (auto&& cmd : fullTextCreate)
+                _exec(cmd);
+            log_info("Full-text search index created");
+        }
+        res = SQLDatabase::select(MYSQL_FULLTEXT_TOKEN_SIZE);
+        std::unique_ptr<SQLRow> row;
+        if (res == nullptr || (row = res->nextRow()) == nullptr)
+            throw_std_runtime_error("ngram_token_size not available");
+        tokenSize = stoiString(row->col(0));
+    } catch (const std::runtime_error& e) {
+        log_warning("Full-text search is not available, mysql needs the ngram full-text parser: {}", e.what());
+        return;
+    }
+
+    // a phrase search matches all ngrams of the value in sequence
+    auto fullText = std::make_shared<FullTextIndex>();
+    fullText->titleContains = "MATCH({1}) AGAINST('\"{2}\"' IN BOOLEAN MODE)";
+    fullText->titleStartsWith = fullText->titleContains;
+    fullText->metaContains = "MATCH({1}) AGAINST('\"{2}\"' IN BOOLEAN MODE)";
+    fullText->metaStartsWith = fullText->metaContains;
+    fullText->minLength = (tokenSize > 0) ? tokenSize : 1;
+    setFullTextIndex(fullText);
+}
+
 std::shared_ptr<Database> MySQLDatabase::getSelf()
 {
     return shared_from_this();
@@ -289,9 +393,16 @@ std::string MySQLDatabase::getError(MYSQL* db)
     return res;
 }
 
+std::string MySQLDatabase::getError(MYSQL_STMT* stmt)
+{
+    auto res = fmt::format("mysql_stmt_error ({}): \"{}\"", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+    log_debug("{}", res);
+    return res;
+}
+
 void MySQLDatabase::beginTransaction(const std::string_view& tName)
 {
-    log_debug("START TRANSACTION {} {}", tName, inTransaction);
+    log_debug("START TRANSACTION {} {}", tName, inTransaction.load());
     StdThreadRunner::waitFor(
         "MySqlDatabase", [this] { return !inTransaction; }, 100);
     inTransaction = true;
@@ -309,6 +420,7 @@ void MySQLDatabase::rollback(const std::string_view& tName)
         throw DatabaseException(myError, fmt::format("Mysql: error while rolling back db: {}", myError));
     }
     inTransaction = false;
+    finishPageTransaction();
 }
 
 void MySQLDatabase::commit(const std::string_view& tName)
@@ -320,6 +432,7 @@ void MySQLDatabase::commit(const std::string_view& tName)
         throw DatabaseException(myError, fmt::format("Mysql: error while commiting db: {}", myError));
     }
     inTransaction = false;
+    finishPageTransaction();
 }
 
 std::shared_ptr<SQLResult> MySQLDatabase::select(const char* query, int length)
@@ -371,12 +484,181 @@ int MySQLDatabase::exec(const char* query, int length, bool getLastInsertId)
         rollback("");
         throw DatabaseException(myError, fmt::format("Mysql: mysql_real_query() failed: {}; query: {}", myError, query));
     }
+    writeGeneration++;
     int insert_id = -1;
     if (getLastInsertId)
         insert_id = mysql_insert_id(&db);
     return insert_id;
 }
 
+int MySQLDatabase::getFirstInsertId(int insertId, int rowCount) const
+{
+    // the following rows get the next ids, the last one has to fit into the id column
+    if (insertId <= 0 || rowCount <= 0 || insertId > std::numeric_limits<int>::max() - (rowCount - 1))
+        throw_std_runtime_error("Mysql: invalid insert id {} for {} rows", insertId, rowCount);
+    return insertId;
+}
+
+std::shared_ptr<SQLResult> MySQLDatabase::selectPrepared(const std::string& query, const std::vector<SQLParam>& params)
+{
+#ifdef MYSQL_SELECT_DEBUG
+    log_debug("{}", query);
+    print_backtrace();
+#endif
+
+    checkMysqlThreadInit();
+    SqlAutoLock lock(sqlMutex);
+    bool myTransaction = false;
+    if (!inTransaction) { // protect calls outside transactions
+        inTransaction = true;
+        myTransaction = true;
+    }
+    auto stmt = executeStatement(query, params);
+
+    MYSQL_RES* meta = mysql_stmt_result_metadata(stmt);
+    if (!meta) {
+        std::string myError = getError(stmt);
+        rollback("");
+        throw DatabaseException(myError, fmt::format("Mysql: mysql_stmt_result_metadata() failed: {}; query: {}", myError, query));
+    }
+    auto ncolumn = mysql_num_fields(meta);
+    mysql_free_result(meta);
+
+    // columns are fetched as strings like mysql_real_query does, longer values are fetched separately
+    std::vector<MYSQL_BIND> bind(ncolumn);
+    std::vector<std::array<char, MYSQL_STATEMENT_BUFFER_SIZE>> buffers(ncolumn);
+    std::vector<unsigned long> lengths(ncolumn);
+    auto nulls = std::make_unique<decltype(MYSQL_BIND::is_null_value)[]>(ncolumn);
+    for (std::size_t i = 0; i < ncolumn; i++) {
+        bind[i].buffer_type = MYSQL_TYPE_STRING;
+        bind[i].buffer = buffers[i].data();
+        bind[i].buffer_length = buffers[i].size();
+        bind[i].length = &lengths[i];
+        bind[i].is_null = &nulls[i];
+    }
+
+    auto result = std::make_shared<MysqlStatementResult>();
+    int ret = mysql_stmt_bind_result(stmt, bind.data());
+    while (ret == 0 && ((ret = mysql_stmt_fetch(stmt)) == 0 || ret == MYSQL_DATA_TRUNCATED)) {
+        auto& row = result->rows.emplace_back(ncolumn);
+        ret = 0;
+        for (unsigned int i = 0; i < ncolumn && ret == 0; i++) {
+            if (nulls[i])
+                continue;
+            if (lengths[i] <= buffers[i].size()) {
+                row[i] = std::string(buffers[i].data(), lengths[i]);
+                continue;
+            }
+            std::string value(lengths[i], '\0');
+            MYSQL_BIND column {};
+            column.buffer_type = MYSQL_TYPE_STRING;
+            column.buffer = value.data();
+            column.buffer_length = value.size();
+            ret = mysql_stmt_fetch_column(stmt, &column, i, 0);
+            row[i] = std::move(value);
+        }
+    }
+    if (ret != MYSQL_NO_DATA) {
+        std::string myError = getError(stmt);
+        mysql_stmt_free_result(stmt);
+        rollback("");
+        throw DatabaseException(myError, fmt::format("Mysql: mysql_stmt_fetch() failed: {}; query: {}", myError, query));
+    }
+    mysql_stmt_free_result(stmt);
+
+    if (myTransaction) {
+        inTransaction = false;
+    }
+
+    return std::static_pointer_cast<SQLResult>(result);
+}
+
+int MySQLDatabase::execPrepared(const std::string& query, const std::vector<SQLParam>& params, bool getLastInsertId)
+{
+#ifdef MYSQL_EXEC_DEBUG
+    log_debug("{}", query);
+    print_backtrace();
+#endif
+
+    checkMysqlThreadInit();
+    SqlAutoLock lock(sqlMutex);
+    auto stmt = executeStatement(query, params);
+    writeGeneration++;
+    int insert_id = -1;
+    if (getLastInsertId)
+        insert_id = mysql_stmt_insert_id(stmt);
+    return insert_id;
+}
+
+MYSQL_STMT* MySQLDatabase::getStatement(const std::string& query)
+{
+    auto entry = statementCache.find(query);
+    if (entry != statementCache.end())
+        return entry->second;
+
+    // the callers use a fixed set of query shapes, so this only protects against misuse
+    if (statementCache.size() >= MYSQL_STATEMENT_CACHE_SIZE)
+        clearStatementCache();
+
+    MYSQL_STMT* stmt = mysql_stmt_init(&db);
+    if (!stmt) {
+        std::string myError = getError(&db);
+        throw DatabaseException(myError, fmt::format("Mysql: mysql_stmt_init() failed: {}", myError));
+    }
+    if (mysql_stmt_prepare(stmt, query.c_str(), query.size())) {
+        std::string myError = getError(stmt);
+        mysql_stmt_close(stmt);
+        throw DatabaseException(myError, fmt::format("Mysql: mysql_stmt_prepare() failed: {}; query: {}", myError, query));
+    }
+    statementCache[query] = stmt;
+    return stmt;
+}
+
+MYSQL_STMT* MySQLDatabase::executeStatement(const std::string& query, const std::vector<SQLParam>& params)
+{
+    std::vector<MYSQL_BIND> bind(params.size());
+    std::vector<unsigned long> lengths(params.size());
+    for (std::size_t i = 0; i < params.size(); i++) {
+        if (auto number = std::get_if<long long>(&params[i])) {
+            bind[i].buffer_type = MYSQL_TYPE_LONGLONG;
+            bind[i].buffer = const_cast<long long*>(number);
+        } else if (auto text = std::get_if<std::string>(&params[i])) {
+            lengths[i] = text->size();
+            bind[i].buffer_type = MYSQL_TYPE_STRING;
+            bind[i].buffer = const_cast<char*>(text->data());
+            bind[i].buffer_length = lengths[i];
+            bind[i].length = &lengths[i];
+        } else {
+            bind[i].buffer_type = MYSQL_TYPE_NULL;
+        }
+    }
+
+    for (bool retry = true;; retry = false) {
+        auto stmt = getStatement(query);
+        if (!mysql_stmt_bind_param(stmt, bind.data()) && !mysql_stmt_execute(stmt))
+            return stmt;
+
+        // the server forgets all statements when the client reconnects
+        auto errNo = mysql_stmt_errno(stmt);
+        if (retry && (errNo == CR_SERVER_GONE_ERROR || errNo == CR_SERVER_LOST)) {
+            log_debug("Connection lost, preparing statements again");
+            clearStatementCache();
+            continue;
+        }
+        std::string myError = getError(stmt);
+        rollback("");
+        throw DatabaseException(myError, fmt::format("Mysql: mysql_stmt_execute() failed: {}; query: {}", myError, query));
+    }
+}
+
+void MySQLDatabase::clearStatementCache()
+{
+    for (auto&& [query, stmt] : statementCache) {
+        mysql_stmt_close(stmt);
+    }
+    statementCache.clear();
+}
+
 void MySQLDatabase::shutdownDriver()
 {
 }
@@ -439,4 +721,21 @@ MysqlRow::MysqlRow(MYSQL_ROW mysql_row)
 {
 }
 
+/* MysqlStatementResult */
+
+std::unique_ptr<SQLRow> MysqlStatementResult::nextRow()
+{
+    if (cur_row < rows.size()) {
+        return std::make_unique<MysqlStatementRow>(&rows[cur_row++]);
+    }
+    return nullptr;
+}
+
+/* MysqlStatementRow */
+
+MysqlStatementRow::MysqlStatementRow(std::vector<std::optional<std::string>>* row)
+    : row(row)
+{
+}
+
 #endif // HAVE_MYSQL
@@ -38,7 +38,9 @@
 #include "database/sql_database.h"
 #include <mutex>
 #include <mysql.h>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class MySQLDatabase : public SQLDatabase, public std::enable_shared_from_this<SQLDatabase> {
@@ -66,6 +68,10 @@ private:
     std::string quote(long long val) const override { return fmt::to_string(val); }
     std::shared_ptr<SQLResult> select(const char* query, int length) override;
     int exec(const char* query, int length, bool getLastInsertId = false) override;
+    std::shared_ptr<SQLResult> selectPrepared(const std::string& query, const std::vector<SQLParam>& params) override;
+    int execPrepared(const std::string& query, const std::vector<SQLParam>& params, bool getLastInsertId = false) override;
+    /// \brief mysql_insert_id() reports the first row of a multi-row INSERT
+    int getFirstInsertId(int insertId, int rowCount) const override;
 
     void beginTransaction(const std::string_view& tName) override;
     void rollback(const std::string_view& tName) override;
@@ -74,12 +80,24 @@ private:
     void storeInternalSetting(const std::string& key, const std::string& value) override;
 
     void _exec(const char* query, int length = -1);
+    /// \brief create, check or drop the ngram full-text indices according to config
+    void initFullTextSearch();
 
     MYSQL db;
 
     bool mysql_connection;
 
     static std::string getError(MYSQL* db);
+    static std::string getError(MYSQL_STMT* stmt);
+
+    /// \brief get the cached server side statement for query or prepare it, sqlMutex must be held
+    MYSQL_STMT* getStatement(const std::string& query);
+    /// \brief bind params to the cached statement and execute it, sqlMutex must be held
+    MYSQL_STMT* executeStatement(const std::string& query, const std::vector<SQLParam>& params);
+    void clearStatementCache();
+
+    /// \brief prepared statements by query, protected by sqlMutex
+    std::unordered_map<std::string, MYSQL_STMT*> statementCache;
 
     void threadCleanup() override;
     bool threadCleanupRequired() const override { return true; }
@@ -101,7 +119,6 @@ public:
 private:
     int nullRead;
     std::unique_ptr<SQLRow> nextRow() override;
-    unsigned long long getNumRows() const override { return mysql_num_rows(mysql_res); }
     MYSQL_RES* mysql_res;
 
     friend class MysqlRow;
@@ -120,6 +137,30 @@ private:
     friend std::unique_ptr<SQLRow> MysqlResult::nextRow();
 };
 
+/// \brief Represents the result of a prepared mysql select, the rows are fetched before the statement is reused
+class MysqlStatementResult : public SQLResult {
+private:
+    std::unique_ptr<SQLRow> nextRow() override;
+
+    std::vector<std::vector<std::optional<std::string>>> rows;
+    std::size_t cur_row {};
+
+    friend class MySQLDatabase;
+};
+
+class MysqlStatementRow : public SQLRow {
+public:
+    explicit MysqlStatementRow(std::vector<std::optional<std::string>>* row);
+
+private:
+    char* col_c_str(int index) const override
+    {
+        auto&& column = row->at(index);
+        return column ? column->data() : nullptr;
+    }
+    std::vector<std::optional<std::string>>* row;
+};
+
 #endif // __mysql_database_H__
 
 #endif // HAVE_MYSQL
@@ -29,6 +29,7 @@
 
 #include "config/config_manager.h"
 #include "database/sql_database.h"
+#include "metadata/metadata_handler.h"
 #include "util/tools.h"
 
 static const std::unordered_map<std::string_view, TokenType> tokenTypes {
@@ -446,7 +447,7 @@ std::string DefaultSQLEmitter::emitSQL(const ASTNode* node) const
 {
     std::string predicates = node->emit();
     if (!predicates.empty()) {
-        return fmt::format("FROM {} INNER JOIN {} ON {} = {} WHERE {}",
+        return fmt::format("FROM {} INNER JOIN {} ON {} = {} WHERE ({})",
             colMapper->tableQuoted(), metaMapper->tableQuoted(),
             colMapper->mapQuoted(UPNP_SEARCH_ID), metaMapper->mapQuoted(UPNP_SEARCH_ID),
             predicates);
@@ -507,6 +508,26 @@ std::string DefaultSQLEmitter::emit(const ASTCompareOperator* node, const std::s
         fmt::format("{}{}", prpUpper, operatr), fmt::format("{}{}", prpLower, operatr), value);
 }
 
+std::string DefaultSQLEmitter::getFullTextStatement(const std::string& stringOperator, const std::string& property, const std::string& value) const
+{
+    if (fullText == nullptr || value.length() < fullText->minLength || value.find('"') != std::string::npos)
+        return "";
+
+    bool contains = (stringOperator == "contains");
+    if (!contains && stringOperator != "startswith")
+        return "";
+
+    if (property == MetadataHandler::getMetaFieldName(M_TITLE) && colMapper != nullptr && colMapper->hasEntry(property)) {
+        return fmt::format(contains ? fullText->titleContains : fullText->titleStartsWith,
+            colMapper->mapQuoted(UPNP_SEARCH_ID), colMapper->mapQuoted(property), value);
+    }
+    if (property[0] != '@' && (colMapper == nullptr || !colMapper->hasEntry(property)) && metaMapper != nullptr) {
+        return fmt::format(contains ? fullText->metaContains : fullText->metaStartsWith,
+            metaMapper->mapQuoted("id"), metaMapper->mapQuoted(META_VALUE), value);
+    }
+    return "";
+}
+
 std::string DefaultSQLEmitter::emit(const ASTStringOperator* node, const std::string& property, const std::string& value) const
 {
     auto stringOperator = aslowercase(node->getValue());
@@ -515,7 +536,12 @@ std::string DefaultSQLEmitter::emit(const ASTStringOperator* node, const std::st
     }
     auto&& [prpUpper, prpLower] = getPropertyStatement(property);
     auto&& [clsUpper, clsLower] = getPropertyStatement(UPNP_SEARCH_CLASS);
-    return fmt::format(logicOperator.at(stringOperator), clsUpper, prpUpper, prpLower, value);
+    auto statement = fmt::format(logicOperator.at(stringOperator), clsUpper, prpUpper, prpLower, value);
+
+    auto fullTextStatement = getFullTextStatement(stringOperator, property, value);
+    if (!fullTextStatement.empty())
+        return fmt::format("({} AND {})", fullTextStatement, statement);
+    return statement;
 }
 
 std::string DefaultSQLEmitter::emit(const ASTExistsOperator* node, const std::string& property, const std::string& value) const
@@ -547,10 +573,19 @@ std::string DefaultSQLEmitter::emit(const ASTOrOperator* node, const std::string
 
 std::string SortParser::parse()
 {
+    std::vector<std::string> sort;
+    for (auto&& [sortSql, desc] : parseList()) {
+        sort.emplace_back(fmt::format("{} {}", sortSql, (desc ? "DESC" : "ASC")));
+    }
+    return join(sort, ", ");
+}
+
+std::vector<std::pair<std::string, bool>> SortParser::parseList()
+{
+    std::vector<std::pair<std::string, bool>> sort;
     if (sortCrit.empty()) {
-        return "";
+        return sort;
     }
-    std::vector<std::string> sort;
     for (auto&& seg : splitString(sortCrit, ',')) {
         seg = trimString(seg);
         bool desc = (seg[0] == '-');
@@ -561,10 +596,10 @@ std::string SortParser::parse()
         }
         auto sortSql = colMapper != nullptr ? colMapper->mapQuoted(seg) : "";
         if (!sortSql.empty()) {
-            sort.emplace_back(fmt::format("{} {}", sortSql, (desc ? "DESC" : "ASC")));
+            sort.emplace_back(sortSql, desc);
         } else {
             log_warning("Unknown sort key '{}' in '{}'", seg, sortCrit);
         }
     }
-    return join(sort, ", ");
+    return sort;
 }
@@ -390,11 +390,25 @@ public:
     virtual std::string mapQuotedLower(const std::string& tag) const = 0;
 };
 
+/// \brief Full-text index lookups that narrow the rows for contains and startsWith.
+///
+/// The format strings get the id column as {0}, the value column as {1} and the search value as {2}.
+/// The result is only used as prefilter, the exact LIKE statement is always added by the emitter.
+struct FullTextIndex {
+    std::string titleContains;
+    std::string titleStartsWith;
+    std::string metaContains;
+    std::string metaStartsWith;
+    /// \brief shorter values can not be found in the index
+    std::size_t minLength;
+};
+
 class DefaultSQLEmitter : public SQLEmitter {
 public:
-    DefaultSQLEmitter(std::shared_ptr<ColumnMapper> colMapper, std::shared_ptr<ColumnMapper> metaMapper)
+    DefaultSQLEmitter(std::shared_ptr<ColumnMapper> colMapper, std::shared_ptr<ColumnMapper> metaMapper, std::shared_ptr<FullTextIndex> fullText = nullptr)
         : colMapper(colMapper)
         , metaMapper(metaMapper)
+        , fullText(std::move(fullText))
     {
     }
 
@@ -414,8 +428,10 @@ public:
 private:
     std::shared_ptr<ColumnMapper> colMapper;
     std::shared_ptr<ColumnMapper> metaMapper;
+    std::shared_ptr<FullTextIndex> fullText;
 
     std::pair<std::string, std::string> getPropertyStatement(const std::string& property) const;
+    std::string getFullTextStatement(const std::string& stringOperator, const std::string& property, const std::string& value) const;
 };
 
 class SearchParser {
@@ -506,6 +522,8 @@ public:
     {
     }
     std::string parse();
+    /// \brief quoted column and descending flag of each valid sort key
+    std::vector<std::pair<std::string, bool>> parseList();
 
 private:
     std::shared_ptr<ColumnMapper> colMapper;
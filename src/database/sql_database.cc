@@ -32,6 +32,7 @@
 #include "sql_database.h" // API
 
 #include <algorithm>
+#include <array>
 #include <climits>
 #include <filesystem>
 #include <fmt/chrono.h>
@@ -43,6 +44,7 @@
 #include "cds_objects.h"
 #include "config/config_manager.h"
 #include "config/config_setup.h"
+#include "config/directory_tweak.h"
 #include "content/autoscan.h"
 #include "metadata/metadata_handler.h"
 #include "search_handler.h"
@@ -51,6 +53,16 @@
 
 #define MAX_REMOVE_SIZE 1000
 #define MAX_REMOVE_RECURSION 500
+#define MAX_METADATA_BATCH_SIZE 1000
+#define MAX_BULK_INSERT_ROWS 200
+#define MAX_PAGE_CACHE_SIZE 100
+#define MAX_PAGE_CURSORS 200
+// keep metadata of removed files for this long, they may be added again
+#define METADATA_CACHE_EXPIRY std::chrono::hours(24 * 30)
+// last_used of cache entries is refreshed at most once in this interval
+#define METADATA_CACHE_TOUCH_INTERVAL std::chrono::hours(24)
+// internal setting holding the hash of the extraction settings the cache was filled with
+#define METADATA_CACHE_CONFIG_KEY "metadata_cache_config"
 
 #define SQL_NULL "NULL"
 
@@ -98,7 +110,9 @@ enum class BrowseCol {
     ref_resources,
     ref_mime_type,
     ref_service_id,
-    as_persistent
+    as_persistent,
+    child_count_container,
+    child_count_item
 };
 
 /// \brief search column ids
@@ -155,6 +169,8 @@ const static std::map<BrowseCol, std::pair<std::string, std::string>> browseColM
     { BrowseCol::ref_mime_type, { REF_ALIAS, "mime_type" } },
     { BrowseCol::ref_service_id, { REF_ALIAS, "service_id" } },
     { BrowseCol::as_persistent, { AUS_ALIAS, "persistent" } },
+    { BrowseCol::child_count_container, { ITM_ALIAS, "child_count_container" } },
+    { BrowseCol::child_count_item, { ITM_ALIAS, "child_count_item" } },
 };
 
 /// \brief Map search oolumn ids to column names
@@ -229,6 +245,14 @@ constexpr auto to_underlying(E e) noexcept
 
 #define getCol(rw, idx) (rw)->col(to_underlying((idx)))
 
+/// \brief index of the column in the select list built from colMap or -1
+template <class En>
+static int getSortColumn(const std::shared_ptr<EnumColumnMapper<En>>& mapper, const std::map<En, std::pair<std::string, std::string>>& colMap, const std::string& expr)
+{
+    auto it = std::find_if(colMap.begin(), colMap.end(), [&](auto&& entry) { return mapper->mapQuoted(entry.first) == expr; });
+    return it != colMap.end() ? to_underlying(it->first) : -1;
+}
+
 static std::shared_ptr<EnumColumnMapper<BrowseCol>> browseColumnMapper;
 static std::shared_ptr<EnumColumnMapper<SearchCol>> searchColumnMapper;
 static std::shared_ptr<EnumColumnMapper<MetadataCol>> metaColumnMapper;
@@ -290,6 +314,80 @@ void SQLDatabase::init()
     buf << " ";
     this->sql_meta_query = buf.str();
 
+    // Prepared statements for the hot paths
+    buf.str("");
+    buf << sql_browse_query << " WHERE " << TQBM(BrowseCol::id) << "=?";
+    this->sql_load_object_query = buf.str();
+
+    buf.str("");
+    buf << "SELECT " << TQ("child_count_container") << ',' << TQ("child_count_item")
+        << " FROM " << TQ(CDS_OBJECT_TABLE) << " WHERE " << TQ("id") << "=?";
+    this->sql_child_count_query = buf.str();
+
+    buf.str("");
+    buf << sql_meta_query << " FROM " << TQ(METADATA_TABLE) << " WHERE " << TQ("item_id") << "=?";
+    this->sql_object_meta_query = buf.str();
+
+    buf.str("");
+    buf << "INSERT INTO " << TQ(METADATA_TABLE)
+        << " (" << TQ("item_id") << ',' << TQ("property_name") << ',' << TQ("property_value") << ") VALUES (?,?,?)";
+    this->sql_meta_insert_query = buf.str();
+
+    buf.str("");
+    buf << "UPDATE " << TQ(METADATA_TABLE) << " SET " << TQ("property_value") << "=?"
+        << " WHERE " << TQ("item_id") << "=? AND " << TQ("property_name") << "=?";
+    this->sql_meta_update_query = buf.str();
+
+    buf.str("");
+    buf << "DELETE FROM " << TQ(METADATA_TABLE)
+        << " WHERE " << TQ("item_id") << "=? AND " << TQ("property_name") << "=?";
+    this->sql_meta_delete_query = buf.str();
+
+    buf.str("");
+    buf << "SELECT " << TQ("mime_type") << ',' << TQ("flags") << ',' << TQ("metadata") << ','
+        << TQ("auxdata") << ',' << TQ("resources") << ',' << TQ("location") << ',' << TQ("last_used")
+        << " FROM " << TQ(METADATA_CACHE_TABLE)
+        << " WHERE " << TQ("device") << "=? AND " << TQ("inode") << "=? AND " << TQ("size") << "=? AND " << TQ("mtime") << "=?";
+    this->sql_cache_load_query = buf.str();
+
+    // REPLACE is understood by sqlite3 and mysql
+    buf.str("");
+    buf << "REPLACE INTO " << TQ(METADATA_CACHE_TABLE) << " ("
+        << TQ("device") << ',' << TQ("inode") << ',' << TQ("size") << ',' << TQ("mtime") << ','
+        << TQ("location_hash") << ',' << TQ("location") << ',' << TQ("mime_type") << ',' << TQ("flags") << ','
+        << TQ("metadata") << ',' << TQ("auxdata") << ',' << TQ("resources") << ',' << TQ("last_used")
+        << ") VALUES (?,?,?,?,?,?,?,?,?,?,?,?)";
+    this->sql_cache_store_query = buf.str();
+
+    buf.str("");
+    buf << "UPDATE " << TQ(METADATA_CACHE_TABLE) << " SET " << TQ("location_hash") << "=?," << TQ("location") << "=?," << TQ("last_used") << "=?"
+        << " WHERE " << TQ("device") << "=? AND " << TQ("inode") << "=?";
+    this->sql_cache_touch_query = buf.str();
+
+    buf.str("");
+    buf << "SELECT " << TQ("mtime") << ',' << TQ("digest")
+        << " FROM " << TQ(DIRECTORY_STATE_TABLE) << " WHERE " << TQ("obj_id") << "=?";
+    this->sql_dir_state_load_query = buf.str();
+
+    buf.str("");
+    buf << "REPLACE INTO " << TQ(DIRECTORY_STATE_TABLE)
+        << " (" << TQ("obj_id") << ',' << TQ("mtime") << ',' << TQ("digest") << ") VALUES (?,?,?)";
+    this->sql_dir_state_store_query = buf.str();
+
+    buf.str("");
+    buf << "SELECT " << TQD('o', "id")
+        << " FROM " << TQ(METADATA_CACHE_TABLE) << ' ' << TQ('c')
+        << " JOIN " << TQ(CDS_OBJECT_TABLE) << ' ' << TQ('o') << " ON " << TQD('o', "location_hash") << '=' << TQD('c', "location_hash")
+        << " AND " << TQD('o', "location") << '=' << TQD('c', "location")
+        << " WHERE " << TQD('c', "device") << "=? AND " << TQD('c', "inode") << "=? AND " << TQD('c', "size") << "=? AND " << TQD('c', "mtime") << "=?"
+        << " AND " << TQD('o', "ref_id") << " IS NULL";
+    this->sql_cache_identity_query = buf.str();
+
+    buf.str("");
+    buf << "UPDATE " << TQ(CDS_OBJECT_TABLE) << " SET " << TQ("location") << "=?," << TQ("location_hash") << "=?"
+        << " WHERE " << TQ("id") << "=?";
+    this->sql_location_update_query = buf.str();
+
     sqlEmitter = std::make_shared<DefaultSQLEmitter>(searchColumnMapper, metaColumnMapper);
 }
 
@@ -534,17 +632,171 @@ void SQLDatabase::addObject(std::shared_ptr<CdsObject> obj, int* changedContaine
 
     beginTransaction("addObject");
     for (auto&& addUpdateTable : tables) {
+        if (addUpdateTable->getTableName() == METADATA_TABLE) {
+            execMetadataOperation(obj, addUpdateTable);
+            continue;
+        }
+
         auto qb = sqlForInsert(obj, addUpdateTable);
         log_debug("Generated insert: {}", qb->str().c_str());
 
         if (addUpdateTable->getTableName() == CDS_OBJECT_TABLE) {
             int newId = exec(qb->str(), true);
             obj->setID(newId);
+            _updateChildCount(obj->getParentID(), obj->getObjectType(), 1);
         } else {
             exec(qb->str(), false);
         }
     }
+    // again after the metadata, it can be part of the sort keys
+    invalidateContainerPages(obj->getParentID());
     commit("addObject");
+    updatePathIndex(obj);
+}
+
+void SQLDatabase::addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, int* changedContainer)
+{
+    *changedContainer = INVALID_OBJECT_ID;
+
+    // all rows of a multi-row INSERT need the same columns, so object rows are grouped by their column list
+    std::map<std::string, std::vector<std::pair<std::shared_ptr<CdsObject>, std::map<std::string, std::string>>>> objectRows;
+    std::map<std::shared_ptr<CdsObject>, std::vector<std::map<std::string, std::string>>> metadataRows;
+
+    for (auto&& obj : objects) {
+        if (obj->getID() != INVALID_OBJECT_ID)
+            throw_std_runtime_error("Tried to add an object with an object ID set");
+
+        std::vector<std::shared_ptr<AddUpdateTable>> tables;
+        try {
+            int objectChanged = INVALID_OBJECT_ID;
+            tables = _addUpdateObject(obj, Operation::Insert, &objectChanged);
+            if (*changedContainer == INVALID_OBJECT_ID)
+                *changedContainer = objectChanged;
+        } catch (const std::runtime_error& e) {
+            log_warning("Skipping {}: {}", obj->getLocation().c_str(), e.what());
+            continue;
+        }
+
+        for (auto&& addUpdateTable : tables) {
+            if (addUpdateTable->getTableName() == METADATA_TABLE) {
+                metadataRows[obj].push_back(addUpdateTable->getDict());
+                continue;
+            }
+            auto dict = addUpdateTable->getDict();
+            std::ostringstream fields;
+            for (auto it = dict.begin(); it != dict.end(); it++) {
+                if (it != dict.begin())
+                    fields << ',';
+                fields << TQ(it->first);
+            }
+            objectRows[fields.str()].emplace_back(obj, std::move(dict));
+        }
+    }
+
+    if (objectRows.empty())
+        return;
+
+    // without use-transactions a failure can not be rolled back, so each chunk is completed
+    // with its metadata and counts before the next one and only the objects of the failed
+    // chunk are left without ID for the caller to add again
+    std::vector<std::shared_ptr<CdsObject>> pending;
+    beginTransaction("addObjects");
+    try {
+        for (auto&& [fields, rows] : objectRows) {
+            for (std::size_t start = 0; start < rows.size(); start += MAX_BULK_INSERT_ROWS) {
+                auto end = std::min(rows.size(), start + MAX_BULK_INSERT_ROWS);
+                std::ostringstream qb;
+                qb << "INSERT INTO " << TQ(CDS_OBJECT_TABLE) << " (" << fields << ") VALUES ";
+                for (auto i = start; i < end; i++) {
+                    if (i > start)
+                        qb << ',';
+                    qb << '(';
+                    auto&& dict = rows[i].second;
+                    for (auto it = dict.begin(); it != dict.end(); it++) {
+                        if (it != dict.begin())
+                            qb << ',';
+                        qb << it->second;
+                    }
+                    qb << ')';
+                }
+
+                int rowCount = end - start;
+                int newId = getFirstInsertId(exec(qb.str(), true), rowCount);
+                std::map<std::pair<int, unsigned int>, int> childCounts;
+                for (auto i = start; i < end; i++) {
+                    auto&& obj = rows[i].first;
+                    obj->setID(newId++);
+                    pending.push_back(obj);
+                    childCounts[{ obj->getParentID(), obj->getObjectType() }]++;
+                }
+                _addMetadataRows(pending, metadataRows);
+                pending.clear();
+
+                for (auto&& [parent, count] : childCounts)
+                    _updateChildCount(parent.first, parent.second, count);
+            }
+        }
+    } catch (const std::runtime_error&) {
+        rollback("addObjects");
+        if (use_transaction) {
+            for (auto&& obj : objects)
+                obj->setID(INVALID_OBJECT_ID);
+        } else {
+            if (!pending.empty()) {
+                std::vector<int> ids;
+                for (auto&& obj : pending)
+                    ids.push_back(obj->getID());
+                // the metadata rows of the chunk are removed by the foreign key
+                std::ostringstream del;
+                del << "DELETE FROM " << TQ(CDS_OBJECT_TABLE) << " WHERE " << TQ("id") << " IN (" << toCSV(ids) << ')';
+                try {
+                    exec(del.str());
+                    for (auto&& obj : pending)
+                        obj->setID(INVALID_OBJECT_ID);
+                } catch (const std::runtime_error& e) {
+                    // the rows stay, adding them again would duplicate them
+                    log_error("Could not remove incomplete objects {}: {}", toCSV(ids), e.what());
+                }
+            }
+            for (auto&& obj : objects) {
+                if (obj->getID() != INVALID_OBJECT_ID)
+                    updatePathIndex(obj);
+            }
+        }
+        throw;
+    }
+    commit("addObjects");
+
+    for (auto&& obj : objects)
+        updatePathIndex(obj);
+}
+
+void SQLDatabase::_addMetadataRows(const std::vector<std::shared_ptr<CdsObject>>& objects, const std::map<std::shared_ptr<CdsObject>, std::vector<std::map<std::string, std::string>>>& metadataRows)
+{
+    std::vector<std::pair<int, const std::map<std::string, std::string>*>> rows;
+    for (auto&& obj : objects) {
+        auto entry = metadataRows.find(obj);
+        if (entry == metadataRows.end())
+            continue;
+        for (auto&& dict : entry->second)
+            rows.emplace_back(obj->getID(), &dict);
+    }
+
+    for (std::size_t start = 0; start < rows.size(); start += MAX_BULK_INSERT_ROWS) {
+        auto end = std::min(rows.size(), start + MAX_BULK_INSERT_ROWS);
+        std::ostringstream qb;
+        qb << "INSERT INTO " << TQ(METADATA_TABLE)
+           << " (" << TQ("item_id") << ',' << TQ("property_name") << ',' << TQ("property_value") << ") VALUES ";
+        for (auto i = start; i < end; i++) {
+            auto&& [id, dict] = rows[i];
+            if (i > start)
+                qb << ',';
+            qb << '(' << id
+               << ',' << quote(dict->at("property_name"))
+               << ',' << quote(dict->at("property_value")) << ')';
+        }
+        exec(qb.str());
+    }
 }
 
 void SQLDatabase::updateObject(std::shared_ptr<CdsObject> obj, int* changedContainer)
@@ -565,7 +817,25 @@ void SQLDatabase::updateObject(std::shared_ptr<CdsObject> obj, int* changedConta
     }
 
     beginTransaction("updateObject");
+    // read inside the transaction, a concurrent move must not shift the counts twice
+    int oldParentID = INVALID_OBJECT_ID;
+    if (!data.empty() && obj->getID() != CDS_ID_FS_ROOT) {
+        std::ostringstream q;
+        q << "SELECT " << TQ("parent_id")
+          << " FROM " << TQ(CDS_OBJECT_TABLE)
+          << " WHERE " << TQ("id") << '=' << obj->getID();
+        auto res = select(q);
+        std::unique_ptr<SQLRow> row;
+        if (res != nullptr && (row = res->nextRow()) != nullptr)
+            oldParentID = std::stoi(row->col(0));
+    }
+
     for (auto&& addUpdateTable : data) {
+        if (addUpdateTable->getTableName() == METADATA_TABLE) {
+            execMetadataOperation(obj, addUpdateTable);
+            continue;
+        }
+
         Operation op = addUpdateTable->getOperation();
         std::unique_ptr<std::ostringstream> qb;
 
@@ -584,25 +854,28 @@ void SQLDatabase::updateObject(std::shared_ptr<CdsObject> obj, int* changedConta
         log_debug("upd_query: {}", qb->str());
         exec(qb->str());
     }
+    // the sort keys of the object may have changed
+    if (!data.empty())
+        invalidateContainerPages(obj->getParentID());
+    if (oldParentID != INVALID_OBJECT_ID && oldParentID != obj->getParentID()) {
+        _updateChildCount(oldParentID, obj->getObjectType(), -1);
+        _updateChildCount(obj->getParentID(), obj->getObjectType(), 1);
+    }
     commit("updateObject");
+    if (!data.empty())
+        updatePathIndex(obj);
 }
 
 std::shared_ptr<CdsObject> SQLDatabase::loadObject(int objectID)
 {
-    std::ostringstream qb;
-
-    qb << sql_browse_query << " WHERE " << TQBM(BrowseCol::id) << '=' << objectID;
-
-    beginTransaction("loadObject");
-    auto res = select(qb);
+    auto res = selectPrepared(sql_load_object_query, { objectID });
     std::unique_ptr<SQLRow> row;
     if (res != nullptr && (row = res->nextRow()) != nullptr) {
         auto result = createObjectFromRow(row);
-        commit("loadObject");
+        attachMetadata({ result }, true);
         return result;
     }
-    log_debug("sql_query = {}", qb.str());
-    commit("loadObject");
+    log_debug("sql_query = {}; id = {}", sql_load_object_query, objectID);
     throw ObjectNotFoundException(fmt::format("Object not found: {}", objectID));
 }
 
@@ -610,15 +883,13 @@ std::shared_ptr<CdsObject> SQLDatabase::loadObjectByServiceID(const std::string&
 {
     std::ostringstream qb;
     qb << sql_browse_query << " WHERE " << TQBM(BrowseCol::service_id) << '=' << quote(serviceID);
-    beginTransaction("loadObjectByServiceID");
     auto res = select(qb);
     std::unique_ptr<SQLRow> row;
     if (res != nullptr && (row = res->nextRow()) != nullptr) {
         auto result = createObjectFromRow(row);
-        commit("loadObjectByServiceID");
+        attachMetadata({ result }, true);
         return result;
     }
-    commit("loadObjectByServiceID");
 
     return nullptr;
 }
@@ -631,19 +902,17 @@ std::unique_ptr<std::vector<int>> SQLDatabase::getServiceObjectIDs(char serviceP
        << " WHERE " << TQ("service_id")
        << " LIKE " << quote(std::string(1, servicePrefix) + '%');
 
-    beginTransaction("getServiceObjectIDs");
     auto res = select(qb);
-    commit("getServiceObjectIDs");
     if (res == nullptr)
         throw_std_runtime_error("db error");
 
-    std::vector<int> objectIDs;
+    auto objectIDs = std::make_unique<std::vector<int>>();
     std::unique_ptr<SQLRow> row;
     while ((row = res->nextRow()) != nullptr) {
-        objectIDs.push_back(std::stoi(row->col(0)));
+        objectIDs->push_back(row->col_int64(0));
     }
 
-    return std::make_unique<std::vector<int>>(objectIDs);
+    return objectIDs;
 }
 
 std::vector<std::shared_ptr<CdsObject>> SQLDatabase::browse(const std::unique_ptr<BrowseParam>& param)
@@ -659,15 +928,22 @@ std::vector<std::shared_ptr<CdsObject>> SQLDatabase::browse(const std::unique_pt
     std::shared_ptr<SQLResult> res;
     std::unique_ptr<SQLRow> row;
 
+    bool hideFsRoot = param->getFlag(BROWSE_HIDE_FS_ROOT);
+    int childCount = 0;
+
+    // read before the first query, the cursors of a container stay valid until its children are written
+    auto generation = getContainerGeneration(objectID);
+
     std::ostringstream qb;
     qb << "SELECT " << TQ("object_type")
+       << ',' << TQ("child_count_container")
+       << ',' << TQ("child_count_item")
        << " FROM " << TQ(CDS_OBJECT_TABLE)
        << " WHERE " << TQ("id") << '=' << objectID;
-    beginTransaction("browse");
     res = select(qb);
-    commit("browse");
     if (res != nullptr && (row = res->nextRow()) != nullptr) {
         objectType = std::stoi(row->col(0));
+        childCount = calcChildCount(objectID, std::stoi(row->col(1)), std::stoi(row->col(2)), getContainers, getItems, hideFsRoot);
     } else {
         throw ObjectNotFoundException(fmt::format("Object not found: {}", objectID));
     }
@@ -675,38 +951,59 @@ std::vector<std::shared_ptr<CdsObject>> SQLDatabase::browse(const std::unique_pt
     row = nullptr;
     res = nullptr;
 
-    bool hideFsRoot = param->getFlag(BROWSE_HIDE_FS_ROOT);
-
     if (param->getFlag(BROWSE_DIRECT_CHILDREN) && IS_CDS_CONTAINER(objectType)) {
-        param->setTotalMatches(getChildCount(objectID, getContainers, getItems, hideFsRoot));
+        param->setTotalMatches(childCount);
     } else {
         param->setTotalMatches(1);
     }
 
-    // order by code..
-    auto orderByCode = [&]() {
-        std::ostringstream orderQb;
-        if (param->getFlag(BROWSE_TRACK_SORT)) {
-            orderQb << TQBM(BrowseCol::part_number) << ',';
-            orderQb << TQBM(BrowseCol::track_number);
-        } else {
-            SortParser sortParser(browseColumnMapper, param->getSortCriteria());
-            orderQb << sortParser.parse();
-        }
-        if (orderQb.str().empty()) {
-            orderQb << TQBM(BrowseCol::dc_title);
-        }
-        return orderQb.str();
+    // sort keys with the column of their value, -1 for the container flag
+    std::vector<SortKey> sortKeys;
+    std::vector<int> sortColumns;
+    auto addSortKey = [&](const std::string& expr, bool desc) {
+        sortKeys.push_back({ expr, desc });
+        sortColumns.push_back(getSortColumn(browseColumnMapper, browseColMap, expr));
+    };
+    if (getContainers && getItems) {
+        sortKeys.push_back({ fmt::format("({}={})", TQBM(BrowseCol::object_type), quote(OBJECT_TYPE_CONTAINER)), true });
+        sortColumns.push_back(-1);
+    }
+    if (param->getFlag(BROWSE_TRACK_SORT)) {
+        addSortKey(TQBM(BrowseCol::part_number), false);
+        addSortKey(TQBM(BrowseCol::track_number), false);
+    } else {
+        SortParser sortParser(browseColumnMapper, param->getSortCriteria());
+        for (auto&& [expr, desc] : sortParser.parseList())
+            addSortKey(expr, desc);
+    }
+    if (sortKeys.empty() || (sortKeys.size() == 1 && sortColumns[0] < 0)) {
+        addSortKey(TQBM(BrowseCol::dc_title), false);
+    }
+    // the id makes the order unique, so each page can continue after the last row of the previous one
+    auto idCol = TQBM(BrowseCol::id);
+    if (std::none_of(sortKeys.begin(), sortKeys.end(), [&](auto&& key) { return key.expr == idCol; })) {
+        addSortKey(idCol, false);
+    }
+    bool useCursor = std::none_of(sortColumns.begin() + (sortColumns[0] < 0 ? 1 : 0), sortColumns.end(), [](int col) { return col < 0; });
+
+    auto orderBy = [&]() {
+        std::vector<std::string> order;
+        std::transform(sortKeys.begin(), sortKeys.end(), std::back_inserter(order), [](auto&& key) { return fmt::format("{} {}", key.expr, (key.desc ? "DESC" : "ASC")); });
+        return join(order, ", ");
     };
 
+    auto cacheKey = fmt::format("B{}:{}:{}", objectID, param->getFlags(), param->getSortCriteria());
+    int startingIndex = param->getStartingIndex();
+    int count = param->getRequestedCount();
+    bool storeCursor = false;
+
     qb.str("");
     qb << sql_browse_query << " WHERE ";
 
     if (param->getFlag(BROWSE_DIRECT_CHILDREN) && IS_CDS_CONTAINER(objectType)) {
-        int count = param->getRequestedCount();
         bool doLimit = true;
         if (!count) {
-            if (param->getStartingIndex())
+            if (startingIndex)
                 count = std::numeric_limits<int>::max();
             else
                 doLimit = false;
@@ -719,35 +1016,59 @@ std::vector<std::shared_ptr<CdsObject>> SQLDatabase::browse(const std::unique_pt
 
         if (!getContainers && !getItems) {
             qb << " AND 0=1";
-        } else if (getContainers && !getItems) {
-            qb << " AND " << TQBM(BrowseCol::object_type) << '='
-               << quote(OBJECT_TYPE_CONTAINER)
-               << " ORDER BY " << orderByCode();
-        } else if (!getContainers && getItems) {
-            qb << " AND (" << TQBM(BrowseCol::object_type) << " & "
-               << quote(OBJECT_TYPE_ITEM) << ") = "
-               << quote(OBJECT_TYPE_ITEM)
-               << " ORDER BY " << orderByCode();
         } else {
-            qb << " ORDER BY ("
-               << TQBM(BrowseCol::object_type) << '=' << quote(OBJECT_TYPE_CONTAINER)
-               << ") DESC, " << orderByCode();
+            if (getContainers && !getItems) {
+                qb << " AND " << TQBM(BrowseCol::object_type) << '='
+                   << quote(OBJECT_TYPE_CONTAINER);
+            } else if (!getContainers && getItems) {
+                qb << " AND (" << TQBM(BrowseCol::object_type) << " & "
+                   << quote(OBJECT_TYPE_ITEM) << ") = "
+                   << quote(OBJECT_TYPE_ITEM);
+            }
+
+            // continue after a known page instead of skipping all rows before it
+            std::vector<std::optional<std::string>> cursor;
+            int cursorIndex = (useCursor && startingIndex > 0) ? findPageCursor(cacheKey, generation, startingIndex, cursor) : 0;
+            if (cursorIndex > 0) {
+                qb << " AND " << keysetCondition(sortKeys, cursor);
+                startingIndex -= cursorIndex;
+            }
+            qb << " ORDER BY " << orderBy();
+            storeCursor = useCursor && doLimit && count < std::numeric_limits<int>::max();
         }
         if (doLimit)
-            qb << " LIMIT " << count << " OFFSET " << param->getStartingIndex();
+            qb << " LIMIT " << count << " OFFSET " << startingIndex;
     } else // metadata
     {
         qb << TQBM(BrowseCol::id) << '=' << objectID << " LIMIT 1";
     }
     log_debug("QUERY: {}", qb.str().c_str());
-    beginTransaction("browse 2");
     res = select(qb);
-    commit("browse 2");
 
     std::vector<std::shared_ptr<CdsObject>> arr;
+    std::vector<std::optional<std::string>> lastKeys;
 
     while ((row = res->nextRow()) != nullptr) {
         auto obj = createObjectFromRow(row);
+        // update childCount fields
+        if (obj->isContainer()) {
+            auto cont = std::static_pointer_cast<CdsContainer>(obj);
+            cont->setChildCount(calcChildCount(cont->getID(),
+                stoiString(getCol(row, BrowseCol::child_count_container)),
+                stoiString(getCol(row, BrowseCol::child_count_item)),
+                getContainers, getItems, hideFsRoot));
+        }
+        if (storeCursor) {
+            lastKeys.clear();
+            for (auto&& col : sortColumns) {
+                if (col < 0) {
+                    lastKeys.emplace_back(obj->isContainer() ? "1" : "0");
+                } else {
+                    auto value = row->col_c_str(col);
+                    lastKeys.push_back(value != nullptr ? std::optional<std::string>(quote(value)) : std::nullopt);
+                }
+            }
+        }
         arr.push_back(obj);
         row = nullptr;
     }
@@ -755,13 +1076,10 @@ std::vector<std::shared_ptr<CdsObject>> SQLDatabase::browse(const std::unique_pt
     row = nullptr;
     res = nullptr;
 
-    // update childCount fields
-    for (auto&& obj : arr) {
-        if (obj->isContainer()) {
-            auto cont = std::static_pointer_cast<CdsContainer>(obj);
-            cont->setChildCount(getChildCount(cont->getID(), getContainers, getItems, hideFsRoot));
-        }
-    }
+    if (storeCursor && !arr.empty())
+        storePageCursor(cacheKey, generation, param->getStartingIndex() + static_cast<int>(arr.size()), std::move(lastKeys));
+
+    attachMetadata(arr, true);
 
     return arr;
 }
@@ -774,85 +1092,278 @@ std::vector<std::shared_ptr<CdsObject>> SQLDatabase::search(const std::unique_pt
     if (searchSQL.empty())
         throw_std_runtime_error("failed to generate SQL for search");
 
-    std::ostringstream countSQL;
-    countSQL << "SELECT COUNT(*) " << searchSQL;
-    beginTransaction("search");
-    auto sqlResult = select(countSQL);
-    commit("search");
-    std::unique_ptr<SQLRow> countRow = sqlResult->nextRow();
-    if (countRow != nullptr) {
-        *numMatches = std::stoi(countRow->col(0));
+    // read before the first query, so writes during search invalidate the cache
+    auto generation = writeGeneration.load();
+    auto cacheKey = fmt::format("S{}\n{}", param->getSortCriteria(), param->searchCriteria());
+
+    int totalMatches = findTotalMatches(cacheKey, generation);
+    if (totalMatches < 0) {
+        std::ostringstream countSQL;
+        countSQL << "SELECT COUNT(*) " << searchSQL;
+        auto sqlResult = select(countSQL);
+        std::unique_ptr<SQLRow> countRow = sqlResult->nextRow();
+        if (countRow != nullptr) {
+            totalMatches = std::stoi(countRow->col(0));
+            storeTotalMatches(cacheKey, generation, totalMatches);
+        }
+    }
+    if (totalMatches >= 0) {
+        *numMatches = totalMatches;
+    }
+
+    std::vector<SortKey> sortKeys;
+    std::vector<int> sortColumns;
+    auto addSortKey = [&](const std::string& expr, bool desc) {
+        sortKeys.push_back({ expr, desc });
+        sortColumns.push_back(getSortColumn(searchColumnMapper, searchColMap, expr));
+    };
+    SortParser sortParser(searchColumnMapper, param->getSortCriteria());
+    for (auto&& [expr, desc] : sortParser.parseList())
+        addSortKey(expr, desc);
+    // the id makes the order unique, so each page can continue after the last row of the previous one
+    auto idCol = TQSM(SearchCol::id);
+    if (std::none_of(sortKeys.begin(), sortKeys.end(), [&](auto&& key) { return key.expr == idCol; })) {
+        addSortKey(idCol, false);
     }
+    bool useCursor = std::none_of(sortColumns.begin(), sortColumns.end(), [](int col) { return col < 0; });
+
+    int startingIndex = param->getStartingIndex(), requestedCount = param->getRequestedCount();
+    bool doLimit = startingIndex > 0 || requestedCount > 0;
+    bool storeCursor = useCursor && requestedCount > 0;
 
     std::ostringstream retrievalSQL;
     retrievalSQL << sql_search_query << searchSQL;
 
-    // order by code..
-    auto orderByCode = [&]() {
-        std::ostringstream orderQb;
-        SortParser sortParser(searchColumnMapper, param->getSortCriteria());
-        orderQb << sortParser.parse();
-        if (orderQb.str().empty()) {
-            orderQb << TQSM(SearchCol::id);
-        }
-        return orderQb.str();
-    };
+    // continue after a known page instead of skipping all rows before it
+    std::vector<std::optional<std::string>> cursor;
+    int cursorIndex = (useCursor && startingIndex > 0) ? findPageCursor(cacheKey, generation, startingIndex, cursor) : 0;
+    if (cursorIndex > 0) {
+        retrievalSQL << " AND " << keysetCondition(sortKeys, cursor);
+    }
 
-    retrievalSQL << " ORDER BY " << orderByCode();
+    std::vector<std::string> order;
+    std::transform(sortKeys.begin(), sortKeys.end(), std::back_inserter(order), [](auto&& key) { return fmt::format("{} {}", key.expr, (key.desc ? "DESC" : "ASC")); });
+    retrievalSQL << " ORDER BY " << join(order, ", ");
 
-    int startingIndex = param->getStartingIndex(), requestedCount = param->getRequestedCount();
-    if (startingIndex > 0 || requestedCount > 0) {
+    if (doLimit) {
         retrievalSQL << " LIMIT " << (requestedCount == 0 ? 10000000000 : requestedCount)
-                     << " OFFSET " << startingIndex;
+                     << " OFFSET " << (startingIndex - cursorIndex);
     }
 
     log_debug("Search resolves to SQL [{}]", retrievalSQL.str().c_str());
-    beginTransaction("search 2");
-    sqlResult = select(retrievalSQL);
-    commit("search 2");
+    auto sqlResult = select(retrievalSQL);
 
     std::vector<std::shared_ptr<CdsObject>> arr;
+    std::vector<std::optional<std::string>> lastKeys;
 
     std::unique_ptr<SQLRow> sqlRow;
     while ((sqlRow = sqlResult->nextRow()) != nullptr) {
         auto obj = createObjectFromSearchRow(sqlRow);
+        if (storeCursor) {
+            lastKeys.clear();
+            for (auto&& col : sortColumns) {
+                auto value = sqlRow->col_c_str(col);
+                lastKeys.push_back(value != nullptr ? std::optional<std::string>(quote(value)) : std::nullopt);
+            }
+        }
         arr.push_back(obj);
         sqlRow = nullptr;
     }
     sqlRow = nullptr;
     sqlResult = nullptr;
 
+    if (storeCursor && !arr.empty())
+        storePageCursor(cacheKey, generation, startingIndex + static_cast<int>(arr.size()), std::move(lastKeys));
+
+    attachMetadata(arr, false);
+
     return arr;
 }
 
+SQLDatabase::PageCache& SQLDatabase::getPageCache(const std::string& key, unsigned long generation)
+{
+    auto it = pageCache.find(key);
+    if (it != pageCache.end()) {
+        if (it->second.generation == generation)
+            return it->second;
+        pageCache.erase(it);
+    }
+    if (pageCache.size() >= MAX_PAGE_CACHE_SIZE)
+        pageCache.clear();
+    auto& entry = pageCache[key];
+    entry.generation = generation;
+    return entry;
+}
+
+unsigned long SQLDatabase::getContainerGeneration(int containerID)
+{
+    AutoLock lock(pageCacheMutex);
+    auto it = containerGenerations.find(containerID);
+    return it != containerGenerations.end() ? it->second : 0;
+}
+
+void SQLDatabase::invalidateContainerPages(int containerID)
+{
+    AutoLock lock(pageCacheMutex);
+    containerGenerations[containerID] = ++lastContainerGeneration;
+    if (inTransaction)
+        transactionContainers.insert(containerID);
+}
+
+void SQLDatabase::finishPageTransaction()
+{
+    AutoLock lock(pageCacheMutex);
+    for (auto&& containerID : transactionContainers)
+        containerGenerations[containerID] = ++lastContainerGeneration;
+    transactionContainers.clear();
+}
+
+int SQLDatabase::findPageCursor(const std::string& key, unsigned long generation, int startingIndex, std::vector<std::optional<std::string>>& cursor)
+{
+    AutoLock lock(pageCacheMutex);
+    auto&& cursors = getPageCache(key, generation).cursors;
+    auto it = cursors.upper_bound(startingIndex);
+    if (it == cursors.begin())
+        return 0;
+    --it;
+    cursor = it->second;
+    return it->first;
+}
+
+void SQLDatabase::storePageCursor(const std::string& key, unsigned long generation, int startingIndex, std::vector<std::optional<std::string>> cursor)
+{
+    AutoLock lock(pageCacheMutex);
+    auto&& cursors = getPageCache(key, generation).cursors;
+    if (cursors.size() >= MAX_PAGE_CURSORS)
+        cursors.clear();
+    cursors[startingIndex] = std::move(cursor);
+}
+
+int SQLDatabase::findTotalMatches(const std::string& key, unsigned long generation)
+{
+    AutoLock lock(pageCacheMutex);
+    return getPageCache(key, generation).totalMatches;
+}
+
+void SQLDatabase::storeTotalMatches(const std::string& key, unsigned long generation, int totalMatches)
+{
+    AutoLock lock(pageCacheMutex);
+    getPageCache(key, generation).totalMatches = totalMatches;
+}
+
+std::string SQLDatabase::keysetCondition(const std::vector<SortKey>& sortKeys, const std::vector<std::optional<std::string>>& cursor)
+{
+    // rows after the cursor in lexicographic order of the sort keys, NULL sorts before any value
+    std::vector<std::string> alternatives;
+    std::vector<std::string> equal;
+    for (std::size_t i = 0; i < sortKeys.size() && i < cursor.size(); i++) {
+        auto&& key = sortKeys[i];
+        auto&& value = cursor[i];
+        if (!key.desc) {
+            equal.push_back(value ? fmt::format("{} > {}", key.expr, *value) : fmt::format("{} IS NOT NULL", key.expr));
+            alternatives.push_back(fmt::format("({})", join(equal, " AND ")));
+            equal.pop_back();
+        } else if (value) {
+            equal.push_back(fmt::format("({0} < {1} OR {0} IS NULL)", key.expr, *value));
+            alternatives.push_back(fmt::format("({})", join(equal, " AND ")));
+            equal.pop_back();
+        }
+        equal.push_back(value ? fmt::format("{} = {}", key.expr, *value) : fmt::format("{} IS NULL", key.expr));
+    }
+    if (alternatives.empty())
+        return "0=1";
+    return fmt::format("({})", join(alternatives, " OR "));
+}
+
 int SQLDatabase::getChildCount(int contId, bool containers, bool items, bool hideFsRoot)
 {
     if (!containers && !items)
         return 0;
 
-    std::ostringstream qb;
-    qb << "SELECT COUNT(*) FROM " << TQ(CDS_OBJECT_TABLE)
-       << " WHERE " << TQ("parent_id") << '=' << contId;
-    if (containers && !items)
-        qb << " AND " << TQ("object_type") << '=' << OBJECT_TYPE_CONTAINER;
-    else if (items && !containers)
-        qb << " AND (" << TQ("object_type") << " & " << OBJECT_TYPE_ITEM
-           << ") = " << OBJECT_TYPE_ITEM;
-    if (contId == CDS_ID_ROOT && hideFsRoot) {
-        qb << " AND " << TQ("id") << "!=" << quote(CDS_ID_FS_ROOT);
-    }
-    beginTransaction("getChildCount");
-    auto res = select(qb);
-    commit("getChildCount");
+    auto res = selectPrepared(sql_child_count_query, { contId });
 
     std::unique_ptr<SQLRow> row;
     if (res != nullptr && (row = res->nextRow()) != nullptr) {
-        int childCount = std::stoi(row->col(0));
-        return childCount;
+        return calcChildCount(contId, std::stoi(row->col(0)), std::stoi(row->col(1)), containers, items, hideFsRoot);
     }
     return 0;
 }
 
+int SQLDatabase::calcChildCount(int contId, int containerCount, int itemCount, bool containers, bool items, bool hideFsRoot)
+{
+    int childCount = 0;
+    if (containers) {
+        childCount += containerCount;
+        // the PC directory is the only container that can be hidden
+        if (contId == CDS_ID_ROOT && hideFsRoot && containerCount > 0)
+            childCount--;
+    }
+    if (items)
+        childCount += itemCount;
+    return childCount;
+}
+
+void SQLDatabase::_updateChildCount(int parentID, unsigned int objectType, int delta)
+{
+    std::string column;
+    if (IS_CDS_CONTAINER(objectType))
+        column = "child_count_container";
+    else if ((objectType & OBJECT_TYPE_ITEM) == OBJECT_TYPE_ITEM)
+        column = "child_count_item";
+    else
+        return;
+
+    std::ostringstream qb;
+    qb << "UPDATE " << TQ(CDS_OBJECT_TABLE)
+       << " SET " << TQ(column) << '=' << TQ(column) << (delta < 0 ? " - " : " + ") << std::abs(delta)
+       << " WHERE " << TQ("id") << '=' << parentID;
+    exec(qb.str());
+    invalidateContainerPages(parentID);
+}
+
+void SQLDatabase::checkChildCounts()
+{
+    if (!childCountsUpgraded)
+        return;
+    childCountsUpgraded = false;
+
+    log_debug("Verifying container child counts");
+    std::ostringstream qb;
+    qb << "SELECT " << TQD('a', "id")
+       << ',' << TQD('a', "child_count_container") << ',' << TQD('a', "child_count_item")
+       << ", COALESCE(" << TQD('b', "containers") << ",0), COALESCE(" << TQD('b', "items") << ",0)"
+       << " FROM " << TQ(CDS_OBJECT_TABLE) << ' ' << TQ('a')
+       << " LEFT JOIN (SELECT " << TQ("parent_id")
+       << ", SUM(CASE WHEN " << TQ("object_type") << '=' << OBJECT_TYPE_CONTAINER << " THEN 1 ELSE 0 END) AS " << TQ("containers")
+       << ", SUM(CASE WHEN (" << TQ("object_type") << " & " << OBJECT_TYPE_ITEM << ")=" << OBJECT_TYPE_ITEM << " THEN 1 ELSE 0 END) AS " << TQ("items")
+       << " FROM " << TQ(CDS_OBJECT_TABLE) << " GROUP BY " << TQ("parent_id") << ") " << TQ('b')
+       << " ON " << TQD('b', "parent_id") << '=' << TQD('a', "id")
+       << " WHERE " << TQD('a', "object_type") << '=' << OBJECT_TYPE_CONTAINER
+       << " AND (" << TQD('a', "child_count_container") << "!=COALESCE(" << TQD('b', "containers") << ",0)"
+       << " OR " << TQD('a', "child_count_item") << "!=COALESCE(" << TQD('b', "items") << ",0))";
+    auto res = select(qb);
+    if (res == nullptr)
+        throw_std_runtime_error("db error");
+
+    // collect first, the result must not change while it is read
+    std::vector<std::array<long long, 3>> repairs;
+    std::unique_ptr<SQLRow> row;
+    while ((row = res->nextRow()) != nullptr) {
+        log_debug("Container {} has child counts {}/{}, expected {}/{}", row->col_view(0), row->col_view(1), row->col_view(2), row->col_view(3), row->col_view(4));
+        repairs.push_back({ row->col_int64(0), row->col_int64(3), row->col_int64(4) });
+    }
+    for (auto&& [id, containers, items] : repairs) {
+        std::ostringstream update;
+        update << "UPDATE " << TQ(CDS_OBJECT_TABLE)
+               << " SET " << TQ("child_count_container") << '=' << containers
+               << ',' << TQ("child_count_item") << '=' << items
+               << " WHERE " << TQ("id") << '=' << id;
+        exec(update.str());
+    }
+    if (!repairs.empty())
+        log_warning("Repaired child counts of {} containers", repairs.size());
+}
+
 std::vector<std::string> SQLDatabase::getMimeTypes()
 {
     std::vector<std::string> arr;
@@ -862,9 +1373,7 @@ std::vector<std::string> SQLDatabase::getMimeTypes()
        << " FROM " << TQ(CDS_OBJECT_TABLE)
        << " WHERE " << TQ("mime_type") << " IS NOT NULL ORDER BY "
        << TQ("mime_type");
-    beginTransaction("getMimeTypes");
     auto res = select(qb);
-    commit("getMimeTypes");
     if (res == nullptr)
         throw_std_runtime_error("db error");
 
@@ -878,43 +1387,183 @@ std::vector<std::string> SQLDatabase::getMimeTypes()
 
 std::shared_ptr<CdsObject> SQLDatabase::findObjectByPath(fs::path fullpath, bool wasRegularFile)
 {
-    std::string dbLocation;
-    std::error_code ec;
-    if (isRegularFile(fullpath, ec) || wasRegularFile)
-        dbLocation = addLocationPrefix(LOC_FILE_PREFIX, fullpath);
-    else
-        dbLocation = addLocationPrefix(LOC_DIR_PREFIX, fullpath);
-
-    std::ostringstream qb;
-    qb << sql_browse_query
-       << " WHERE " << TQBM(BrowseCol::location_hash) << '=' << quote(stringHash(dbLocation))
-       << " AND " << TQBM(BrowseCol::location) << '=' << quote(dbLocation)
-       << " AND " << TQBM(BrowseCol::ref_id) << " IS NULL"
-                                                " LIMIT 1";
-
-    beginTransaction("findObjectByPath");
-    auto res = select(qb);
-    if (res == nullptr) {
-        commit("findObjectByPath");
-        throw_std_runtime_error("error while doing select: {}", qb.str());
-    }
+    int objectID = lookupPathIndex(fullpath, wasRegularFile);
+    if (objectID == INVALID_OBJECT_ID)
+        return nullptr;
 
-    std::unique_ptr<SQLRow> row = res->nextRow();
-    if (row == nullptr) {
-        commit("findObjectByPath");
+    try {
+        return loadObject(objectID);
+    } catch (const ObjectNotFoundException&) {
+        log_warning("Path index is outdated for {}", fullpath.c_str());
+        removeFromPathIndex({ objectID });
         return nullptr;
     }
-    auto result = createObjectFromRow(row);
-    commit("findObjectByPath");
-    return result;
 }
 
 int SQLDatabase::findObjectIDByPath(fs::path fullpath, bool wasRegularFile)
 {
-    auto obj = findObjectByPath(fullpath, wasRegularFile);
-    if (obj == nullptr)
+    return lookupPathIndex(fullpath, wasRegularFile);
+}
+
+int SQLDatabase::lookupPathIndex(const fs::path& fullpath, bool wasRegularFile)
+{
+    loadPathIndex();
+    AutoLock lock(pathIndexMutex);
+
+    auto node = pathIndex->find(fullpath.string(), false);
+    if (node == nullptr)
         return INVALID_OBJECT_ID;
-    return obj->getID();
+    int file = node->file.objectID;
+    int dir = node->dir.objectID;
+    if (wasRegularFile)
+        return file;
+
+    if (file != INVALID_OBJECT_ID && dir != INVALID_OBJECT_ID) {
+        // a file replaced a directory or vice versa and the next scan has not cleaned up yet
+        std::error_code ec;
+        return isRegularFile(fullpath, ec) ? file : dir;
+    }
+    return file != INVALID_OBJECT_ID ? file : dir;
+}
+
+void SQLDatabase::loadPathIndex()
+{
+    {
+        AutoLock lock(pathIndexMutex);
+        if (pathIndex != nullptr)
+            return;
+    }
+    AutoLock loadLock(pathIndexLoadMutex);
+    {
+        AutoLock lock(pathIndexMutex);
+        if (pathIndex != nullptr)
+            return;
+        pathIndexUpdates.emplace();
+        pathIndexRemovals.clear();
+    }
+
+    auto index = std::make_unique<PathIndex>();
+    std::ostringstream q;
+    q << "SELECT " << TQ("id") << ',' << TQ("object_type") << ',' << TQ("location")
+      << " FROM " << TQ(CDS_OBJECT_TABLE)
+      << " WHERE " << TQ("ref_id") << " IS NULL"
+      << " AND " << TQ("location_hash") << " IS NOT NULL";
+    try {
+        auto res = select(q);
+        if (res == nullptr)
+            throw_std_runtime_error("error while loading path index: {}", q.str());
+
+        std::unique_ptr<SQLRow> row;
+        while ((row = res->nextRow()) != nullptr) {
+            auto location = row->col_view(2);
+            if (location.empty() || (location[0] != LOC_FILE_PREFIX && location[0] != LOC_DIR_PREFIX))
+                continue;
+            index->update(location, static_cast<int>(row->col_int64(0)), static_cast<unsigned int>(row->col_int64(1)));
+        }
+    } catch (const std::runtime_error&) {
+        AutoLock lock(pathIndexMutex);
+        pathIndexUpdates.reset();
+        pathIndexRemovals.clear();
+        throw;
+    }
+
+    AutoLock lock(pathIndexMutex);
+    // the changes were written while the index was read, they may already be part of it
+    for (auto&& [dbLocation, objectID, objectType] : *pathIndexUpdates)
+        index->update(dbLocation, objectID, objectType);
+    for (auto&& objectID : pathIndexRemovals)
+        index->remove(objectID);
+    pathIndexUpdates.reset();
+    pathIndexRemovals.clear();
+    pathIndex = std::move(index);
+    log_debug("Loaded {} locations into path index", pathIndex->nodes.size());
+}
+
+SQLDatabase::PathIndexNode* SQLDatabase::PathIndex::find(std::string_view path, bool create)
+{
+    auto node = &root;
+    while (!path.empty()) {
+        auto end = path.find(DIR_SEPARATOR);
+        auto name = path.substr(0, end);
+        path = end == std::string_view::npos ? std::string_view() : path.substr(end + 1);
+        if (name.empty())
+            continue;
+
+        auto child = node->children.find(name);
+        if (child == node->children.end()) {
+            if (!create)
+                return nullptr;
+            child = node->children.emplace(name, std::make_unique<PathIndexNode>()).first;
+            child->second->parent = node;
+            child->second->name = child->first;
+        }
+        node = child->second.get();
+    }
+    return node;
+}
+
+void SQLDatabase::PathIndex::update(std::string_view dbLocation, int objectID, unsigned int objectType)
+{
+    // a moved object leaves its old location
+    remove(objectID);
+
+    auto node = find(dbLocation.substr(1), true);
+    auto&& entry = dbLocation[0] == LOC_FILE_PREFIX ? node->file : node->dir;
+    if (entry.objectID != INVALID_OBJECT_ID)
+        nodes.erase(entry.objectID);
+    entry = PathIndexEntry { objectID, objectType };
+    nodes[objectID] = node;
+}
+
+void SQLDatabase::PathIndex::remove(int objectID)
+{
+    auto it = nodes.find(objectID);
+    if (it == nodes.end())
+        return;
+    auto node = it->second;
+    nodes.erase(it);
+    if (node->file.objectID == objectID)
+        node->file = PathIndexEntry();
+    if (node->dir.objectID == objectID)
+        node->dir = PathIndexEntry();
+
+    // drop the directories that only led to the location
+    while (node != &root && node->children.empty() && node->file.objectID == INVALID_OBJECT_ID && node->dir.objectID == INVALID_OBJECT_ID) {
+        auto parent = node->parent;
+        parent->children.erase(parent->children.find(node->name));
+        node = parent;
+    }
+}
+
+void SQLDatabase::updatePathIndex(const std::shared_ptr<CdsObject>& obj)
+{
+    if (obj->getID() == INVALID_OBJECT_ID || IS_FORBIDDEN_CDS_ID(obj->getID()) || obj->isVirtual() || obj->getRefID() > 0 || obj->getLocation().empty())
+        return;
+
+    if (obj->isContainer())
+        updatePathIndex(addLocationPrefix(LOC_DIR_PREFIX, obj->getLocation()), obj->getID(), obj->getObjectType());
+    else if (obj->isPureItem())
+        updatePathIndex(addLocationPrefix(LOC_FILE_PREFIX, obj->getLocation()), obj->getID(), obj->getObjectType());
+}
+
+void SQLDatabase::updatePathIndex(const std::string& dbLocation, int objectID, unsigned int objectType)
+{
+    AutoLock lock(pathIndexMutex);
+    if (pathIndex != nullptr)
+        pathIndex->update(dbLocation, objectID, objectType);
+    else if (pathIndexUpdates)
+        pathIndexUpdates->emplace_back(dbLocation, objectID, objectType);
+}
+
+void SQLDatabase::removeFromPathIndex(const std::vector<int32_t>& objectIDs)
+{
+    AutoLock lock(pathIndexMutex);
+    if (pathIndex != nullptr) {
+        for (auto&& objectID : objectIDs)
+            pathIndex->remove(objectID);
+    } else if (pathIndexUpdates) {
+        pathIndexRemovals.insert(pathIndexRemovals.end(), objectIDs.begin(), objectIDs.end());
+    }
 }
 
 int SQLDatabase::ensurePathExistence(fs::path path, int* changedContainer)
@@ -923,9 +1572,9 @@ int SQLDatabase::ensurePathExistence(fs::path path, int* changedContainer)
     if (path == std::string(1, DIR_SEPARATOR))
         return CDS_ID_FS_ROOT;
 
-    auto obj = findObjectByPath(path);
-    if (obj != nullptr)
-        return obj->getID();
+    int objectID = findObjectIDByPath(path);
+    if (objectID != INVALID_OBJECT_ID)
+        return objectID;
 
     int parentID = ensurePathExistence(path.parent_path(), changedContainer);
 
@@ -974,25 +1623,18 @@ int SQLDatabase::createContainer(int parentID, std::string name, const std::stri
     beginTransaction("createContainer");
     int newId = exec(qb.str(), true); // true = get last id#
     log_debug("Created object row, id: {}", newId);
+    _updateChildCount(parentID, OBJECT_TYPE_CONTAINER, 1);
 
     if (!itemMetadata.empty()) {
         for (auto&& [key, val] : itemMetadata) {
-            std::ostringstream ib;
-            ib << "INSERT INTO "
-               << TQ(METADATA_TABLE)
-               << " ("
-               << TQ("item_id") << ','
-               << TQ("property_name") << ','
-               << TQ("property_value") << ") VALUES ("
-               << newId << ","
-               << quote(key) << ","
-               << quote(val)
-               << ")";
-            exec(ib.str());
+            execPrepared(sql_meta_insert_query, { newId, key, val });
         }
         log_debug("Wrote metadata for cds_object {}", newId);
+        invalidateContainerPages(parentID);
     }
     commit("createContainer");
+    if (!isVirtual)
+        updatePathIndex(dbLocation, newId, OBJECT_TYPE_CONTAINER);
 
     return newId;
 }
@@ -1100,21 +1742,12 @@ std::shared_ptr<CdsObject> SQLDatabase::createObjectFromRow(const std::unique_pt
     obj->setFlags(std::stoi(getCol(row, BrowseCol::flags)));
     obj->setMTime(std::chrono::seconds(stoulString(getCol(row, BrowseCol::last_modified))));
 
-    auto meta = retrieveMetadataForObject(obj->getID());
-    if (!meta.empty()) {
-        obj->setMetadata(meta);
-    } else if (obj->getRefID() != CDS_ID_ROOT) {
-        meta = retrieveMetadataForObject(obj->getRefID());
-        if (!meta.empty())
-            obj->setMetadata(meta);
-    }
-    if (meta.empty()) {
-        // fallback to metadata that might be in mt_cds_object, which
-        // will be useful if retrieving for schema upgrade
-        std::string metadataStr = getCol(row, BrowseCol::metadata);
-        dictDecode(metadataStr, &meta);
-        obj->setMetadata(meta);
-    }
+    // fallback to metadata that might be in mt_cds_object, which
+    // will be useful if retrieving for schema upgrade
+    // entries from mt_metadata are attached later by attachMetadata
+    std::map<std::string, std::string> meta;
+    dictDecode(getCol(row, BrowseCol::metadata), &meta);
+    obj->setMetadata(meta);
 
     std::string auxdataStr = fallbackString(getCol(row, BrowseCol::auxdata), getCol(row, BrowseCol::ref_auxdata));
     std::map<std::string, std::string> aux;
@@ -1202,10 +1835,6 @@ std::shared_ptr<CdsObject> SQLDatabase::createObjectFromSearchRow(const std::uni
     obj->setTitle(getCol(row, SearchCol::dc_title));
     obj->setClass(getCol(row, SearchCol::upnp_class));
 
-    auto meta = retrieveMetadataForObject(obj->getID());
-    if (!meta.empty())
-        obj->setMetadata(meta);
-
     std::string resources_str = getCol(row, SearchCol::resources);
     bool resource_zero_ok = false;
     if (!resources_str.empty()) {
@@ -1239,12 +1868,7 @@ std::shared_ptr<CdsObject> SQLDatabase::createObjectFromSearchRow(const std::uni
 
 std::map<std::string, std::string> SQLDatabase::retrieveMetadataForObject(int objectId)
 {
-    std::ostringstream qb;
-    qb << sql_meta_query
-       << " FROM " << TQ(METADATA_TABLE)
-       << " WHERE " << TQ("item_id")
-       << " = " << objectId;
-    auto res = select(qb);
+    auto res = selectPrepared(sql_object_meta_query, { objectId });
 
     std::map<std::string, std::string> metadata;
     if (res == nullptr)
@@ -1257,6 +1881,55 @@ std::map<std::string, std::string> SQLDatabase::retrieveMetadataForObject(int ob
     return metadata;
 }
 
+std::unordered_map<int, std::map<std::string, std::string>> SQLDatabase::retrieveMetadataForObjects(const std::vector<int>& objectIds)
+{
+    std::unordered_map<int, std::map<std::string, std::string>> metadata;
+
+    for (auto it = objectIds.begin(); it != objectIds.end();) {
+        auto batchEnd = std::distance(it, objectIds.end()) > MAX_METADATA_BATCH_SIZE ? std::next(it, MAX_METADATA_BATCH_SIZE) : objectIds.end();
+        std::ostringstream qb;
+        qb << sql_meta_query
+           << " FROM " << TQ(METADATA_TABLE)
+           << " WHERE " << TQ("item_id")
+           << " IN (" << join(std::vector<int>(it, batchEnd), ',') << ')';
+        it = batchEnd;
+
+        auto res = select(qb);
+        if (res == nullptr)
+            continue;
+
+        std::unique_ptr<SQLRow> row;
+        while ((row = res->nextRow()) != nullptr) {
+            metadata[std::stoi(getCol(row, MetadataCol::item_id))][getCol(row, MetadataCol::property_name)] = getCol(row, MetadataCol::property_value);
+        }
+    }
+    return metadata;
+}
+
+void SQLDatabase::attachMetadata(const std::vector<std::shared_ptr<CdsObject>>& objects, bool useRefId)
+{
+    if (objects.empty())
+        return;
+
+    std::vector<int> objectIds;
+    std::unordered_set<int> seen;
+    for (auto&& obj : objects) {
+        if (seen.insert(obj->getID()).second)
+            objectIds.push_back(obj->getID());
+        if (useRefId && obj->getRefID() != CDS_ID_ROOT && seen.insert(obj->getRefID()).second)
+            objectIds.push_back(obj->getRefID());
+    }
+
+    auto metadata = retrieveMetadataForObjects(objectIds);
+    for (auto&& obj : objects) {
+        auto meta = metadata.find(obj->getID());
+        if (meta == metadata.end() && useRefId && obj->getRefID() != CDS_ID_ROOT)
+            meta = metadata.find(obj->getRefID());
+        if (meta != metadata.end())
+            obj->setMetadata(meta->second);
+    }
+}
+
 int SQLDatabase::getTotalFiles(bool isVirtual, const std::string& mimeType, const std::string& upnpClass)
 {
     std::ostringstream query;
@@ -1343,15 +2016,15 @@ std::unique_ptr<std::unordered_set<int>> SQLDatabase::getObjects(int parentID, b
     auto res = select(q);
     if (res == nullptr)
         throw_std_runtime_error("db error");
-    if (res->getNumRows() == 0)
-        return nullptr;
 
-    std::unordered_set<int> ret;
+    auto ret = std::make_unique<std::unordered_set<int>>();
     std::unique_ptr<SQLRow> row;
     while ((row = res->nextRow()) != nullptr) {
-        ret.insert(std::stoi(row->col(0)));
+        ret->insert(row->col_int64(0));
     }
-    return std::make_unique<std::unordered_set<int>>(ret);
+    if (ret->empty())
+        return nullptr;
+    return ret;
 }
 
 std::unique_ptr<Database::ChangedContainers> SQLDatabase::removeObjects(const std::unique_ptr<std::unordered_set<int>>& list, bool all)
@@ -1390,6 +2063,113 @@ std::unique_ptr<Database::ChangedContainers> SQLDatabase::removeObjects(const st
     return _purgeEmptyContainers(rr);
 }
 
+std::unique_ptr<Database::ChangedContainers> SQLDatabase::moveObject(int objectID, const fs::path& location, const std::string& title, std::vector<int>& movedItems)
+{
+    if (IS_FORBIDDEN_CDS_ID(objectID))
+        throw_std_runtime_error("Tried to move a forbidden ID ({})", objectID);
+    auto obj = loadObject(objectID);
+    if (obj->isVirtual() || obj->getRefID() > 0 || (!obj->isContainer() && !obj->isPureItem()))
+        throw_std_runtime_error("Tried to move an object without file location ({})", objectID);
+
+    auto oldLocation = obj->getLocation().string();
+    char prefix = obj->isContainer() ? LOC_DIR_PREFIX : LOC_FILE_PREFIX;
+    auto changedContainers = std::make_unique<ChangedContainers>();
+    // new locations for the path index
+    std::vector<std::tuple<std::string, int, unsigned int>> moved;
+
+    beginTransaction("moveObject");
+    int changedContainer;
+    int parentID = ensurePathExistence(location.parent_path(), &changedContainer);
+    if (changedContainer != INVALID_OBJECT_ID) {
+        changedContainers->upnp.push_back(changedContainer);
+        changedContainers->ui.push_back(changedContainer);
+    }
+
+    auto dbLocation = addLocationPrefix(prefix, location);
+    std::ostringstream qb;
+    qb << "UPDATE " << TQ(CDS_OBJECT_TABLE)
+       << " SET " << TQ("parent_id") << '=' << quote(parentID)
+       << ',' << TQ("dc_title") << '=' << quote(title)
+       << ',' << TQ("location") << '=' << quote(dbLocation)
+       << ',' << TQ("location_hash") << '=' << quote(stringHash(dbLocation))
+       << " WHERE " << TQ("id") << '=' << quote(objectID);
+    exec(qb.str());
+    invalidateContainerPages(parentID);
+    moved.emplace_back(dbLocation, objectID, obj->getObjectType());
+    if (parentID != obj->getParentID()) {
+        _updateChildCount(obj->getParentID(), obj->getObjectType(), -1);
+        _updateChildCount(parentID, obj->getObjectType(), 1);
+        changedContainers->upnp.push_back(obj->getParentID());
+        changedContainers->ui.push_back(obj->getParentID());
+    }
+    changedContainers->upnp.push_back(parentID);
+    changedContainers->ui.push_back(parentID);
+
+    if (obj->isContainer()) {
+        // children keep their parent, only the location changes
+        std::vector<int> parentIDs { objectID };
+        while (!parentIDs.empty()) {
+            std::ostringstream q;
+            q << "SELECT " << TQ("id") << ',' << TQ("object_type") << ',' << TQ("location")
+              << " FROM " << TQ(CDS_OBJECT_TABLE)
+              << " WHERE " << TQ("parent_id") << " IN (" << join(parentIDs, ',') << ')'
+              << " AND " << TQ("ref_id") << " IS NULL";
+            auto res = select(q);
+            if (res == nullptr)
+                throw DatabaseException("", fmt::format("Sql error: {}", q.str()));
+            parentIDs.clear();
+
+            std::unique_ptr<SQLRow> row;
+            while ((row = res->nextRow()) != nullptr) {
+                int childID = row->col_int64(0);
+                auto childType = static_cast<unsigned int>(row->col_int64(1));
+                auto childLocation = row->col(2);
+                if (IS_CDS_CONTAINER(childType))
+                    parentIDs.push_back(childID);
+                else
+                    movedItems.push_back(childID);
+                if (childLocation.size() <= oldLocation.size() + 1 || childLocation.compare(1, oldLocation.size(), oldLocation) != 0 || childLocation[oldLocation.size() + 1] != DIR_SEPARATOR)
+                    continue;
+
+                auto childDbLocation = fmt::format("{}{}{}", childLocation[0], location.string(), childLocation.substr(oldLocation.size() + 1));
+                execPrepared(sql_location_update_query, { childDbLocation, static_cast<long long>(stringHash(childDbLocation)), static_cast<long long>(childID) });
+                moved.emplace_back(childDbLocation, childID, childType);
+            }
+        }
+    } else {
+        movedItems.push_back(objectID);
+    }
+    commit("moveObject");
+
+    for (auto&& [movedLocation, movedID, movedType] : moved) {
+        updatePathIndex(movedLocation, movedID, movedType);
+    }
+    return changedContainers;
+}
+
+std::unique_ptr<std::unordered_set<int>> SQLDatabase::getReferences(const std::vector<int>& objectIDs)
+{
+    if (objectIDs.empty())
+        return nullptr;
+
+    std::ostringstream q;
+    q << "SELECT " << TQ("id") << " FROM " << TQ(CDS_OBJECT_TABLE)
+      << " WHERE " << TQ("object_type") << " != " << OBJECT_TYPE_CONTAINER
+      << " AND " << TQ("ref_id") << " IN (" << join(objectIDs, ',') << ')';
+    auto res = select(q);
+    if (res == nullptr)
+        throw_std_runtime_error("db error");
+
+    auto ret = std::make_unique<std::unordered_set<int>>();
+    std::unique_ptr<SQLRow> row;
+    while ((row = res->nextRow()) != nullptr) {
+        ret->insert(row->col_int64(0));
+    }
+    if (ret->empty())
+        return nullptr;
+    return ret;
+}
+
 void SQLDatabase::_removeObjects(const std::vector<int32_t>& objectIDs)
 {
     auto objectIdsStr = join(objectIDs, ',');
@@ -1406,7 +2186,27 @@ void SQLDatabase::_removeObjects(const std::vector<int32_t>& objectIDs)
 
     log_debug("{}", sel.str());
 
+    std::ostringstream selParents;
+    selParents << "SELECT " << TQ("parent_id") << ',' << TQ("object_type") << ", COUNT(*)"
+               << " FROM " << TQ(CDS_OBJECT_TABLE)
+               << " WHERE " << TQ("id") << " IN (" << objectIdsStr << ')'
+               << " GROUP BY " << TQ("parent_id") << ',' << TQ("object_type");
+
     beginTransaction("_removeObjects");
+    auto parentRes = select(selParents);
+    std::vector<int> parentIDs;
+    if (parentRes != nullptr) {
+        std::unordered_set<int32_t> removed(objectIDs.begin(), objectIDs.end());
+        std::unique_ptr<SQLRow> row;
+        while ((row = parentRes->nextRow()) != nullptr) {
+            int parentID = std::stoi(row->col(0));
+            if (removed.find(parentID) == removed.end()) {
+                _updateChildCount(parentID, std::stoul(row->col(1)), -std::stoi(row->col(2)));
+                parentIDs.push_back(parentID);
+            }
+        }
+    }
+
     auto res = select(sel);
     if (res != nullptr) {
         log_debug("relevant autoscans!");
@@ -1444,7 +2244,19 @@ void SQLDatabase::_removeObjects(const std::vector<int32_t>& objectIDs)
             << " WHERE " << TQ("id")
             << " IN (" << objectIdsStr << ')';
     exec(qObject.str());
+    if (!parentIDs.empty()) {
+        // a rescan has to import the removed objects again if their files still exist
+        std::ostringstream qState;
+        qState << "DELETE FROM " << TQ(DIRECTORY_STATE_TABLE)
+               << " WHERE " << TQ("obj_id")
+               << " IN (" << join(parentIDs, ',') << ')';
+        exec(qState.str());
+    }
+    // the counts were written before the rows were gone
+    for (auto&& parentID : parentIDs)
+        invalidateContainerPages(parentID);
     commit("_removeObjects");
+    removeFromPathIndex(objectIDs);
 }
 
 std::unique_ptr<Database::ChangedContainers> SQLDatabase::removeObject(int objectID, bool all)
@@ -1625,16 +2437,16 @@ std::unique_ptr<Database::ChangedContainers> SQLDatabase::_purgeEmptyContainers(
     if (maybeEmpty->upnp.empty() && maybeEmpty->ui.empty())
         return nullptr;
 
+    // the stored child counts are not trusted before deleting, look for a child row instead
     std::ostringstream selectSql;
     selectSql << "SELECT " << TQD('a', "id")
-              << ", COUNT(" << TQD('b', "parent_id")
-              << ")," << TQD('a', "parent_id") << ',' << TQD('a', "flags")
+              << ",CASE WHEN EXISTS (SELECT 1 FROM " << TQ(CDS_OBJECT_TABLE) << ' ' << TQ('b')
+              << " WHERE " << TQD('b', "parent_id") << '=' << TQD('a', "id") << ") THEN 1 ELSE 0 END"
+              << ',' << TQD('a', "parent_id") << ',' << TQD('a', "flags")
               << " FROM " << TQ(CDS_OBJECT_TABLE) << ' ' << TQ('a')
-              << " LEFT JOIN " << TQ(CDS_OBJECT_TABLE) << ' ' << TQ('b')
-              << " ON " << TQD('a', "id") << '=' << TQD('b', "parent_id")
               << " WHERE " << TQD('a', "object_type") << '=' << quote(1)
               << " AND " << TQD('a', "id") << " IN ("; //(a.flags & " << OBJECT_FLAG_PERSISTENT_CONTAINER << ") = 0 AND
-    std::string strSel2(") GROUP BY a.id"); // HAVING COUNT(b.parent_id)=0");
+    std::string strSel2(")");
 
     std::ostringstream bufSelUpnp;
     bufSelUpnp << selectSql.str();
@@ -1746,6 +2558,163 @@ std::string SQLDatabase::getInternalSetting(const std::string& key)
 }
 
 /* config methods */
+bool SQLDatabase::loadCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item)
+{
+    auto res = selectPrepared(sql_cache_load_query, { identity.device, identity.inode, identity.size, identity.mtime });
+    std::unique_ptr<SQLRow> row;
+    if (res == nullptr || (row = res->nextRow()) == nullptr)
+        return false;
+    // mime type mappings may have changed since
+    if (row->col(0) != item->getMimeType())
+        return false;
+
+    item->setFlags(stoulString(row->col(1)));
+
+    std::map<std::string, std::string> dict;
+    dictDecode(row->col(2), &dict);
+    item->setMetadata(dict);
+    dict.clear();
+    dictDecode(row->col(3), &dict);
+    item->setAuxData(dict);
+
+    auto resources = row->col(4);
+    if (!resources.empty()) {
+        for (auto&& resource : splitString(resources, RESOURCE_SEP)) {
+            item->addResource(CdsResource::decode(resource));
+        }
+    }
+
+    // keep entries in use from expiring and follow moved files
+    auto dbLocation = addLocationPrefix(LOC_FILE_PREFIX, item->getLocation());
+    auto now = currentTime();
+    if (row->col(5) != dbLocation || std::chrono::seconds(std::stoll(row->col(6))) + METADATA_CACHE_TOUCH_INTERVAL < now) {
+        execPrepared(sql_cache_touch_query, { static_cast<long long>(stringHash(dbLocation)), dbLocation, static_cast<long long>(now.count()), identity.device, identity.inode });
+    }
+    return true;
+}
+
+void SQLDatabase::storeCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item)
+{
+    std::ostringstream resBuf;
+    for (size_t i = 0; i < item->getResourceCount(); i++) {
+        if (i > 0)
+            resBuf << RESOURCE_SEP;
+        resBuf << item->getResource(i)->encode();
+    }
+
+    auto dbLocation = addLocationPrefix(LOC_FILE_PREFIX, item->getLocation());
+    execPrepared(sql_cache_store_query, {
+                                            identity.device,
+                                            identity.inode,
+                                            identity.size,
+                                            identity.mtime,
+                                            static_cast<long long>(stringHash(dbLocation)),
+                                            dbLocation,
+                                            item->getMimeType(),
+                                            static_cast<long long>(item->getFlags()),
+                                            dictEncode(item->getMetadata()),
+                                            dictEncode(item->getAuxData()),
+                                            resBuf.str(),
+                                            static_cast<long long>(currentTime().count()),
+                                        });
+}
+
+std::shared_ptr<CdsObject> SQLDatabase::findObjectByIdentity(const FileIdentity& identity)
+{
+    auto res = selectPrepared(sql_cache_identity_query, { identity.device, identity.inode, identity.size, identity.mtime });
+    if (res == nullptr)
+        return nullptr;
+
+    std::unique_ptr<SQLRow> row;
+    while ((row = res->nextRow()) != nullptr) {
+        try {
+            auto obj = loadObject(row->col_int64(0));
+            // directories and virtual containers have hashes as well
+            if (obj->isPureItem())
+                return obj;
+        } catch (const ObjectNotFoundException&) {
+        }
+    }
+    return nullptr;
+}
+
+/// \brief hash of the settings that change what the metadata handlers extract
+static std::string getMetadataCacheConfig(const std::shared_ptr<Config>& config)
+{
+    std::ostringstream buf;
+    buf << config->getOption(CFG_IMPORT_FILESYSTEM_CHARSET) << ';' << config->getOption(CFG_IMPORT_METADATA_CHARSET)
+        << ';' << config->getOption(CFG_IMPORT_LIBOPTS_ENTRY_SEP) << ';' << config->getOption(CFG_IMPORT_LIBOPTS_ENTRY_LEGACY_SEP);
+    for (auto&& [mimetype, contentType] : config->getDictionaryOption(CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST))
+        buf << ';' << mimetype << '=' << contentType;
+    for (auto&& tweak : config->getDirectoryTweakOption(CFG_IMPORT_DIRECTORIES_LIST)->getArrayCopy()) {
+        if (tweak->hasMetaCharset())
+            buf << ';' << tweak->getLocation().string() << '=' << tweak->getMetaCharset();
+    }
+#ifdef HAVE_LIBEXIF
+    buf << ';' << join(config->getArrayOption(CFG_IMPORT_LIBOPTS_EXIF_AUXDATA_TAGS_LIST), ',') << ';' << config->getOption(CFG_IMPORT_LIBOPTS_EXIF_CHARSET);
+#endif
+#ifdef HAVE_EXIV2
+    buf << ';' << join(config->getArrayOption(CFG_IMPORT_LIBOPTS_EXIV2_AUXDATA_TAGS_LIST), ',') << ';' << config->getOption(CFG_IMPORT_LIBOPTS_EXIV2_CHARSET);
+#endif
+#ifdef HAVE_TAGLIB
+    buf << ';' << join(config->getArrayOption(CFG_IMPORT_LIBOPTS_ID3_AUXDATA_TAGS_LIST), ',') << ';' << config->getOption(CFG_IMPORT_LIBOPTS_ID3_CHARSET);
+#endif
+#ifdef HAVE_FFMPEG
+    buf << ';' << join(config->getArrayOption(CFG_IMPORT_LIBOPTS_FFMPEG_AUXDATA_TAGS_LIST), ',') << ';' << config->getOption(CFG_IMPORT_LIBOPTS_FFMPEG_CHARSET);
+#endif
+#if defined(HAVE_FFMPEG) && defined(HAVE_FFMPEGTHUMBNAILER)
+    buf << ';' << config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_ENABLED);
+#endif
+    return fmt::to_string(stringHash(buf.str()));
+}
+
+void SQLDatabase::pruneMetadataCache()
+{
+    // entries extracted with other settings would keep the old tags and charsets
+    auto cacheConfig = getMetadataCacheConfig(config);
+    if (getInternalSetting(METADATA_CACHE_CONFIG_KEY) != cacheConfig) {
+        log_info("Metadata extraction settings changed, clearing the metadata cache");
+        std::ostringstream del;
+        del << "DELETE FROM " << TQ(METADATA_CACHE_TABLE);
+        exec(del.str());
+        storeInternalSetting(METADATA_CACHE_CONFIG_KEY, cacheConfig);
+        return;
+    }
+
+    auto expired = currentTime() - METADATA_CACHE_EXPIRY;
+    std::ostringstream qb;
+    qb << "DELETE FROM " << TQ(METADATA_CACHE_TABLE)
+       << " WHERE " << TQ("last_used") << '<' << quote(static_cast<long long>(expired.count()))
+       << " AND " << TQ("location_hash") << " NOT IN (SELECT " << TQ("location_hash")
+       << " FROM " << TQ(CDS_OBJECT_TABLE) << " WHERE " << TQ("location_hash") << " IS NOT NULL)";
+    exec(qb.str());
+}
+
+bool SQLDatabase::loadDirectoryState(int objectID, DirectoryState& state)
+{
+    auto res = selectPrepared(sql_dir_state_load_query, { static_cast<long long>(objectID) });
+    std::unique_ptr<SQLRow> row;
+    if (res == nullptr || (row = res->nextRow()) == nullptr)
+        return false;
+    state.mtime = std::stoll(row->col(0));
+    state.digest = std::stoll(row->col(1));
+    return true;
+}
+
+void SQLDatabase::storeDirectoryState(int objectID, const DirectoryState& state)
+{
+    execPrepared(sql_dir_state_store_query, { static_cast<long long>(objectID), state.mtime, state.digest });
+}
+
+void SQLDatabase::pruneDirectoryStates()
+{
+    // sqlite3 deletes them with the container, MyISAM tables have no foreign keys
+    std::ostringstream qb;
+    qb << "DELETE FROM " << TQ(DIRECTORY_STATE_TABLE)
+       << " WHERE " << TQ("obj_id") << " NOT IN (SELECT " << TQ("id") << " FROM " << TQ(CDS_OBJECT_TABLE) << ')';
+    exec(qb.str());
+}
+
 std::vector<ConfigValue> SQLDatabase::getConfigValues()
 {
     std::ostringstream query;
@@ -2159,7 +3128,7 @@ std::unique_ptr<std::vector<int>> SQLDatabase::_checkOverlappingAutoscans(const
         if (res == nullptr)
             throw_std_runtime_error("SQL error");
         if ((row = res->nextRow()) != nullptr) {
-            int objectID = std::stoi(row->col(0));
+            int objectID = row->col_int64(0);
             log_debug("-------------- {}", objectID);
             auto obj = loadObject(objectID);
             if (obj == nullptr)
@@ -2169,6 +3138,7 @@ std::unique_ptr<std::vector<int>> SQLDatabase::_checkOverlappingAutoscans(const
         }
     }
 
+    int objectID;
     {
         auto pathIDs = getPathIDs(checkObjectID);
         if (pathIDs == nullptr)
@@ -2188,9 +3158,10 @@ std::unique_ptr<std::vector<int>> SQLDatabase::_checkOverlappingAutoscans(const
             throw_std_runtime_error("SQL error");
         if ((row = res->nextRow()) == nullptr)
             return pathIDs;
+        // the row is only valid as long as its result
+        objectID = row->col_int64(0);
     }
 
-    int objectID = std::stoi(row->col(0));
     auto obj = loadObject(objectID);
     if (obj == nullptr) {
         throw_std_runtime_error("Referenced object (by Autoscan) not found.");
@@ -2264,8 +3235,8 @@ void SQLDatabase::generateMetadataDBOperations(const std::shared_ptr<CdsObject>&
     if (op == Operation::Insert) {
         for (auto&& [key, val] : dict) {
             std::map<std::string, std::string> metadataSql;
-            metadataSql["property_name"] = quote(key);
-            metadataSql["property_value"] = quote(val);
+            metadataSql["property_name"] = key;
+            metadataSql["property_value"] = val;
             operations.push_back(std::make_shared<AddUpdateTable>(METADATA_TABLE, metadataSql, op));
         }
     } else {
@@ -2274,16 +3245,16 @@ void SQLDatabase::generateMetadataDBOperations(const std::shared_ptr<CdsObject>&
         for (auto&& [key, val] : dict) {
             Operation operation = dbMetadata.find(key) == dbMetadata.end() ? Operation::Insert : Operation::Update;
             std::map<std::string, std::string> metadataSql;
-            metadataSql["property_name"] = quote(key);
-            metadataSql["property_value"] = quote(val);
+            metadataSql["property_name"] = key;
+            metadataSql["property_value"] = val;
             operations.push_back(std::make_shared<AddUpdateTable>(METADATA_TABLE, metadataSql, operation));
         }
         for (auto&& [key, val] : dbMetadata) {
             if (dict.find(key) == dict.end()) {
                 // key in db metadata but not obj metadata, so needs a delete
                 std::map<std::string, std::string> metadataSql;
-                metadataSql["property_name"] = quote(key);
-                metadataSql["property_value"] = quote(val);
+                metadataSql["property_name"] = key;
+                metadataSql["property_value"] = val;
                 operations.push_back(std::make_shared<AddUpdateTable>(METADATA_TABLE, metadataSql, Operation::Delete));
             }
         }
@@ -2311,11 +3282,6 @@ std::unique_ptr<std::ostringstream> SQLDatabase::sqlForInsert(const std::shared_
         throw_std_runtime_error("Attempted to insert new object with ID!");
     }
 
-    if (tableName == METADATA_TABLE) {
-        fields << "," << TQ("item_id");
-        values << "," << obj->getID();
-    }
-
     std::ostringstream qb;
     qb << "INSERT INTO " << TQ(tableName) << " (" << fields.str() << ") VALUES (" << values.str() << ')';
 
@@ -2324,8 +3290,7 @@ std::unique_ptr<std::ostringstream> SQLDatabase::sqlForInsert(const std::shared_
 
 std::unique_ptr<std::ostringstream> SQLDatabase::sqlForUpdate(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable) const
 {
-    if (addUpdateTable == nullptr
-        || (addUpdateTable->getTableName() == METADATA_TABLE && addUpdateTable->getDict().size() != 2))
+    if (addUpdateTable == nullptr || addUpdateTable->getTableName() == METADATA_TABLE)
         throw_std_runtime_error("sqlForUpdate called with invalid arguments");
 
     std::string tableName = addUpdateTable->getTableName();
@@ -2339,41 +3304,47 @@ std::unique_ptr<std::ostringstream> SQLDatabase::sqlForUpdate(const std::shared_
         qb << TQ(it->first) << '='
            << it->second;
     }
-
-    // relying on only one element when tableName is mt_metadata
-    if (tableName == METADATA_TABLE) {
-        qb << " WHERE " << TQ("item_id") << " = " << obj->getID();
-        qb << " AND " << TQ("property_name") << " = " << dict.begin()->second;
-    } else {
-        qb << " WHERE " << TQ("id") << " = " << obj->getID();
-    }
+    qb << " WHERE " << TQ("id") << " = " << obj->getID();
 
     return std::make_unique<std::ostringstream>(std::move(qb));
 }
 
+void SQLDatabase::execMetadataOperation(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable)
+{
+    auto dict = addUpdateTable->getDict();
+    const auto& name = dict["property_name"];
+    const auto& value = dict["property_value"];
+
+    switch (addUpdateTable->getOperation()) {
+    case Operation::Insert:
+        execPrepared(sql_meta_insert_query, { obj->getID(), name, value });
+        break;
+    case Operation::Update:
+        execPrepared(sql_meta_update_query, { value, obj->getID(), name });
+        break;
+    case Operation::Delete:
+        execPrepared(sql_meta_delete_query, { obj->getID(), name });
+        break;
+    }
+}
+
 std::unique_ptr<std::ostringstream> SQLDatabase::sqlForDelete(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable) const
 {
-    if (addUpdateTable == nullptr
-        || (addUpdateTable->getTableName() == METADATA_TABLE && addUpdateTable->getDict().size() != 2))
+    if (addUpdateTable == nullptr || addUpdateTable->getTableName() == METADATA_TABLE)
         throw_std_runtime_error("sqlForDelete called with invalid arguments");
 
-    std::string tableName = addUpdateTable->getTableName();
-    auto dict = addUpdateTable->getDict();
-
     std::ostringstream qb;
-    qb << "DELETE FROM " << TQ(tableName);
-
-    // relying on only one element when tableName is mt_metadata
-    if (tableName == METADATA_TABLE) {
-        qb << " WHERE " << TQ("item_id") << " = " << obj->getID();
-        qb << " AND " << TQ("property_name") << " = " << dict.begin()->second;
-    } else {
-        qb << " WHERE " << TQ("id") << " = " << obj->getID();
-    }
+    qb << "DELETE FROM " << TQ(addUpdateTable->getTableName())
+       << " WHERE " << TQ("id") << " = " << obj->getID();
 
     return std::make_unique<std::ostringstream>(std::move(qb));
 }
 
+void SQLDatabase::setFullTextIndex(const std::shared_ptr<FullTextIndex>& fullText)
+{
+    sqlEmitter = std::make_shared<DefaultSQLEmitter>(searchColumnMapper, metaColumnMapper, fullText);
+}
+
 void SQLDatabase::doMetadataMigration()
 {
     log_debug("Checking if metadata migration is required");
@@ -2426,25 +3397,8 @@ void SQLDatabase::migrateMetadata(const std::shared_ptr<CdsObject>& object)
     auto dict = object->getMetadata();
     if (!dict.empty()) {
         log_debug("Migrating metadata for cds object {}", object->getID());
-        std::map<std::string, std::string> metadataSQLVals;
         for (auto&& [key, val] : dict) {
-            metadataSQLVals[quote(key)] = quote(val);
-        }
-
-        for (auto&& [key, val] : metadataSQLVals) {
-            std::ostringstream fields, values;
-            fields << TQ("item_id") << ','
-                   << TQ("property_name") << ','
-                   << TQ("property_value");
-            values << object->getID() << ','
-                   << key << ','
-                   << val;
-            std::ostringstream qb;
-            qb << "INSERT INTO " << TQ(METADATA_TABLE)
-               << " (" << fields.str()
-               << ") VALUES (" << values.str() << ')';
-
-            exec(qb.str());
+            execPrepared(sql_meta_insert_query, { object->getID(), key, val });
         }
     } else {
         log_debug("Skipping migration - no metadata for cds object {}", object->getID());
@@ -32,16 +32,25 @@
 #ifndef __SQL_STORAGE_H__
 #define __SQL_STORAGE_H__
 
+#include <atomic>
+#include <cstdlib>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <sstream>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <variant>
 
+#include "common.h"
 #include "database.h"
 
 // forward declaration
 class SQLResult;
 class SQLEmitter;
+struct FullTextIndex;
 
 #define QTB table_quote_begin
 #define QTE table_quote_end
@@ -51,31 +60,55 @@ class SQLEmitter;
 #define AUTOSCAN_TABLE "mt_autoscan"
 #define METADATA_TABLE "mt_metadata"
 #define CONFIG_VALUE_TABLE "grb_config_value"
+#define METADATA_CACHE_TABLE "grb_metadata_cache"
+#define DIRECTORY_STATE_TABLE "grb_directory_state"
+
+// database version that introduced child_count_container and child_count_item
+#define CHILD_COUNT_DB_VERSION 11
 
 class SQLRow {
 public:
     //SQLRow() { }
     //virtual ~SQLRow();
     std::string col(int index) const
+    {
+        return std::string(col_view(index));
+    }
+    virtual char* col_c_str(int index) const = 0;
+    /// \brief column without copy, empty for NULL
+    virtual std::string_view col_view(int index) const
     {
         char* c = col_c_str(index);
         if (c == nullptr)
-            return "";
-        return std::string(c);
+            return {};
+        return c;
+    }
+    /// \brief column as integer, 0 for NULL
+    virtual long long col_int64(int index) const
+    {
+        char* c = col_c_str(index);
+        if (c == nullptr)
+            return 0;
+        return std::strtoll(c, nullptr, 10);
     }
-    virtual char* col_c_str(int index) const = 0;
 
     virtual ~SQLRow() = default;
 };
 
+/// \brief Result of a select
+///
+/// Rows are only valid until the next call of nextRow() and results can be read while
+/// the database is queried, but the callers must not change the rows they are reading.
 class SQLResult {
 public:
     //SQLResult();
     virtual ~SQLResult() = default;
     virtual std::unique_ptr<SQLRow> nextRow() = 0;
-    virtual unsigned long long getNumRows() const = 0;
 };
 
+/// \brief value bound to a '?' placeholder of a prepared statement
+using SQLParam = std::variant<std::nullptr_t, long long, std::string>;
+
 class SQLDatabase : public Database {
 public:
     /* methods to override in subclasses */
@@ -97,6 +130,13 @@ public:
     virtual std::shared_ptr<SQLResult> select(const char* query, int length) = 0;
     virtual int exec(const char* query, int length, bool getLastInsertId = false) = 0;
 
+    /// \brief run a select through the prepared statement cache of the driver
+    /// \param query SQL with '?' placeholders, the text is the cache key so it must not contain literal values
+    /// \param params values for the placeholders in order of appearance
+    virtual std::shared_ptr<SQLResult> selectPrepared(const std::string& query, const std::vector<SQLParam>& params) = 0;
+    /// \brief run an insert, update or delete through the prepared statement cache of the driver
+    virtual int execPrepared(const std::string& query, const std::vector<SQLParam>& params, bool getLastInsertId = false) = 0;
+
     /* wrapper functions for select and exec */
     std::shared_ptr<SQLResult> select(const std::string& buf)
     {
@@ -113,15 +153,19 @@ public:
     }
 
     void addObject(std::shared_ptr<CdsObject> object, int* changedContainer) override;
+    void addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, int* changedContainer) override;
     void updateObject(std::shared_ptr<CdsObject> object, int* changedContainer) override;
 
     std::shared_ptr<CdsObject> loadObject(int objectID) override;
     int getChildCount(int contId, bool containers, bool items, bool hideFsRoot) override;
+    void checkChildCounts() override;
 
     std::unique_ptr<std::unordered_set<int>> getObjects(int parentID, bool withoutContainer) override;
 
     std::unique_ptr<ChangedContainers> removeObject(int objectID, bool all) override;
     std::unique_ptr<ChangedContainers> removeObjects(const std::unique_ptr<std::unordered_set<int>>& list, bool all = false) override;
+    std::unique_ptr<ChangedContainers> moveObject(int objectID, const fs::path& location, const std::string& title, std::vector<int>& movedItems) override;
+    std::unique_ptr<std::unordered_set<int>> getReferences(const std::vector<int>& objectIDs) override;
 
     std::shared_ptr<CdsObject> loadObjectByServiceID(const std::string& serviceID) override;
     std::unique_ptr<std::vector<int>> getServiceObjectIDs(char servicePrefix) override;
@@ -144,6 +188,15 @@ public:
     std::string getInternalSetting(const std::string& key) override;
     void storeInternalSetting(const std::string& key, const std::string& value) override = 0;
 
+    bool loadCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) override;
+    void storeCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) override;
+    std::shared_ptr<CdsObject> findObjectByIdentity(const FileIdentity& identity) override;
+    void pruneMetadataCache() override;
+
+    bool loadDirectoryState(int objectID, DirectoryState& state) override;
+    void storeDirectoryState(int objectID, const DirectoryState& state) override;
+    void pruneDirectoryStates() override;
+
     std::shared_ptr<AutoscanList> getAutoscanList(ScanMode scanmode) override;
     void updateAutoscanList(ScanMode scanmode, std::shared_ptr<AutoscanList> list) override;
 
@@ -176,25 +229,63 @@ protected:
     //virtual ~SQLDatabase();
     void init() override;
 
+    /// \brief id of the first row of a multi-row INSERT
+    /// \param insertId id returned by exec() with getLastInsertId for the statement
+    /// \param rowCount number of rows inserted by the statement
+    virtual int getFirstInsertId(int insertId, int rowCount) const = 0;
+
     void doMetadataMigration() override;
+    /// \brief route string operators of search through a full-text index maintained by the driver
+    void setFullTextIndex(const std::shared_ptr<FullTextIndex>& fullText);
     void migrateMetadata(const std::shared_ptr<CdsObject>& object);
 
     char table_quote_begin;
     char table_quote_end;
     bool use_transaction;
-    bool inTransaction;
+    /// \brief read by other threads to decide where to run their statements
+    std::atomic<bool> inTransaction;
+    /// \brief set by init() when the upgrade to the child count columns ran
+    bool childCountsUpgraded {};
 
     std::recursive_mutex sqlMutex;
     using SqlAutoLock = std::lock_guard<decltype(sqlMutex)>;
 
+    /// \brief incremented by the drivers after each write, invalidates the cached pages of search
+    std::atomic<unsigned long> writeGeneration {};
+    /// \brief invalidate the browse pages of the containers written in the transaction again, called by the drivers after commit and rollback
+    ///
+    /// Other connections only see the changes now, or see them reverted.
+    void finishPageTransaction();
+
 private:
     std::string sql_browse_query;
     std::string sql_search_query;
     std::string sql_meta_query;
 
+    /* prepared statements of the hot paths, built in init() */
+    std::string sql_load_object_query;
+    std::string sql_child_count_query;
+    std::string sql_object_meta_query;
+    std::string sql_meta_insert_query;
+    std::string sql_meta_update_query;
+    std::string sql_meta_delete_query;
+    std::string sql_cache_load_query;
+    std::string sql_cache_store_query;
+    std::string sql_cache_touch_query;
+    std::string sql_dir_state_load_query;
+    std::string sql_dir_state_store_query;
+    std::string sql_cache_identity_query;
+    std::string sql_location_update_query;
+
     std::shared_ptr<CdsObject> createObjectFromRow(const std::unique_ptr<SQLRow>& row);
     std::shared_ptr<CdsObject> createObjectFromSearchRow(const std::unique_ptr<SQLRow>& row);
     std::map<std::string, std::string> retrieveMetadataForObject(int objectId);
+    std::unordered_map<int, std::map<std::string, std::string>> retrieveMetadataForObjects(const std::vector<int>& objectIds);
+
+    /// \brief fetch metadata for all given objects with one query per batch and attach it
+    /// \param objects objects created by createObjectFromRow or createObjectFromSearchRow
+    /// \param useRefId fall back to metadata of the referenced object if the object has none
+    void attachMetadata(const std::vector<std::shared_ptr<CdsObject>>& objects, bool useRefId);
 
     enum class Operation {
         Insert,
@@ -228,10 +319,98 @@ private:
     std::unique_ptr<std::ostringstream> sqlForInsert(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable) const;
     std::unique_ptr<std::ostringstream> sqlForUpdate(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable) const;
     std::unique_ptr<std::ostringstream> sqlForDelete(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable) const;
+    /// \brief run a metadata operation created by generateMetadataDBOperations as prepared statement
+    void execMetadataOperation(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<AddUpdateTable>& addUpdateTable);
+
+    /* in-memory index of the files and directories by db location, loaded on first use */
+    struct PathIndexEntry {
+        int objectID { INVALID_OBJECT_ID };
+        unsigned int objectType {};
+    };
+    /// \brief a path component, locations share the nodes of their parent directories
+    struct PathIndexNode {
+        PathIndexNode* parent {};
+        /// \brief key of the node in the children of parent
+        std::string_view name;
+        std::map<std::string, std::unique_ptr<PathIndexNode>, std::less<>> children;
+        PathIndexEntry file;
+        PathIndexEntry dir;
+    };
+    struct PathIndex {
+        PathIndexNode root;
+        /// \brief node of each object id
+        std::unordered_map<int, PathIndexNode*> nodes;
+
+        /// \brief node of a path, missing nodes are only added if create is set
+        PathIndexNode* find(std::string_view path, bool create);
+        void update(std::string_view dbLocation, int objectID, unsigned int objectType);
+        void remove(int objectID);
+    };
+    /// \brief the index, nullptr until it is loaded
+    std::unique_ptr<PathIndex> pathIndex;
+    /// \brief changes of the database while the index is read, applied to it once it is loaded
+    std::optional<std::vector<std::tuple<std::string, int, unsigned int>>> pathIndexUpdates;
+    std::vector<int> pathIndexRemovals;
+    std::mutex pathIndexMutex;
+    /// \brief held while the index is read, without blocking the updates
+    std::mutex pathIndexLoadMutex;
+
+    /// \brief object id of a file or directory without querying the database
+    int lookupPathIndex(const fs::path& fullpath, bool wasRegularFile);
+    /// \brief read all file and directory locations if the index is not loaded yet
+    void loadPathIndex();
+    /// \brief add or move the entry of an object after it was written to the database
+    void updatePathIndex(const std::shared_ptr<CdsObject>& obj);
+    void updatePathIndex(const std::string& dbLocation, int objectID, unsigned int objectType);
+    void removeFromPathIndex(const std::vector<int32_t>& objectIDs);
+
+    /* keyset pagination of browse and search */
+    struct SortKey {
+        std::string expr;
+        bool desc;
+    };
+    struct PageCache {
+        /// \brief generation of the container for browse, writeGeneration for search
+        unsigned long generation {};
+        /// \brief sql literals of the sort keys of the row before each known starting index
+        std::map<int, std::vector<std::optional<std::string>>> cursors;
+        int totalMatches { -1 };
+    };
+    std::unordered_map<std::string, PageCache> pageCache;
+    /// \brief generation of the browse pages of each written container, not dropped with the pages
+    std::unordered_map<int, unsigned long> containerGenerations;
+    unsigned long lastContainerGeneration {};
+    /// \brief containers written in the running transaction
+    std::unordered_set<int> transactionContainers;
+    std::mutex pageCacheMutex;
+
+    /// \brief generation of the browse pages of a container, read before its first query
+    unsigned long getContainerGeneration(int containerID);
+    /// \brief invalidate the browse pages of a container after its children were written
+    void invalidateContainerPages(int containerID);
+
+    /// \brief get the cache entry for key and drop it if its generation changed, pageCacheMutex must be held
+    PageCache& getPageCache(const std::string& key, unsigned long generation);
+    /// \brief find the nearest known starting index before or at startingIndex
+    /// \return the known starting index or 0 if there is none
+    int findPageCursor(const std::string& key, unsigned long generation, int startingIndex, std::vector<std::optional<std::string>>& cursor);
+    void storePageCursor(const std::string& key, unsigned long generation, int startingIndex, std::vector<std::optional<std::string>> cursor);
+    /// \return cached total matches or -1
+    int findTotalMatches(const std::string& key, unsigned long generation);
+    void storeTotalMatches(const std::string& key, unsigned long generation, int totalMatches);
+    /// \brief condition for all rows sorted after the row with the given sort key literals
+    static std::string keysetCondition(const std::vector<SortKey>& sortKeys, const std::vector<std::optional<std::string>>& cursor);
 
     /* helper for removeObject(s) */
     void _removeObjects(const std::vector<int32_t>& objectIDs);
 
+    /* helpers for persisted child counts */
+    static int calcChildCount(int contId, int containerCount, int itemCount, bool containers, bool items, bool hideFsRoot);
+    void _updateChildCount(int parentID, unsigned int objectType, int delta);
+
+    /* helper for addObjects, inserts the metadata rows of objects that were just added */
+    void _addMetadataRows(const std::vector<std::shared_ptr<CdsObject>>& objects, const std::map<std::shared_ptr<CdsObject>, std::vector<std::map<std::string, std::string>>>& metadataRows);
+
     static std::string toCSV(const std::vector<int>& input);
 
     std::unique_ptr<ChangedContainers> _recursiveRemove(
@@ -19,17 +19,19 @@ CREATE TABLE "mt_cds_object" (
   "service_id" varchar(255) default NULL,
   "bookmark_pos" integer unsigned NOT NULL default 0,
   "last_modified" integer unsigned default NULL,
+  "child_count_container" integer unsigned NOT NULL default 0,
+  "child_count_item" integer unsigned NOT NULL default 0,
   CONSTRAINT "cds_object_ibfk_1" FOREIGN KEY ("ref_id") REFERENCES "mt_cds_object" ("id") ON DELETE CASCADE ON UPDATE CASCADE,
   CONSTRAINT "cds_object_ibfk_2" FOREIGN KEY ("parent_id") REFERENCES "mt_cds_object" ("id") ON DELETE CASCADE ON UPDATE CASCADE
 );
-INSERT INTO "mt_cds_object" VALUES(-1, NULL, -1, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL);
-INSERT INTO "mt_cds_object" VALUES(0, NULL, -1, 1, 'object.container', 'Root', NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL);
-INSERT INTO "mt_cds_object" VALUES(1, NULL, 0, 1, 'object.container', 'PC Directory', NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL);
+INSERT INTO "mt_cds_object" VALUES(-1, NULL, -1, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL, 0, 0);
+INSERT INTO "mt_cds_object" VALUES(0, NULL, -1, 1, 'object.container', 'Root', NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL, 1, 0);
+INSERT INTO "mt_cds_object" VALUES(1, NULL, 0, 1, 'object.container', 'PC Directory', NULL, NULL, NULL, NULL, NULL, 0, NULL, 9, NULL, NULL, NULL, 0, NULL, 0, 0);
 CREATE TABLE "mt_internal_setting" (
   "key" varchar(40) primary key NOT NULL,
   "value" varchar(255) NOT NULL
 );
-INSERT INTO "mt_internal_setting" VALUES('db_version', '10');
+INSERT INTO "mt_internal_setting" VALUES('db_version', '13');
 CREATE TABLE "mt_autoscan" (
   "id" integer primary key,
   "obj_id" integer default NULL,
@@ -57,6 +59,25 @@ CREATE TABLE "grb_config_value" (
   "key" varchar(255) NOT NULL,
   "item_value" varchar(255) NOT NULL,
   "status" varchar(20) NOT NULL);
+CREATE TABLE "grb_metadata_cache" (
+  "device" integer NOT NULL,
+  "inode" integer NOT NULL,
+  "size" integer NOT NULL,
+  "mtime" integer NOT NULL,
+  "location_hash" integer unsigned NOT NULL,
+  "location" text NOT NULL,
+  "mime_type" varchar(40) NOT NULL,
+  "flags" integer unsigned NOT NULL default 0,
+  "metadata" text default NULL,
+  "auxdata" text default NULL,
+  "resources" text default NULL,
+  "last_used" integer NOT NULL,
+  PRIMARY KEY ("device", "inode"));
+CREATE TABLE "grb_directory_state" (
+  "obj_id" integer primary key,
+  "mtime" integer NOT NULL,
+  "digest" integer NOT NULL,
+  CONSTRAINT "grb_directory_state_idfk1" FOREIGN KEY ("obj_id") REFERENCES "mt_cds_object" ("id") ON DELETE CASCADE ON UPDATE CASCADE);
 CREATE INDEX mt_cds_object_ref_id ON mt_cds_object(ref_id);
 CREATE INDEX mt_cds_object_parent_id ON mt_cds_object(parent_id,object_type,dc_title);
 CREATE INDEX mt_object_type ON mt_cds_object(object_type);
@@ -34,8 +34,15 @@
 #include <array>
 
 #include "config/config_manager.h"
+#include "database/search_handler.h"
 
 #define DB_BACKUP_FORMAT "{}.backup"
+#define DB_BACKUP_TEMP_FORMAT "{}.backup.tmp"
+#define SQLITE3_STATEMENT_CACHE_SIZE 64
+#define SQLITE3_RESULT_BATCH_SIZE 1000
+#define SQLITE3_READER_BUSY_TIMEOUT 1000
+// a locked backup step runs again after the transaction of the connection and gives up after this many attempts
+#define SQLITE3_BACKUP_BUSY_RETRIES 100
 
 // updates 1->2
 #define SQLITE3_UPDATE_1_2_1 "DROP INDEX mt_autoscan_obj_id"
@@ -116,9 +123,79 @@ PRAGMA foreign_keys = ON;"
 // updates 9->10: last_modified
 #define SQLITE3_UPDATE_9_10_1 "ALTER TABLE \"mt_cds_object\" ADD \"last_modified\" integer unsigned default NULL"
 
+// updates 10->11: child counts
+#define SQLITE3_UPDATE_10_11_1 "ALTER TABLE \"mt_cds_object\" ADD \"child_count_container\" integer unsigned NOT NULL default 0"
+#define SQLITE3_UPDATE_10_11_2 "ALTER TABLE \"mt_cds_object\" ADD \"child_count_item\" integer unsigned NOT NULL default 0"
+#define SQLITE3_UPDATE_10_11_3 "UPDATE \"mt_cds_object\" SET \
+  \"child_count_container\" = (SELECT COUNT(*) FROM \"mt_cds_object\" c WHERE c.\"parent_id\" = \"mt_cds_object\".\"id\" AND c.\"object_type\" = 1), \
+  \"child_count_item\" = (SELECT COUNT(*) FROM \"mt_cds_object\" c WHERE c.\"parent_id\" = \"mt_cds_object\".\"id\" AND (c.\"object_type\" & 2) = 2) \
+  WHERE \"object_type\" = 1"
+
+// updates 11->12: metadata cache
+#define SQLITE3_UPDATE_11_12_1 "CREATE TABLE \"grb_metadata_cache\" ( \
+  \"device\" integer NOT NULL, \
+  \"inode\" integer NOT NULL, \
+  \"size\" integer NOT NULL, \
+  \"mtime\" integer NOT NULL, \
+  \"location_hash\" integer unsigned NOT NULL, \
+  \"location\" text NOT NULL, \
+  \"mime_type\" varchar(40) NOT NULL, \
+  \"flags\" integer unsigned NOT NULL default 0, \
+  \"metadata\" text default NULL, \
+  \"auxdata\" text default NULL, \
+  \"resources\" text default NULL, \
+  \"last_used\" integer NOT NULL, \
+  PRIMARY KEY (\"device\", \"inode\"))"
+
+// updates 12->13: directory scan state
+#define SQLITE3_UPDATE_12_13_1 "CREATE TABLE \"grb_directory_state\" ( \
+  \"obj_id\" integer primary key, \
+  \"mtime\" integer NOT NULL, \
+  \"digest\" integer NOT NULL, \
+  CONSTRAINT \"grb_directory_state_idfk1\" FOREIGN KEY (\"obj_id\") REFERENCES \"mt_cds_object\" (\"id\") ON DELETE CASCADE ON UPDATE CASCADE)"
+
 #define SQLITE3_UPDATE_VERSION "UPDATE \"mt_internal_setting\" SET \"value\"='{}' WHERE \"key\"='db_version' AND \"value\"='{}'"
 
-static const auto dbUpdates = std::array<std::vector<const char*>, 9> { {
+// optional full-text index on titles and metadata values, kept in sync by triggers
+#define SQLITE3_FTS_EXISTS "SELECT COUNT(*) FROM \"sqlite_master\" WHERE \"type\"='trigger' AND \"name\" IN ('grb_cds_object_fts_insert', 'grb_metadata_fts_insert')"
+#define SQLITE3_FTS_CHECK "SELECT \"rowid\" FROM \"grb_cds_object_fts\" LIMIT 1"
+
+static const auto ftsCreate = std::vector<const char*> {
+    "CREATE VIRTUAL TABLE IF NOT EXISTS \"grb_cds_object_fts\" USING fts5(\"dc_title\", content='mt_cds_object', content_rowid='id', tokenize='trigram')",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_cds_object_fts_insert\" AFTER INSERT ON \"mt_cds_object\" BEGIN \
+INSERT INTO \"grb_cds_object_fts\"(\"rowid\", \"dc_title\") VALUES (new.\"id\", new.\"dc_title\"); END",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_cds_object_fts_delete\" AFTER DELETE ON \"mt_cds_object\" BEGIN \
+INSERT INTO \"grb_cds_object_fts\"(\"grb_cds_object_fts\", \"rowid\", \"dc_title\") VALUES ('delete', old.\"id\", old.\"dc_title\"); END",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_cds_object_fts_update\" AFTER UPDATE OF \"dc_title\" ON \"mt_cds_object\" WHEN old.\"dc_title\" IS NOT new.\"dc_title\" BEGIN \
+INSERT INTO \"grb_cds_object_fts\"(\"grb_cds_object_fts\", \"rowid\", \"dc_title\") VALUES ('delete', old.\"id\", old.\"dc_title\"); \
+INSERT INTO \"grb_cds_object_fts\"(\"rowid\", \"dc_title\") VALUES (new.\"id\", new.\"dc_title\"); END",
+    "CREATE VIRTUAL TABLE IF NOT EXISTS \"grb_metadata_fts\" USING fts5(\"property_value\", content='mt_metadata', content_rowid='id', tokenize='trigram')",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_metadata_fts_insert\" AFTER INSERT ON \"mt_metadata\" BEGIN \
+INSERT INTO \"grb_metadata_fts\"(\"rowid\", \"property_value\") VALUES (new.\"id\", new.\"property_value\"); END",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_metadata_fts_delete\" AFTER DELETE ON \"mt_metadata\" BEGIN \
+INSERT INTO \"grb_metadata_fts\"(\"grb_metadata_fts\", \"rowid\", \"property_value\") VALUES ('delete', old.\"id\", old.\"property_value\"); END",
+    "CREATE TRIGGER IF NOT EXISTS \"grb_metadata_fts_update\" AFTER UPDATE OF \"property_value\" ON \"mt_metadata\" WHEN old.\"property_value\" IS NOT new.\"property_value\" BEGIN \
+INSERT INTO \"grb_metadata_fts\"(\"grb_metadata_fts\", \"rowid\", \"property_value\") VALUES ('delete', old.\"id\", old.\"property_value\"); \
+INSERT INTO \"grb_metadata_fts\"(\"rowid\", \"property_value\") VALUES (new.\"id\", new.\"property_value\"); END",
+    "INSERT INTO \"grb_cds_object_fts\"(\"grb_cds_object_fts\") VALUES ('rebuild')",
+    "INSERT INTO \"grb_metadata_fts\"(\"grb_metadata_fts\") VALUES ('rebuild')",
+};
+
+// the tables are kept if the fts5 module is missing, because they can not be dropped without it
+static const auto ftsDropTriggers = std::vector<const char*> {
+    "DROP TRIGGER IF EXISTS \"grb_cds_object_fts_insert\"",
+    "DROP TRIGGER IF EXISTS \"grb_cds_object_fts_delete\"",
+    "DROP TRIGGER IF EXISTS \"grb_cds_object_fts_update\"",
+    "DROP TRIGGER IF EXISTS \"grb_metadata_fts_insert\"",
+    "DROP TRIGGER IF EXISTS \"grb_metadata_fts_delete\"",
+    "DROP TRIGGER IF EXISTS \"grb_metadata_fts_update\"",
+};
+static const auto ftsDropTables = std::vector<const char*> {
+    "DROP TABLE IF EXISTS \"grb_cds_object_fts\"",
+    "DROP TABLE IF EXISTS \"grb_metadata_fts\"",
+};
+
+static const auto dbUpdates = std::array<std::vector<const char*>, 12> { {
     { SQLITE3_UPDATE_1_2_1, SQLITE3_UPDATE_1_2_2, SQLITE3_UPDATE_1_2_3 },
     { SQLITE3_UPDATE_2_3_1, SQLITE3_UPDATE_2_3_2 },
     { SQLITE3_UPDATE_3_4_1, SQLITE3_UPDATE_3_4_2 },
@@ -128,6 +205,9 @@ static const auto dbUpdates = std::array<std::vector<const char*>, 9> { {
     { SQLITE3_UPDATE_7_8_1, SQLITE3_UPDATE_7_8_2, SQLITE3_UPDATE_7_8_3 },
     { SQLITE3_UPDATE_8_9_1 },
     { SQLITE3_UPDATE_9_10_1 },
+    { SQLITE3_UPDATE_10_11_1, SQLITE3_UPDATE_10_11_2, SQLITE3_UPDATE_10_11_3 },
+    { SQLITE3_UPDATE_11_12_1 },
+    { SQLITE3_UPDATE_12_13_1 },
 } };
 
 Sqlite3Database::Sqlite3Database(std::shared_ptr<Config> config, std::shared_ptr<Timer> timer)
@@ -144,7 +224,11 @@ Sqlite3Database::Sqlite3Database(std::shared_ptr<Config> config, std::shared_ptr
 
 void Sqlite3Database::prepare()
 {
-    _exec("PRAGMA locking_mode = EXCLUSIVE");
+    // the reader pool needs the shared memory index of the WAL, which exclusive locking mode does not create
+    if (config->getIntOption(CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS) > 0)
+        _exec("PRAGMA locking_mode = NORMAL");
+    else
+        _exec("PRAGMA locking_mode = EXCLUSIVE");
     _exec("PRAGMA foreign_keys = ON");
     _exec("PRAGMA journal_mode = WAL;");
     SQLDatabase::exec(fmt::format("PRAGMA synchronous = {}", config->getIntOption(CFG_SERVER_STORAGE_SQLITE_SYNCHRONOUS)));
@@ -243,6 +327,8 @@ void Sqlite3Database::init()
                     _exec(upgradeCmd);
                 }
                 _exec(fmt::format(SQLITE3_UPDATE_VERSION, version + 1, version).c_str());
+                if (version + 1 == CHILD_COUNT_DB_VERSION)
+                    childCountsUpgraded = true;
                 dbVersion = fmt::to_string(version + 1);
                 log_info("Database upgrade to version {} successful.", dbVersion.c_str());
             }
@@ -252,6 +338,8 @@ void Sqlite3Database::init()
         if (dbVersion != fmt::to_string(version))
             throw_std_runtime_error("The database seems to be from a newer version");
 
+        initFullTextSearch();
+
         if (config->getBoolOption(CFG_SERVER_STORAGE_SQLITE_BACKUP_ENABLED)) {
             // do a backup now
             auto btask = std::make_shared<SLBackupTask>(config, false);
@@ -263,6 +351,7 @@ void Sqlite3Database::init()
             timer->addTimerSubscriber(this, backupInterval, nullptr);
             hasBackupTimer = true;
         }
+        startReaders();
         dbInitDone = true;
     } catch (const std::runtime_error& e) {
         log_error("prematurely shutting down.");
@@ -271,6 +360,51 @@ void Sqlite3Database::init()
     }
 }
 
+void Sqlite3Database::initFullTextSearch()
+{
+    auto res = SQLDatabase::select(SQLITE3_FTS_EXISTS);
+    std::unique_ptr<SQLRow> row;
+    bool exists = (res != nullptr && (row = res->nextRow()) != nullptr && row->col_int64(0) > 0);
+    row = nullptr;
+    res = nullptr;
+
+    if (!config->getBoolOption(CFG_SERVER_STORAGE_FULLTEXT_SEARCH)) {
+        if (exists) {
+            log_info("Removing full-text search index");
+            for (auto&& cmd : ftsDropTriggers)
+                _exec(cmd);
+            for (auto&& cmd : ftsDropTables)
+                _exec(cmd);
+        }
+        return;
+    }
+
+    try {
+        if (exists) {
+            _exec(SQLITE3_FTS_CHECK);
+        } else {
+            log_info("Creating full-text search index...");
+            for (auto&& cmd : ftsCreate)
+                _exec(cmd);
+            log_info("Full-text search index created");
+        }
+    } catch (const std::runtime_error& e) {
+        log_warning("Full-text search is not available, sqlite3 needs fts5 with the trigram tokenizer: {}", e.what());
+        for (auto&& cmd : ftsDropTriggers)
+            _exec(cmd);
+        return;
+    }
+
+    auto fullText = std::make_shared<FullTextIndex>();
+    fullText->titleContains = "{0} IN (SELECT \"rowid\" FROM \"grb_cds_object_fts\" WHERE \"dc_title\" LIKE '%{2}%')";
+    fullText->titleStartsWith = "{0} IN (SELECT \"rowid\" FROM \"grb_cds_object_fts\" WHERE \"dc_title\" LIKE '{2}%')";
+    fullText->metaContains = "{0} IN (SELECT \"rowid\" FROM \"grb_metadata_fts\" WHERE \"property_value\" LIKE '%{2}%')";
+    fullText->metaStartsWith = "{0} IN (SELECT \"rowid\" FROM \"grb_metadata_fts\" WHERE \"property_value\" LIKE '{2}%')";
+    // trigram tokenizer
+    fullText->minLength = 3;
+    setFullTextIndex(fullText);
+}
+
 std::shared_ptr<Database> Sqlite3Database::getSelf()
 {
     return shared_from_this();
@@ -278,7 +412,7 @@ std::shared_ptr<Database> Sqlite3Database::getSelf()
 
 void Sqlite3Database::_exec(const char* query)
 {
-    exec(query, strlen(query), false);
+    runExecTask(query, false);
 }
 
 std::string Sqlite3Database::quote(std::string value) const
@@ -298,39 +432,55 @@ std::string Sqlite3Database::getError(const std::string& query, const std::strin
 void Sqlite3Database::beginTransaction(const std::string_view& tName)
 {
     if (use_transaction) {
-        log_debug("BEGIN TRANSACTION {} {}", tName, inTransaction);
+        log_debug("BEGIN TRANSACTION {} {}", tName, inTransaction.load());
         SqlAutoLock lock(sqlMutex);
         StdThreadRunner::waitFor(
             fmt::format("SqliteDatabase.begin {}", tName), [this] { return !inTransaction; }, 100);
         inTransaction = true;
+        transactionOwner = std::this_thread::get_id();
         _exec("BEGIN TRANSACTION");
+        transactionGeneration = writeGeneration;
     }
 }
 
 void Sqlite3Database::rollback(const std::string_view& tName)
 {
     if (use_transaction && inTransaction) {
-        log_debug("ROLLBACK {} {}", tName, inTransaction);
+        log_debug("ROLLBACK {} {}", tName, inTransaction.load());
         _exec("ROLLBACK");
         inTransaction = false;
+        transactionOwner = std::thread::id();
+        // the changes of the transaction are gone
+        if (writeGeneration != transactionGeneration)
+            writeGeneration++;
+        finishPageTransaction();
     }
 }
 
 void Sqlite3Database::commit(const std::string_view& tName)
 {
     if (use_transaction && inTransaction) {
-        log_debug("COMMIT {} {}", tName, inTransaction);
+        log_debug("COMMIT {} {}", tName, inTransaction.load());
         _exec("COMMIT");
         inTransaction = false;
+        transactionOwner = std::thread::id();
+        // the readers only see the changes of the transaction now
+        if (writeGeneration != transactionGeneration)
+            writeGeneration++;
+        finishPageTransaction();
     }
 }
 
 std::shared_ptr<SQLResult> Sqlite3Database::select(const char* query, int length)
 {
     try {
-        log_debug("Adding select to Queue: {}", query);
+        bool readOnly = useReaders();
+        log_debug("Adding select to {}Queue: {}", readOnly ? "read " : "", query);
         auto stask = std::make_shared<SLSelectTask>(query);
-        addTask(stask);
+        if (readOnly)
+            addReadTask(stask);
+        else
+            addTask(stask);
         stask->waitForTask();
         return stask->getResult();
     } catch (const std::runtime_error& e) {
@@ -344,6 +494,13 @@ std::shared_ptr<SQLResult> Sqlite3Database::select(const char* query, int length
 }
 
 int Sqlite3Database::exec(const char* query, int length, bool getLastInsertId)
+{
+    auto insertId = runExecTask(query, getLastInsertId);
+    writeGeneration++;
+    return insertId;
+}
+
+int Sqlite3Database::runExecTask(const char* query, bool getLastInsertId)
 {
     try {
         log_debug("Adding query to Queue: {}", query);
@@ -361,6 +518,113 @@ int Sqlite3Database::exec(const char* query, int length, bool getLastInsertId)
     }
 }
 
+std::shared_ptr<SQLResult> Sqlite3Database::selectPrepared(const std::string& query, const std::vector<SQLParam>& params)
+{
+    bool readOnly = useReaders();
+    log_debug("Adding prepared select to {}Queue: {}", readOnly ? "read " : "", query);
+    auto stask = std::make_shared<SLStatementTask>(query, params, true, false);
+    runStatementTask(stask, readOnly);
+    return stask->getResult();
+}
+
+int Sqlite3Database::execPrepared(const std::string& query, const std::vector<SQLParam>& params, bool getLastInsertId)
+{
+    log_debug("Adding prepared query to Queue: {}", query);
+    auto etask = std::make_shared<SLStatementTask>(query, params, false, getLastInsertId);
+    runStatementTask(etask, false);
+    writeGeneration++;
+    return getLastInsertId ? etask->getLastInsertId() : -1;
+}
+
+void Sqlite3Database::runStatementTask(const std::shared_ptr<SLStatementTask>& task, bool readOnly)
+{
+    try {
+        if (readOnly)
+            addReadTask(task);
+        else
+            addTask(task);
+        task->waitForTask();
+    } catch (const std::runtime_error& e) {
+        if (dbInitDone) {
+            log_error("prematurely shutting down.");
+            rollback("");
+            shutdown();
+        }
+        throw_std_runtime_error(e.what());
+    }
+}
+
+sqlite3_stmt* Sqlite3Database::getStatement(sqlite3* db, const std::string& query)
+{
+    auto reader = getReader(db);
+    auto cache = reader != nullptr ? &reader->statementCache : &statementCache;
+
+    auto entry = cache->find(query);
+    if (entry != cache->end())
+        return entry->second;
+
+    // the callers use a fixed set of query shapes, so this only protects against misuse
+    if (cache->size() >= SQLITE3_STATEMENT_CACHE_SIZE)
+        clearStatementCache(*cache);
+
+    sqlite3_stmt* stmt = nullptr;
+    int ret = sqlite3_prepare_v3(db, query.c_str(), query.size() + 1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+    if (ret != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        throw DatabaseException("", getError(query, "prepare failed", db, ret));
+    }
+    (*cache)[query] = stmt;
+    return stmt;
+}
+
+void Sqlite3Database::clearStatementCache(std::unordered_map<std::string, sqlite3_stmt*>& cache)
+{
+    for (auto&& [query, stmt] : cache) {
+        sqlite3_finalize(stmt);
+    }
+    cache.clear();
+}
+
+void Sqlite3Database::closeAbandonedCursors()
+{
+    std::vector<int> abandoned;
+    {
+        std::lock_guard<decltype(abandonedCursorsMutex)> lock(abandonedCursorsMutex);
+        abandoned.swap(abandonedCursors);
+    }
+    for (auto&& cursorId : abandoned) {
+        auto cursor = cursors.find(cursorId);
+        if (cursor != cursors.end()) {
+            sqlite3_finalize(cursor->second.stmt);
+            cursors.erase(cursor);
+        }
+    }
+}
+
+void Sqlite3Database::drainCursors(sqlite3* db)
+{
+    for (auto&& [cursorId, cursor] : getCursors(db)) {
+        if (cursor.stmt == nullptr)
+            continue;
+        cursor.rest = std::make_shared<Sqlite3Result>(this);
+        int ret = cursor.rest->fetchBatch(cursor.stmt, 0);
+        if (ret != SQLITE_DONE)
+            cursor.error = getError(sqlite3_sql(cursor.stmt), "", db, ret);
+        sqlite3_finalize(cursor.stmt);
+        cursor.stmt = nullptr;
+    }
+}
+
+void Sqlite3Database::finalizeStatements()
+{
+    clearStatementCache(statementCache);
+    // results that are still read will fail on their next batch
+    for (auto&& [cursorId, cursor] : cursors) {
+        sqlite3_finalize(cursor.stmt);
+    }
+    cursors.clear();
+}
+
 void* Sqlite3Database::staticThreadProc(void* arg)
 {
     log_debug("Sqlite3Database::staticThreadProc - running thread");
@@ -397,31 +661,53 @@ void Sqlite3Database::threadProc()
             taskQueue.pop();
 
             lock.unlock();
+            closeAbandonedCursors();
             try {
+                if (task->isWrite())
+                    drainCursors(db);
                 task->run(&db, this);
                 if (task->didContamination())
                     dirty = true;
                 else if (task->didDecontamination())
                     dirty = false;
+                if (task->needsRequeue()) {
+                    lock.lock();
+                    if (task->waitsForTransaction() && !sqlite3_get_autocommit(db))
+                        parkedTasks.push_back(task);
+                    else
+                        taskQueue.push(task);
+                    continue;
+                }
                 task->sendSignal();
             } catch (const std::runtime_error& e) {
                 task->sendSignal(e.what());
             }
             lock.lock();
+            if (!parkedTasks.empty() && sqlite3_get_autocommit(db)) {
+                // the transaction is finished, the parked tasks go behind the pending ones
+                for (auto&& parked : parkedTasks)
+                    taskQueue.push(parked);
+                parkedTasks.clear();
+            }
         }
 
-        /* if nothing to do, sleep until awakened */
-        threadRunner->wait(lock);
+        /* if nothing to do, sleep until awakened, shutdown may have been signalled while a task ran */
+        threadRunner->wait(lock, [this] { return shutdownFlag || !taskQueue.empty(); });
     }
     log_debug("Sqlite3Database::threadProc - exiting");
 
     taskQueueOpen = false;
+    for (auto&& parked : parkedTasks)
+        taskQueue.push(parked);
+    parkedTasks.clear();
     while (!taskQueue.empty()) {
         auto task = taskQueue.front();
         taskQueue.pop();
+        task->cancel();
         task->sendSignal("Sorry, sqlite3 thread is shutting down");
     }
 
+    finalizeStatements();
     if (db) {
         log_debug("Sqlite3Database::staticThreadProc - closing database");
         if (sqlite3_close(db) == SQLITE_OK) {
@@ -450,6 +736,85 @@ void Sqlite3Database::addTask(const std::shared_ptr<SLTask>& task, bool onlyIfDi
     }
 }
 
+void Sqlite3Database::startReaders()
+{
+    int count = config->getIntOption(CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS);
+    if (count <= 0)
+        return;
+
+    readQueueOpen = true;
+    std::vector<std::unique_ptr<Sqlite3Reader>> pool;
+    bool failed = false;
+    for (int i = 0; i < count; i++) {
+        auto reader = std::make_unique<Sqlite3Reader>(this, config, i);
+        reader->threadRunner->waitForReady();
+        failed = failed || reader->db == nullptr;
+        pool.push_back(std::move(reader));
+    }
+
+    if (failed) {
+        {
+            std::lock_guard<decltype(readMutex)> lock(readMutex);
+            readQueueOpen = false;
+        }
+        readCond.notify_all();
+        for (auto&& reader : pool) {
+            reader->threadRunner->join();
+        }
+        log_warning("Could not open all sqlite3 read connections, using the main connection only");
+        return;
+    }
+
+    readers = std::move(pool);
+    log_info("Using {} sqlite3 read connections", readers.size());
+}
+
+bool Sqlite3Database::useReaders() const
+{
+    // a thread inside its own transaction needs to see its uncommitted changes
+    return !readers.empty() && !(inTransaction && transactionOwner == std::this_thread::get_id());
+}
+
+void Sqlite3Database::addReadTask(const std::shared_ptr<SLTask>& task)
+{
+    {
+        std::lock_guard<decltype(readMutex)> lock(readMutex);
+        if (!readQueueOpen) {
+            throw_std_runtime_error("sqlite3 read queue is already closed");
+        }
+        readQueue.push(task);
+    }
+    readCond.notify_one();
+}
+
+void Sqlite3Database::addFetchTask(Sqlite3Reader* reader, const std::shared_ptr<SLTask>& task)
+{
+    {
+        std::lock_guard<decltype(readMutex)> lock(readMutex);
+        if (!readQueueOpen) {
+            throw_std_runtime_error("sqlite3 read queue is already closed");
+        }
+        reader->fetchQueue.push(task);
+    }
+    // only the owner of the connection can run the task
+    readCond.notify_all();
+}
+
+Sqlite3Reader* Sqlite3Database::getReader(sqlite3* db) const
+{
+    for (auto&& reader : readers) {
+        if (reader->db == db)
+            return reader.get();
+    }
+    return nullptr;
+}
+
+std::unordered_map<int, Sqlite3Cursor>& Sqlite3Database::getCursors(sqlite3* db)
+{
+    auto reader = getReader(db);
+    return reader != nullptr ? reader->cursors : cursors;
+}
+
 void Sqlite3Database::shutdownDriver()
 {
     log_debug("start");
@@ -464,6 +829,15 @@ void Sqlite3Database::shutdownDriver()
         lock.unlock();
         log_debug("waiting for thread");
         threadRunner->join();
+
+        {
+            std::lock_guard<decltype(readMutex)> readLock(readMutex);
+            readQueueOpen = false;
+        }
+        readCond.notify_all();
+        for (auto&& reader : readers) {
+            reader->threadRunner->join();
+        }
     }
     log_debug("end");
 }
@@ -523,6 +897,7 @@ void SLInitTask::run(sqlite3** db, Sqlite3Database* sl)
     log_debug("Running: init");
     std::string dbFilePath = config->getOption(CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE);
 
+    sl->finalizeStatements();
     sqlite3_close(*db);
 
     int res = sqlite3_open(dbFilePath.c_str(), db);
@@ -561,28 +936,26 @@ SLSelectTask::SLSelectTask(const char* query)
 void SLSelectTask::run(sqlite3** db, Sqlite3Database* sl)
 {
     log_debug("Running: {}", query);
-    pres = std::make_shared<Sqlite3Result>();
-
-    char* err = nullptr;
-    int ret = sqlite3_get_table(
-        *db,
-        query,
-        &pres->table,
-        &pres->nrow,
-        &pres->ncolumn,
-        &err);
-    std::string error;
-    if (err != nullptr) {
-        log_debug(err);
-        error = err;
-        sqlite3_free(err);
+    sqlite3_stmt* stmt = nullptr;
+    int ret = sqlite3_prepare_v2(*db, query, -1, &stmt, nullptr);
+    if (ret == SQLITE_OK) {
+        pres = std::make_shared<Sqlite3Result>(sl);
+        ret = pres->fetchBatch(stmt, SQLITE3_RESULT_BATCH_SIZE);
     }
-    if (ret != SQLITE_OK) {
-        throw DatabaseException("", sl->getError(query, error, *db, ret));
+    if (ret == SQLITE_ROW) {
+        // keep the statement for the next batch, a reader keeps the snapshot of the database until it is finished
+        pres->cursorId = ++sl->lastCursorId;
+        pres->reader = sl->getReader(*db);
+        sl->getCursors(*db)[pres->cursorId].stmt = stmt;
+        return;
     }
 
-    pres->row = pres->table;
-    pres->cur_row = 0;
+    std::string error;
+    if (ret != SQLITE_DONE)
+        error = sl->getError(query, "", *db, ret);
+    sqlite3_finalize(stmt);
+    if (ret != SQLITE_DONE)
+        throw DatabaseException("", error);
 }
 
 /* SLExecTask */
@@ -616,31 +989,170 @@ void SLExecTask::run(sqlite3** db, Sqlite3Database* sl)
     contamination = true;
 }
 
+/* SLStatementTask */
+
+SLStatementTask::SLStatementTask(std::string query, std::vector<SQLParam> params, bool isSelect, bool getLastInsertId)
+    : query(std::move(query))
+    , params(std::move(params))
+    , isSelect(isSelect)
+    , getLastInsertIdFlag(getLastInsertId)
+{
+}
+
+void SLStatementTask::run(sqlite3** db, Sqlite3Database* sl)
+{
+    log_debug("Running: {}", query);
+    auto stmt = sl->getStatement(*db, query);
+
+    int ret = SQLITE_OK;
+    int index = 1;
+    for (auto&& param : params) {
+        if (auto number = std::get_if<long long>(&param))
+            ret = sqlite3_bind_int64(stmt, index, *number);
+        else if (auto text = std::get_if<std::string>(&param))
+            ret = sqlite3_bind_text(stmt, index, text->c_str(), text->size(), SQLITE_STATIC);
+        else
+            ret = sqlite3_bind_null(stmt, index);
+        if (ret != SQLITE_OK)
+            break;
+        index++;
+    }
+
+    if (ret == SQLITE_OK && isSelect) {
+        // cached statements are reset below, so all rows are read at once
+        pres = std::make_shared<Sqlite3Result>(sl);
+        ret = pres->fetchBatch(stmt, 0);
+    } else if (ret == SQLITE_OK) {
+        while ((ret = sqlite3_step(stmt)) == SQLITE_ROW)
+            ;
+    }
+
+    // the statement stays in the cache, so it has to be reset in any case
+    std::string error;
+    if (ret != SQLITE_DONE)
+        error = sl->getError(query, "", *db, ret);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (ret != SQLITE_DONE)
+        throw DatabaseException("", error);
+
+    if (!isSelect) {
+        if (getLastInsertIdFlag)
+            lastInsertId = sqlite3_last_insert_rowid(*db);
+        contamination = true;
+    }
+}
+
+/* SLFetchTask */
+
+SLFetchTask::SLFetchTask(Sqlite3Result* pres)
+    : pres(pres)
+{
+}
+
+void SLFetchTask::run(sqlite3** db, Sqlite3Database* sl)
+{
+    auto&& cursors = sl->getCursors(*db);
+    auto cursor = cursors.find(pres->cursorId);
+    if (cursor == cursors.end()) {
+        pres->cursorId = -1;
+        pres->nrow = 0;
+        throw DatabaseException("", "SQLITE3: database was closed while reading a result");
+    }
+
+    if (cursor->second.stmt == nullptr) {
+        // a write came in between, the remaining rows were read before it
+        auto rest = std::move(cursor->second.rest);
+        auto error = std::move(cursor->second.error);
+        cursors.erase(cursor);
+        pres->cursorId = -1;
+        if (!error.empty()) {
+            pres->nrow = 0;
+            throw DatabaseException("", error);
+        }
+        pres->nrow = rest->nrow;
+        pres->cur_row = 0;
+        pres->cells = std::move(rest->cells);
+        pres->text = std::move(rest->text);
+        return;
+    }
+
+    auto stmt = cursor->second.stmt;
+    int ret = pres->fetchBatch(stmt, SQLITE3_RESULT_BATCH_SIZE);
+    if (ret == SQLITE_ROW)
+        return;
+
+    std::string error;
+    if (ret != SQLITE_DONE)
+        error = sl->getError(sqlite3_sql(stmt), "", *db, ret);
+    sqlite3_finalize(stmt);
+    cursors.erase(cursor);
+    pres->cursorId = -1;
+    if (ret != SQLITE_DONE)
+        throw DatabaseException("", error);
+}
+
 /* SLBackupTask */
 SLBackupTask::SLBackupTask(std::shared_ptr<Config> config, bool restore)
     : config(std::move(config))
     , restore(restore)
 {
+    dbFilePath = this->config->getOption(CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE);
+    tempFilePath = fmt::format(DB_BACKUP_TEMP_FORMAT, dbFilePath);
+}
+
+SLBackupTask::~SLBackupTask()
+{
+    if (backup != nullptr)
+        sqlite3_backup_finish(backup);
+    if (backupDb != nullptr)
+        sqlite3_close(backupDb);
 }
 
 void SLBackupTask::run(sqlite3** db, Sqlite3Database* sl)
 {
     log_debug("Running: backup");
-    std::string dbFilePath = config->getOption(CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE);
 
     if (!restore) {
-        try {
-            fs::copy(
-                dbFilePath,
-                fmt::format(DB_BACKUP_FORMAT, dbFilePath),
-                fs::copy_options::overwrite_existing);
-            log_debug("sqlite3 backup successful");
-            decontamination = true;
-        } catch (const std::runtime_error& e) {
-            log_error("error while making sqlite3 backup: {}", e.what());
+        requeue = false;
+        waitForTransaction = false;
+        if (backup == nullptr) {
+            if (sl->backupRunning) {
+                log_debug("sqlite3 backup is already running");
+                return;
+            }
+            startBackup(*db, sl);
+            if (backup == nullptr)
+                return;
+        }
+
+        int ret = sqlite3_backup_step(backup, config->getIntOption(CFG_SERVER_STORAGE_SQLITE_BACKUP_STEP_PAGES));
+        if (ret == SQLITE_BUSY || ret == SQLITE_LOCKED) {
+            // a write transaction of the connection is running, the other tasks have to finish it first
+            if (++busyRetries > SQLITE3_BACKUP_BUSY_RETRIES) {
+                log_error("error while making sqlite3 backup: database stayed locked");
+                finishBackup(false);
+                return;
+            }
+            requeue = true;
+            waitForTransaction = true;
+            return;
         }
+        if (ret == SQLITE_OK) {
+            log_debug("sqlite3 backup: {} of {} pages remaining", sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+            busyRetries = 0;
+            requeue = true;
+            return;
+        }
+        if (ret != SQLITE_DONE) {
+            log_error("error while making sqlite3 backup: {}", sqlite3_errstr(ret));
+            finishBackup(false);
+            return;
+        }
+        finishBackup(true);
     } else {
         log_info("trying to restore sqlite3 database from backup...");
+        sl->finalizeStatements();
         sqlite3_close(*db);
         try {
             fs::copy(
@@ -658,33 +1170,248 @@ void SLBackupTask::run(sqlite3** db, Sqlite3Database* sl)
     }
 }
 
+void SLBackupTask::startBackup(sqlite3* db, Sqlite3Database* sl)
+{
+    database = sl;
+    std::error_code ec;
+    fs::remove(tempFilePath, ec);
+    if (sqlite3_open(tempFilePath.c_str(), &backupDb) != SQLITE_OK) {
+        log_error("error while making sqlite3 backup: could not open {}: {}", tempFilePath, sqlite3_errmsg(backupDb));
+        finishBackup(false);
+        return;
+    }
+    backup = sqlite3_backup_init(backupDb, "main", db, "main");
+    if (backup == nullptr) {
+        log_error("error while making sqlite3 backup: {}", sqlite3_errmsg(backupDb));
+        finishBackup(false);
+        return;
+    }
+    sl->backupRunning = true;
+    startTime = currentTimeMS();
+}
+
+void SLBackupTask::finishBackup(bool complete)
+{
+    int pages = backup != nullptr ? sqlite3_backup_pagecount(backup) : 0;
+    if (backup != nullptr) {
+        sqlite3_backup_finish(backup);
+        backup = nullptr;
+        database->backupRunning = false;
+    }
+    if (backupDb != nullptr) {
+        sqlite3_close(backupDb);
+        backupDb = nullptr;
+    }
+
+    std::error_code ec;
+    if (complete) {
+        fs::rename(tempFilePath, fmt::format(DB_BACKUP_FORMAT, dbFilePath), ec);
+        if (!ec) {
+            log_info("sqlite3 backup of {} pages successful, took {} ms", pages, getDeltaMillis(startTime).count());
+            decontamination = true;
+            return;
+        }
+        log_error("error while making sqlite3 backup: {}", ec.message());
+    }
+    fs::remove(tempFilePath, ec);
+}
+
+void SLBackupTask::cancel()
+{
+    if (backup != nullptr) {
+        log_info("sqlite3 backup cancelled");
+        finishBackup(false);
+    }
+}
+
+/* Sqlite3Reader */
+
+Sqlite3Reader::Sqlite3Reader(Sqlite3Database* sl, std::shared_ptr<Config> config, int index)
+    : sl(sl)
+    , config(std::move(config))
+{
+    threadRunner = std::make_unique<StdThreadRunner>(fmt::format("SQLiteReader{}", index), Sqlite3Reader::staticThreadProc, this, this->config);
+}
+
+void* Sqlite3Reader::staticThreadProc(void* arg)
+{
+    auto inst = static_cast<Sqlite3Reader*>(arg);
+    try {
+        inst->threadProc();
+    } catch (const std::runtime_error& e) {
+        log_error("Sqlite3Reader::staticThreadProc - aborting thread");
+    }
+    return nullptr;
+}
+
+void Sqlite3Reader::threadProc()
+{
+    std::string dbFilePath = config->getOption(CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE);
+    if (sqlite3_open_v2(dbFilePath.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        log_error("Sqlite3Reader: could not open '{}': {}", dbFilePath, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = nullptr;
+    } else {
+        sqlite3_busy_timeout(db, SQLITE3_READER_BUSY_TIMEOUT);
+    }
+
+    StdThreadRunner::waitFor("Sqlite3Reader", [this] { return threadRunner != nullptr; });
+    {
+        auto lock = threadRunner->uniqueLockS("threadProc");
+        threadRunner->setReady();
+    }
+    if (db == nullptr)
+        return;
+
+    while (true) {
+        std::unique_lock<decltype(sl->readMutex)> lock(sl->readMutex);
+        sl->readCond.wait(lock, [this] { return !fetchQueue.empty() || !abandonedCursors.empty() || !sl->readQueue.empty() || !sl->readQueueOpen; });
+        std::vector<int> abandoned;
+        abandoned.swap(abandonedCursors);
+        std::shared_ptr<SLTask> task;
+        bool newRead = false;
+        // results that are read already go first, their statements keep the snapshot of the database
+        if (!fetchQueue.empty()) {
+            task = fetchQueue.front();
+            fetchQueue.pop();
+        } else if (!sl->readQueue.empty()) {
+            task = sl->readQueue.front();
+            sl->readQueue.pop();
+            newRead = true;
+        }
+        lock.unlock();
+
+        for (auto&& cursorId : abandoned) {
+            auto cursor = cursors.find(cursorId);
+            if (cursor != cursors.end()) {
+                sqlite3_finalize(cursor->second.stmt);
+                cursors.erase(cursor);
+            }
+        }
+        if (task == nullptr) {
+            if (!abandoned.empty())
+                continue;
+            break;
+        }
+
+        try {
+            // an open statement keeps the old snapshot for all statements of the connection
+            if (newRead)
+                sl->drainCursors(db);
+            task->run(&db, sl);
+            task->sendSignal();
+        } catch (const std::runtime_error& e) {
+            task->sendSignal(e.what());
+        }
+    }
+
+    // results that are still read will fail on their next batch
+    for (auto&& [cursorId, cursor] : cursors) {
+        sqlite3_finalize(cursor.stmt);
+    }
+    cursors.clear();
+    Sqlite3Database::clearStatementCache(statementCache);
+    sqlite3_close(db);
+    db = nullptr;
+}
+
 /* Sqlite3Result */
 
+Sqlite3Result::Sqlite3Result(Sqlite3Database* sl)
+    : sl(sl)
+{
+}
+
 Sqlite3Result::~Sqlite3Result()
 {
-    if (table) {
-        sqlite3_free_table(table);
-        table = nullptr;
+    if (cursorId >= 0 && reader != nullptr) {
+        // wake the reader to release its snapshot of the database
+        {
+            std::lock_guard<decltype(sl->readMutex)> lock(sl->readMutex);
+            reader->abandonedCursors.push_back(cursorId);
+        }
+        sl->readCond.notify_all();
+    } else if (cursorId >= 0) {
+        // the statement belongs to the sqlite3 thread, it finalizes it before the next task
+        std::lock_guard<decltype(sl->abandonedCursorsMutex)> lock(sl->abandonedCursorsMutex);
+        sl->abandonedCursors.push_back(cursorId);
     }
 }
+
 std::unique_ptr<SQLRow> Sqlite3Result::nextRow()
 {
-    if (nrow) {
-        row += ncolumn;
-        cur_row++;
-        if (cur_row <= nrow) {
-            return std::make_unique<Sqlite3Row>(row);
-        }
-        return nullptr;
+    if (cur_row >= nrow && cursorId >= 0) {
+        auto ftask = std::make_shared<SLFetchTask>(this);
+        if (reader != nullptr)
+            sl->addFetchTask(reader, ftask);
+        else
+            sl->addTask(ftask);
+        ftask->waitForTask();
+    }
+    if (cur_row < nrow) {
+        return std::make_unique<Sqlite3Row>(this, cur_row++);
     }
     return nullptr;
 }
 
+int Sqlite3Result::fetchBatch(sqlite3_stmt* stmt, std::size_t maxRows)
+{
+    nrow = 0;
+    cur_row = 0;
+    cells.clear();
+    text.clear();
+    ncolumn = sqlite3_column_count(stmt);
+
+    int ret = SQLITE_ROW;
+    while ((maxRows == 0 || nrow < maxRows) && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int i = 0; i < ncolumn; i++) {
+            auto&& cell = cells.emplace_back();
+            cell.type = sqlite3_column_type(stmt, i);
+            if (cell.type == SQLITE_NULL)
+                continue;
+            if (cell.type == SQLITE_INTEGER)
+                cell.number = sqlite3_column_int64(stmt, i);
+            auto value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+            cell.length = sqlite3_column_bytes(stmt, i);
+            cell.offset = text.size();
+            text.insert(text.end(), value, value + cell.length);
+            text.push_back('\0');
+        }
+        nrow++;
+    }
+    return ret;
+}
+
 /* Sqlite3Row */
 
-Sqlite3Row::Sqlite3Row(char** row)
-    : row(row)
+Sqlite3Row::Sqlite3Row(Sqlite3Result* res, std::size_t row)
+    : res(res)
+    , row(row)
+{
+}
+
+char* Sqlite3Row::col_c_str(int index) const
+{
+    auto&& c = cell(index);
+    if (c.type == SQLITE_NULL)
+        return nullptr;
+    return res->text.data() + c.offset;
+}
+
+std::string_view Sqlite3Row::col_view(int index) const
+{
+    auto&& c = cell(index);
+    if (c.type == SQLITE_NULL)
+        return {};
+    return { res->text.data() + c.offset, c.length };
+}
+
+long long Sqlite3Row::col_int64(int index) const
 {
+    auto&& c = cell(index);
+    if (c.type == SQLITE_INTEGER)
+        return c.number;
+    return SQLRow::col_int64(index);
 }
 
 /* Sqlite3BackupTimerSubscriber */
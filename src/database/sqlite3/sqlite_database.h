@@ -33,10 +33,12 @@
 #ifndef __SQLITE3_STORAGE_H__
 #define __SQLITE3_STORAGE_H__
 
+#include <atomic>
 #include <queue>
 #include <sqlite3.h>
 #include <sstream>
 #include <unistd.h>
+#include <unordered_map>
 
 #include "database/sql_database.h"
 #include "util/thread_runner.h"
@@ -68,6 +70,14 @@ public:
 
     bool didContamination() const { return contamination; }
     bool didDecontamination() const { return decontamination; }
+    /// \brief true if the task gave way to the other queued tasks and has to run again
+    bool needsRequeue() const { return requeue; }
+    /// \brief true if the task has to run again after the transaction of the connection is finished
+    bool waitsForTransaction() const { return waitForTransaction; }
+    /// \brief release what an unfinished task holds on the connection before it is closed
+    virtual void cancel() { }
+    /// \brief true if the task changes the database, the open cursors are read to the end before it runs
+    virtual bool isWrite() const { return false; }
 
     std::string getError() const { return error; }
 
@@ -87,6 +97,9 @@ protected:
     /// \brief true if this task has backuped the db
     bool decontamination { false };
 
+    bool requeue { false };
+    bool waitForTransaction { false };
+
     std::condition_variable cond;
     std::mutex mutex;
 
@@ -99,6 +112,7 @@ public:
     /// \brief Constructor for the sqlite3 init task
     explicit SLInitTask(std::shared_ptr<Config> config);
     void run(sqlite3** db, Sqlite3Database* sl) override;
+    bool isWrite() const override { return true; }
 
     std::string_view taskType() const override { return "InitTask"; }
 
@@ -132,6 +146,7 @@ public:
     SLExecTask(const char* query, bool getLastInsertId);
     void run(sqlite3** db, Sqlite3Database* sl) override;
     int getLastInsertId() const { return lastInsertId; }
+    bool isWrite() const override { return true; }
 
     std::string_view taskType() const override { return "ExecTask"; }
 
@@ -143,18 +158,114 @@ protected:
     bool getLastInsertIdFlag;
 };
 
-/// \brief A task for the sqlite3 thread to do a SQL exec.
+/// \brief A task for the sqlite3 thread to run a cached prepared statement.
+class SLStatementTask : public SLTask {
+public:
+    /// \brief Constructor for the sqlite3 statement task
+    /// \param query The SQL query string with '?' placeholders
+    /// \param params The values to bind, the task keeps a copy as it may outlive the caller
+    /// \param isSelect true if the rows of the statement should be collected
+    SLStatementTask(std::string query, std::vector<SQLParam> params, bool isSelect, bool getLastInsertId);
+    void run(sqlite3** db, Sqlite3Database* sl) override;
+    [[nodiscard]] std::shared_ptr<SQLResult> getResult() const { return std::static_pointer_cast<SQLResult>(pres); }
+    int getLastInsertId() const { return lastInsertId; }
+    bool isWrite() const override { return !isSelect; }
+
+    std::string_view taskType() const override { return "StatementTask"; }
+
+protected:
+    /// \brief The SQL query string
+    std::string query;
+    std::vector<SQLParam> params;
+    bool isSelect;
+
+    int lastInsertId {};
+    bool getLastInsertIdFlag;
+
+    /// \brief The rows collected for a select
+    std::shared_ptr<Sqlite3Result> pres;
+};
+
+/// \brief A task for the sqlite3 thread to step the next batch of rows of a select.
+class SLFetchTask : public SLTask {
+public:
+    /// \brief Constructor for the sqlite3 fetch task
+    /// \param pres The result to fill, the caller waits for the task so it stays valid
+    explicit SLFetchTask(Sqlite3Result* pres);
+    void run(sqlite3** db, Sqlite3Database* sl) override;
+
+    std::string_view taskType() const override { return "FetchTask"; }
+
+protected:
+    Sqlite3Result* pres;
+};
+
+/// \brief A task for the sqlite3 thread to backup or restore the database.
+///
+/// The backup copies a number of pages per run and is queued again until it is complete,
+/// so the other tasks are not blocked for the whole copy.
 class SLBackupTask : public SLTask {
 public:
     /// \brief Constructor for the sqlite3 backup task
     SLBackupTask(std::shared_ptr<Config> config, bool restore);
+    ~SLBackupTask() override;
     void run(sqlite3** db, Sqlite3Database* sl) override;
+    void cancel() override;
 
     std::string_view taskType() const override { return "BackupTask"; }
 
 protected:
     std::shared_ptr<Config> config;
     bool restore;
+
+    /// \brief start the backup into the temporary file
+    void startBackup(sqlite3* db, Sqlite3Database* sl);
+    /// \brief close the temporary file and replace the backup with it if complete
+    void finishBackup(bool complete);
+
+    Sqlite3Database* database {};
+    std::string dbFilePath;
+    std::string tempFilePath;
+    sqlite3* backupDb {};
+    sqlite3_backup* backup {};
+    std::chrono::milliseconds startTime {};
+    /// \brief steps in a row that found the database locked
+    int busyRetries {};
+};
+
+/// \brief The statement of a result with more rows than the first batch
+struct Sqlite3Cursor {
+    /// \brief the open statement, nullptr after the remaining rows were read into rest
+    sqlite3_stmt* stmt {};
+    /// \brief the remaining rows, read before a write on the connection could change them
+    std::shared_ptr<Sqlite3Result> rest;
+    /// \brief the error of reading the remaining rows
+    std::string error;
+};
+
+/// \brief A read-only connection of the reader pool with its own thread
+class Sqlite3Reader {
+public:
+    Sqlite3Reader(Sqlite3Database* sl, std::shared_ptr<Config> config, int index);
+
+    /// \brief the connection, only used by the reader thread
+    sqlite3* db {};
+    /// \brief prepared statements of this connection
+    std::unordered_map<std::string, sqlite3_stmt*> statementCache;
+    /// \brief statements of results with more rows than the first batch, only used by the reader thread
+    std::unordered_map<int, Sqlite3Cursor> cursors;
+    /// \brief cursors of results that were destroyed before their last row, guarded by Sqlite3Database::readMutex
+    std::vector<int> abandonedCursors;
+    /// \brief the next batches of the results of this connection, guarded by Sqlite3Database::readMutex
+    std::queue<std::shared_ptr<SLTask>> fetchQueue;
+    std::unique_ptr<StdThreadRunner> threadRunner;
+
+private:
+    Sqlite3Database* sl;
+    std::shared_ptr<Config> config;
+
+    static void* staticThreadProc(void* arg);
+    void threadProc();
 };
 
 /// \brief The Database class for using SQLite3
@@ -182,6 +293,10 @@ private:
 
     std::shared_ptr<SQLResult> select(const char* query, int length) override;
     int exec(const char* query, int length, bool getLastInsertId = false) override;
+    std::shared_ptr<SQLResult> selectPrepared(const std::string& query, const std::vector<SQLParam>& params) override;
+    int execPrepared(const std::string& query, const std::vector<SQLParam>& params, bool getLastInsertId = false) override;
+    /// \brief sqlite3_last_insert_rowid() reports the last row, a single writer assigns the rowids in sequence
+    int getFirstInsertId(int insertId, int rowCount) const override { return insertId - rowCount + 1; }
 
     void beginTransaction(const std::string_view& tName) override;
     void rollback(const std::string_view& tName) override;
@@ -189,7 +304,9 @@ private:
 
     void storeInternalSetting(const std::string& key, const std::string& value) override;
 
+    /// \brief run a statement without changing writeGeneration, for transactions and schema changes
     void _exec(const char* query);
+    int runExecTask(const char* query, bool getLastInsertId);
 
     std::string startupError;
 
@@ -200,6 +317,58 @@ private:
     void threadProc();
 
     void addTask(const std::shared_ptr<SLTask>& task, bool onlyIfDirty = false);
+    void runStatementTask(const std::shared_ptr<SLStatementTask>& task, bool readOnly);
+
+    /// \brief get the cached statement of the connection for query or prepare it, only called by the thread of the connection
+    sqlite3_stmt* getStatement(sqlite3* db, const std::string& query);
+    /// \brief finalize all cached statements of a connection
+    static void clearStatementCache(std::unordered_map<std::string, sqlite3_stmt*>& cache);
+
+    /// \brief start the reader pool if configured, after the database is ready
+    void startReaders();
+    /// \brief create or drop the fts5 tables for search as configured
+    void initFullTextSearch();
+    /// \brief true if a select of the calling thread can be answered by the reader pool
+    bool useReaders() const;
+    void addReadTask(const std::shared_ptr<SLTask>& task);
+    /// \brief queue a task for the reader that owns the connection of the task
+    void addFetchTask(Sqlite3Reader* reader, const std::shared_ptr<SLTask>& task);
+    /// \brief the reader of the connection, nullptr for the main connection
+    Sqlite3Reader* getReader(sqlite3* db) const;
+    /// \brief the open cursors of a connection, only called by the thread of the connection
+    std::unordered_map<int, Sqlite3Cursor>& getCursors(sqlite3* db);
+
+    /// \brief the read-only connections, not changed while the readers run
+    std::vector<std::unique_ptr<Sqlite3Reader>> readers;
+    /// \brief the selects for the reader pool
+    std::queue<std::shared_ptr<SLTask>> readQueue;
+    bool readQueueOpen {};
+    std::mutex readMutex;
+    std::condition_variable readCond;
+
+    /// \brief thread that started the current transaction, selects of this thread have to see its changes
+    std::atomic<std::thread::id> transactionOwner {};
+    /// \brief writeGeneration at the start of the current transaction
+    unsigned long transactionGeneration {};
+
+    /// \brief prepared statements by query, only accessed by the sqlite3 thread
+    std::unordered_map<std::string, sqlite3_stmt*> statementCache;
+
+    /// \brief statements of results with more rows than the first batch, only accessed by the sqlite3 thread
+    std::unordered_map<int, Sqlite3Cursor> cursors;
+    std::atomic_int lastCursorId {};
+    /// \brief cursors of results that were destroyed before their last row
+    std::vector<int> abandonedCursors;
+    std::mutex abandonedCursorsMutex;
+    /// \brief finalize the statements of abandoned results, only called by the sqlite3 thread
+    void closeAbandonedCursors();
+    /// \brief read the remaining rows of all open cursors of a connection and finalize their statements
+    ///
+    /// Only called by the thread of the connection. A statement of the main connection that is stepped across
+    /// a write may skip or repeat rows, an open statement of a reader keeps its old snapshot for new selects.
+    void drainCursors(sqlite3* db);
+    /// \brief finalize all cached and open statements, must be called by the sqlite3 thread before the db is closed
+    void finalizeStatements();
 
     std::shared_ptr<Timer> timer;
 
@@ -208,6 +377,8 @@ private:
 
     /// \brief the tasks to be done by the sqlite3 thread
     std::queue<std::shared_ptr<SLTask>> taskQueue;
+    /// \brief tasks waiting for the end of the running transaction, only accessed by the sqlite3 thread
+    std::vector<std::shared_ptr<SLTask>> parkedTasks;
     bool taskQueueOpen {};
 
     void threadCleanup() override { }
@@ -216,18 +387,31 @@ private:
     bool dirty;
     bool dbInitDone;
     bool hasBackupTimer;
+    /// \brief a backup task is copying pages, only accessed by the sqlite3 thread
+    bool backupRunning {};
     int sqliteStatus {};
 
     friend class SLSelectTask;
     friend class SLExecTask;
+    friend class SLStatementTask;
+    friend class SLFetchTask;
     friend class SLInitTask;
+    friend class SLBackupTask;
+    friend class Sqlite3Result;
+    friend class Sqlite3Reader;
     friend class Sqlite3BackupTimerSubscriber;
 };
 
 /// \brief Represents a result of a sqlite3 select
+///
+/// The sqlite3 thread steps the statement in batches of SQLITE3_RESULT_BATCH_SIZE rows and copies
+/// each batch into one buffer. Results that fit into the first batch are complete when select returns,
+/// larger results keep their statement open until the last row was read or the result is destroyed.
+/// A write on the main connection or a new select on a reader reads the remaining rows of all open statements
+/// of the connection before it runs.
 class Sqlite3Result : public SQLResult {
 public:
-    Sqlite3Result() = default;
+    explicit Sqlite3Result(Sqlite3Database* sl);
     ~Sqlite3Result() override;
 
     Sqlite3Result(const Sqlite3Result&) = delete;
@@ -235,29 +419,55 @@ public:
 
 private:
     std::unique_ptr<SQLRow> nextRow() override;
-    [[nodiscard]] unsigned long long getNumRows() const override { return nrow; }
 
-    char** table { nullptr };
-    char** row;
+    /// \brief replace the batch with the next rows of stmt, only called by the sqlite3 thread
+    /// \param maxRows stop after this number of rows, 0 to read all remaining rows
+    /// \return the result code of the last sqlite3_step
+    int fetchBatch(sqlite3_stmt* stmt, std::size_t maxRows);
+
+    struct Cell {
+        int type;
+        sqlite3_int64 number;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    Sqlite3Database* sl;
 
-    int cur_row;
+    /// \brief key of the open statement in the cursors of the connection, -1 after the last row was stepped
+    int cursorId { -1 };
+    /// \brief the reader that holds the open statement, nullptr for the main connection
+    Sqlite3Reader* reader {};
 
-    int nrow;
-    int ncolumn;
+    int ncolumn {};
+    std::size_t nrow {};
+    std::size_t cur_row {};
+
+    std::vector<Cell> cells;
+    /// \brief text of all cells of the batch, each terminated by '\0'
+    std::vector<char> text;
 
     friend class SLSelectTask;
-    friend class Sqlite3Row;
+    friend class SLStatementTask;
+    friend class SLFetchTask;
     friend class Sqlite3Database;
+    friend class Sqlite3Row;
 };
 
-/// \brief Represents a row of a result of a sqlite3 select
+/// \brief Represents a row of a result of a sqlite3 select, valid until the next call of nextRow()
 class Sqlite3Row : public SQLRow {
 public:
-    explicit Sqlite3Row(char** row);
+    Sqlite3Row(Sqlite3Result* res, std::size_t row);
 
 private:
-    char* col_c_str(int index) const override { return row[index]; }
-    char** row;
+    char* col_c_str(int index) const override;
+    std::string_view col_view(int index) const override;
+    long long col_int64(int index) const override;
+
+    const Sqlite3Result::Cell& cell(int index) const { return res->cells.at(row * res->ncolumn + index); }
+
+    Sqlite3Result* res;
+    std::size_t row;
 };
 
 #endif // __SQLITE3_STORAGE_H__
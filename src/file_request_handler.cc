@@ -40,6 +40,7 @@
 #include "content/content_manager.h"
 #include "database/database.h"
 #include "iohandler/file_io_handler.h"
+#include "iohandler/io_handler_cache.h"
 #include "metadata/metadata_handler.h"
 #include "transcoding/transcode_dispatcher.h"
 #include "util/process.h"
@@ -48,9 +49,10 @@
 #include "util/upnp_quirks.h"
 #include "web/session_manager.h"
 
-FileRequestHandler::FileRequestHandler(std::shared_ptr<ContentManager> content, UpnpXMLBuilder* xmlBuilder)
+FileRequestHandler::FileRequestHandler(std::shared_ptr<ContentManager> content, UpnpXMLBuilder* xmlBuilder, IOHandlerCache* generatedContent)
     : RequestHandler(std::move(content))
     , xmlBuilder(xmlBuilder)
+    , generatedContent(generatedContent)
 {
 }
 
@@ -148,6 +150,10 @@ void FileRequestHandler::getInfo(const char* filename, UpnpFileInfo* info)
         off_t size = io_handler->tell();
         io_handler->close();
 
+        // open follows right away and serves the content generated here
+        if (generatedContent != nullptr)
+            generatedContent->put(filename, std::move(io_handler));
+
         UpnpFileInfo_set_FileLength(info, size);
     } else if (!is_srt && !tr_profile.empty()) {
         auto tp = config->getTranscodingProfileListOption(CFG_TRANSCODING_PROFILE_LIST)
@@ -222,6 +228,15 @@ std::unique_ptr<IOHandler> FileRequestHandler::open(const char* filename, enum U
         throw_std_runtime_error("UPNP_WRITE unsupported");
     }
 
+    if (generatedContent != nullptr) {
+        auto io_handler = generatedContent->take(filename);
+        if (io_handler != nullptr) {
+            io_handler->open(mode);
+            log_debug("end");
+            return io_handler;
+        }
+    }
+
     auto params = parseParameters(filename, LINK_FILE_REQUEST_HANDLER);
     auto obj = getObjectById(params);
     std::string rh = getValueOrDefault(params, RESOURCE_HANDLER);
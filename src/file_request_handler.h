@@ -37,12 +37,17 @@
 #include "upnp_xml.h"
 #include <memory>
 
+// forward declaration
+class IOHandlerCache;
+
 class FileRequestHandler : public RequestHandler {
 protected:
     UpnpXMLBuilder* xmlBuilder;
+    /// \brief content generated by getInfo for the following open, nullptr to generate it again
+    IOHandlerCache* generatedContent;
 
 public:
-    explicit FileRequestHandler(std::shared_ptr<ContentManager> content, UpnpXMLBuilder* xmlBuilder);
+    explicit FileRequestHandler(std::shared_ptr<ContentManager> content, UpnpXMLBuilder* xmlBuilder, IOHandlerCache* generatedContent = nullptr);
 
     void getInfo(const char* filename, UpnpFileInfo* info) override;
     std::unique_ptr<IOHandler> open(const char* filename, enum UpnpOpenFileMode mode) override;
@@ -0,0 +1,75 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    io_handler_cache.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file io_handler_cache.cc
+
+#include "io_handler_cache.h" // API
+
+#include <algorithm>
+
+#include "io_handler.h"
+#include "util/logger.h"
+
+IOHandlerCache::IOHandlerCache(std::size_t maxEntries, std::chrono::milliseconds ttl)
+    : maxEntries(std::max<std::size_t>(maxEntries, 1))
+    , ttl(ttl)
+{
+}
+
+void IOHandlerCache::put(const std::string& url, std::unique_ptr<IOHandler> handler)
+{
+    if (handler == nullptr)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    expire(now);
+    if (entries.size() >= maxEntries)
+        entries.pop_front();
+    entries.push_back(Entry { url, now + ttl, std::move(handler) });
+}
+
+std::unique_ptr<IOHandler> IOHandlerCache::take(const std::string& url)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    auto entry = std::find_if(entries.begin(), entries.end(), [&](auto&& e) { return e.url == url && e.expires > now; });
+    if (entry == entries.end())
+        return nullptr;
+
+    auto result = std::move(entry->handler);
+    entries.erase(entry);
+    log_debug("Serving generated content of {} from getInfo", url);
+    return result;
+}
+
+void IOHandlerCache::expire(std::chrono::steady_clock::time_point now)
+{
+    entries.remove_if([now](auto&& e) { return e.expires <= now; });
+}
+
+std::size_t IOHandlerCache::size() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return entries.size();
+}
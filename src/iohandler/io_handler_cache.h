@@ -0,0 +1,79 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    io_handler_cache.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file io_handler_cache.h
+/// \brief Definition of the IOHandlerCache class.
+
+#ifndef __IO_HANDLER_CACHE_H__
+#define __IO_HANDLER_CACHE_H__
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// forward declaration
+class IOHandler;
+
+/// \brief Hands content generated for getInfo to the open of the same request
+///
+/// The length of a generated resource, like a thumbnail, is only known after it is
+/// generated. The web server asks for the length first and opens the URL right after,
+/// so the handler is kept under the URL for a short time instead of generating the
+/// content twice. Each handler is taken once, handlers that are never opened expire.
+class IOHandlerCache {
+public:
+    /// \param maxEntries handlers kept at most, the oldest are dropped first
+    /// \param ttl time a handler waits for the open
+    IOHandlerCache(std::size_t maxEntries, std::chrono::milliseconds ttl);
+
+    IOHandlerCache(const IOHandlerCache&) = delete;
+    IOHandlerCache& operator=(const IOHandlerCache&) = delete;
+
+    /// \brief keep the closed handler for the next open of url
+    void put(const std::string& url, std::unique_ptr<IOHandler> handler);
+    /// \brief remove and return the handler kept for url, nullptr if there is none
+    std::unique_ptr<IOHandler> take(const std::string& url);
+
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        std::string url;
+        std::chrono::steady_clock::time_point expires;
+        std::unique_ptr<IOHandler> handler;
+    };
+
+    void expire(std::chrono::steady_clock::time_point now);
+
+    std::size_t maxEntries;
+    std::chrono::milliseconds ttl;
+
+    mutable std::mutex mutex;
+    /// \brief oldest first, few entries are waiting at any time
+    std::list<Entry> entries;
+};
+
+#endif // __IO_HANDLER_CACHE_H__
@@ -55,9 +55,18 @@ MemIOHandler::MemIOHandler(const std::string& str)
     memcpy(this->buffer, str.c_str(), length);
 }
 
+MemIOHandler::MemIOHandler(std::shared_ptr<const std::vector<std::byte>> data)
+    : buffer(const_cast<char*>(reinterpret_cast<const char*>(data->data())))
+    , length(data->size())
+    , pos(-1)
+    , shared(std::move(data))
+{
+}
+
 MemIOHandler::~MemIOHandler()
 {
-    delete[] buffer;
+    if (shared == nullptr)
+        delete[] buffer;
 }
 
 void MemIOHandler::open(enum UpnpOpenFileMode mode)
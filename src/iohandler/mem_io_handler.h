@@ -32,6 +32,9 @@
 #ifndef __MEM_IO_HANDLER_H__
 #define __MEM_IO_HANDLER_H__
 
+#include <memory>
+#include <vector>
+
 #include "common.h"
 #include "io_handler.h"
 
@@ -45,11 +48,16 @@ protected:
     /// \brief current offset in the buffer
     off_t pos;
 
+    /// \brief owner of the buffer if it is shared
+    std::shared_ptr<const std::vector<std::byte>> shared;
+
 public:
     /// \brief Initializes the internal buffer.
     /// \param buffer all operations will be done on this buffer.
     MemIOHandler(const void* buffer, int length);
     explicit MemIOHandler(const std::string& str);
+    /// \brief Serves the data without copying it.
+    explicit MemIOHandler(std::shared_ptr<const std::vector<std::byte>> data);
     ~MemIOHandler() override;
 
     MemIOHandler(const MemIOHandler&) = delete;
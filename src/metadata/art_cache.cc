@@ -0,0 +1,323 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    art_cache.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file art_cache.cc
+
+#include "art_cache.h" // API
+
+#include <algorithm>
+#include <tuple>
+
+#include "database/database.h"
+#include "metadata/metadata_handler.h"
+#include "util/tools.h"
+
+// files mapped in memory, an arbitrary one is dropped when more are seen
+#define ART_CACHE_MAX_FILES 100000
+
+ArtCache::ArtCache(fs::path base, std::size_t maxSize, std::size_t maxDiskSize)
+    : base(std::move(base))
+    , maxSize(maxSize)
+    , maxDiskSize(maxDiskSize)
+{
+    if (!this->base.empty())
+        loadIndex();
+}
+
+void ArtCache::loadIndex()
+{
+    // files are listed by modification time, the oldest go first
+    auto list = [](const fs::path& dir) {
+        std::vector<std::tuple<fs::file_time_type, fs::path, std::size_t>> found;
+        std::error_code ec;
+        for (auto&& dirEnt : fs::directory_iterator(dir, ec)) {
+            std::error_code dirEc;
+            if (!dirEnt.is_directory(dirEc))
+                continue;
+            for (auto&& fileEnt : fs::directory_iterator(dirEnt.path(), dirEc)) {
+                std::error_code fileEc;
+                if (fileEnt.path().extension() == ".tmp" || !fileEnt.is_regular_file(fileEc))
+                    continue;
+                auto size = fileEnt.file_size(fileEc);
+                auto mtime = fileEnt.last_write_time(fileEc);
+                if (!fileEc)
+                    found.emplace_back(mtime, fileEnt.path(), size);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    };
+
+    std::vector<fs::path> evicted;
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        for (auto&& [mtime, path, size] : list(base / "blobs"))
+            addDiskBlob(path.filename().string(), size, evicted);
+    }
+
+    // files are removed with their blob from now on, the oldest beyond the limit are dropped
+    auto mappings = list(base / "files");
+    auto dropped = mappings.size() > ART_CACHE_MAX_FILES ? mappings.size() - ART_CACHE_MAX_FILES : 0;
+    std::vector<std::pair<std::string, std::string>> mapped;
+    for (auto&& [mtime, path, size] : mappings) {
+        auto content = dropped > 0 ? std::nullopt : readBinaryFile(path);
+        if (dropped > 0)
+            dropped--;
+        if (content && !content->empty())
+            mapped.emplace_back(path.filename().string(), std::string(reinterpret_cast<const char*>(content->data()), content->size()));
+        else
+            evicted.push_back(path);
+    }
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        for (auto&& [key, hash] : mapped) {
+            addDiskFile(key, hash, evicted);
+            files[key] = hash;
+        }
+    }
+
+    for (auto&& path : evicted) {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+    log_debug("Art cache {} holds {} blobs with {} bytes", base.c_str(), diskBlobs.size(), diskSize);
+}
+
+void ArtCache::addDiskBlob(const std::string& hash, std::size_t size, std::vector<fs::path>& evicted)
+{
+    if (diskBlobs.find(hash) != diskBlobs.end())
+        return;
+
+    diskLru.push_front(hash);
+    diskBlobs[hash] = DiskEntry { size, diskLru.begin() };
+    diskSize += size;
+
+    while (maxDiskSize > 0 && diskSize > maxDiskSize && diskLru.size() > 1) {
+        auto oldest = diskBlobs.find(diskLru.back());
+        evicted.push_back(getBlobPath(oldest->first));
+        for (auto&& key : oldest->second.keys)
+            evicted.push_back(getFilePath(key));
+        diskSize -= oldest->second.size;
+        diskBlobs.erase(oldest);
+        diskLru.pop_back();
+    }
+}
+
+void ArtCache::addDiskFile(const std::string& key, const std::string& hash, std::vector<fs::path>& evicted)
+{
+    auto diskBlob = diskBlobs.find(hash);
+    if (diskBlob == diskBlobs.end()) {
+        evicted.push_back(getFilePath(key));
+        return;
+    }
+    auto&& keys = diskBlob->second.keys;
+    if (std::find(keys.begin(), keys.end(), key) == keys.end())
+        keys.push_back(key);
+}
+
+fs::path ArtCache::getFilePath(const std::string& key) const
+{
+    return base / "files" / key.substr(0, 2) / key;
+}
+
+fs::path ArtCache::getBlobPath(const std::string& hash) const
+{
+    return base / "blobs" / hash.substr(0, 2) / hash;
+}
+
+ArtCache::Blob ArtCache::get(const fs::path& file, int handlerType, const Extractor& extract)
+{
+    FileIdentity identity;
+    if (!MetadataHandler::getFileIdentity(file, identity))
+        return std::make_shared<const std::vector<std::byte>>(extract());
+
+    // the inode first spreads the files over the directories
+    auto key = fmt::format("{:02x}{:x}-{:x}-{:x}-{:x}-{}",
+        static_cast<unsigned long long>(identity.inode) & 0xff, static_cast<unsigned long long>(identity.device),
+        static_cast<unsigned long long>(identity.inode), static_cast<unsigned long long>(identity.size),
+        static_cast<unsigned long long>(identity.mtime), handlerType);
+
+    if (auto hash = findHash(key)) {
+        if (auto data = findBlob(key, *hash))
+            return data;
+    }
+
+    auto data = std::make_shared<const std::vector<std::byte>>(extract());
+    auto hash = hexMd5(data->data(), data->size());
+    log_debug("Art of {} has hash {}", file.c_str(), hash);
+
+    Blob result;
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if (files.size() >= ART_CACHE_MAX_FILES)
+            files.erase(files.begin());
+        files[key] = hash;
+        // another track of the album may have added it already
+        auto blob = blobs.find(hash);
+        if (blob != blobs.end()) {
+            lru.splice(lru.begin(), lru, blob->second.lru);
+            result = blob->second.data;
+        } else {
+            result = addBlob(hash, data);
+        }
+    }
+    storeFile(key, hash, result);
+    return result;
+}
+
+std::optional<std::string> ArtCache::findHash(const std::string& key)
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        auto entry = files.find(key);
+        if (entry != files.end())
+            return entry->second;
+    }
+    if (base.empty())
+        return std::nullopt;
+
+    auto path = getFilePath(key);
+    auto content = readBinaryFile(path);
+    if (!content || content->empty())
+        return std::nullopt;
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    auto hash = std::string(reinterpret_cast<const char*>(content->data()), content->size());
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (files.size() >= ART_CACHE_MAX_FILES)
+        files.erase(files.begin());
+    files[key] = hash;
+    return hash;
+}
+
+ArtCache::Blob ArtCache::findBlob(const std::string& key, const std::string& hash)
+{
+    {
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        auto blob = blobs.find(hash);
+        if (blob != blobs.end()) {
+            lru.splice(lru.begin(), lru, blob->second.lru);
+            auto data = blob->second.data;
+            if (auto diskBlob = diskBlobs.find(hash); diskBlob != diskBlobs.end()) {
+                diskLru.splice(diskLru.begin(), diskLru, diskBlob->second.lru);
+            } else if (!base.empty()) {
+                // removed from disk while in use, the next start finds it again
+                lock.unlock();
+                storeFile(key, hash, data);
+            }
+            return data;
+        }
+    }
+    if (base.empty())
+        return nullptr;
+
+    auto path = getBlobPath(hash);
+    auto data = readBinaryFile(path);
+    if (!data)
+        return nullptr;
+    // keep the order of use for the next start
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (auto diskBlob = diskBlobs.find(hash); diskBlob != diskBlobs.end())
+        diskLru.splice(diskLru.begin(), diskLru, diskBlob->second.lru);
+    return addBlob(hash, std::make_shared<const std::vector<std::byte>>(std::move(*data)));
+}
+
+ArtCache::Blob ArtCache::addBlob(const std::string& hash, Blob data)
+{
+    auto blob = blobs.find(hash);
+    if (blob != blobs.end())
+        return blob->second.data;
+
+    lru.push_front(hash);
+    blobs[hash] = BlobEntry { data, lru.begin() };
+    totalSize += data->size();
+
+    // requests still serving a dropped blob keep their reference
+    while (totalSize > maxSize && lru.size() > 1) {
+        auto oldest = blobs.find(lru.back());
+        totalSize -= oldest->second.data->size();
+        blobs.erase(oldest);
+        lru.pop_back();
+    }
+    return data;
+}
+
+void ArtCache::storeFile(const std::string& key, const std::string& hash, const Blob& data)
+{
+    if (base.empty())
+        return;
+
+    auto write = [](const fs::path& path, const std::byte* bytes, std::size_t size) {
+        fs::create_directories(path.parent_path());
+        auto tmpPath = path;
+        tmpPath += ".tmp";
+        writeBinaryFile(tmpPath, bytes, size);
+        fs::rename(tmpPath, path);
+    };
+    std::vector<fs::path> evicted;
+    try {
+        bool onDisk;
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            onDisk = diskBlobs.find(hash) != diskBlobs.end();
+        }
+        if (!onDisk) {
+            write(getBlobPath(hash), data->data(), data->size());
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            addDiskBlob(hash, data->size(), evicted);
+        }
+        write(getFilePath(key), reinterpret_cast<const std::byte*>(hash.data()), hash.size());
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        addDiskFile(key, hash, evicted);
+    } catch (const std::runtime_error& e) {
+        log_error("Failed to write art cache: {}", e.what());
+    }
+
+    for (auto&& path : evicted) {
+        std::error_code ec;
+        fs::remove(path, ec);
+        log_debug("Removed art {} from cache", path.c_str());
+    }
+}
+
+std::size_t ArtCache::getSize() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return totalSize;
+}
+
+std::size_t ArtCache::getBlobCount() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return blobs.size();
+}
+
+std::size_t ArtCache::getDiskSize() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return diskSize;
+}
@@ -0,0 +1,117 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    art_cache.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file art_cache.h
+
+#ifndef __ART_CACHE_H__
+#define __ART_CACHE_H__
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace fs = std::filesystem;
+
+/// \brief Cache of the art embedded in media files
+///
+/// The art of a file is stored once per content hash, so all tracks of an album share
+/// one blob. Files are mapped to their blob by device, inode, size and modification time
+/// and the handler reading the art. Blobs are held in memory up to a size and written
+/// to disk, so the file is parsed again only after it changed. The least recently used
+/// blobs are removed from disk when they grow beyond their size, together with the
+/// files mapped to them.
+class ArtCache {
+public:
+    using Blob = std::shared_ptr<const std::vector<std::byte>>;
+    using Extractor = std::function<std::vector<std::byte>()>;
+
+    /// \param base directory of the cache files, empty to keep the art in memory only
+    /// \param maxSize bytes of the blobs held in memory
+    /// \param maxDiskSize bytes of the blobs kept on disk, 0 for no limit
+    ArtCache(fs::path base, std::size_t maxSize, std::size_t maxDiskSize);
+
+    ArtCache(const ArtCache&) = delete;
+    ArtCache& operator=(const ArtCache&) = delete;
+
+    /// \brief art of the file from the cache, the extractor runs on a miss
+    Blob get(const fs::path& file, int handlerType, const Extractor& extract);
+
+    /// \brief bytes of the blobs held in memory
+    std::size_t getSize() const;
+    std::size_t getBlobCount() const;
+    /// \brief bytes of the blobs on disk
+    std::size_t getDiskSize() const;
+
+private:
+    struct BlobEntry {
+        Blob data;
+        std::list<std::string>::iterator lru;
+    };
+    struct DiskEntry {
+        std::size_t size;
+        std::list<std::string>::iterator lru;
+        /// \brief files mapped to the blob on disk
+        std::vector<std::string> keys;
+    };
+
+    void loadIndex();
+    /// \brief add a blob written to disk, the mutex is held
+    /// \param evicted receives the blobs to remove from disk
+    void addDiskBlob(const std::string& hash, std::size_t size, std::vector<fs::path>& evicted);
+    /// \brief add a file mapping written to disk, the mutex is held
+    /// \param evicted receives the mapping when its blob is not on disk
+    void addDiskFile(const std::string& key, const std::string& hash, std::vector<fs::path>& evicted);
+
+    std::optional<std::string> findHash(const std::string& key);
+    Blob findBlob(const std::string& key, const std::string& hash);
+    Blob addBlob(const std::string& hash, Blob data);
+    void storeFile(const std::string& key, const std::string& hash, const Blob& data);
+
+    fs::path getFilePath(const std::string& key) const;
+    fs::path getBlobPath(const std::string& hash) const;
+
+    fs::path base;
+    std::size_t maxSize;
+    std::size_t maxDiskSize;
+
+    mutable std::mutex mutex;
+    /// \brief content hash of the files seen
+    std::unordered_map<std::string, std::string> files;
+    std::unordered_map<std::string, BlobEntry> blobs;
+    /// \brief hashes of the blobs, most recently used first
+    std::list<std::string> lru;
+    std::size_t totalSize {};
+
+    std::unordered_map<std::string, DiskEntry> diskBlobs;
+    /// \brief hashes of the blobs on disk, most recently used first
+    std::list<std::string> diskLru;
+    std::size_t diskSize {};
+};
+
+#endif // __ART_CACHE_H__
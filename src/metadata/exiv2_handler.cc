@@ -33,6 +33,7 @@
 #include "exiv2_handler.h" // API
 
 #include <exiv2/exiv2.hpp>
+#include <mutex>
 
 #include "cds_objects.h"
 #include "config/config_manager.h"
@@ -47,6 +48,10 @@ Exiv2Handler::Exiv2Handler(const std::shared_ptr<Context>& context)
 
 void Exiv2Handler::fillMetadata(std::shared_ptr<CdsObject> item)
 {
+    // the xmp toolkit must be initialized once before images are read concurrently
+    static std::once_flag xmpInit;
+    std::call_once(xmpInit, [] { Exiv2::XmpParser::initialize(); });
+
     try {
         std::string value;
         const auto sc = StringConverter::m2i(CFG_IMPORT_LIBOPTS_EXIV2_CHARSET, item->getLocation(), config);
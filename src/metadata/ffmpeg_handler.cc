@@ -66,6 +66,10 @@ extern "C" {
 
 #include "cds_objects.h"
 #include "config/config_manager.h"
+#include "content/content_manager.h"
+#include "media_file.h"
+#include "server.h"
+#include "thumbnail_cache.h"
 #include "util/string_converter.h"
 #include "util/tools.h"
 
@@ -75,10 +79,24 @@ extern "C" {
 #define as_codecpar(s) s->codec
 #endif
 
+#define FFMPEG_AVIO_BUFFER_SIZE (32 * 1024)
+// thumbnails of the former cache layout, stored next to the path of the video below the cache directory
+#define LEGACY_THUMBNAIL_SUFFIX "-thumb.jpg"
+#define LEGACY_THUMBNAIL_MARKER ".legacy-thumbnails-removed"
+// avformat_find_stream_info reads up to 5 MB by default,
+// the streams of audio files are known after the first frames
+#define FFMPEG_AUDIO_PROBE_SIZE (512 * 1024)
+
 // Default constructor
 FfmpegHandler::FfmpegHandler(const std::shared_ptr<Context>& context)
     : MetadataHandler(context)
 {
+#ifdef HAVE_FFMPEGTHUMBNAILER
+    auto server = context->getServer();
+    auto content = server != nullptr ? server->getContent() : nullptr;
+    if (content != nullptr)
+        thumbnails = content->getThumbnailCache();
+#endif
 }
 
 void FfmpegHandler::addFfmpegAuxdataFields(const std::shared_ptr<CdsItem>& item, AVFormatContext* pFormatCtx) const
@@ -287,16 +305,64 @@ static void FfmpegNoOutputStub(void* ptr, int level, const char* fmt, va_list vl
     // do nothing
 }
 
+/// \brief Position of ffmpeg in the extraction context
+struct MediaFileReader {
+    MediaFile* file;
+    int64_t position;
+};
+
+static int readMediaFile(void* opaque, uint8_t* buf, int bufSize)
+{
+    auto reader = static_cast<MediaFileReader*>(opaque);
+    auto count = reader->file->read(reader->position, reinterpret_cast<char*>(buf), bufSize);
+    if (count == 0)
+        return AVERROR_EOF;
+    reader->position += count;
+    return int(count);
+}
+
+static int64_t seekMediaFile(void* opaque, int64_t offset, int whence)
+{
+    auto reader = static_cast<MediaFileReader*>(opaque);
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return reader->file->getSize();
+    case SEEK_SET:
+        reader->position = offset;
+        break;
+    case SEEK_CUR:
+        reader->position += offset;
+        break;
+    case SEEK_END:
+        reader->position = reader->file->getSize() + offset;
+        break;
+    default:
+        return -1;
+    }
+    return reader->position;
+}
+
+/// \brief bytes that may be read to find the streams, 0 for the ffmpeg default
+static int64_t getProbeSize(const std::string& mimeType)
+{
+    if (startswith(mimeType, "audio"))
+        return FFMPEG_AUDIO_PROBE_SIZE;
+    return 0;
+}
+
 void FfmpegHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
+{
+    fillMetadata(obj, std::make_shared<MediaFile>(obj->getLocation()));
+}
+
+void FfmpegHandler::fillMetadata(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<MediaFile>& file)
 {
     auto item = std::dynamic_pointer_cast<CdsItem>(obj);
-    if (item == nullptr)
+    if (item == nullptr || !file->open())
         return;
 
     log_debug("Running ffmpeg handler on {}", item->getLocation().c_str());
 
-    AVFormatContext* pFormatCtx = nullptr;
-
     // Suppress all log messages
     av_log_set_callback(FfmpegNoOutputStub);
 
@@ -304,15 +370,48 @@ void FfmpegHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
     // Register all formats and codecs
     av_register_all();
 #endif
-    // Open video file
+
+    // ffmpeg reads through the extraction context instead of opening the file again
+    MediaFileReader reader { file.get(), 0 };
+    auto avioBuffer = static_cast<unsigned char*>(av_malloc(FFMPEG_AVIO_BUFFER_SIZE));
+    if (avioBuffer == nullptr)
+        return;
+    AVIOContext* avioCtx = avio_alloc_context(avioBuffer, FFMPEG_AVIO_BUFFER_SIZE, 0, &reader, readMediaFile, nullptr, seekMediaFile);
+    if (avioCtx == nullptr) {
+        av_free(avioBuffer);
+        return;
+    }
+    auto freeAvio = [&avioCtx]() {
+        av_freep(&avioCtx->buffer);
+#if (LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(57, 80, 100))
+        av_freep(&avioCtx);
+#else
+        avio_context_free(&avioCtx);
+#endif
+    };
+
+    AVFormatContext* pFormatCtx = avformat_alloc_context();
+    if (pFormatCtx == nullptr) {
+        freeAvio();
+        return;
+    }
+    pFormatCtx->pb = avioCtx;
+    auto probeSize = getProbeSize(item->getMimeType());
+    if (probeSize > 0)
+        pFormatCtx->probesize = probeSize;
+
+    // Open video file, frees the context on failure
     if (avformat_open_input(&pFormatCtx,
             item->getLocation().c_str(), nullptr, nullptr)
-        != 0)
+        != 0) {
+        freeAvio();
         return; // Couldn't open file
+    }
 
     // Retrieve stream information
     if (avformat_find_stream_info(pFormatCtx, nullptr) < 0) {
         avformat_close_input(&pFormatCtx);
+        freeAvio();
         return; // Couldn't find stream information
     }
     // Add metadata using ffmpeg library calls
@@ -322,8 +421,9 @@ void FfmpegHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
     // Add resources using ffmpeg library calls
     addFfmpegResourceFields(item, pFormatCtx);
 
-    // Close the video file
+    // Close the video file, the custom io context is left to the caller
     avformat_close_input(&pFormatCtx);
+    freeAvio();
 }
 
 #ifdef HAVE_FFMPEGTHUMBNAILER
@@ -338,32 +438,70 @@ fs::path getThumbnailCacheBasePath(Config& config)
     return fs::path(std::move(home)) / "cache-dir";
 }
 
-fs::path getThumbnailCachePath(const fs::path& base, const fs::path& movie)
+static bool isLegacyThumbnail(const fs::directory_entry& dirEnt)
 {
-    assert(movie.is_absolute());
-
-    auto path = base / movie.relative_path();
-    path += "-thumb.jpg";
-    return path;
+    std::error_code ec;
+    auto&& name = dirEnt.path().filename().string();
+    constexpr auto suffixLen = std::char_traits<char>::length(LEGACY_THUMBNAIL_SUFFIX);
+    return name.size() > suffixLen && name.compare(name.size() - suffixLen, suffixLen, LEGACY_THUMBNAIL_SUFFIX) == 0 && dirEnt.is_regular_file(ec);
 }
 
-std::optional<std::vector<std::byte>> FfmpegHandler::readThumbnailCacheFile(const fs::path& movie_filename) const
+/// \brief remove the legacy thumbnails below dir and the directories left empty
+static std::size_t removeLegacyDirectory(const fs::path& dir)
 {
-    auto path = getThumbnailCachePath(getThumbnailCacheBasePath(*config), movie_filename);
-    return readBinaryFile(path);
+    std::size_t removed = 0;
+    std::error_code ec;
+    for (auto&& dirEnt : fs::directory_iterator(dir, ec)) {
+        std::error_code entryEc;
+        if (dirEnt.is_directory(entryEc) && !dirEnt.is_symlink(entryEc)) {
+            removed += removeLegacyDirectory(dirEnt.path());
+        } else if (isLegacyThumbnail(dirEnt) && fs::remove(dirEnt.path(), entryEc)) {
+            removed++;
+        }
+    }
+    // fails for directories holding anything else
+    fs::remove(dir, ec);
+    return removed;
 }
 
-void FfmpegHandler::writeThumbnailCacheFile(const fs::path& movie_filename, const std::byte* data, std::size_t size) const
+void removeLegacyThumbnails(const fs::path& base)
 {
+    // the cache is walked once, the marker keeps later starts from doing it again
+    auto marker = base / LEGACY_THUMBNAIL_MARKER;
+    std::error_code ec;
+    if (fs::exists(marker, ec))
+        return;
+
+    // files of the current layout are in directories named by two hex digits and have no subdirectories
+    std::size_t removed = 0;
+    for (auto&& dirEnt : fs::directory_iterator(base, ec)) {
+        std::error_code dirEc;
+        if (!dirEnt.is_directory(dirEc))
+            continue;
+        auto&& name = dirEnt.path().filename().string();
+        if (name.size() != 2 || !std::isxdigit(name[0]) || !std::isxdigit(name[1])) {
+            removed += removeLegacyDirectory(dirEnt.path());
+            continue;
+        }
+        for (auto&& subEnt : fs::directory_iterator(dirEnt.path(), dirEc)) {
+            std::error_code subEc;
+            if (subEnt.is_directory(subEc) && !subEnt.is_symlink(subEc)) {
+                removed += removeLegacyDirectory(subEnt.path());
+            } else if (isLegacyThumbnail(subEnt) && fs::remove(subEnt.path(), subEc)) {
+                removed++;
+            }
+        }
+    }
+    if (removed > 0)
+        log_info("Removed {} thumbnails of the former cache layout from {}", removed, base.c_str());
+
     try {
-        auto path = getThumbnailCachePath(getThumbnailCacheBasePath(*config), movie_filename);
-        fs::create_directories(path.parent_path());
-        writeBinaryFile(path, data, size);
+        fs::create_directories(base);
+        writeTextFile(marker, "");
     } catch (const std::runtime_error& e) {
-        log_error("Failed to write thumbnail cache: {}", e.what());
+        log_warning("Thumbnail cache {} is checked for old thumbnails again on the next start: {}", base.c_str(), e.what());
     }
 }
-#endif
 
 namespace {
 template <auto C, auto D>
@@ -374,27 +512,8 @@ inline auto wrap_unique_ptr()
 }
 } // namespace
 
-std::unique_ptr<IOHandler> FfmpegHandler::serveContent(std::shared_ptr<CdsObject> obj, int resNum)
+std::vector<std::byte> FfmpegHandler::generateThumbnail(const std::shared_ptr<Config>& config, const fs::path& file)
 {
-    auto item = std::dynamic_pointer_cast<CdsItem>(obj);
-    if (item == nullptr)
-        return nullptr;
-
-#ifdef HAVE_FFMPEGTHUMBNAILER
-    if (!config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_ENABLED))
-        return nullptr;
-
-    const auto cache_enabled = config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_CACHE_DIR_ENABLED);
-
-    if (cache_enabled) {
-        if (auto data = readThumbnailCacheFile(item->getLocation())) {
-            log_debug("Returning cached thumbnail for file: {}", item->getLocation().c_str());
-            return std::make_unique<MemIOHandler>(data->data(), data->size());
-        }
-    }
-
-    auto thumb_lock = std::scoped_lock<std::mutex>(thumb_mutex);
-
 #ifdef FFMPEGTHUMBNAILER_OLD_API
     auto th = wrap_unique_ptr<create_thumbnailer, destroy_thumbnailer>();
     auto img = wrap_unique_ptr<create_image_data, destroy_image_data>();
@@ -414,22 +533,41 @@ std::unique_ptr<IOHandler> FfmpegHandler::serveContent(std::shared_ptr<CdsObject
     th->thumbnail_image_quality = config->getIntOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_IMAGE_QUALITY);
     th->thumbnail_image_type = Jpeg;
 
-    log_debug("Generating thumbnail for file: {}", item->getLocation().c_str());
-
 #ifdef FFMPEGTHUMBNAILER_OLD_API
-    if (generate_thumbnail_to_buffer(th.get(), item->getLocation().c_str(), img.get()) != 0)
+    if (generate_thumbnail_to_buffer(th.get(), file.c_str(), img.get()) != 0)
 #else
-    if (video_thumbnailer_generate_thumbnail_to_buffer(th.get(), item->getLocation().c_str(), img.get()) != 0)
+    if (video_thumbnailer_generate_thumbnail_to_buffer(th.get(), file.c_str(), img.get()) != 0)
 #endif // old api
     {
-        throw_std_runtime_error("Could not generate thumbnail for {}", item->getLocation().c_str());
+        throw_std_runtime_error("Could not generate thumbnail for {}", file.c_str());
     }
-    if (cache_enabled) {
-        writeThumbnailCacheFile(item->getLocation(),
-            reinterpret_cast<std::byte*>(img->image_data_ptr), img->image_data_size);
+
+    auto data = reinterpret_cast<const std::byte*>(img->image_data_ptr);
+    return std::vector<std::byte>(data, data + img->image_data_size);
+}
+#endif
+
+std::unique_ptr<IOHandler> FfmpegHandler::serveContent(std::shared_ptr<CdsObject> obj, int resNum)
+{
+    auto item = std::dynamic_pointer_cast<CdsItem>(obj);
+    if (item == nullptr)
+        return nullptr;
+
+#ifdef HAVE_FFMPEGTHUMBNAILER
+    if (!config->getBoolOption(CFG_SERVER_EXTOPTS_FFMPEGTHUMBNAILER_ENABLED))
+        return nullptr;
+
+    std::vector<std::byte> data;
+    if (thumbnails != nullptr) {
+        data = thumbnails->get(item->getLocation());
+    } else {
+        // The ffmpegthumbnailer code (ffmpeg?) is not threading safe.
+        static std::mutex thumbMutex;
+        auto thumbLock = std::scoped_lock<std::mutex>(thumbMutex);
+        data = generateThumbnail(config, item->getLocation());
     }
 
-    return std::make_unique<MemIOHandler>(reinterpret_cast<void*>(img->image_data_ptr), img->image_data_size);
+    return std::make_unique<MemIOHandler>(data.data(), data.size());
 #else
     return nullptr;
 #endif
@@ -40,35 +40,42 @@
 
 #include <filesystem>
 namespace fs = std::filesystem;
-#include <optional>
+#include <vector>
 
 #include "iohandler/io_handler.h"
 #include "metadata_handler.h"
 
 // forward declaration
 class AVFormatContext;
+class MediaFile;
+class ThumbnailCache;
 
 /// \brief This class is responsible for reading id3 tags metadata
 class FfmpegHandler : public MetadataHandler {
 public:
     explicit FfmpegHandler(const std::shared_ptr<Context>& context);
     void fillMetadata(std::shared_ptr<CdsObject> obj) override;
+    /// \brief read the streams from the extraction context of the import
+    void fillMetadata(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<MediaFile>& file);
     std::unique_ptr<IOHandler> serveContent(std::shared_ptr<CdsObject> obj, int resNum) override;
     std::string getMimeType() override;
 
+#ifdef HAVE_FFMPEGTHUMBNAILER
+    /// \brief run ffmpegthumbnailer on the file, see ThumbnailCache for the limit of concurrent runs
+    static std::vector<std::byte> generateThumbnail(const std::shared_ptr<Config>& config, const fs::path& file);
+#endif
+
 private:
-    // The ffmpegthumbnailer code (ffmpeg?) is not threading safe.
-    // Add a lock around the usage to avoid crashing randomly.
-    std::mutex thumb_mutex;
+    std::shared_ptr<ThumbnailCache> thumbnails;
 
     void addFfmpegAuxdataFields(const std::shared_ptr<CdsItem>& item, AVFormatContext* pFormatCtx) const;
     void addFfmpegMetadataFields(const std::shared_ptr<CdsItem>& item, AVFormatContext* pFormatCtx) const;
     void addFfmpegResourceFields(const std::shared_ptr<CdsItem>& item, AVFormatContext* pFormatCtx) const;
-    std::optional<std::vector<std::byte>> readThumbnailCacheFile(const fs::path& movie_filename) const;
-    void writeThumbnailCacheFile(const fs::path& movie_filename, const std::byte* data, std::size_t size) const;
 };
 
 fs::path getThumbnailCacheBasePath(Config& config);
-fs::path getThumbnailCachePath(const fs::path& base, const fs::path& movie);
+/// \brief remove the thumbnails stored by the path of the video before the cache was keyed by file identity
+/// runs once per cache directory, a marker file in base records that it is done
+void removeLegacyThumbnails(const fs::path& base);
 
 #endif //__FFMPEG_HANDLER_H__
@@ -0,0 +1,283 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    jpeg_scale_handler.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file jpeg_scale_handler.cc
+
+#ifdef HAVE_LIBJPEG
+#include "jpeg_scale_handler.h" // API
+
+#include <algorithm>
+#include <array>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+
+#include <jpeglib.h>
+
+#include "cds_objects.h"
+#include "config/config_manager.h"
+#include "content/content_manager.h"
+#include "iohandler/mem_io_handler.h"
+#include "server.h"
+#include "thumbnail_cache.h"
+#include "util/tools.h"
+
+// boxes of the DLNA profiles JPEG_TN, JPEG_SM and JPEG_MED
+static constexpr std::array<std::pair<int, int>, 3> jpegProfiles { {
+    { 160, 160 },
+    { 640, 480 },
+    { 1024, 768 },
+} };
+
+namespace {
+struct JpegError {
+    struct jpeg_error_mgr pub;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+/// \brief libjpeg state, kept on the heap as locals changed before a longjmp are indeterminate
+struct JpegScaleState {
+    JpegError err {};
+    struct jpeg_decompress_struct dinfo {};
+    struct jpeg_compress_struct cinfo {};
+    FILE* file {};
+    std::vector<JSAMPLE> source;
+    std::vector<JSAMPLE> target;
+    unsigned char* output {};
+    unsigned long outputSize {};
+
+    JpegScaleState();
+    ~JpegScaleState();
+};
+} // namespace
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+    auto err = reinterpret_cast<JpegError*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    std::longjmp(err->jump, 1);
+}
+
+static void jpegOutputMessage(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    log_debug("libjpeg: {}", message);
+}
+
+JpegScaleState::JpegScaleState()
+{
+    dinfo.err = jpeg_std_error(&err.pub);
+    cinfo.err = dinfo.err;
+    err.pub.error_exit = jpegErrorExit;
+    err.pub.output_message = jpegOutputMessage;
+    jpeg_create_decompress(&dinfo);
+    jpeg_create_compress(&cinfo);
+}
+
+JpegScaleState::~JpegScaleState()
+{
+    jpeg_destroy_compress(&cinfo);
+    jpeg_destroy_decompress(&dinfo);
+    if (file != nullptr)
+        std::fclose(file);
+    std::free(output);
+}
+
+std::pair<int, int> fitJpegSize(int width, int height, int boxWidth, int boxHeight)
+{
+    if (width <= boxWidth && height <= boxHeight)
+        return { width, height };
+
+    // compare width / height against boxWidth / boxHeight without rounding
+    if (static_cast<long long>(width) * boxHeight >= static_cast<long long>(height) * boxWidth)
+        return { boxWidth, std::max(1, static_cast<int>(static_cast<long long>(height) * boxWidth / width)) };
+    return { std::max(1, static_cast<int>(static_cast<long long>(width) * boxHeight / height)), boxHeight };
+}
+
+bool readJpegSize(const fs::path& file, int& width, int& height)
+{
+    auto state = std::make_unique<JpegScaleState>();
+    state->file = std::fopen(file.c_str(), "rb");
+    if (state->file == nullptr)
+        return false;
+
+    if (setjmp(state->err.jump)) {
+        log_debug("Could not read JPEG header of {}: {}", file.c_str(), state->err.message);
+        return false;
+    }
+    jpeg_stdio_src(&state->dinfo, state->file);
+    jpeg_read_header(&state->dinfo, TRUE);
+    width = static_cast<int>(state->dinfo.image_width);
+    height = static_cast<int>(state->dinfo.image_height);
+    return width > 0 && height > 0;
+}
+
+std::vector<std::byte> scaleJpeg(const fs::path& file, int width, int height, int quality)
+{
+    if (width <= 0 || height <= 0)
+        throw_std_runtime_error("Invalid image size {}x{}", width, height);
+
+    auto state = std::make_unique<JpegScaleState>();
+    state->file = std::fopen(file.c_str(), "rb");
+    if (state->file == nullptr)
+        throw_std_runtime_error("Could not open {}", file.c_str());
+
+    if (setjmp(state->err.jump))
+        throw_std_runtime_error("Could not scale {}: {}", file.c_str(), state->err.message);
+
+    auto& dinfo = state->dinfo;
+    jpeg_stdio_src(&dinfo, state->file);
+    jpeg_read_header(&dinfo, TRUE);
+    dinfo.out_color_space = JCS_RGB;
+
+    // the decoder skips most of the work for 1/2, 1/4 and 1/8 of the size
+    dinfo.scale_num = 1;
+    dinfo.scale_denom = 1;
+    for (unsigned int denom : { 8U, 4U, 2U }) {
+        if ((dinfo.image_width + denom - 1) / denom >= static_cast<unsigned int>(width) && (dinfo.image_height + denom - 1) / denom >= static_cast<unsigned int>(height)) {
+            dinfo.scale_denom = denom;
+            break;
+        }
+    }
+    jpeg_start_decompress(&dinfo);
+
+    std::size_t srcWidth = dinfo.output_width;
+    std::size_t srcHeight = dinfo.output_height;
+    std::size_t components = dinfo.output_components;
+    state->source.resize(srcWidth * srcHeight * components);
+    while (dinfo.output_scanline < dinfo.output_height) {
+        JSAMPROW row = &state->source[dinfo.output_scanline * srcWidth * components];
+        jpeg_read_scanlines(&dinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&dinfo);
+
+    // average the source pixels covered by each target pixel
+    std::size_t dstWidth = width;
+    std::size_t dstHeight = height;
+    state->target.resize(dstWidth * dstHeight * components);
+    for (std::size_t y = 0; y < dstHeight; y++) {
+        std::size_t y0 = y * srcHeight / dstHeight;
+        std::size_t y1 = std::max(y0 + 1, (y + 1) * srcHeight / dstHeight);
+        for (std::size_t x = 0; x < dstWidth; x++) {
+            std::size_t x0 = x * srcWidth / dstWidth;
+            std::size_t x1 = std::max(x0 + 1, (x + 1) * srcWidth / dstWidth);
+            std::size_t count = (y1 - y0) * (x1 - x0);
+            for (std::size_t c = 0; c < components; c++) {
+                std::size_t sum = 0;
+                for (std::size_t sy = y0; sy < y1; sy++) {
+                    for (std::size_t sx = x0; sx < x1; sx++)
+                        sum += state->source[(sy * srcWidth + sx) * components + c];
+                }
+                state->target[(y * dstWidth + x) * components + c] = static_cast<JSAMPLE>((sum + count / 2) / count);
+            }
+        }
+    }
+
+    auto& cinfo = state->cinfo;
+    jpeg_mem_dest(&cinfo, &state->output, &state->outputSize);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = static_cast<int>(components);
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, std::clamp(quality, 1, 100), TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &state->target[cinfo.next_scanline * dstWidth * components];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+
+    auto data = reinterpret_cast<const std::byte*>(state->output);
+    return std::vector<std::byte>(data, data + state->outputSize);
+}
+
+JpegScaleHandler::JpegScaleHandler(const std::shared_ptr<Context>& context)
+    : MetadataHandler(context)
+{
+    auto server = context->getServer();
+    auto content = server != nullptr ? server->getContent() : nullptr;
+    if (content != nullptr)
+        images = content->getImageCache();
+}
+
+void JpegScaleHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
+{
+    auto item = std::dynamic_pointer_cast<CdsItem>(obj);
+    if (item == nullptr || item->getResourceCount() == 0)
+        return;
+    // an item read from the database carries the sizes of the last import
+    while (item->hasResource(CH_JPEGSCALE))
+        item->removeResource(CH_JPEGSCALE);
+
+    // libexif or exiv2 may know the size already
+    auto original = item->getResource(0);
+    int width;
+    int height;
+    auto resolution = original->getAttribute(R_RESOLUTION);
+    if (resolution.empty() || !checkResolution(resolution, &width, &height)) {
+        if (!readJpegSize(item->getLocation(), width, height))
+            return;
+        original->addAttribute(R_RESOLUTION, fmt::format("{}x{}", width, height));
+    }
+
+    for (auto&& [boxWidth, boxHeight] : jpegProfiles) {
+        if (width <= boxWidth && height <= boxHeight)
+            break;
+
+        auto [x, y] = fitJpegSize(width, height, boxWidth, boxHeight);
+        auto resource = std::make_shared<CdsResource>(CH_JPEGSCALE);
+        resource->addAttribute(R_PROTOCOLINFO, renderProtocolInfo(item->getMimeType()));
+        resource->addAttribute(R_RESOLUTION, fmt::format("{}x{}", x, y));
+        if (boxWidth == jpegProfiles.front().first)
+            resource->addOption(RESOURCE_CONTENT_TYPE, THUMBNAIL);
+        item->addResource(resource);
+        log_debug("Adding resource for {}x{} image of {}", x, y, item->getLocation().c_str());
+    }
+}
+
+std::unique_ptr<IOHandler> JpegScaleHandler::serveContent(std::shared_ptr<CdsObject> obj, int resNum)
+{
+    auto item = std::dynamic_pointer_cast<CdsItem>(obj);
+    if (item == nullptr)
+        return nullptr;
+    if (images == nullptr)
+        throw_std_runtime_error("Image scaling is disabled");
+
+    auto resolution = item->getResource(resNum)->getAttribute(R_RESOLUTION);
+    auto data = std::make_shared<const std::vector<std::byte>>(images->get(item->getLocation(), resolution));
+    return std::make_unique<MemIOHandler>(std::move(data));
+}
+
+std::vector<std::byte> JpegScaleHandler::generateImage(const std::shared_ptr<Config>& config, const fs::path& file, const std::string& variant)
+{
+    int width;
+    int height;
+    if (!checkResolution(variant, &width, &height))
+        throw_std_runtime_error("Invalid image size {}", variant);
+    return scaleJpeg(file, width, height, config->getIntOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_QUALITY));
+}
+
+#endif // HAVE_LIBJPEG
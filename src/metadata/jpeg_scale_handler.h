@@ -0,0 +1,69 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    jpeg_scale_handler.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file jpeg_scale_handler.h
+/// \brief Definition of the JpegScaleHandler class.
+
+#ifndef __JPEG_SCALE_HANDLER_H__
+#define __JPEG_SCALE_HANDLER_H__
+
+#ifdef HAVE_LIBJPEG
+
+#include <cstddef>
+#include <filesystem>
+#include <utility>
+#include <vector>
+namespace fs = std::filesystem;
+
+#include "metadata_handler.h"
+
+// forward declaration
+class ThumbnailCache;
+
+/// \brief Serves JPEG images downscaled to the sizes of the DLNA profiles
+///
+/// Each profile smaller than the image gets its own resource, so a client can pick
+/// a small image instead of loading the original photo. The images are scaled on the
+/// first request, or in the background after the import, and kept in a disk cache.
+class JpegScaleHandler : public MetadataHandler {
+public:
+    explicit JpegScaleHandler(const std::shared_ptr<Context>& context);
+    void fillMetadata(std::shared_ptr<CdsObject> obj) override;
+    std::unique_ptr<IOHandler> serveContent(std::shared_ptr<CdsObject> obj, int resNum) override;
+
+    /// \brief scale the file to the resolution in variant
+    static std::vector<std::byte> generateImage(const std::shared_ptr<Config>& config, const fs::path& file, const std::string& variant);
+
+private:
+    std::shared_ptr<ThumbnailCache> images;
+};
+
+/// \brief size of the image fitted into the box keeping its aspect ratio
+std::pair<int, int> fitJpegSize(int width, int height, int boxWidth, int boxHeight);
+/// \brief read the size of a JPEG image from its header
+bool readJpegSize(const fs::path& file, int& width, int& height);
+/// \brief decode the image at the smallest scale covering the size and encode it at that size
+std::vector<std::byte> scaleJpeg(const fs::path& file, int width, int height, int quality);
+
+#endif // HAVE_LIBJPEG
+#endif // __JPEG_SCALE_HANDLER_H__
@@ -44,7 +44,6 @@
 
 #include "cds_objects.h"
 #include "config/config_manager.h"
-#include "iohandler/mem_io_handler.h"
 #include "util/mime.h"
 #include "util/string_converter.h"
 #include "util/tools.h"
@@ -135,13 +134,16 @@ std::unique_ptr<IOHandler> MatroskaHandler::serveContent(std::shared_ptr<CdsObje
     if (item == nullptr)
         return nullptr;
 
-    std::unique_ptr<MemIOHandler> io_handler;
-    parseMKV(item, &io_handler);
-
-    return io_handler;
+    return serveArt(item, CH_MATROSKA, [this, &item]() {
+        std::vector<std::byte> art;
+        parseMKV(item, &art);
+        if (art.empty())
+            throw_std_runtime_error("{} has no cover attachment", item->getLocation().c_str());
+        return art;
+    });
 }
 
-void MatroskaHandler::parseMKV(const std::shared_ptr<CdsItem>& item, std::unique_ptr<MemIOHandler>* p_io_handler) const
+void MatroskaHandler::parseMKV(const std::shared_ptr<CdsItem>& item, std::vector<std::byte>* p_art) const
 {
     file_io_callback ebml_file(item->getLocation().c_str());
     EbmlStream ebml_stream(ebml_file);
@@ -151,7 +153,7 @@ void MatroskaHandler::parseMKV(const std::shared_ptr<CdsItem>& item, std::unique
         int i_upper_level = 0;
         auto el_l1 = ebml_stream.FindNextElement(el_l0->Generic().Context, i_upper_level, ~0, true);
         while (el_l1 != nullptr) {
-            parseLevel1Element(item, ebml_stream, el_l1, p_io_handler);
+            parseLevel1Element(item, ebml_stream, el_l1, p_art);
 
             el_l1->SkipData(ebml_stream, el_l1->Generic().Context);
             delete el_l1;
@@ -168,7 +170,7 @@ void MatroskaHandler::parseMKV(const std::shared_ptr<CdsItem>& item, std::unique
     ebml_file.close();
 }
 
-void MatroskaHandler::parseLevel1Element(const std::shared_ptr<CdsItem>& item, EbmlStream& ebml_stream, EbmlElement* el_l1, std::unique_ptr<MemIOHandler>* p_io_handler) const
+void MatroskaHandler::parseLevel1Element(const std::shared_ptr<CdsItem>& item, EbmlStream& ebml_stream, EbmlElement* el_l1, std::vector<std::byte>* p_art) const
 {
     // Looking at just at EbmlId is not reliable since it can be a dummy element.
     if (!el_l1->IsMaster())
@@ -181,7 +183,7 @@ void MatroskaHandler::parseLevel1Element(const std::shared_ptr<CdsItem>& item, E
     if (EbmlId(*master) == LIBMATROSKA_NAMESPACE::KaxInfo::ClassInfos.GlobalId) {
         parseInfo(item, ebml_stream, master);
     } else if (EbmlId(*master) == LIBMATROSKA_NAMESPACE::KaxAttachments::ClassInfos.GlobalId) {
-        parseAttachments(item, ebml_stream, master, p_io_handler);
+        parseAttachments(item, ebml_stream, master, p_art);
     }
 }
 
@@ -220,7 +222,7 @@ void MatroskaHandler::parseInfo(const std::shared_ptr<CdsItem>& item, EbmlStream
     }
 }
 
-void MatroskaHandler::parseAttachments(const std::shared_ptr<CdsItem>& item, EbmlStream& ebml_stream, EbmlMaster* attachments, std::unique_ptr<MemIOHandler>* p_io_handler) const
+void MatroskaHandler::parseAttachments(const std::shared_ptr<CdsItem>& item, EbmlStream& ebml_stream, EbmlMaster* attachments, std::vector<std::byte>* p_art) const
 {
     EbmlElement* dummy_el;
     int i_upper_level = 0;
@@ -236,9 +238,10 @@ void MatroskaHandler::parseAttachments(const std::shared_ptr<CdsItem>& item, Ebm
             auto&& fileData = GetChild<LIBMATROSKA_NAMESPACE::KaxFileData>(*attachedFile);
             log_debug("KaxFileData (size={})", fileData.GetSize());
 
-            if (p_io_handler != nullptr) {
+            if (p_art != nullptr) {
                 // serveContent
-                *p_io_handler = std::make_unique<MemIOHandler>(fileData.GetBuffer(), fileData.GetSize());
+                auto data = reinterpret_cast<const std::byte*>(fileData.GetBuffer());
+                p_art->assign(data, data + fileData.GetSize());
             } else {
                 // fillMetadata
                 std::string art_mimetype = getContentTypeFromByteVector(&fileData);
@@ -0,0 +1,121 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    media_file.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file media_file.cc
+
+#include "media_file.h" // API
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/logger.h"
+
+// enough for the magic of all common formats and id3v2 / mp4 headers without cover art
+#define MEDIA_FILE_HEADER_SIZE (64 * 1024)
+// id3v1, ape and lyrics tags or a trailing mp4 moov atom
+#define MEDIA_FILE_TAIL_SIZE (64 * 1024)
+
+MediaFile::MediaFile(fs::path path)
+    : path(std::move(path))
+{
+}
+
+MediaFile::~MediaFile()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool MediaFile::open()
+{
+    if (opened)
+        return isOpen();
+    opened = true;
+
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_debug("Could not open {}: {}", path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        log_debug("Could not stat {}: {}", path.c_str(), std::strerror(errno));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    size = statbuf.st_size;
+
+    header.resize(std::min<off_t>(size, MEDIA_FILE_HEADER_SIZE));
+    header.resize(readFile(0, header.data(), header.size()));
+    return true;
+}
+
+std::size_t MediaFile::read(off_t offset, char* buffer, std::size_t length)
+{
+    if (!open() || offset < 0 || offset >= size)
+        return 0;
+    length = std::min<off_t>(length, size - offset);
+
+    if (offset + off_t(length) <= off_t(header.size())) {
+        std::memcpy(buffer, header.data() + offset, length);
+        return length;
+    }
+
+    if (size > MEDIA_FILE_HEADER_SIZE && offset >= size - MEDIA_FILE_TAIL_SIZE) {
+        if (tail.empty()) {
+            tailOffset = std::max<off_t>(size - MEDIA_FILE_TAIL_SIZE, header.size());
+            tail.resize(size - tailOffset);
+            tail.resize(readFile(tailOffset, tail.data(), tail.size()));
+        }
+        if (offset >= tailOffset && offset + off_t(length) <= tailOffset + off_t(tail.size())) {
+            std::memcpy(buffer, tail.data() + (offset - tailOffset), length);
+            return length;
+        }
+    }
+
+    return readFile(offset, buffer, length);
+}
+
+std::size_t MediaFile::readFile(off_t offset, char* buffer, std::size_t length) const
+{
+    std::size_t done = 0;
+    while (done < length) {
+        auto count = ::pread(fd, buffer + done, length - done, offset + done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0) {
+            log_debug("Could not read {}: {}", path.c_str(), std::strerror(errno));
+            break;
+        }
+        if (count == 0)
+            break;
+        done += count;
+    }
+    return done;
+}
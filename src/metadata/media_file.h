@@ -0,0 +1,80 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    media_file.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file media_file.h
+/// \brief Definition of the MediaFile class.
+
+#ifndef __METADATA_MEDIA_FILE_H__
+#define __METADATA_MEDIA_FILE_H__
+
+#include <filesystem>
+#include <sys/types.h>
+#include <vector>
+namespace fs = std::filesystem;
+
+/// \brief Extraction context of a file that is imported
+///
+/// The file is opened once and shared by mime detection and all metadata handlers.
+/// Header and tail of the file are read ahead, because that is where most
+/// containers keep their tags and stream descriptions.
+class MediaFile {
+public:
+    explicit MediaFile(fs::path path);
+    ~MediaFile();
+
+    MediaFile(const MediaFile&) = delete;
+    MediaFile& operator=(const MediaFile&) = delete;
+
+    /// \brief open the file and read the header, only the first call opens
+    /// \return false if the file cannot be read
+    bool open();
+    bool isOpen() const { return fd >= 0; }
+
+    const fs::path& getPath() const { return path; }
+    off_t getSize() const { return size; }
+
+    /// \brief first bytes of the file, empty if it cannot be read
+    const std::vector<char>& getHeader()
+    {
+        open();
+        return header;
+    }
+
+    /// \brief read up to length bytes at offset, from the read ahead regions where possible
+    /// \return number of bytes read, 0 at end of file or on error
+    std::size_t read(off_t offset, char* buffer, std::size_t length);
+
+private:
+    fs::path path;
+    int fd { -1 };
+    bool opened {};
+    off_t size {};
+
+    std::vector<char> header;
+    std::vector<char> tail;
+    off_t tailOffset {};
+
+    std::size_t readFile(off_t offset, char* buffer, std::size_t length) const;
+};
+
+#endif // __METADATA_MEDIA_FILE_H__
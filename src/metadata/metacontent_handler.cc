@@ -34,6 +34,14 @@
 #include "util/mime.h"
 #include "util/tools.h"
 
+// folders with a cached listing
+#define METACONTENT_LISTING_CACHE_SIZE 32
+// a listing is read again after this time even if the folder mtime did not change
+#define METACONTENT_LISTING_TTL std::chrono::seconds(30)
+
+std::mutex MetacontentHandler::listingMutex;
+std::map<fs::path, std::shared_ptr<const MetacontentHandler::FolderListing>> MetacontentHandler::listings;
+
 MetacontentHandler::MetacontentHandler(const std::shared_ptr<Context>& context)
     : MetadataHandler(context)
 {
@@ -59,19 +67,13 @@ fs::path MetacontentHandler::getContentPath(const std::vector<std::string>& name
                 return found;
             }
         } else {
-            auto fileNames = std::map<std::string, fs::path>();
-            std::error_code ec;
-            for (auto&& p : fs::directory_iterator(folder, ec))
-                if (isRegularFile(p, ec))
-                    fileNames[toLower(p.path().filename())] = p;
-
+            auto listing = getFolderListing(folder);
             for (auto&& name : names) {
                 auto fileName = toLower(expandName(name, obj));
-                for (auto&& [f, s] : fileNames) {
-                    if (f == fileName) {
-                        log_debug("{}: found", f.c_str());
-                        return s;
-                    }
+                auto entry = listing->files.find(fileName);
+                if (entry != listing->files.end()) {
+                    log_debug("{}: found", fileName.c_str());
+                    return entry->second;
                 }
             }
         }
@@ -79,6 +81,46 @@ fs::path MetacontentHandler::getContentPath(const std::vector<std::string>& name
     return "";
 }
 
+std::shared_ptr<const MetacontentHandler::FolderListing> MetacontentHandler::getFolderListing(const fs::path& folder)
+{
+    std::error_code ec;
+    auto mtime = fs::last_write_time(folder, ec);
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(listingMutex);
+        auto cached = listings.find(folder);
+        if (cached != listings.end() && !ec && cached->second->mtime == mtime && cached->second->time + METACONTENT_LISTING_TTL > now)
+            return cached->second;
+    }
+
+    auto listing = std::make_shared<FolderListing>();
+    listing->mtime = mtime;
+    listing->time = now;
+    if (!ec) {
+        std::error_code entryEc;
+        for (auto&& p : fs::directory_iterator(folder, ec))
+            if (isRegularFile(p, entryEc))
+                listing->files.emplace(toLower(p.path().filename()), p);
+    }
+    // not cached, the folder is read again next time
+    if (ec)
+        return listing;
+
+    std::lock_guard<std::mutex> lock(listingMutex);
+    if (listings.size() >= METACONTENT_LISTING_CACHE_SIZE && listings.find(folder) == listings.end()) {
+        auto oldest = std::min_element(listings.begin(), listings.end(), [](auto&& a, auto&& b) { return a.second->time < b.second->time; });
+        listings.erase(oldest);
+    }
+    listings[folder] = listing;
+    return listing;
+}
+
+void MetacontentHandler::invalidateFolder(const fs::path& folder)
+{
+    std::lock_guard<std::mutex> lock(listingMutex);
+    listings.erase(folder);
+}
+
 static constexpr std::array<std::pair<std::string_view, metadata_fields_t>, 5> metaTags { {
     { "%album%", M_ALBUM },
     { "%albumArtist%", M_ALBUMARTIST },
@@ -27,7 +27,11 @@
 #ifndef __METADATA_CONTENT_H__
 #define __METADATA_CONTENT_H__
 
+#include <chrono>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 namespace fs = std::filesystem;
 
 #include "metadata_handler.h"
@@ -38,9 +42,25 @@ public:
     explicit MetacontentHandler(const std::shared_ptr<Context>& context);
     static bool caseSensitive;
 
+    /// \brief drop the cached listing of a folder, e.g. when inotify reports a change in it
+    static void invalidateFolder(const fs::path& folder);
+
 protected:
     static fs::path getContentPath(const std::vector<std::string>& names, const std::shared_ptr<CdsObject>& obj, bool isCaseSensitive, fs::path folder = "");
     static std::string expandName(const std::string& name, const std::shared_ptr<CdsObject>& obj);
+
+private:
+    /// \brief regular files of a folder by lowercase name, for case insensitive lookups
+    struct FolderListing {
+        fs::file_time_type mtime;
+        std::chrono::steady_clock::time_point time;
+        std::unordered_map<std::string, fs::path> files;
+    };
+    /// \brief listing of the folder, shared by all handlers while the folder is not modified
+    static std::shared_ptr<const FolderListing> getFolderListing(const fs::path& folder);
+
+    static std::mutex listingMutex;
+    static std::map<fs::path, std::shared_ptr<const FolderListing>> listings;
 };
 
 /// \brief This class is responsible for populating filesystem based album and fan art
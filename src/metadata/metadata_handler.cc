@@ -32,9 +32,16 @@
 #include "metadata_handler.h" // API
 
 #include <filesystem>
+#include <sys/stat.h>
 
+#include "art_cache.h"
 #include "cds_objects.h"
 #include "config/config_manager.h"
+#include "content/content_manager.h"
+#include "database/database.h"
+#include "iohandler/mem_io_handler.h"
+#include "media_file.h"
+#include "server.h"
 #include "util/tools.h"
 
 #ifdef HAVE_EXIV2
@@ -53,6 +60,10 @@
 #include "metadata/libexif_handler.h"
 #endif
 
+#ifdef HAVE_LIBJPEG
+#include "metadata/jpeg_scale_handler.h"
+#endif
+
 #ifdef HAVE_MATROSKA
 #include "metadata/matroska_handler.h"
 #endif
@@ -63,13 +74,34 @@ MetadataHandler::MetadataHandler(const std::shared_ptr<Context>& context)
     : config(context->getConfig())
     , mime(context->getMime())
 {
+    auto server = context->getServer();
+    auto content = server != nullptr ? server->getContent() : nullptr;
+    if (content != nullptr)
+        artCache = content->getArtCache();
 }
 
-void MetadataHandler::setMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt)
+std::unique_ptr<IOHandler> MetadataHandler::serveArt(const std::shared_ptr<CdsItem>& item, int handlerType, const std::function<std::vector<std::byte>()>& extract) const
+{
+    auto art = artCache != nullptr ? artCache->get(item->getLocation(), handlerType, extract) : std::make_shared<const std::vector<std::byte>>(extract());
+    // the length is known without copying the art
+    return std::make_unique<MemIOHandler>(std::move(art));
+}
+
+bool MetadataHandler::getFileIdentity(const fs::path& path, FileIdentity& identity)
+{
+    struct stat statbuf;
+    if (stat(path.c_str(), &statbuf) != 0)
+        return false;
+
+    identity.device = statbuf.st_dev;
+    identity.inode = statbuf.st_ino;
+    identity.size = statbuf.st_size;
+    identity.mtime = statbuf.st_mtime;
+    return true;
+}
+
+void MetadataHandler::extractMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt, std::shared_ptr<MediaFile> file)
 {
-    std::error_code ec;
-    if (!isRegularFile(dirEnt, ec))
-        throw_std_runtime_error("Not a file: {}", dirEnt.path().c_str());
     auto filesize = getFileSize(dirEnt);
 
     std::string mimetype = item->getMimeType();
@@ -83,13 +115,17 @@ void MetadataHandler::setMetadata(const std::shared_ptr<Context>& context, const
     auto mappings = context->getConfig()->getDictionaryOption(CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST);
     std::string content_type = getValueOrDefault(mappings, mimetype);
 
-    if ((content_type == CONTENT_TYPE_OGG) && (isTheora(item->getLocation()))) {
+    // all handlers read from the same open file
+    if (file == nullptr)
+        file = std::make_shared<MediaFile>(dirEnt.path());
+
+    if ((content_type == CONTENT_TYPE_OGG) && (isTheora(file->getHeader()))) {
         item->setFlag(OBJECT_FLAG_OGG_THEORA);
     }
 
 #ifdef HAVE_TAGLIB
     if ((content_type == CONTENT_TYPE_MP3) || ((content_type == CONTENT_TYPE_OGG) && (!item->getFlag(OBJECT_FLAG_OGG_THEORA))) || (content_type == CONTENT_TYPE_WMA) || (content_type == CONTENT_TYPE_WAVPACK) || (content_type == CONTENT_TYPE_FLAC) || (content_type == CONTENT_TYPE_PCM) || (content_type == CONTENT_TYPE_AIFF) || (content_type == CONTENT_TYPE_APE) || (content_type == CONTENT_TYPE_MP4)) {
-        TagLibHandler(context).fillMetadata(item);
+        TagLibHandler(context).fillMetadata(item, file);
     }
 #endif // HAVE_TAGLIB
 
@@ -113,17 +149,40 @@ void MetadataHandler::setMetadata(const std::shared_ptr<Context>& context, const
 
 #ifdef HAVE_FFMPEG
     if (content_type != CONTENT_TYPE_PLAYLIST && ((content_type == CONTENT_TYPE_OGG && item->getFlag(OBJECT_FLAG_OGG_THEORA)) || startswith(item->getMimeType(), "video") || startswith(item->getMimeType(), "audio"))) {
-        FfmpegHandler(context).fillMetadata(item);
+        FfmpegHandler(context).fillMetadata(item, file);
     }
 #else
     if (content_type == CONTENT_TYPE_AVI) {
-        std::string fourcc = getAVIFourCC(dirEnt.path().string());
+        std::string fourcc = getAVIFourCC(file->getHeader());
         if (!fourcc.empty()) {
             item->getResource(0)->addOption(RESOURCE_OPTION_FOURCC,
                 fourcc);
         }
     }
 #endif // HAVE_FFMPEG
+}
+
+void MetadataHandler::setMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt, std::shared_ptr<MediaFile> file)
+{
+    std::error_code ec;
+    if (!isRegularFile(dirEnt, ec))
+        throw_std_runtime_error("Not a file: {}", dirEnt.path().c_str());
+
+    std::string mimetype = item->getMimeType();
+
+    // the file is parsed again only if it changed since it was cached,
+    // items loaded from the database already carry resources and are not cached
+    auto database = context->getDatabase();
+    FileIdentity identity {};
+    bool useCache = database != nullptr && item->getResourceCount() == 0
+        && context->getConfig()->getBoolOption(CFG_IMPORT_METADATA_CACHE) && getFileIdentity(dirEnt.path(), identity);
+    if (useCache && database->loadCachedMetadata(identity, item)) {
+        log_debug("Cached metadata for {}", dirEnt.path().c_str());
+    } else {
+        extractMetadata(context, item, dirEnt, file);
+        if (useCache)
+            database->storeCachedMetadata(identity, item);
+    }
 
     // Fanart for audio and video
     if (startswith(mimetype, "video") || startswith(mimetype, "audio"))
@@ -133,6 +192,15 @@ void MetadataHandler::setMetadata(const std::shared_ptr<Context>& context, const
     if (startswith(mimetype, "video"))
         SubtitleHandler(context).fillMetadata(item);
 
+#ifdef HAVE_LIBJPEG
+    // Downscaled images, the sizes depend on the configuration and are not cached
+    if (context->getConfig()->getBoolOption(CFG_SERVER_EXTOPTS_IMAGE_SCALING_ENABLED)) {
+        auto mappings = context->getConfig()->getDictionaryOption(CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST);
+        if (getValueOrDefault(mappings, mimetype) == CONTENT_TYPE_JPG)
+            JpegScaleHandler(context).fillMetadata(item);
+    }
+#endif
+
     ResourceHandler(context).fillMetadata(item);
 }
 
@@ -179,6 +247,10 @@ std::unique_ptr<MetadataHandler> MetadataHandler::createHandler(const std::share
         return std::make_unique<FanArtHandler>(context);
     case CH_CONTAINERART:
         return std::make_unique<ContainerArtHandler>(context);
+#ifdef HAVE_LIBJPEG
+    case CH_JPEGSCALE:
+        return std::make_unique<JpegScaleHandler>(context);
+#endif
     case CH_SUBTITLE:
         return std::make_unique<SubtitleHandler>(context);
     case CH_RESOURCE:
@@ -221,6 +293,10 @@ const char* MetadataHandler::mapContentHandler2String(int ch)
         return "Fanart";
     case CH_CONTAINERART:
         return "ContainerArt";
+#ifdef HAVE_LIBJPEG
+    case CH_JPEGSCALE:
+        return "JpegScale";
+#endif
 #ifdef HAVE_MATROSKA
     case CH_MATROSKA:
         return "Matroska";
@@ -34,15 +34,20 @@
 
 #include <array>
 #include <filesystem>
+#include <functional>
+#include <vector>
 namespace fs = std::filesystem;
 
 #include "common.h"
 #include "context.h"
 
 // forward declaration
+class ArtCache;
 class CdsItem;
 class CdsObject;
 class IOHandler;
+class MediaFile;
+struct FileIdentity;
 
 // content handler Id's
 #define CH_DEFAULT 0
@@ -57,6 +62,7 @@ class IOHandler;
 #define CH_MATROSKA 9
 #define CH_SUBTITLE 10
 #define CH_CONTAINERART 11
+#define CH_JPEGSCALE 12
 #define CH_RESOURCE 20
 
 #define CONTENT_TYPE_MP3 "mp3"
@@ -185,13 +191,19 @@ class MetadataHandler {
 protected:
     std::shared_ptr<Config> config;
     std::shared_ptr<Mime> mime;
+    std::shared_ptr<ArtCache> artCache;
+
+    /// \brief serve the art embedded in the file of item, extracted once per version of the file
+    std::unique_ptr<IOHandler> serveArt(const std::shared_ptr<CdsItem>& item, int handlerType, const std::function<std::vector<std::byte>()>& extract) const;
 
 public:
     /// \brief Definition of the supported metadata fields.
 
     explicit MetadataHandler(const std::shared_ptr<Context>& context);
 
-    static void setMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt);
+    /// \brief run all handlers for the content type of item
+    /// \param file extraction context shared with mime detection, opened here if not given
+    static void setMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt, std::shared_ptr<MediaFile> file = nullptr);
     static std::string getMetaFieldName(metadata_fields_t field);
     static std::string getResAttrName(resource_attributes_t attr);
     static std::unique_ptr<MetadataHandler> createHandler(const std::shared_ptr<Context>& context, int handlerType);
@@ -203,6 +215,13 @@ public:
     static const char* mapContentHandler2String(int ch);
 
     virtual ~MetadataHandler() = default;
+
+    /// \brief device, inode, size and mtime of the file at path
+    static bool getFileIdentity(const fs::path& path, FileIdentity& identity);
+
+private:
+    /// \brief run the handlers that parse the file itself
+    static void extractMetadata(const std::shared_ptr<Context>& context, const std::shared_ptr<CdsItem>& item, const fs::directory_entry& dirEnt, std::shared_ptr<MediaFile> file);
 };
 
 #endif // __METADATA_HANDLER_H__
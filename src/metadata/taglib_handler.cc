@@ -49,7 +49,7 @@
 
 #include "cds_objects.h"
 #include "config/config_manager.h"
-#include "iohandler/mem_io_handler.h"
+#include "media_file.h"
 #include "util/mime.h"
 #include "util/string_converter.h"
 #include "util/tools.h"
@@ -206,7 +206,64 @@ void TagLibHandler::populateGenericTags(const std::shared_ptr<CdsItem>& item, co
     }
 }
 
+/// \brief Read only TagLib stream on the extraction context of an import
+class MediaFileStream : public TagLib::IOStream {
+public:
+    explicit MediaFileStream(std::shared_ptr<MediaFile> file)
+        : file(std::move(file))
+    {
+    }
+
+    TagLib::FileName name() const override { return file->getPath().c_str(); }
+
+    TagLib::ByteVector readBlock(unsigned long length) override
+    {
+        // taglib asks for blocks beyond the end of damaged files, do not allocate more than is left
+        length = std::min<unsigned long>(length, std::max<long>(0, file->getSize() - position));
+        TagLib::ByteVector data(static_cast<unsigned int>(length), 0);
+        auto count = file->read(position, data.data(), length);
+        data.resize(static_cast<unsigned int>(count));
+        position += count;
+        return data;
+    }
+
+    void writeBlock(const TagLib::ByteVector& data) override { }
+    void insert(const TagLib::ByteVector& data, unsigned long start, unsigned long replace) override { }
+    void removeBlock(unsigned long start, unsigned long length) override { }
+    bool readOnly() const override { return true; }
+    bool isOpen() const override { return file->isOpen(); }
+
+    void seek(long offset, Position p) override
+    {
+        switch (p) {
+        case Beginning:
+            position = offset;
+            break;
+        case Current:
+            position += offset;
+            break;
+        case End:
+            position = file->getSize() + offset;
+            break;
+        }
+    }
+
+    void clear() override { }
+    long tell() const override { return position; }
+    long length() override { return file->getSize(); }
+    void truncate(long length) override { }
+
+private:
+    std::shared_ptr<MediaFile> file;
+    long position {};
+};
+
 void TagLibHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
+{
+    fillMetadata(obj, std::make_shared<MediaFile>(obj->getLocation()));
+}
+
+void TagLibHandler::fillMetadata(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<MediaFile>& file)
 {
     auto item = std::dynamic_pointer_cast<CdsItem>(obj);
     if (item == nullptr)
@@ -215,7 +272,8 @@ void TagLibHandler::fillMetadata(std::shared_ptr<CdsObject> obj)
     auto mappings = config->getDictionaryOption(CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST);
     std::string content_type = getValueOrDefault(mappings, item->getMimeType());
 
-    TagLib::FileStream fs(item->getLocation().c_str(), true); // true = Read only
+    file->open();
+    MediaFileStream fs(file);
 
     if (content_type == CONTENT_TYPE_MP3) {
         extractMP3(&fs, item);
@@ -278,6 +336,17 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
     if (item == nullptr)
         return nullptr;
 
+    return serveArt(item, CH_ID3, [this, &item]() { return readArt(item); });
+}
+
+static std::vector<std::byte> toBytes(const TagLib::ByteVector& data)
+{
+    auto bytes = reinterpret_cast<const std::byte*>(data.data());
+    return std::vector<std::byte>(bytes, bytes + data.size());
+}
+
+std::vector<std::byte> TagLibHandler::readArt(const std::shared_ptr<CdsItem>& item) const
+{
     auto mappings = config->getDictionaryOption(CFG_IMPORT_MAPPINGS_MIMETYPE_TO_CONTENTTYPE_LIST);
     std::string content_type = getValueOrDefault(mappings, item->getMimeType());
 
@@ -299,7 +368,7 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
 
         auto art = dynamic_cast<TagLib::ID3v2::AttachedPictureFrame*>(list.front());
 
-        return std::make_unique<MemIOHandler>(art->picture().data(), art->picture().size());
+        return toBytes(art->picture());
     }
     if (content_type == CONTENT_TYPE_FLAC) {
         TagLib::FLAC::File f(&roStream, TagLib::ID3v2::FrameFactory::instance());
@@ -313,7 +382,7 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
         TagLib::FLAC::Picture* pic = f.pictureList().front();
         const TagLib::ByteVector& data = pic->data();
 
-        return std::make_unique<MemIOHandler>(data.data(), data.size());
+        return toBytes(data);
     }
     if (content_type == CONTENT_TYPE_MP4) {
         TagLib::MP4::File f(&roStream);
@@ -341,7 +410,7 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
         const TagLib::MP4::CoverArt& coverArt = coverArtList.front();
         const TagLib::ByteVector& data = coverArt.data();
 
-        return std::make_unique<MemIOHandler>(data.data(), data.size());
+        return toBytes(data);
     }
     if (content_type == CONTENT_TYPE_WMA) {
         TagLib::ASF::File f(&roStream);
@@ -363,7 +432,7 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
 
         const TagLib::ByteVector& data = wmpic.picture();
 
-        return std::make_unique<MemIOHandler>(data.data(), data.size());
+        return toBytes(data);
     }
     if (content_type == CONTENT_TYPE_OGG) {
         TagLib::Ogg::Vorbis::File f(&roStream);
@@ -378,7 +447,7 @@ std::unique_ptr<IOHandler> TagLibHandler::serveContent(std::shared_ptr<CdsObject
         const TagLib::FLAC::Picture* pic = picList.front();
         const TagLib::ByteVector& data = pic->data();
 
-        return std::make_unique<MemIOHandler>(data.data(), data.size());
+        return toBytes(data);
     }
 
     throw_std_runtime_error("Unsupported content_type: {}", content_type.c_str());
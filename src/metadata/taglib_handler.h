@@ -36,6 +36,7 @@
 #ifdef HAVE_TAGLIB
 
 #include <string>
+#include <vector>
 
 #include <taglib/tbytevector.h>
 #include <taglib/tfile.h>
@@ -43,11 +44,16 @@
 
 #include "metadata_handler.h"
 
+// forward declaration
+class MediaFile;
+
 /// \brief This class is responsible for reading id3 or ogg tags metadata
 class TagLibHandler : public MetadataHandler {
 public:
     explicit TagLibHandler(const std::shared_ptr<Context>& context);
     void fillMetadata(std::shared_ptr<CdsObject> obj) override;
+    /// \brief read the tags from the extraction context of the import
+    void fillMetadata(const std::shared_ptr<CdsObject>& obj, const std::shared_ptr<MediaFile>& file);
     std::unique_ptr<IOHandler> serveContent(std::shared_ptr<CdsObject> obj, int resNum) override;
 
 private:
@@ -60,6 +66,8 @@ private:
     static bool isValidArtworkContentType(const std::string& art_mimetype);
     std::string getContentTypeFromByteVector(const TagLib::ByteVector& data) const;
     static void addArtworkResource(const std::shared_ptr<CdsItem>& item, const std::string& art_mimetype);
+    /// \brief picture embedded in the tags of the item
+    std::vector<std::byte> readArt(const std::shared_ptr<CdsItem>& item) const;
     void extractMP3(TagLib::IOStream* roStream, const std::shared_ptr<CdsItem>& item) const;
     void extractOgg(TagLib::IOStream* roStream, const std::shared_ptr<CdsItem>& item) const;
     void extractASF(TagLib::IOStream* roStream, const std::shared_ptr<CdsItem>& item) const;
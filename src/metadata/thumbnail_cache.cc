@@ -0,0 +1,352 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    thumbnail_cache.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file thumbnail_cache.cc
+
+#include "thumbnail_cache.h" // API
+
+#include <algorithm>
+#include <tuple>
+
+#include "database/database.h"
+#include "metadata/metadata_handler.h"
+#include "util/tools.h"
+
+// files waiting for background generation, more are left to the requests
+#define THUMBNAIL_QUEUE_SIZE 10000
+#define THUMBNAIL_FILE_EXTENSION ".jpg"
+
+ThumbnailCache::ThumbnailCache(const std::shared_ptr<Config>& config, fs::path base, std::size_t maxSize, int threads, int background, Generator generator)
+    : base(std::move(base))
+    , maxSize(maxSize)
+    , maxRunning(std::max(threads, 1))
+    , generator(std::move(generator))
+{
+    if (this->base.empty())
+        return;
+
+    loadIndex();
+
+    for (int i = 0; i < background; i++) {
+        auto thread = std::make_unique<StdThreadRunner>(fmt::format("ThumbnailWorker{}", i), ThumbnailCache::staticThreadProc, this, config);
+        if (!thread->isAlive()) {
+            log_error("Could not start ThumbnailWorker{}", i);
+            continue;
+        }
+        this->threads.push_back(std::move(thread));
+    }
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    shutdown();
+}
+
+std::string getThumbnailCacheKey(const FileIdentity& identity, const std::string& variant)
+{
+    auto key = fmt::format("{:x}-{:x}-{:x}-{:x}",
+        static_cast<unsigned long long>(identity.device), static_cast<unsigned long long>(identity.inode),
+        static_cast<unsigned long long>(identity.size), static_cast<unsigned long long>(identity.mtime));
+    if (!variant.empty())
+        key.append(fmt::format("-{}", variant));
+    return key;
+}
+
+fs::path getThumbnailCachePath(const fs::path& base, const FileIdentity& identity, const std::string& variant)
+{
+    // spread the files over 256 directories
+    auto dir = fmt::format("{:02x}", static_cast<unsigned long long>(identity.inode) & 0xff);
+    return base / dir / (getThumbnailCacheKey(identity, variant) + THUMBNAIL_FILE_EXTENSION);
+}
+
+void ThumbnailCache::loadIndex()
+{
+    std::vector<std::tuple<fs::file_time_type, std::string, fs::path, std::size_t>> files;
+    std::error_code ec;
+    for (auto&& dirEnt : fs::directory_iterator(base, ec)) {
+        if (!dirEnt.is_directory(ec))
+            continue;
+        for (auto&& fileEnt : fs::directory_iterator(dirEnt.path(), ec)) {
+            std::error_code fileEc;
+            if (fileEnt.path().extension() != THUMBNAIL_FILE_EXTENSION || !fileEnt.is_regular_file(fileEc))
+                continue;
+            auto size = fileEnt.file_size(fileEc);
+            auto mtime = fileEnt.last_write_time(fileEc);
+            if (!fileEc)
+                files.emplace_back(mtime, fileEnt.path().stem().string(), fileEnt.path(), size);
+        }
+    }
+
+    // the oldest files are the first to go
+    std::sort(files.begin(), files.end());
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    for (auto&& [mtime, key, path, size] : files) {
+        lru.push_front(key);
+        entries[key] = Entry { path, size, lru.begin() };
+        totalSize += size;
+    }
+    log_debug("Thumbnail cache {} holds {} files with {} bytes", base.c_str(), entries.size(), totalSize);
+}
+
+std::optional<std::vector<std::byte>> ThumbnailCache::lookup(const fs::path& file, const std::string& variant)
+{
+    FileIdentity identity;
+    if (base.empty() || !MetadataHandler::getFileIdentity(file, identity))
+        return std::nullopt;
+
+    return readEntry(getThumbnailCacheKey(identity, variant));
+}
+
+std::optional<std::vector<std::byte>> ThumbnailCache::readEntry(const std::string& key)
+{
+    fs::path path;
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        auto entry = entries.find(key);
+        if (entry == entries.end())
+            return std::nullopt;
+        lru.splice(lru.begin(), lru, entry->second.lru);
+        path = entry->second.path;
+    }
+
+    auto data = readBinaryFile(path);
+    if (!data) {
+        // removed behind our back
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        auto entry = entries.find(key);
+        if (entry != entries.end()) {
+            totalSize -= entry->second.size;
+            lru.erase(entry->second.lru);
+            entries.erase(entry);
+        }
+        return std::nullopt;
+    }
+
+    // keep the order of use for the next start
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return data;
+}
+
+void ThumbnailCache::storeEntry(const std::string& key, const fs::path& path, const std::vector<std::byte>& data)
+{
+    if (base.empty() || data.empty())
+        return;
+
+    try {
+        fs::create_directories(path.parent_path());
+        // a request must never read a partial file
+        auto tmpPath = path;
+        tmpPath += ".tmp";
+        writeBinaryFile(tmpPath, data.data(), data.size());
+        fs::rename(tmpPath, path);
+    } catch (const std::runtime_error& e) {
+        log_error("Failed to write thumbnail cache: {}", e.what());
+        return;
+    }
+
+    std::vector<fs::path> evicted;
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        auto entry = entries.find(key);
+        if (entry != entries.end()) {
+            totalSize -= entry->second.size;
+            lru.erase(entry->second.lru);
+            entries.erase(entry);
+        }
+        lru.push_front(key);
+        entries[key] = Entry { path, data.size(), lru.begin() };
+        totalSize += data.size();
+
+        while (maxSize > 0 && totalSize > maxSize && lru.size() > 1) {
+            auto oldest = entries.find(lru.back());
+            evicted.push_back(oldest->second.path);
+            totalSize -= oldest->second.size;
+            entries.erase(oldest);
+            lru.pop_back();
+        }
+    }
+
+    for (auto&& oldPath : evicted) {
+        std::error_code ec;
+        fs::remove(oldPath, ec);
+        log_debug("Removed thumbnail {} from cache", oldPath.c_str());
+    }
+}
+
+std::vector<std::byte> ThumbnailCache::get(const fs::path& file, const std::string& variant)
+{
+    FileIdentity identity;
+    if (!MetadataHandler::getFileIdentity(file, identity))
+        throw_std_runtime_error("Could not access {}", file.c_str());
+    if (base.empty())
+        return generate(file, variant, false);
+
+    auto key = getThumbnailCacheKey(identity, variant);
+    if (auto data = readEntry(key))
+        return std::move(*data);
+    return create(key, getThumbnailCachePath(base, identity, variant), file, variant, false);
+}
+
+std::vector<std::byte> ThumbnailCache::create(const std::string& key, const fs::path& path, const fs::path& file, const std::string& variant, bool background)
+{
+    std::promise<std::vector<std::byte>> promise;
+    {
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        auto pending = generating.find(key);
+        if (pending != generating.end()) {
+            auto result = pending->second;
+            lock.unlock();
+            return result.get();
+        }
+        generating.emplace(key, promise.get_future().share());
+    }
+
+    std::vector<std::byte> data;
+    try {
+        data = generate(file, variant, background);
+        storeEntry(key, path, data);
+        promise.set_value(data);
+    } catch (...) {
+        // waiting requests get the error as well, the next request tries again
+        promise.set_exception(std::current_exception());
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        generating.erase(key);
+        throw;
+    }
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    generating.erase(key);
+    return data;
+}
+
+std::vector<std::byte> ThumbnailCache::generate(const fs::path& file, const std::string& variant, bool background)
+{
+    {
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        // requests go first, the background threads wait until none is waiting
+        if (!background)
+            waitingRequests++;
+        slotCond.wait(lock, [this, background] {
+            return (background && shutdownFlag) || (runningCount < maxRunning && (!background || waitingRequests == 0));
+        });
+        if (!background)
+            waitingRequests--;
+        if (background && shutdownFlag)
+            throw_std_runtime_error("Thumbnail cache is shutting down");
+        runningCount++;
+    }
+
+    auto release = [this]() {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        runningCount--;
+        slotCond.notify_all();
+    };
+    try {
+        log_debug("Generating thumbnail {} for file: {}", variant, file.c_str());
+        auto data = generator(file, variant);
+        release();
+        return data;
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+void ThumbnailCache::enqueue(const fs::path& file, const std::string& variant)
+{
+    if (threads.empty())
+        return;
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (shutdownFlag || queue.size() >= THUMBNAIL_QUEUE_SIZE || !queued.insert(fmt::format("{}:{}", variant, file.string())).second)
+        return;
+    queue.emplace_back(file, variant);
+    queueCond.notify_one();
+}
+
+void ThumbnailCache::shutdown()
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if (shutdownFlag)
+            return;
+        shutdownFlag = true;
+        queue.clear();
+        queued.clear();
+    }
+    queueCond.notify_all();
+    slotCond.notify_all();
+    for (auto&& thread : threads) {
+        thread->join();
+    }
+    threads.clear();
+}
+
+std::size_t ThumbnailCache::getSize() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return totalSize;
+}
+
+std::size_t ThumbnailCache::getCount() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return entries.size();
+}
+
+void* ThumbnailCache::staticThreadProc(void* arg)
+{
+    auto inst = static_cast<ThumbnailCache*>(arg);
+    inst->threadProc();
+    return nullptr;
+}
+
+void ThumbnailCache::threadProc()
+{
+    while (true) {
+        std::unique_lock<decltype(mutex)> lock(mutex);
+        queueCond.wait(lock, [this] { return !queue.empty() || shutdownFlag; });
+        if (shutdownFlag)
+            break;
+        auto [file, variant] = std::move(queue.front());
+        queue.pop_front();
+        queued.erase(fmt::format("{}:{}", variant, file.string()));
+        lock.unlock();
+
+        FileIdentity identity;
+        if (!MetadataHandler::getFileIdentity(file, identity))
+            continue;
+        auto key = getThumbnailCacheKey(identity, variant);
+        {
+            std::lock_guard<decltype(mutex)> entryLock(mutex);
+            if (entries.find(key) != entries.end())
+                continue;
+        }
+        try {
+            create(key, getThumbnailCachePath(base, identity, variant), file, variant, true);
+        } catch (const std::runtime_error& e) {
+            log_debug("No thumbnail for {}: {}", file.c_str(), e.what());
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    thumbnail_cache.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file thumbnail_cache.h
+
+#ifndef __THUMBNAIL_CACHE_H__
+#define __THUMBNAIL_CACHE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+namespace fs = std::filesystem;
+
+#include "util/thread_runner.h"
+
+// forward declaration
+class Config;
+struct FileIdentity;
+
+/// \brief Disk cache of generated thumbnails
+///
+/// Files are keyed by device, inode, size and modification time of the source, so a
+/// renamed file keeps its thumbnail and a changed file gets a new one. The least recently
+/// used files are removed when the cache grows beyond its size. Generation runs in the
+/// calling thread for requests and in background threads for queued files, the number
+/// of generators running at the same time is limited for all of them. A source file can
+/// have several variants, e.g. one per image size, which are cached independently.
+class ThumbnailCache {
+public:
+    using Generator = std::function<std::vector<std::byte>(const fs::path& file, const std::string& variant)>;
+
+    /// \param base directory of the cache files, empty to keep no files
+    /// \param maxSize bytes the cache may hold, 0 for no limit
+    /// \param threads generators that may run at the same time
+    /// \param background threads working on the queued files, 0 for none
+    ThumbnailCache(const std::shared_ptr<Config>& config, fs::path base, std::size_t maxSize, int threads, int background, Generator generator);
+    ~ThumbnailCache();
+
+    ThumbnailCache(const ThumbnailCache&) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+    /// \brief cached thumbnail of the file, never runs the generator
+    std::optional<std::vector<std::byte>> lookup(const fs::path& file, const std::string& variant = "");
+    /// \brief thumbnail of the file, generated and stored on a cache miss
+    std::vector<std::byte> get(const fs::path& file, const std::string& variant = "");
+    /// \brief generate the thumbnail of the file in the background unless it is cached
+    void enqueue(const fs::path& file, const std::string& variant = "");
+    /// \brief stop the background threads, queued files are dropped
+    void shutdown();
+
+    /// \brief bytes held by the cache files
+    std::size_t getSize() const;
+    std::size_t getCount() const;
+
+private:
+    struct Entry {
+        fs::path path;
+        std::size_t size;
+        std::list<std::string>::iterator lru;
+    };
+
+    static void* staticThreadProc(void* arg);
+    void threadProc();
+
+    void loadIndex();
+    std::optional<std::vector<std::byte>> readEntry(const std::string& key);
+    void storeEntry(const std::string& key, const fs::path& path, const std::vector<std::byte>& data);
+    /// \brief generate and store the thumbnail, or wait for the thread already doing so
+    std::vector<std::byte> create(const std::string& key, const fs::path& path, const fs::path& file, const std::string& variant, bool background);
+    /// \brief run the generator once a slot is free
+    std::vector<std::byte> generate(const fs::path& file, const std::string& variant, bool background);
+
+    fs::path base;
+    std::size_t maxSize;
+    int maxRunning;
+    Generator generator;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    /// \brief keys of the entries, most recently used first
+    std::list<std::string> lru;
+    std::size_t totalSize {};
+
+    /// \brief thumbnails being generated, later requests for the same file wait for them
+    std::map<std::string, std::shared_future<std::vector<std::byte>>> generating;
+    int runningCount {};
+    int waitingRequests {};
+    std::condition_variable slotCond;
+
+    std::deque<std::pair<fs::path, std::string>> queue;
+    std::unordered_set<std::string> queued;
+    bool shutdownFlag {};
+    std::condition_variable queueCond;
+    std::vector<std::unique_ptr<StdThreadRunner>> threads;
+};
+
+/// \brief name of the cache file for a source file
+std::string getThumbnailCacheKey(const FileIdentity& identity, const std::string& variant = "");
+/// \brief location of the cache file for a source file
+fs::path getThumbnailCachePath(const fs::path& base, const FileIdentity& identity, const std::string& variant = "");
+
+#endif // __THUMBNAIL_CACHE_H__
@@ -49,6 +49,7 @@
 #include "database/database.h"
 #include "device_description_handler.h"
 #include "file_request_handler.h"
+#include "iohandler/io_handler_cache.h"
 #include "serve_request_handler.h"
 #include "util/mime.h"
 #include "util/upnp_clients.h"
@@ -59,6 +60,11 @@
 #include "url_request_handler.h"
 #endif
 
+// requests for generated content waiting between getInfo and open
+#define GENERATED_CONTENT_ENTRIES 32
+// time the content waits for open, clients not opening it leave it behind
+#define GENERATED_CONTENT_TTL std::chrono::seconds(10)
+
 Server::Server(std::shared_ptr<Config> config)
     : config(std::move(config))
     , server_shutdown_flag(false)
@@ -151,6 +157,7 @@ void Server::run()
 
     log_debug("Creating UpnpXMLBuilder");
     xmlbuilder = std::make_unique<UpnpXMLBuilder>(context, virtualUrl, presentationURL);
+    generatedContent = std::make_unique<IOHandlerCache>(GENERATED_CONTENT_ENTRIES, GENERATED_CONTENT_TTL);
 
     // register root device with the library
     auto desc = xmlbuilder->renderDeviceDescription();
@@ -505,7 +512,7 @@ std::unique_ptr<RequestHandler> Server::createRequestHandler(const char* filenam
     std::unique_ptr<RequestHandler> ret = nullptr;
 
     if (startswith(link, fmt::format("/{}/{}", SERVER_VIRTUAL_DIR, CONTENT_MEDIA_HANDLER))) {
-        ret = std::make_unique<FileRequestHandler>(content, xmlbuilder.get());
+        ret = std::make_unique<FileRequestHandler>(content, xmlbuilder.get(), generatedContent.get());
     } else if (startswith(link, fmt::format("/{}/{}", SERVER_VIRTUAL_DIR, CONTENT_UI_HANDLER))) {
         std::string parameters;
         std::string path;
@@ -43,6 +43,7 @@
 // forward declaration
 class Timer;
 class ContentManager;
+class IOHandlerCache;
 
 /// \brief Provides methods to initialize and shutdown
 /// and to retrieve various information about the server.
@@ -147,6 +148,9 @@ protected:
 
     std::unique_ptr<UpnpXMLBuilder> xmlbuilder;
 
+    /// \brief Generated content waiting for the open following getInfo.
+    std::unique_ptr<IOHandlerCache> generatedContent;
+
     /// \brief ContentDirectoryService instance.
     ///
     /// The ContentDirectoryService class is instantiated in the
@@ -412,6 +412,7 @@ bool UpnpXMLBuilder::renderItemImage(const std::string& virtualURL, const std::s
         if (res->isMetaResource(ID3_ALBUM_ART) //
             || (res->getHandlerType() == CH_LIBEXIF && res->getParameter(RESOURCE_CONTENT_TYPE) == EXIF_THUMBNAIL) //
             || (res->getHandlerType() == CH_FFTH && res->getOption(RESOURCE_CONTENT_TYPE) == THUMBNAIL) //
+            || (res->getHandlerType() == CH_JPEGSCALE && res->getOption(RESOURCE_CONTENT_TYPE) == THUMBNAIL) //
         ) {
             auto res_attrs = res->getAttributes();
             auto res_params = res->getParameters();
@@ -681,6 +682,7 @@ void UpnpXMLBuilder::addResources(const std::shared_ptr<CdsItem>& item, pugi::xm
         if (res->isMetaResource(ID3_ALBUM_ART) //
             || (res->getHandlerType() == CH_LIBEXIF && res->getParameter(RESOURCE_CONTENT_TYPE) == EXIF_THUMBNAIL) //
             || (res->getHandlerType() == CH_FFTH && res->getOption(RESOURCE_CONTENT_TYPE) == THUMBNAIL) //
+            || (res->getHandlerType() == CH_JPEGSCALE && res->getOption(RESOURCE_CONTENT_TYPE) == THUMBNAIL) //
         ) {
             auto aa = parent->append_child(MetadataHandler::getMetaFieldName(M_ALBUMARTURI).c_str());
             aa.append_child(pugi::node_pcdata).set_value((virtualURL + url).c_str());
@@ -718,7 +720,7 @@ void UpnpXMLBuilder::addResources(const std::shared_ptr<CdsItem>& item, pugi::xm
             if ((i > 0) && !resolution.empty() && checkResolution(resolution, &x, &y)) {
                 if ((((res->getHandlerType() == CH_LIBEXIF) && (res->getParameter(RESOURCE_CONTENT_TYPE) == EXIF_THUMBNAIL)) || (res->getOption(RESOURCE_CONTENT_TYPE) == EXIF_THUMBNAIL) || (res->getOption(RESOURCE_CONTENT_TYPE) == THUMBNAIL)) && (x <= 160) && (y <= 160))
                     extend = fmt::format("{}={};", UPNP_DLNA_PROFILE, UPNP_DLNA_PROFILE_JPEG_TN);
-                else if ((x <= 640) && (y <= 420))
+                else if ((x <= 640) && (y <= 480))
                     extend = fmt::format("{}={};", UPNP_DLNA_PROFILE, UPNP_DLNA_PROFILE_JPEG_SM);
                 else if ((x <= 1024) && (y <= 768))
                     extend = fmt::format("{}={};", UPNP_DLNA_PROFILE, UPNP_DLNA_PROFILE_JPEG_MED);
@@ -10,6 +10,8 @@ enum task_type_t {
     Invalid,
     AddFile,
     RemoveObject,
+    MoveObject,
+    UpdateFiles,
     LoadAccounting,
     RescanDirectory,
     FetchOnlineContent
@@ -26,6 +26,7 @@
 #include "mime.h" // API
 
 #include "config/config_manager.h"
+#include "metadata/media_file.h"
 #include "util/tools.h"
 
 Mime::Mime(const std::shared_ptr<Config>& config)
@@ -73,6 +74,7 @@ Mime::~Mime()
 #ifdef HAVE_MAGIC
 std::string Mime::fileToMimeType(const fs::path& path, const std::string& defval)
 {
+    std::lock_guard<std::mutex> lock(magicMutex);
     const char* mimeType = magic_file(magicCookie, path.c_str());
     if (!mimeType || mimeType[0] == '\0') {
         return defval;
@@ -81,14 +83,31 @@ std::string Mime::fileToMimeType(const fs::path& path, const std::string& defval
     return mimeType;
 }
 
+std::string Mime::fileToMimeType(MediaFile& file, const std::string& defval)
+{
+    auto&& header = file.getHeader();
+    // libmagic reports empty and special files from the path only
+    if (header.empty())
+        return fileToMimeType(file.getPath(), defval);
+
+    std::lock_guard<std::mutex> lock(magicMutex);
+    const char* mimeType = magic_buffer(magicCookie, header.data(), header.size());
+    if (!mimeType || mimeType[0] == '\0') {
+        return defval;
+    }
+
+    return mimeType;
+}
+
 std::string Mime::bufferToMimeType(const void* buffer, size_t length)
 {
+    std::lock_guard<std::mutex> lock(magicMutex);
     const char* mimeType = magic_buffer(magicCookie, buffer, length);
     return mimeType;
 }
 #endif
 
-std::string Mime::getMimeType(const fs::path& path, const std::string& defval)
+std::string Mime::getMimeType(const fs::path& path, const std::string& defval, const std::shared_ptr<MediaFile>& file)
 {
     std::string extension = path.extension().string();
     if (!extension.empty())
@@ -100,7 +119,7 @@ std::string Mime::getMimeType(const fs::path& path, const std::string& defval)
     std::string mimeType = getValueOrDefault(extension_mimetype_map, extension, "");
     if (mimeType.empty() && !ignore_unknown_extensions) {
 #ifdef HAVE_MAGIC
-        auto fileMime = fileToMimeType(path, defval);
+        auto fileMime = file != nullptr ? fileToMimeType(*file, defval) : fileToMimeType(path, defval);
         mimeType = fileMime.empty() ? extension : fileMime;
 #else
         mimeType = defval.empty() ? extension : defval;
@@ -29,6 +29,7 @@
 #include <filesystem>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 namespace fs = std::filesystem;
 
@@ -41,6 +42,7 @@ extern "C" {
 
 // forward declaration
 class Config;
+class MediaFile;
 
 class Mime {
 public:
@@ -58,7 +60,9 @@ public:
 #endif // HAVE_MAGIC
 
     std::string mimeTypeToUpnpClass(const std::string& mimeType);
-    std::string getMimeType(const fs::path& path, const std::string& defval = "");
+    /// \brief mime type from the extension mapping or the file content
+    /// \param file opened extraction context of path, if there is one
+    std::string getMimeType(const fs::path& path, const std::string& defval = "", const std::shared_ptr<MediaFile>& file = nullptr);
 
 private:
     bool extension_map_case_sensitive;
@@ -69,9 +73,13 @@ private:
 
 #ifdef HAVE_MAGIC
     magic_t magicCookie;
+    /// \brief the cookie is used by the metadata workers concurrently
+    std::mutex magicMutex;
 
     /// \brief Extracts mimetype from a file using filemagic
     std::string fileToMimeType(const fs::path& path, const std::string& defval = "");
+    /// \brief Extracts mimetype from the header of an extraction context using filemagic
+    std::string fileToMimeType(MediaFile& file, const std::string& defval = "");
 #endif
 };
 
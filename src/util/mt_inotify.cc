@@ -27,43 +27,35 @@
     $Id$
 */
 
-/*
-    The original version of the next_events function was taken from the 
-    inotify-tools package, http://inotify-tools.sf.net/
-    The original author is Rohan McGovern  <rohan@mcgovern.id.au>
-    inotify tools are licensed under GNU GPL Version 2
-*/
-
 /// \file mt_inotify.cc
 
 #ifdef HAVE_INOTIFY
 #include "mt_inotify.h"
 
-#include <array>
-#include <cassert>
 #include <cerrno>
+#include <fcntl.h>
 #include <sys/inotify.h>
-#include <sys/ioctl.h>
-#include <sys/select.h>
 #include <unistd.h>
-#ifdef SOLARIS
-#include <sys/filio.h> // FIONREAD
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
 #endif
 
 #include "tools.h"
 
-#define MAX_EVENTS 4096
-#define MAX_STRLEN 4096
-
 Inotify::Inotify()
 #ifdef __linux__
-    : inotify_fd(inotify_init1(IN_CLOEXEC))
+    : inotify_fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK))
 #else
     : inotify_fd(inotify_init())
 #endif
 {
     if (inotify_fd < 0)
         throw_std_runtime_error("Unable to initialize inotify");
+#ifndef __linux__
+    fcntl(inotify_fd, F_SETFL, fcntl(inotify_fd, F_GETFL) | O_NONBLOCK);
+#endif
 
 #ifdef __linux__
     if (pipe2(stop_fds_pipe, IN_CLOEXEC) < 0)
@@ -74,12 +66,32 @@ Inotify::Inotify()
 
     stop_fd_read = stop_fds_pipe[0];
     stop_fd_write = stop_fds_pipe[1];
+
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        throw_std_runtime_error("Unable to create epoll instance");
+
+    for (int fd : { inotify_fd, stop_fd_read }) {
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throw_std_runtime_error("Unable to add fd to epoll: {}", std::strerror(errno));
+    }
+#endif
+
+    events.reserve(INOTIFY_BUFFER_SIZE / sizeof(struct inotify_event));
 }
 
 Inotify::~Inotify()
 {
+    if (epoll_fd >= 0)
+        close(epoll_fd);
     if (inotify_fd >= 0)
         close(inotify_fd);
+    close(stop_fd_read);
+    close(stop_fd_write);
 }
 
 bool Inotify::supported()
@@ -118,115 +130,64 @@ void Inotify::removeWatch(int wd) const
     }
 }
 
-struct inotify_event* Inotify::nextEvent()
+const std::vector<const struct inotify_event*>& Inotify::nextEvents(int timeout)
 {
-    static std::array<inotify_event, MAX_EVENTS> event;
-    static struct inotify_event* ret;
-    static int first_byte = 0;
-    static ssize_t bytes;
-
-    int fd_max;
-
-    // first_byte is index into event buffer
-    if (first_byte != 0
-        && first_byte <= int(bytes - sizeof(struct inotify_event))) {
-
-        ret = reinterpret_cast<struct inotify_event*>(reinterpret_cast<char*>(&event[0]) + first_byte);
-        first_byte += sizeof(struct inotify_event) + ret->len;
-
-        // if the pointer to the next event exactly hits end of bytes read,
-        // that's good.  next time we're called, we'll read.
-        if (first_byte == bytes) {
-            first_byte = 0;
-        } else if (first_byte > bytes) {
-            // oh... no.  this can't be happening.  An incomplete event.
-            // Copy what we currently have into first element, call self to
-            // read remainder.
-            // oh, and they BETTER NOT overlap.
-            // Boy I hope this code works.
-            // But I think this can never happen due to how inotify is written.
-            assert(long(reinterpret_cast<char*>(&event[0]) + sizeof(struct inotify_event) + event[0].len) <= long(ret));
-
-            // how much of the event do we have?
-            bytes = reinterpret_cast<char*>(&event[0]) + bytes - reinterpret_cast<char*>(ret);
-            memcpy(&event[0], ret, bytes);
-            return nextEvent();
-        }
-        return ret;
-    }
+    events.clear();
 
-    if (first_byte == 0) {
-        bytes = 0;
+    bool readable = false;
+    bool stopped = false;
+#ifdef __linux__
+    std::array<epoll_event, 2> ready;
+    int rc = epoll_wait(epoll_fd, ready.data(), ready.size(), timeout);
+    for (int i = 0; i < rc; i++) {
+        if (ready[i].data.fd == inotify_fd)
+            readable = true;
+        else if (ready[i].data.fd == stop_fd_read)
+            stopped = true;
     }
-
-    static ssize_t this_bytes;
-    static unsigned int bytes_to_read;
-    static int rc;
-    static fd_set read_fds;
-
-    FD_ZERO(&read_fds);
-
-    FD_SET(inotify_fd, &read_fds);
-
-    fd_max = inotify_fd;
-
-    FD_SET(stop_fd_read, &read_fds);
-
-    if (stop_fd_read > fd_max)
-        fd_max = stop_fd_read;
-
-    rc = select(fd_max + 1, &read_fds,
-        nullptr, nullptr, nullptr);
-    if (rc < 0) {
-        return nullptr;
+#else
+    std::array<pollfd, 2> fds { { { inotify_fd, POLLIN, 0 }, { stop_fd_read, POLLIN, 0 } } };
+    int rc = poll(fds.data(), fds.size(), timeout);
+    if (rc > 0) {
+        readable = fds[0].revents & POLLIN;
+        stopped = fds[1].revents & POLLIN;
     }
-    if (rc == 0) {
-        // timeout
-        return nullptr;
+#endif
+    if (rc < 0) {
+        if (errno != EINTR)
+            log_error("Inotify: could not wait for events: {}", std::strerror(errno));
+        return events;
     }
 
-    if (FD_ISSET(stop_fd_read, &read_fds)) {
+    if (stopped) {
         char buf;
         if (read(stop_fd_read, &buf, 1) == -1) {
             log_error("Inotify: could not read stop: {}", std::strerror(errno));
         }
     }
 
-    if (FD_ISSET(inotify_fd, &read_fds)) {
+    if (!readable)
+        return events;
 
-        // wait until we have enough bytes to read
-        do {
-            rc = ioctl(inotify_fd, FIONREAD, &bytes_to_read);
-        } while (!rc && bytes_to_read < sizeof(struct inotify_event));
-
-        if (rc == -1) {
-            return nullptr;
-        }
-
-        this_bytes = read(inotify_fd, &event[0] + bytes,
-            sizeof(struct inotify_event) * MAX_EVENTS - bytes);
-        if (this_bytes < 0) {
-            return nullptr;
-        }
-        if (this_bytes == 0) {
-            log_error("Inotify reported end-of-file.  Possibly too many "
-                      "events occurred at once.\n");
-            return nullptr;
-        }
-        bytes += this_bytes;
-
-        ret = &event[0];
-        first_byte = int(sizeof(struct inotify_event) + ret->len);
-        assert(first_byte <= bytes);
-
-        if (first_byte == bytes) {
-            first_byte = 0;
-        }
+    // the kernel only returns complete events
+    ssize_t bytes = read(inotify_fd, buffer.data(), buffer.size());
+    if (bytes < 0) {
+        if (errno != EAGAIN && errno != EINTR)
+            log_error("Inotify: could not read events: {}", std::strerror(errno));
+        return events;
+    }
+    if (bytes == 0) {
+        log_error("Inotify reported end-of-file.  Possibly too many events occurred at once.");
+        return events;
+    }
 
-        return ret;
+    for (ssize_t pos = 0; pos + ssize_t(sizeof(struct inotify_event)) <= bytes;) {
+        auto event = reinterpret_cast<const struct inotify_event*>(buffer.data() + pos);
+        events.push_back(event);
+        pos += sizeof(struct inotify_event) + event->len;
     }
 
-    return nullptr;
+    return events;
 }
 
 void Inotify::stop() const
@@ -34,11 +34,16 @@
 
 #ifdef HAVE_INOTIFY
 
+#include <array>
 #include <filesystem>
 #include <string>
 #include <sys/inotify.h>
+#include <vector>
 namespace fs = std::filesystem;
 
+// large enough for many events, at least one event with the longest name
+#define INOTIFY_BUFFER_SIZE (64 * 1024)
+
 /// \brief Inotify interface.
 class Inotify {
 public:
@@ -58,14 +63,16 @@ public:
     /// \param wd watch descriptor that was returned by the add_watch function
     void removeWatch(int wd) const;
 
-    /// \brief Returns the next inotify event.
+    /// \brief Returns the inotify events that are available.
     ///
-    /// This function will return the next inotify event that occurs, in case
-    /// that there are no events the function will block indefinetely. It can
-    /// be unblocked by the stop function.
-    struct inotify_event* nextEvent();
+    /// This function waits for inotify events and returns all events read at
+    /// once, in case that there are no events the function will block
+    /// indefinetely. It can be unblocked by the stop function.
+    /// \param timeout milliseconds to wait for events, negative to wait indefinitely
+    /// \return events in the internal buffer, valid until the next call, empty on timeout or stop
+    const std::vector<const struct inotify_event*>& nextEvents(int timeout = -1);
 
-    /// \brief Unblock the next_event function.
+    /// \brief Unblock the nextEvents function.
     void stop() const;
 
     /// \brief Checks if inotify is supported on the system.
@@ -73,9 +80,13 @@ public:
 
 private:
     int inotify_fd;
+    int epoll_fd { -1 };
     int stop_fds_pipe[2];
     int stop_fd_read;
     int stop_fd_write;
+
+    alignas(struct inotify_event) std::array<char, INOTIFY_BUFFER_SIZE> buffer;
+    std::vector<const struct inotify_event*> events;
 };
 
 #endif
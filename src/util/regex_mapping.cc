@@ -0,0 +1,81 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    regex_mapping.cc - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file regex_mapping.cc
+
+#include "regex_mapping.h" // API
+
+#include "util/logger.h"
+
+// group numbers change in the combined pattern
+static const auto backReference = std::regex(R"(\\[1-9])");
+
+RegexMapping::RegexMapping(const std::map<std::string, std::string>& mapping, std::regex::flag_type flags)
+{
+    std::string alternation;
+    bool combinable = mapping.size() > 1;
+    for (auto&& [from, to] : mapping) {
+        try {
+            rules.emplace_back(std::regex(from, flags), to);
+        } catch (const std::regex_error& e) {
+            log_error("Invalid regular expression '{}' is ignored: {}", from, e.what());
+            continue;
+        }
+        if (std::regex_search(from, backReference))
+            combinable = false;
+        alternation += fmt::format("{}(?:{})", alternation.empty() ? "" : "|", from);
+    }
+
+    if (combinable && rules.size() > 1) {
+        try {
+            combined.emplace(alternation, flags | std::regex::nosubs);
+        } catch (const std::regex_error& e) {
+            log_debug("Cannot combine patterns: {}", e.what());
+        }
+    }
+}
+
+std::string RegexMapping::replaceAll(const std::string& text) const
+{
+    // no pattern matches, so no replacement changes the text
+    if (combined && !std::regex_search(text, *combined))
+        return text;
+
+    auto result = text;
+    for (auto&& [from, to] : rules) {
+        result = std::regex_replace(result, from, to);
+    }
+    return result;
+}
+
+std::string RegexMapping::replaceFirstMatch(const std::string& text) const
+{
+    if (combined && !std::regex_match(text, *combined))
+        return text;
+
+    for (auto&& [from, to] : rules) {
+        if (std::regex_match(text, from))
+            return std::regex_replace(text, from, to);
+    }
+    return text;
+}
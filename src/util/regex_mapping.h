@@ -0,0 +1,57 @@
+/*GRB*
+
+    Gerbera - https://gerbera.io/
+
+    regex_mapping.h - this file is part of Gerbera.
+
+    Copyright (C) 2021 Gerbera Contributors
+
+    Gerbera is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation.
+
+    Gerbera is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Gerbera.  If not, see <http://www.gnu.org/licenses/>.
+
+    $Id$
+*/
+
+/// \file regex_mapping.h
+
+#ifndef __REGEX_MAPPING_H__
+#define __REGEX_MAPPING_H__
+
+#include <map>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+/// \brief Regular expression replacements from a config dictionary, compiled once.
+///
+/// All patterns are also combined into one alternation, so text that no pattern
+/// matches is checked in a single pass.
+class RegexMapping {
+public:
+    explicit RegexMapping(const std::map<std::string, std::string>& mapping, std::regex::flag_type flags = std::regex::ECMAScript);
+
+    bool empty() const { return rules.empty(); }
+
+    /// \brief apply every replacement in turn on the result of the previous one
+    std::string replaceAll(const std::string& text) const;
+
+    /// \brief apply the replacement of the first pattern matching the whole text
+    /// \return the replaced text or the text itself if no pattern matches
+    std::string replaceFirstMatch(const std::string& text) const;
+
+private:
+    std::vector<std::pair<std::regex, std::string>> rules;
+    std::optional<std::regex> combined;
+};
+
+#endif // __REGEX_MAPPING_H__
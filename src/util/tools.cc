@@ -958,46 +958,13 @@ fs::path tempName(const fs::path& leadPath, char* tmpl)
     return "";
 }
 
-bool isTheora(const fs::path& ogg_filename)
+bool isTheora(const std::vector<char>& header)
 {
-    char buffer[7];
-
-#ifdef __linux__
-    auto f = ::fopen(ogg_filename.c_str(), "rbe");
-#else
-    auto f = ::fopen(ogg_filename.c_str(), "rb");
-#endif
-    if (!f) {
-        throw_std_runtime_error("Error opening {}: {}", ogg_filename.c_str(), std::strerror(errno));
-    }
-
-    if (std::fread(buffer, 1, 4, f) != 4) {
-        fclose(f);
-        throw_std_runtime_error("Error reading {}", ogg_filename.c_str());
-    }
-
-    if (memcmp(buffer, "OggS", 4) != 0) {
-        fclose(f);
-        return false;
-    }
-
-    if (fseek(f, 28, SEEK_SET) != 0) {
-        fclose(f);
-        throw_std_runtime_error("Incomplete file {}", ogg_filename.c_str());
-    }
-
-    if (std::fread(buffer, 1, 7, f) != 7) {
-        fclose(f);
-        throw_std_runtime_error("Error reading {}", ogg_filename.c_str());
-    }
-
-    if (memcmp(buffer, "\x80theora", 7) != 0) {
-        fclose(f);
+    // first page of the ogg stream carries the identification header of the first codec
+    if (header.size() < 35 || std::memcmp(header.data(), "OggS", 4) != 0)
         return false;
-    }
 
-    fclose(f);
-    return true;
+    return std::memcmp(header.data() + 28, "\x80theora", 7) == 0;
 }
 
 fs::path getLastPath(const fs::path& path)
@@ -1089,44 +1056,19 @@ std::string getDLNATransferHeader(const std::shared_ptr<Config>& config, const s
 }
 
 #ifndef HAVE_FFMPEG
-std::string getAVIFourCC(const fs::path& avi_filename)
+std::string getAVIFourCC(const std::vector<char>& header)
 {
 #define FCC_OFFSET 0xbc
-    char* buffer;
-
-#ifdef __linux__
-    auto f = ::fopen(avi_filename.c_str(), "rbe");
-#else
-    auto f = ::fopen(avi_filename.c_str(), "rb");
-#endif
-    if (!f)
-        throw_std_runtime_error("Could not open file {}: {}", avi_filename.c_str(), std::strerror(errno));
-
-    buffer = new char[FCC_OFFSET + 6];
-
-    size_t rb = std::fread(buffer, 1, FCC_OFFSET + 4, f);
-    fclose(f);
-    if (rb != FCC_OFFSET + 4) {
-        delete[] buffer;
-        throw_std_runtime_error("Could not read header of {}: {}", avi_filename.c_str(), std::strerror(errno));
-    }
-
-    buffer[FCC_OFFSET + 5] = '\0';
-
-    if (strncmp(buffer, "RIFF", 4) != 0) {
-        delete[] buffer;
+    if (header.size() < FCC_OFFSET + 4)
         return "";
-    }
 
-    if (strncmp(buffer + 8, "AVI ", 4) != 0) {
-        delete[] buffer;
+    if (std::strncmp(header.data(), "RIFF", 4) != 0)
         return "";
-    }
 
-    std::string fourcc = std::string(buffer + FCC_OFFSET, 4);
-    delete[] buffer;
+    if (std::strncmp(header.data() + 8, "AVI ", 4) != 0)
+        return "";
 
-    return fourcc;
+    return std::string(header.data() + FCC_OFFSET, 4);
 }
 #endif
 
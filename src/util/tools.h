@@ -287,7 +287,8 @@ std::vector<std::string> populateCommandLine(const std::string& line,
 fs::path tempName(const fs::path& leadPath, char* tmpl);
 
 /// \brief Determines if the particular ogg file contains a video (theora)
-bool isTheora(const fs::path& ogg_filename);
+/// \param header first bytes of the file
+bool isTheora(const std::vector<char>& header);
 
 /// \brief Gets an absolute filename as a parameter and returns the last parent
 ///
@@ -307,7 +308,8 @@ std::string getDLNAContentHeader([[maybe_unused]] const std::shared_ptr<Config>&
 ///
 /// This code is based on offsets, so we will use it only if ffmpeg is not
 /// available.
-std::string getAVIFourCC(const fs::path& avi_filename);
+/// \param header first bytes of the file
+std::string getAVIFourCC(const std::vector<char>& header);
 #endif
 
 /// \brief Compare sockaddr
@@ -154,6 +154,34 @@ void web::configLoad::process()
         setValue(item, database->getTotalFiles(true, "image"));
     }
 
+    // write import status
+    {
+        auto item = values.append_child("item");
+        createItem(item, "/status/attribute::tasks", CFG_MAX, CFG_MAX);
+        setValue(item, content->getTaskQueueSize());
+#ifdef HAVE_INOTIFY
+        auto stats = content->getInotifyStats();
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyEvents", CFG_MAX, CFG_MAX);
+        setValue(item, stats.events);
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyCoalesced", CFG_MAX, CFG_MAX);
+        setValue(item, stats.coalesced);
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyChanges", CFG_MAX, CFG_MAX);
+        setValue(item, stats.changes);
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyTasks", CFG_MAX, CFG_MAX);
+        setValue(item, stats.tasks);
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyPending", CFG_MAX, CFG_MAX);
+        setValue(item, stats.pending);
+        item = values.append_child("item");
+        createItem(item, "/status/attribute::inotifyOverflows", CFG_MAX, CFG_MAX);
+        setValue(item, stats.overflows);
+#endif
+    }
+
     // write all values with simple type (string, int, bool)
     for (int i = 0; i < int(CFG_MAX); i++) {
         auto scs = ConfigDefinition::findConfigSetup(config_option_t(i));
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "content/autoscan.h"
+#include "content/autoscan_list.h"
+
+using namespace ::testing;
+
+class AutoscanListTest : public ::testing::Test {
+public:
+    AutoscanListTest() = default;
+    ~AutoscanListTest() override = default;
+
+    void SetUp() override
+    {
+        subject = std::make_shared<AutoscanList>(nullptr);
+    }
+
+    std::shared_ptr<AutoscanDirectory> addDir(const fs::path& location)
+    {
+        auto dir = std::make_shared<AutoscanDirectory>(location, ScanMode::Timed, true, false);
+        subject->add(dir);
+        return dir;
+    }
+
+    std::shared_ptr<AutoscanList> subject;
+};
+
+TEST_F(AutoscanListTest, GetByLocation)
+{
+    auto music = addDir("/media/music");
+    auto video = addDir("/media/video");
+
+    EXPECT_EQ(subject->get("/media/music"), music);
+    EXPECT_EQ(subject->get("/media/video/"), video);
+    EXPECT_EQ(subject->get("/media"), nullptr);
+    EXPECT_EQ(subject->get("/media/music/rock"), nullptr);
+    EXPECT_THROW(addDir("/media/music"), std::runtime_error);
+}
+
+TEST_F(AutoscanListTest, GetContainingReturnsDeepest)
+{
+    auto media = addDir("/media");
+    auto music = addDir("/media/music");
+
+    EXPECT_EQ(subject->getContaining("/media/music/rock/song.mp3"), music);
+    EXPECT_EQ(subject->getContaining("/media/music"), music);
+    EXPECT_EQ(subject->getContaining("/media/musical/song.mp3"), media);
+    EXPECT_EQ(subject->getContaining("/home/user"), nullptr);
+}
+
+TEST_F(AutoscanListTest, RemoveUpdatesIndex)
+{
+    auto media = addDir("/media");
+    auto music = addDir("/media/music");
+
+    subject->remove(music->getScanID());
+    EXPECT_EQ(subject->get("/media/music"), nullptr);
+    EXPECT_EQ(subject->getContaining("/media/music/song.mp3"), media);
+    EXPECT_EQ(subject->size(), 1U);
+}
+
+TEST_F(AutoscanListTest, RemoveIfSubdirMatchesComponents)
+{
+    addDir("/media/music");
+    addDir("/media/music/rock");
+    auto musical = addDir("/media/musical");
+
+    auto removed = subject->removeIfSubdir("/media/music");
+    EXPECT_EQ(removed->size(), 2U);
+    EXPECT_EQ(subject->size(), 1U);
+    EXPECT_EQ(subject->getContaining("/media/music/rock/song.mp3"), nullptr);
+    EXPECT_EQ(subject->get("/media/musical"), musical);
+}
+
+TEST_F(AutoscanListTest, SetLocationMovesIndexEntry)
+{
+    auto dir = addDir("/media/music");
+
+    subject->setLocation(dir, "/srv/music");
+    EXPECT_EQ(subject->get("/media/music"), nullptr);
+    EXPECT_EQ(subject->get("/srv/music"), dir);
+    EXPECT_EQ(subject->getSubdirs("/srv").size(), 1U);
+}
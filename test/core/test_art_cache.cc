@@ -0,0 +1,128 @@
+#include "../mock/temp_dir_test.h"
+#include "metadata/art_cache.h"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+class ArtCacheTest : public TempDirTest {
+public:
+    ArtCacheTest()
+        : TempDirTest("art")
+    {
+    }
+
+    fs::path addFile(const std::string& name)
+    {
+        return writeFile(fs::path("media") / name, name);
+    }
+
+    ArtCache::Extractor cover(char fill, std::size_t size = 100)
+    {
+        return [this, fill, size]() {
+            extracted++;
+            return std::vector<std::byte>(size, std::byte(fill));
+        };
+    }
+
+    int extracted {};
+};
+
+TEST_F(ArtCacheTest, AlbumSharesOneBlob)
+{
+    auto track1 = addFile("01.mp3");
+    auto track2 = addFile("02.mp3");
+    ArtCache subject(dir / "cache", 1024, 0);
+
+    auto art1 = subject.get(track1, 2, cover('a'));
+    auto art2 = subject.get(track2, 2, cover('a'));
+
+    EXPECT_EQ(art1, art2);
+    EXPECT_EQ(subject.getBlobCount(), 1);
+    EXPECT_EQ(subject.getSize(), 100);
+}
+
+TEST_F(ArtCacheTest, KnownFileIsNotParsedAgain)
+{
+    auto track = addFile("01.mp3");
+    {
+        ArtCache subject(dir / "cache", 1024, 0);
+        subject.get(track, 2, cover('a'));
+        subject.get(track, 2, cover('a'));
+        EXPECT_EQ(extracted, 1);
+    }
+
+    // read back from disk
+    ArtCache subject(dir / "cache", 1024, 0);
+    auto art = subject.get(track, 2, cover('b'));
+    EXPECT_EQ(extracted, 1);
+    EXPECT_EQ(art->front(), std::byte('a'));
+}
+
+TEST_F(ArtCacheTest, MemoryIsBounded)
+{
+    ArtCache subject("", 250, 0);
+    for (auto&& name : { "01.mp3", "02.mp3", "03.mp3" }) {
+        auto track = addFile(name);
+        subject.get(track, 2, cover(name[1]));
+    }
+
+    EXPECT_EQ(subject.getBlobCount(), 2);
+    EXPECT_EQ(subject.getSize(), 200);
+}
+
+TEST_F(ArtCacheTest, DiskIsBounded)
+{
+    std::vector<fs::path> tracks;
+    {
+        ArtCache subject(dir / "cache", 1024, 250);
+        for (auto&& name : { "01.mp3", "02.mp3", "03.mp3" }) {
+            tracks.push_back(addFile(name));
+            subject.get(tracks.back(), 2, cover(name[1]));
+        }
+        EXPECT_EQ(subject.getDiskSize(), 200);
+    }
+
+    // the art of the first track was removed, the others are read back from disk
+    ArtCache subject(dir / "cache", 1024, 250);
+    EXPECT_EQ(subject.getDiskSize(), 200);
+    subject.get(tracks[1], 2, cover('x'));
+    subject.get(tracks[2], 2, cover('x'));
+    EXPECT_EQ(extracted, 3);
+    subject.get(tracks[0], 2, cover('1'));
+    EXPECT_EQ(extracted, 4);
+}
+
+TEST_F(ArtCacheTest, RemovedBlobTakesItsFilesAlong)
+{
+    ArtCache subject(dir / "cache", 1024, 250);
+    for (auto&& name : { "01.mp3", "02.mp3", "03.mp3" })
+        subject.get(addFile(name), 2, cover(name[1]));
+
+    auto mappings = 0;
+    for (auto&& dirEnt : fs::recursive_directory_iterator(dir / "cache" / "files")) {
+        if (dirEnt.is_regular_file())
+            mappings++;
+    }
+    EXPECT_EQ(mappings, 2);
+}
+
+TEST_F(ArtCacheTest, BlobInMemoryIsStoredAgain)
+{
+    std::vector<fs::path> tracks;
+    {
+        ArtCache subject(dir / "cache", 1024, 250);
+        for (auto&& name : { "01.mp3", "02.mp3", "03.mp3" }) {
+            tracks.push_back(addFile(name));
+            subject.get(tracks.back(), 2, cover(name[1]));
+        }
+        // removed from disk, but still held in memory
+        subject.get(tracks[0], 2, cover('x'));
+        EXPECT_EQ(extracted, 3);
+    }
+
+    ArtCache subject(dir / "cache", 1024, 250);
+    auto art = subject.get(tracks[0], 2, cover('x'));
+    EXPECT_EQ(extracted, 3);
+    EXPECT_EQ(art->front(), std::byte('1'));
+}
@@ -0,0 +1,48 @@
+#include "iohandler/io_handler_cache.h"
+#include "iohandler/mem_io_handler.h"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+static std::unique_ptr<IOHandler> content(const std::string& text)
+{
+    return std::make_unique<MemIOHandler>(text);
+}
+
+TEST(IOHandlerCache, ContentIsTakenOnce)
+{
+    IOHandlerCache subject(4, std::chrono::seconds(10));
+    subject.put("/content/media/object_id/1/res_id/1", content("thumbnail"));
+
+    EXPECT_EQ(subject.take("/content/media/object_id/2/res_id/1"), nullptr);
+    auto handler = subject.take("/content/media/object_id/1/res_id/1");
+    ASSERT_NE(handler, nullptr);
+    EXPECT_EQ(subject.take("/content/media/object_id/1/res_id/1"), nullptr);
+
+    char buf[16] = {};
+    handler->open(UPNP_READ);
+    EXPECT_EQ(handler->read(buf, sizeof(buf)), 9);
+    EXPECT_EQ(std::string(buf), "thumbnail");
+}
+
+TEST(IOHandlerCache, ExpiredContentIsGeneratedAgain)
+{
+    IOHandlerCache subject(4, std::chrono::milliseconds(0));
+    subject.put("/content/media/object_id/1/res_id/1", content("thumbnail"));
+
+    EXPECT_EQ(subject.take("/content/media/object_id/1/res_id/1"), nullptr);
+}
+
+TEST(IOHandlerCache, OldestContentIsDropped)
+{
+    IOHandlerCache subject(2, std::chrono::seconds(10));
+    subject.put("/a", content("a"));
+    subject.put("/b", content("b"));
+    subject.put("/c", content("c"));
+
+    EXPECT_EQ(subject.size(), 2);
+    EXPECT_EQ(subject.take("/a"), nullptr);
+    EXPECT_NE(subject.take("/b"), nullptr);
+    EXPECT_NE(subject.take("/c"), nullptr);
+}
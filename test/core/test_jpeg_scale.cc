@@ -0,0 +1,92 @@
+#include "../mock/temp_dir_test.h"
+#include "metadata/jpeg_scale_handler.h"
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_LIBJPEG
+
+#include <cstdio>
+#include <jpeglib.h>
+
+using namespace ::testing;
+
+class JpegScaleTest : public TempDirTest {
+public:
+    JpegScaleTest()
+        : TempDirTest("jpeg")
+    {
+    }
+
+    fs::path writeJpeg(const std::string& name, int width, int height)
+    {
+        auto path = dir / name;
+        FILE* file = std::fopen(path.c_str(), "wb");
+
+        struct jpeg_compress_struct cinfo;
+        struct jpeg_error_mgr jerr;
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+        jpeg_stdio_dest(&cinfo, file);
+        cinfo.image_width = width;
+        cinfo.image_height = height;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+        jpeg_start_compress(&cinfo, TRUE);
+        std::vector<JSAMPLE> row(width * 3);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            for (int x = 0; x < width; x++) {
+                row[x * 3] = static_cast<JSAMPLE>(x % 256);
+                row[x * 3 + 1] = static_cast<JSAMPLE>(cinfo.next_scanline % 256);
+                row[x * 3 + 2] = 128;
+            }
+            JSAMPROW rowPtr = row.data();
+            jpeg_write_scanlines(&cinfo, &rowPtr, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+        std::fclose(file);
+        return path;
+    }
+};
+
+TEST(JpegScale, FitsIntoProfileBox)
+{
+    EXPECT_EQ(fitJpegSize(4000, 3000, 160, 160), std::make_pair(160, 120));
+    EXPECT_EQ(fitJpegSize(3000, 4000, 640, 480), std::make_pair(360, 480));
+    EXPECT_EQ(fitJpegSize(2048, 1024, 1024, 768), std::make_pair(1024, 512));
+    EXPECT_EQ(fitJpegSize(100, 50, 160, 160), std::make_pair(100, 50));
+}
+
+TEST_F(JpegScaleTest, ScalesToRequestedSize)
+{
+    auto file = writeJpeg("photo.jpg", 1300, 975);
+    int width;
+    int height;
+    EXPECT_TRUE(readJpegSize(file, width, height));
+    EXPECT_EQ(width, 1300);
+    EXPECT_EQ(height, 975);
+
+    for (auto&& [x, y] : { std::make_pair(160, 120), std::make_pair(640, 480), std::make_pair(1024, 768) }) {
+        auto data = scaleJpeg(file, x, y, 85);
+        auto scaled = dir / fmt::format("{}x{}.jpg", x, y);
+        writeBinaryFile(scaled, data.data(), data.size());
+
+        EXPECT_TRUE(readJpegSize(scaled, width, height));
+        EXPECT_EQ(width, x);
+        EXPECT_EQ(height, y);
+    }
+}
+
+TEST_F(JpegScaleTest, InvalidImageIsRejected)
+{
+    auto file = writeFile("broken.jpg", "not a jpeg");
+
+    int width;
+    int height;
+    EXPECT_FALSE(readJpegSize(file, width, height));
+    EXPECT_THROW(scaleJpeg(file, 160, 120, 85), std::runtime_error);
+    EXPECT_THROW(scaleJpeg(dir / "missing.jpg", 160, 120, 85), std::runtime_error);
+}
+
+#endif // HAVE_LIBJPEG
@@ -412,6 +412,31 @@ TEST(SearchParser, SearchCriteriaUsingStartsWithOperator)
         "(_t_._property_name_='upnp:album' AND LOWER(_t_._property_value_) LIKE LOWER('Midnight%') AND _t_._upnp_class_ IS NOT NULL) OR (_t_._property_name_='upnp:artist' AND LOWER(_t_._property_value_) LIKE LOWER('HEAVE%') AND _t_._upnp_class_ IS NOT NULL)"));
 }
 
+TEST(SearchParser, SearchCriteriaUsingFullTextIndex)
+{
+    auto columnMapper = std::make_shared<EnumColumnMapper<TestCol>>('_', '_', "t", "TestTable", testSortMap, testColMap);
+    auto fullText = std::make_shared<FullTextIndex>();
+    fullText->metaContains = "{0} IN (FTS({1}, '%{2}%'))";
+    fullText->metaStartsWith = "{0} IN (FTS({1}, '{2}%'))";
+    fullText->minLength = 3;
+    DefaultSQLEmitter sqlEmitter(columnMapper, columnMapper, fullText);
+    // containsOpExpr
+    EXPECT_TRUE(executeSearchParserTest(sqlEmitter, "upnp:album contains \"Midnight\"",
+        "(_t_._id_ IN (FTS(_t_._property_value_, '%Midnight%')) AND (_t_._property_name_='upnp:album' AND LOWER(_t_._property_value_) LIKE LOWER('%Midnight%') AND _t_._upnp_class_ IS NOT NULL))"));
+
+    // startsWithOpExpr
+    EXPECT_TRUE(executeSearchParserTest(sqlEmitter, "upnp:album startswith \"Midnight\"",
+        "(_t_._id_ IN (FTS(_t_._property_value_, 'Midnight%')) AND (_t_._property_name_='upnp:album' AND LOWER(_t_._property_value_) LIKE LOWER('Midnight%') AND _t_._upnp_class_ IS NOT NULL))"));
+
+    // value too short for the index
+    EXPECT_TRUE(executeSearchParserTest(sqlEmitter, "upnp:album contains \"Mi\"",
+        "(_t_._property_name_='upnp:album' AND LOWER(_t_._property_value_) LIKE LOWER('%Mi%') AND _t_._upnp_class_ IS NOT NULL)"));
+
+    // doesNotContain is not indexed
+    EXPECT_TRUE(executeSearchParserTest(sqlEmitter, "upnp:album doesnotcontain \"Midnight\"",
+        "(_t_._property_name_='upnp:album' AND LOWER(_t_._property_value_) NOT LIKE LOWER('%Midnight%') AND _t_._upnp_class_ IS NOT NULL)"));
+}
+
 TEST(SearchParser, SearchCriteriaUsingExistsOperator)
 {
     auto columnMapper = std::make_shared<EnumColumnMapper<TestCol>>('_', '_', "t", "TestTable", testSortMap, testColMap);
@@ -468,3 +493,15 @@ TEST(SortParser, SortCriteriaError)
     EXPECT_TRUE(executeSortParserTest("+id,nme,+value",
         "_t_._id_ ASC, _t_._property_value_ ASC"));
 }
+
+TEST(SortParser, SortCriteriaList)
+{
+    auto columnMapper = std::make_shared<EnumColumnMapper<TestCol>>('_', '_', "t", "TestTable", testSortMap, testColMap);
+    auto parser = SortParser(columnMapper, "+id,-name,nme,value");
+    auto expected = std::vector<std::pair<std::string, bool>> {
+        { "_t_._id_", false },
+        { "_t_._property_name_", true },
+        { "_t_._property_value_", false },
+    };
+    EXPECT_EQ(parser.parseList(), expected);
+}
@@ -0,0 +1,294 @@
+#include "../mock/config_mock.h"
+#include "../mock/temp_dir_test.h"
+#include "cds_objects.h"
+#include "database/sqlite3/sqlite_database.h"
+#include "metadata/metadata_handler.h"
+#include "util/tools.h"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+/// \brief fails to write the metadata of an item after its row was inserted
+class FailingSqlite3Database : public Sqlite3Database {
+public:
+    using Sqlite3Database::Sqlite3Database;
+
+    std::string quote(std::string value) const override
+    {
+        if (value == "Failing Artist")
+            throw_std_runtime_error("Failed to quote {}", value);
+        char* q = sqlite3_mprintf("'%q'", value.c_str());
+        std::string ret = q;
+        sqlite3_free(q);
+        return ret;
+    }
+};
+
+class SqliteConfigMock : public ConfigMock {
+public:
+    int getIntOption(config_option_t option) const override
+    {
+        auto it = intOptions.find(option);
+        return it != intOptions.end() ? it->second : 0;
+    }
+    bool getBoolOption(config_option_t option) const override { return boolOptions.find(option) != boolOptions.end(); }
+
+    std::map<config_option_t, int> intOptions;
+    std::set<config_option_t> boolOptions;
+};
+
+class SqliteDatabaseTest : public TempDirTest {
+public:
+    SqliteDatabaseTest()
+        : TempDirTest("sqlite")
+    {
+    }
+
+    void SetUp() override
+    {
+        TempDirTest::SetUp();
+
+        // the mock can not enable the restore option that creates a missing database
+        auto initSql = fs::path(CMAKE_SOURCE_DIR) / "src/database/sqlite3/sqlite3.sql";
+        sqlite3* db;
+        ASSERT_EQ(sqlite3_open((dir / "gerbera.db").c_str(), &db), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(db, readTextFile(initSql).c_str(), nullptr, nullptr, nullptr), SQLITE_OK);
+        sqlite3_close(db);
+
+        config = std::make_shared<NiceMock<SqliteConfigMock>>();
+        ON_CALL(*config, getOption(_)).WillByDefault(Return(""));
+        ON_CALL(*config, getOption(CFG_SERVER_STORAGE_DRIVER)).WillByDefault(Return("sqlite3"));
+        ON_CALL(*config, getOption(CFG_SERVER_STORAGE_SQLITE_DATABASE_FILE)).WillByDefault(Return((dir / "gerbera.db").string()));
+        ON_CALL(*config, getOption(CFG_SERVER_STORAGE_SQLITE_INIT_SQL_FILE)).WillByDefault(Return(initSql.string()));
+        start();
+    }
+
+    void start()
+    {
+        auto sqlite = std::make_shared<FailingSqlite3Database>(config, nullptr);
+        database = sqlite;
+        database->init();
+        subject = sqlite;
+    }
+
+    void TearDown() override
+    {
+        database->shutdown();
+        TempDirTest::TearDown();
+    }
+
+    std::vector<std::shared_ptr<CdsObject>> createItems(int count)
+    {
+        std::vector<std::shared_ptr<CdsObject>> items;
+        for (int i = 0; i < count; i++) {
+            auto item = std::make_shared<CdsItem>();
+            item->setParentID(CDS_ID_FS_ROOT);
+            item->setTitle(fmt::format("Track {}", i));
+            item->setLocation(dir / fmt::format("track{}.mp3", i));
+            item->setMimeType("audio/mpeg");
+            item->setClass(UPNP_CLASS_MUSIC_TRACK);
+            item->setMetadata(M_ARTIST, i == 230 ? "Failing Artist" : "Artist");
+            item->addResource(std::make_shared<CdsResource>(CH_DEFAULT));
+            items.push_back(item);
+        }
+        return items;
+    }
+
+    int countRows(const std::string& query)
+    {
+        auto res = subject->select(query);
+        auto row = res->nextRow();
+        return std::stoi(row->col(0));
+    }
+
+    std::shared_ptr<NiceMock<SqliteConfigMock>> config;
+    std::shared_ptr<Database> database;
+    std::shared_ptr<SQLDatabase> subject;
+};
+
+TEST_F(SqliteDatabaseTest, FailedBulkInsertKeepsCompletedChunksOnly)
+{
+    // the first chunk holds 200 rows, the metadata of the second one fails
+    auto items = createItems(250);
+    int changedContainer;
+    EXPECT_THROW(database->addObjects(items, &changedContainer), std::runtime_error);
+    items[230]->setMetadata(M_ARTIST, "Artist");
+    // the container chain of the location is created for the first item
+    int parentID = items.front()->getParentID();
+    auto countChildren = fmt::format("SELECT COUNT(*) FROM \"mt_cds_object\" WHERE \"parent_id\" = {}", parentID);
+
+    std::vector<std::shared_ptr<CdsObject>> missing;
+    for (auto&& item : items) {
+        if (item->getID() == INVALID_OBJECT_ID)
+            missing.push_back(item);
+    }
+    EXPECT_EQ(missing.size(), 50);
+    EXPECT_EQ(countRows(countChildren), 200);
+    EXPECT_EQ(countRows("SELECT COUNT(*) FROM \"mt_metadata\""), 200);
+    EXPECT_EQ(database->getChildCount(parentID), 200);
+
+    // the caller adds the missing objects one by one
+    for (auto&& item : missing)
+        database->addObject(item, &changedContainer);
+
+    EXPECT_EQ(countRows(countChildren), 250);
+    EXPECT_EQ(countRows(fmt::format("SELECT COUNT(DISTINCT \"location\") FROM \"mt_cds_object\" WHERE \"parent_id\" = {}", parentID)), 250);
+    EXPECT_EQ(countRows("SELECT COUNT(*) FROM \"mt_metadata\""), 250);
+    EXPECT_EQ(database->getChildCount(parentID), 250);
+}
+
+TEST_F(SqliteDatabaseTest, ResultLargerThanBatchKeepsRowsAcrossWrite)
+{
+    subject->exec("WITH RECURSIVE \"n\"(\"i\") AS (SELECT 1 UNION ALL SELECT \"i\" + 1 FROM \"n\" WHERE \"i\" < 2500) "
+                  "INSERT INTO \"mt_internal_setting\" SELECT 'row ' || \"i\", \"i\" FROM \"n\"");
+
+    auto res = subject->select("SELECT \"value\" FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'");
+    std::set<std::string> values;
+    int rows = 0;
+    for (; rows < 1500; rows++)
+        values.insert(res->nextRow()->col(0));
+
+    // the write on the same connection must not change the rows that are still to be read
+    subject->exec("DELETE FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'");
+
+    std::unique_ptr<SQLRow> row;
+    while ((row = res->nextRow()) != nullptr) {
+        values.insert(row->col(0));
+        rows++;
+    }
+    EXPECT_EQ(rows, 2500);
+    EXPECT_EQ(values.size(), 2500);
+    EXPECT_EQ(countRows("SELECT COUNT(*) FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'"), 0);
+}
+
+TEST_F(SqliteDatabaseTest, ReaderResultLargerThanBatchKeepsSnapshot)
+{
+    database->shutdown();
+    config->intOptions[CFG_SERVER_STORAGE_SQLITE_READ_CONNECTIONS] = 2;
+    start();
+    subject->exec("WITH RECURSIVE \"n\"(\"i\") AS (SELECT 1 UNION ALL SELECT \"i\" + 1 FROM \"n\" WHERE \"i\" < 2500) "
+                  "INSERT INTO \"mt_internal_setting\" SELECT 'row ' || \"i\", \"i\" FROM \"n\"");
+
+    auto res = subject->select("SELECT \"value\" FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'");
+    auto abandoned = subject->select("SELECT \"value\" FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'");
+    abandoned->nextRow();
+    abandoned = nullptr;
+
+    std::set<std::string> values;
+    int rows = 0;
+    for (; rows < 1500; rows++)
+        values.insert(res->nextRow()->col(0));
+
+    // the reader keeps reading the rows of its snapshot
+    subject->exec("DELETE FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'");
+    EXPECT_EQ(countRows("SELECT COUNT(*) FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'"), 0);
+
+    std::unique_ptr<SQLRow> row;
+    while ((row = res->nextRow()) != nullptr) {
+        values.insert(row->col(0));
+        rows++;
+    }
+    EXPECT_EQ(rows, 2500);
+    EXPECT_EQ(values.size(), 2500);
+}
+
+TEST_F(SqliteDatabaseTest, PathIndexFollowsAddedAndRemovedObjects)
+{
+    auto items = createItems(3);
+    int changedContainer;
+    database->addObjects(items, &changedContainer);
+    int parentID = items.front()->getParentID();
+
+    EXPECT_EQ(database->findObjectIDByPath(dir / "track1.mp3", true), items[1]->getID());
+    EXPECT_EQ(database->findObjectIDByPath(dir), parentID);
+    EXPECT_EQ(database->findObjectIDByPath(dir / "track3.mp3", true), INVALID_OBJECT_ID);
+
+    database->removeObject(items[1]->getID(), false);
+    EXPECT_EQ(database->findObjectIDByPath(dir / "track1.mp3", true), INVALID_OBJECT_ID);
+    EXPECT_EQ(database->findObjectIDByPath(dir / "track2.mp3", true), items[2]->getID());
+    EXPECT_EQ(database->findObjectIDByPath(dir), parentID);
+
+    auto item = createItems(1).front();
+    item->setLocation(dir / "sub" / "track1.mp3");
+    database->addObject(item, &changedContainer);
+    EXPECT_EQ(database->findObjectIDByPath(dir / "sub" / "track1.mp3", true), item->getID());
+    EXPECT_EQ(database->findObjectIDByPath(dir / "sub"), item->getParentID());
+}
+
+TEST_F(SqliteDatabaseTest, BrowsePagesFollowWrittenChildren)
+{
+    auto items = createItems(4);
+    int changedContainer;
+    database->addObjects(items, &changedContainer);
+    int parentID = items.front()->getParentID();
+
+    auto browsePage = [&](int startingIndex) {
+        auto param = std::make_unique<BrowseParam>(parentID, BROWSE_DIRECT_CHILDREN | BROWSE_ITEMS);
+        param->setRange(startingIndex, 2);
+        std::vector<std::string> titles;
+        for (auto&& obj : database->browse(param))
+            titles.push_back(obj->getTitle());
+        return titles;
+    };
+    EXPECT_EQ(browsePage(0), std::vector<std::string>({ "Track 0", "Track 1" }));
+    EXPECT_EQ(browsePage(2), std::vector<std::string>({ "Track 2", "Track 3" }));
+
+    // the page cursors are dropped before the update id of the container is increased
+    auto item = createItems(1).front();
+    item->setTitle("Track 00");
+    item->setLocation(dir / "track00.mp3");
+    database->addObject(item, &changedContainer);
+    EXPECT_EQ(browsePage(2), std::vector<std::string>({ "Track 1", "Track 2" }));
+
+    database->removeObject(items[1]->getID(), false);
+    EXPECT_EQ(browsePage(2), std::vector<std::string>({ "Track 2", "Track 3" }));
+}
+
+TEST_F(SqliteDatabaseTest, BackupWaitsForTransactionWithoutDelayingIt)
+{
+    database->shutdown();
+    config->boolOptions.insert(CFG_SERVER_STORAGE_USE_TRANSACTIONS);
+    config->intOptions[CFG_SERVER_STORAGE_SQLITE_BACKUP_STEP_PAGES] = -1;
+    start();
+    auto backupFile = dir / "gerbera.db.backup";
+
+    subject->beginTransaction("test");
+    subject->exec("INSERT INTO \"mt_internal_setting\" VALUES ('row 0', '0')");
+    // the backup can not copy the database while the transaction is open
+    std::dynamic_pointer_cast<Sqlite3Database>(subject)->timerNotify(nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i < 100; i++)
+        subject->exec(fmt::format("INSERT INTO \"mt_internal_setting\" VALUES ('row {0}', '{0}')", i));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_FALSE(fs::exists(backupFile));
+    subject->commit("test");
+
+    for (int i = 0; i < 500 && !fs::exists(backupFile); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_TRUE(fs::exists(backupFile));
+    sqlite3* db;
+    ASSERT_EQ(sqlite3_open(backupFile.c_str(), &db), SQLITE_OK);
+    sqlite3_stmt* stmt;
+    ASSERT_EQ(sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM \"mt_internal_setting\" WHERE \"key\" LIKE 'row %'", -1, &stmt, nullptr), SQLITE_OK);
+    ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+    EXPECT_EQ(sqlite3_column_int(stmt, 0), 100);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+TEST_F(SqliteDatabaseTest, RemovedChildInvalidatesDirectoryState)
+{
+    auto items = createItems(2);
+    int changedContainer;
+    database->addObjects(items, &changedContainer);
+    int parentID = items.front()->getParentID();
+
+    DirectoryState state { 1000, 42 };
+    database->storeDirectoryState(parentID, state);
+    ASSERT_TRUE(database->loadDirectoryState(parentID, state));
+
+    // the next rescan must not skip the directory, the file of the item is still there
+    database->removeObject(items[1]->getID(), false);
+    EXPECT_FALSE(database->loadDirectoryState(parentID, state));
+}
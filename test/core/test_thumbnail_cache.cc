@@ -0,0 +1,104 @@
+#include "../mock/config_mock.h"
+#include "../mock/temp_dir_test.h"
+#include "database/database.h"
+#include "metadata/thumbnail_cache.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace ::testing;
+
+class ThumbnailCacheTest : public TempDirTest {
+public:
+    ThumbnailCacheTest()
+        : TempDirTest("thumbnail")
+    {
+    }
+
+    fs::path addFile(const std::string& name, const std::string& content = "video")
+    {
+        return writeFile(fs::path("media") / name, content);
+    }
+
+    std::unique_ptr<ThumbnailCache> createCache(std::size_t maxSize, int background = 0, std::shared_ptr<Config> config = nullptr)
+    {
+        return std::make_unique<ThumbnailCache>(config, dir / "cache", maxSize, 1, background, [this](const fs::path& file, const std::string& variant) {
+            generated++;
+            return std::vector<std::byte>(100, std::byte { 42 });
+        });
+    }
+
+    std::atomic_int generated {};
+};
+
+TEST(ThumbnailCachePath, KeyedByFileIdentity)
+{
+    FileIdentity identity { 0x801, 0x1234, 1000, 1600000000 };
+    EXPECT_EQ(getThumbnailCachePath("/data/cache", identity), fs::path { "/data/cache/34/801-1234-3e8-5f5e1000.jpg" });
+
+    FileIdentity modified { 0x801, 0x1234, 1000, 1600000001 };
+    EXPECT_NE(getThumbnailCachePath("/data/cache", identity), getThumbnailCachePath("/data/cache", modified));
+}
+
+TEST_F(ThumbnailCacheTest, WarmCacheDoesNotGenerate)
+{
+    auto file = addFile("a.mkv");
+    {
+        auto subject = createCache(0);
+        EXPECT_FALSE(subject->lookup(file).has_value());
+        EXPECT_EQ(subject->get(file).size(), 100);
+        EXPECT_EQ(subject->get(file).size(), 100);
+        EXPECT_EQ(generated, 1);
+    }
+
+    // the files are found again after a restart
+    auto subject = createCache(0);
+    EXPECT_EQ(subject->getCount(), 1);
+    EXPECT_TRUE(subject->lookup(file).has_value());
+    EXPECT_EQ(generated, 1);
+}
+
+TEST_F(ThumbnailCacheTest, ChangedFileIsGeneratedAgain)
+{
+    auto file = addFile("a.mkv");
+    auto subject = createCache(0);
+    subject->get(file);
+    addFile("a.mkv", "longer video");
+
+    EXPECT_FALSE(subject->lookup(file).has_value());
+    subject->get(file);
+    EXPECT_EQ(generated, 2);
+}
+
+TEST_F(ThumbnailCacheTest, EvictsLeastRecentlyUsed)
+{
+    auto fileA = addFile("a.mkv");
+    auto fileB = addFile("b.mkv");
+    auto fileC = addFile("c.mkv");
+    auto subject = createCache(250);
+
+    subject->get(fileA);
+    subject->get(fileB);
+    EXPECT_TRUE(subject->lookup(fileA).has_value());
+    subject->get(fileC);
+
+    EXPECT_EQ(subject->getSize(), 200);
+    EXPECT_TRUE(subject->lookup(fileA).has_value());
+    EXPECT_FALSE(subject->lookup(fileB).has_value());
+    EXPECT_TRUE(subject->lookup(fileC).has_value());
+}
+
+TEST_F(ThumbnailCacheTest, QueuedFilesAreGeneratedInBackground)
+{
+    auto file = addFile("a.mkv");
+    auto subject = createCache(0, 1, std::make_shared<NiceMock<ConfigMock>>());
+
+    subject->enqueue(file);
+    for (int i = 0; i < 500 && subject->getCount() == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_EQ(subject->get(file).size(), 100);
+    EXPECT_EQ(generated, 1);
+    subject->shutdown();
+}
@@ -20,6 +20,7 @@ public:
     void shutdown() override { }
 
     void addObject(std::shared_ptr<CdsObject> object, int* changedContainer) override { }
+    void addObjects(const std::vector<std::shared_ptr<CdsObject>>& objects, int* changedContainer) override { }
     void addContainerChain(std::string path, const std::string& lastClass, int lastRefID, int* containerID,
         std::vector<int>& updateID, const std::map<std::string, std::string>& lastMetadata) override { }
     fs::path buildContainerPath(int parentID, const std::string& title) override { return ""; }
@@ -36,10 +37,13 @@ public:
 
     std::shared_ptr<CdsObject> loadObject(int objectID) override { return nullptr; }
     int getChildCount(int contId, bool containers = true, bool items = true, bool hideFsRoot = false) override { return 0; }
+    void checkChildCounts() override { }
 
     std::unique_ptr<ChangedContainers> removeObject(int objectID, bool all) override { return nullptr; }
     std::unique_ptr<std::unordered_set<int>> getObjects(int parentID, bool withoutContainer) override { return nullptr; }
     std::unique_ptr<ChangedContainers> removeObjects(const std::unique_ptr<std::unordered_set<int>>& list, bool all = false) override { return nullptr; }
+    std::unique_ptr<ChangedContainers> moveObject(int objectID, const fs::path& location, const std::string& title, std::vector<int>& movedItems) override { return nullptr; }
+    std::unique_ptr<std::unordered_set<int>> getReferences(const std::vector<int>& objectIDs) override { return nullptr; }
 
     std::shared_ptr<CdsObject> loadObjectByServiceID(const std::string& serviceID) override { return nullptr; }
     std::unique_ptr<std::vector<int>> getServiceObjectIDs(char servicePrefix) override { return nullptr; }
@@ -49,6 +53,15 @@ public:
     std::string getInternalSetting(const std::string& key) override { return ""; }
     void storeInternalSetting(const std::string& key, const std::string& value) override { }
 
+    bool loadCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) override { return false; }
+    void storeCachedMetadata(const FileIdentity& identity, const std::shared_ptr<CdsItem>& item) override { }
+    std::shared_ptr<CdsObject> findObjectByIdentity(const FileIdentity& identity) override { return nullptr; }
+    void pruneMetadataCache() override { }
+
+    bool loadDirectoryState(int objectID, DirectoryState& state) override { return false; }
+    void storeDirectoryState(int objectID, const DirectoryState& state) override { }
+    void pruneDirectoryStates() override { }
+
     std::vector<ConfigValue> getConfigValues() override
     {
         std::vector<ConfigValue> result;
@@ -0,0 +1,45 @@
+#ifndef __TEMP_DIR_TEST_H__
+#define __TEMP_DIR_TEST_H__
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "util/tools.h"
+
+/// \brief Fixture with an empty directory for the files of each test
+class TempDirTest : public ::testing::Test {
+public:
+    /// \param name part of the directory name, e.g. the class under test
+    explicit TempDirTest(std::string name)
+        : name(std::move(name))
+    {
+    }
+
+    void SetUp() override
+    {
+        dir = fs::temp_directory_path() / fmt::format("gerbera-{}-test-{}", name, getpid());
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(dir);
+    }
+
+    /// \brief write content to a file below the directory, creating its parents
+    fs::path writeFile(const fs::path& relPath, const std::string& content)
+    {
+        auto path = dir / relPath;
+        fs::create_directories(path.parent_path());
+        writeBinaryFile(path, reinterpret_cast<const std::byte*>(content.data()), content.size());
+        return path;
+    }
+
+    fs::path dir;
+
+private:
+    std::string name;
+};
+
+#endif // __TEMP_DIR_TEST_H__
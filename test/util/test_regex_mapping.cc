@@ -0,0 +1,30 @@
+#include "util/regex_mapping.h"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+TEST(RegexMappingTest, replaceAllAppliesRulesInOrder)
+{
+    RegexMapping subject({ { "/Audio", "/Music" }, { "/Music/All", "/Music/Everything" } });
+
+    EXPECT_EQ(subject.replaceAll("/Audio/All Audio"), "/Music/Everything Audio");
+    EXPECT_EQ(subject.replaceAll("/Video/Directories"), "/Video/Directories");
+}
+
+TEST(RegexMappingTest, replaceFirstMatchNeedsFullMatch)
+{
+    RegexMapping subject({ { "Hard Rock|Metal", "Rock" }, { "^R&B$", "Soul" } }, std::regex::ECMAScript | std::regex::icase);
+
+    EXPECT_EQ(subject.replaceFirstMatch("metal"), "Rock");
+    EXPECT_EQ(subject.replaceFirstMatch("r&b"), "Soul");
+    EXPECT_EQ(subject.replaceFirstMatch("Heavy Metal"), "Heavy Metal");
+}
+
+TEST(RegexMappingTest, backReferencesAndInvalidPatterns)
+{
+    RegexMapping subject({ { "(a)\\1", "b" }, { "c", "d" }, { "(", "x" } });
+
+    EXPECT_EQ(subject.replaceAll("aac"), "bd");
+    EXPECT_EQ(subject.replaceAll("xyz"), "xyz");
+}
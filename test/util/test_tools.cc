@@ -1,5 +1,7 @@
 #include "util/tools.h"
 
+#include <cstring>
+
 #include <gtest/gtest.h>
 
 using namespace ::testing;
@@ -55,4 +57,18 @@ TEST(ToolsTest, renderWebUriV4)
 TEST(ToolsTest, renderWebUriV6)
 {
     EXPECT_EQ(renderWebUri("2001:0db8:85a3:0000:0000:8a2e:0370:7334", 7777), "[2001:0db8:85a3:0000:0000:8a2e:0370:7334]:7777");
-}
\ No newline at end of file
+}
+
+TEST(ToolsTest, isTheoraFromHeader)
+{
+    std::vector<char> header(64, '\0');
+    std::memcpy(header.data(), "OggS", 4);
+    std::memcpy(header.data() + 28, "\x01vorbis", 7);
+    EXPECT_FALSE(isTheora(header));
+
+    std::memcpy(header.data() + 28, "\x80theora", 7);
+    EXPECT_TRUE(isTheora(header));
+
+    header.resize(30);
+    EXPECT_FALSE(isTheora(header));
+}